@@ -8,6 +8,7 @@
 #include <eepp/system/compression.hpp>
 #include <eepp/system/condition.hpp>
 #include <eepp/system/directorypack.hpp>
+#include <eepp/system/directorywalker.hpp>
 #include <eepp/system/filesystem.hpp>
 #include <eepp/system/functionstring.hpp>
 #include <eepp/system/inifile.hpp>
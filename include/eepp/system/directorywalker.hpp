@@ -0,0 +1,135 @@
+#ifndef EE_SYSTEM_DIRECTORYWALKER_HPP
+#define EE_SYSTEM_DIRECTORYWALKER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <eepp/config.hpp>
+#include <eepp/core/noncopyable.hpp>
+#include <eepp/system/threadpool.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace EE { namespace System {
+
+/** Walks a directory tree recursively in parallel.
+ * Every directory is read by its own thread pool task, that posts a task for each subdirectory it
+ * finds. Tasks never wait for work, so the pool threads are free to run any other task between
+ * directories. The entry type is taken from the directory listing when the platform provides it,
+ * so most entries are never stat'ed.
+ * Entries are filtered while walking (an ignored directory is never read) and streamed to the
+ * consumer in batches. */
+class EE_API DirectoryWalker : public std::enable_shared_from_this<DirectoryWalker>,
+							   NonCopyable {
+  public:
+	struct Entry {
+		/** The directory containing the entry, ends with a slash. */
+		std::string directory;
+		std::string name;
+		bool isDirectory{ false };
+		bool isLink{ false };
+
+		std::string getPath() const { return directory + name; }
+	};
+
+	/** Decides which entries are walked. A filter can return a different filter for the entries
+	 * of a directory, so rules like the ones of nested ignore files only apply to their tree.
+	 * Filters are shared between the walking threads, they must be thread safe. */
+	class EE_API Filter : public std::enable_shared_from_this<Filter> {
+	  public:
+		virtual ~Filter() {}
+
+		/** @return True if the entry must not be reported. An ignored directory isn't walked. */
+		virtual bool ignore( const Entry& entry ) const = 0;
+
+		/** @return The filter for the entries of the directory path. By default the same one. */
+		virtual std::shared_ptr<const Filter> enterDirectory( const std::string& /*path*/ ) const {
+			return shared_from_this();
+		}
+	};
+
+	typedef std::function<void( std::vector<Entry>&& )> BatchCb;
+	typedef std::function<void()> DoneCb;
+
+	static constexpr size_t DEFAULT_BATCH_SIZE = 1024;
+
+	static std::shared_ptr<DirectoryWalker>
+	createShared( const std::string& path, std::shared_ptr<const Filter> filter = nullptr,
+				  bool followLinks = true );
+
+	DirectoryWalker( const std::string& path, std::shared_ptr<const Filter> filter = nullptr,
+					 bool followLinks = true );
+
+	/** Walks the tree in the thread pool. onBatch is called with the entries found (never
+	 * concurrently), and onDone once the walk finished. Both are called from the walking threads.
+	 * A stopped walk only calls onDone if a directory was being read when it stopped. */
+	void run( std::shared_ptr<ThreadPool> pool, const BatchCb& onBatch, const DoneCb& onDone,
+			  size_t batchSize = DEFAULT_BATCH_SIZE );
+
+	/** Walks the tree in the calling thread. */
+	void run( const BatchCb& onBatch, size_t batchSize = DEFAULT_BATCH_SIZE );
+
+	/** Stops the walk, the directories pending are not read. */
+	void stop();
+
+	/** Blocks until the walk finished and its done callback returned. */
+	void wait();
+
+	bool isRunning() const;
+
+	bool isStopped() const;
+
+	const std::string& getPath() const { return mPath; }
+
+  protected:
+	struct PendingDirectory {
+		std::string path;
+		// The path with the links resolved, to not walk a directory twice through links
+		std::string realPath;
+		std::shared_ptr<const Filter> filter;
+	};
+
+	std::string mPath;
+	std::shared_ptr<const Filter> mFilter;
+	bool mFollowLinks{ true };
+	std::unordered_set<std::string> mVisited;
+	// Directory tasks posted that didn't finish yet
+	size_t mActive{ 0 };
+	// Tasks reading a directory or calling the callbacks
+	size_t mWorkers{ 0 };
+	bool mRunning{ false };
+	bool mDone{ false };
+	std::atomic<bool> mStopped{ false };
+	mutable std::mutex mMutex;
+	std::condition_variable mCond;
+	// Entries of the directories already read that didn't fill a batch yet
+	std::vector<Entry> mBatch;
+	std::mutex mBatchMutex;
+	BatchCb mOnBatch;
+	DoneCb mOnDone;
+	size_t mBatchSize{ DEFAULT_BATCH_SIZE };
+
+	PendingDirectory start();
+
+	void post( const std::shared_ptr<ThreadPool>& pool, PendingDirectory&& dir );
+
+	void walk( const std::weak_ptr<ThreadPool>& weakPool, const PendingDirectory& dir );
+
+	void readDirectory( const PendingDirectory& dir, std::vector<Entry>& batch,
+						std::vector<PendingDirectory>& subdirs, const BatchCb& onBatch,
+						size_t batchSize );
+
+	bool visit( const std::string& realPath );
+
+	void flush( std::vector<Entry>& batch, const BatchCb& onBatch );
+
+	/** Adds the entries to the shared batch, that is delivered once it's filled. */
+	void collect( std::vector<Entry>& batch );
+};
+
+}} // namespace EE::System
+
+#endif // EE_SYSTEM_DIRECTORYWALKER_HPP
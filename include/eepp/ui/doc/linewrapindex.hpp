@@ -0,0 +1,74 @@
+#ifndef EE_UI_DOC_LINEWRAPINDEX_HPP
+#define EE_UI_DOC_LINEWRAPINDEX_HPP
+
+#include <eepp/config.hpp>
+#include <eepp/core/string.hpp>
+#include <eepp/ui/doc/textposition.hpp>
+#include <functional>
+#include <vector>
+
+namespace EE { namespace UI { namespace Doc {
+
+enum class LineWrapMode { NoWrap, Letter, Word };
+
+/** Maps document lines to visual lines when soft wrap is enabled.
+ * Each document line keeps the columns where it's broken, and a Fenwick tree over the number of
+ * visual lines of each document line resolves both directions of the mapping in O(log n). */
+class EE_API LineWrapIndex {
+  public:
+	typedef std::function<Float( String::StringBaseType )> CharWidthFn;
+
+	/** @return The columns where a line must be broken so each segment fits in maxWidth. */
+	static std::vector<Int64> computeLineBreaks( const String& text, Float maxWidth,
+												 LineWrapMode mode, const CharWidthFn& charWidth );
+
+	/** Resets the index to linesCount unwrapped lines. */
+	void reset( Int64 linesCount );
+
+	void clear();
+
+	Int64 linesCount() const;
+
+	Int64 visualLinesCount() const;
+
+	void setLineBreaks( Int64 line, std::vector<Int64>&& breaks );
+
+	/** Replaces the breaks of every line, breaks size must match the lines count. */
+	void setLinesBreaks( std::vector<std::vector<Int64>>&& breaks );
+
+	const std::vector<Int64>& getLineBreaks( Int64 line ) const;
+
+	/** Inserts count unwrapped lines before line at. */
+	void insertLines( Int64 at, Int64 count );
+
+	void removeLines( Int64 at, Int64 count );
+
+	/** @return The first visual line of a document line. */
+	Int64 getVisualLine( Int64 line ) const;
+
+	/** @return The visual line that contains the document position. */
+	Int64 getVisualLine( const TextPosition& position ) const;
+
+	/** @return The column where the visual segment containing position starts. */
+	Int64 getSegmentStart( const TextPosition& position ) const;
+
+	/** @return The document line and the column where a visual line starts. */
+	TextPosition getVisualLineStart( Int64 visualLine ) const;
+
+	/** @return The column where a visual line ends (exclusive). */
+	Int64 getVisualLineEnd( Int64 visualLine, Int64 lineLength ) const;
+
+  protected:
+	std::vector<std::vector<Int64>> mBreaks;
+	std::vector<Int64> mTree;
+
+	void buildTree();
+
+	void add( Int64 line, Int64 delta );
+
+	Int64 prefixSum( Int64 count ) const;
+};
+
+}}} // namespace EE::UI::Doc
+
+#endif // EE_UI_DOC_LINEWRAPINDEX_HPP
@@ -0,0 +1,110 @@
+#ifndef EE_UI_DOC_STRUCTUREINDEX_HPP
+#define EE_UI_DOC_STRUCTUREINDEX_HPP
+
+#include <eepp/config.hpp>
+#include <eepp/core/string.hpp>
+#include <eepp/system/mutex.hpp>
+#include <eepp/ui/doc/syntaxtokenizer.hpp>
+#include <eepp/ui/doc/textrange.hpp>
+#include <vector>
+
+using namespace EE::System;
+
+namespace EE { namespace UI { namespace Doc {
+
+/** Keeps the brackets (outside strings and comments) and the indentation of every document line.
+ * A segment tree over the bracket depth changes and the indentation of the lines resolves
+ * bracket matching and fold ranges in O(log n).
+ * Lines are indexed from the highlighter tokens. A line that has not been indexed yet, or that
+ * changed since it was indexed, is unknown: queries that need it report it so the caller can
+ * index it and retry. */
+class EE_API StructureIndex {
+  public:
+	struct Bracket {
+		Int32 column;
+		String::StringBaseType ch;
+	};
+
+	static bool isOpenBracket( String::StringBaseType ch );
+
+	static bool isCloseBracket( String::StringBaseType ch );
+
+	/** @return The bracket that pairs with ch, or 0 if ch is not a bracket. */
+	static String::StringBaseType getPairBracket( String::StringBaseType ch );
+
+	/** Resets the index to linesCount unknown lines. */
+	void reset( Int64 linesCount );
+
+	void clear();
+
+	Int64 linesCount() const;
+
+	/** Indexes a line. If tokens is null every bracket in the line is counted. */
+	void setLine( Int64 line, const String& text, const std::vector<SyntaxTokenPosition>* tokens );
+
+	void invalidateLine( Int64 line );
+
+	/** Inserts (numLines > 0) or removes (numLines < 0) lines after fromLine, the same way
+	 * SyntaxHighlighter::moveHighlight does. Inserted lines are unknown. Linear on the lines
+	 * after fromLine, without indexing any line again. */
+	void moveLines( Int64 fromLine, Int64 numLines );
+
+	/** @return The position of the bracket that matches the bracket at position. Invalid if there
+	 * isn't a bracket at position, the brackets are unbalanced or an unknown line was reached, in
+	 * which case unknownLine is set to it. */
+	TextPosition getMatchingBracket( const TextPosition& position,
+									 Int64* unknownLine = nullptr ) const;
+
+	/** @return The range that can be folded at line: from the outermost bracket of the line closed
+	 * in a later line to its matching bracket. If there's none, from the end of the line to the
+	 * end of the last following line indented deeper than it. */
+	TextRange getFoldRange( Int64 line, Int64* unknownLine = nullptr ) const;
+
+	/** @return The indentation width of the line, or -1 if it's blank or unknown. */
+	Int64 getIndentation( Int64 line ) const;
+
+  protected:
+	struct Line {
+		std::vector<Bracket> brackets;
+		Int32 length{ 0 };
+		Int32 indent{ -1 };
+		bool known{ false };
+	};
+
+	struct Node {
+		Int32 sum;
+		Int32 minPrefix;
+		Int32 maxSuffix;
+		Int32 minIndent;
+	};
+
+	mutable Mutex mMutex;
+	std::vector<Line> mLines;
+	std::vector<Node> mTree;
+	Int64 mTreeSize{ 0 };
+
+	static Node leaf( const Line& line );
+
+	static Node combine( const Node& left, const Node& right );
+
+	void buildTree();
+
+	void updateTree( Int64 line );
+
+	Int64 findForward( Int64 node, Int64 nodeStart, Int64 nodeEnd, Int64 from, Int64& acc,
+					   Int64 threshold ) const;
+
+	Int64 findBackward( Int64 node, Int64 nodeStart, Int64 nodeEnd, Int64 to, Int64& acc,
+						Int64 threshold ) const;
+
+	Int64 findIndentation( Int64 node, Int64 nodeStart, Int64 nodeEnd, Int64 from,
+						   Int64 indent ) const;
+
+	TextPosition matchForward( Int64 line, size_t index, Int64* unknownLine ) const;
+
+	TextPosition matchBackward( Int64 line, size_t index, Int64* unknownLine ) const;
+};
+
+}}} // namespace EE::UI::Doc
+
+#endif // EE_UI_DOC_STRUCTUREINDEX_HPP
@@ -135,9 +135,15 @@ class EE_API SyntaxDefinition {
 
 	const Uint16& getLanguageIndex() const { return mLanguageIndex; }
 
+	/** @return A hash of the patterns and symbols of the definition and its sub syntaxes, changes
+	 * every time any of them changes. Zero if the sub syntaxes are only known when tokenizing. */
+	Uint64 getSignature() const;
+
   protected:
 	friend class SyntaxDefinitionManager;
 
+	Uint64 getOwnSignature() const;
+
 	std::string mLanguageName;
 	String::HashType mLanguageId;
 	std::vector<std::string> mFiles;
@@ -3,9 +3,14 @@
 
 #include <eepp/config.hpp>
 #include <eepp/system/iostream.hpp>
+#include <eepp/system/mutex.hpp>
 #include <eepp/system/pack.hpp>
 #include <eepp/system/singleton.hpp>
 #include <eepp/ui/doc/syntaxdefinition.hpp>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -13,6 +18,19 @@ using namespace EE::System;
 
 namespace EE { namespace UI { namespace Doc {
 
+/** The metadata needed to find a bundled language. The language definition is only built (by
+ * calling load, that must add the language) the first time it's requested. The pre-definition is
+ * the source of the language metadata, the definition built inherits it. */
+struct EE_API SyntaxPreDefinition {
+	std::string language;
+	std::function<void()> load;
+	std::vector<std::string> files;
+	std::vector<std::string> headers{};
+	std::string lspName{};
+	bool visible{ true };
+	bool extensionPriority{ false };
+};
+
 class EE_API SyntaxDefinitionManager {
 	SINGLETON_DECLARE_HEADERS( SyntaxDefinitionManager )
   public:
@@ -20,6 +38,9 @@ class EE_API SyntaxDefinitionManager {
 
 	SyntaxDefinition& add( SyntaxDefinition&& syntaxStyle );
 
+	/** Registers a language that will be loaded on demand. */
+	void addPreDefinition( SyntaxPreDefinition&& preDefinition );
+
 	const SyntaxDefinition& getPlainDefinition() const;
 
 	std::vector<const SyntaxDefinition*>
@@ -41,6 +62,8 @@ class EE_API SyntaxDefinitionManager {
 
 	const SyntaxDefinition& getByLanguageName( const std::string& name ) const;
 
+	/** Doesn't lock once the language is loaded, it's used by the tokenizer to restore the
+	 * sub-languages states. */
 	const SyntaxDefinition& getByLanguageIndex( const Uint32& index ) const;
 
 	const SyntaxDefinition& getByLanguageNameInsensitive( std::string name ) const;
@@ -71,19 +94,96 @@ class EE_API SyntaxDefinitionManager {
 
 	bool loadFromPack( Pack* Pack, const std::string& filePackPath );
 
+	/** Loads every precompiled (.esdb) and JSON language definition in the folder. JSON files
+	 * compiled into a precompiled file that loaded are skipped, unless they were modified after
+	 * being compiled. */
 	void loadFromFolder( const std::string& folderPath );
 
-	const std::vector<SyntaxDefinition>& getDefinitions() const;
+	/** @return The definitions sorted by language index, without loading any language. The
+	 * languages that are only pre-defined contain just their metadata: name, file types, headers,
+	 * LSP name and visibility. */
+	std::vector<const SyntaxDefinition*> getDefinitionsMetadata() const;
+
+	/** Loads every language that is only pre-defined and returns all the definitions, sorted by
+	 * language index. */
+	std::vector<const SyntaxDefinition*> loadAllDefinitions() const;
 
 	/* empty = all */
 	bool save( const std::string& path, const std::vector<SyntaxDefinition>& def = {} );
 
+	/** Saves the definitions in the precompiled binary format, that can be loaded with any of the
+	 * loadFrom functions without parsing JSON. empty = all. Definitions with a dynamic syntax
+	 * can't be compiled and are skipped.
+	 * @param sourceFiles The language files compiled, loadFromFolder skips them. */
+	bool saveCompiled( const std::string& path, const std::vector<SyntaxDefinition>& def = {},
+					   const std::vector<std::string>& sourceFiles = {} );
+
   protected:
 	SyntaxDefinitionManager();
 
-	std::vector<SyntaxDefinition> mDefinitions;
-
-	std::optional<size_t> getLanguageIndex( const std::string& langName );
+	static constexpr size_t SLOTS_PER_CHUNK = 256;
+
+	// The definition published for a language index. Pre-defined languages point to their
+	// metadata until they are loaded.
+	struct DefinitionSlot {
+		std::atomic<SyntaxDefinition*> definition{ nullptr };
+		std::atomic<bool> loaded{ false };
+	};
+
+	struct SlotsChunk {
+		DefinitionSlot slots[SLOTS_PER_CHUNK];
+	};
+
+	// Definitions are never moved nor destroyed while the manager is alive, loading or replacing
+	// a language publishes a new definition in its slot, so any reference handed out stays valid.
+	// Slots are only written under mMutex and can be read by language index without locking.
+	// The price is that a replaced definition is kept until the manager is destroyed: loading a
+	// pre-defined language keeps its metadata and every reload of a language file keeps the
+	// previous definition, so the memory grows with the number of reloads, not with time.
+	std::vector<std::unique_ptr<SyntaxDefinition>> mDefinitions;
+	std::vector<std::unique_ptr<SlotsChunk>> mSlotsChunks;
+	std::array<std::atomic<SlotsChunk*>, 256> mSlots{};
+	std::atomic<size_t> mDefinitionsCount{ 0 };
+	mutable Mutex mMutex;
+	// Loaders of the languages that haven't been loaded yet, by language index
+	mutable UnorderedMap<size_t, std::function<void()>> mPreDefinitions;
+	// File types index: "%.ext$" patterns by extension and plain file types by name, as pairs of
+	// language index and file type index. Any other pattern is matched one by one.
+	mutable UnorderedMap<std::string, std::vector<std::pair<size_t, size_t>>> mFileTypesByExtension;
+	mutable UnorderedMap<std::string, std::vector<std::pair<size_t, size_t>>> mFileTypesByName;
+	mutable std::vector<std::pair<size_t, size_t>> mFileTypesPatterns;
+	mutable bool mFileTypesIndexDirty{ true };
+
+	std::optional<size_t> getLanguageIndex( const std::string& langName ) const;
+
+	DefinitionSlot& getSlot( size_t index ) const;
+
+	/** @return The definition currently published for the language index, it can be only the
+	 * metadata of a pre-defined language. */
+	SyntaxDefinition& getDefinition( size_t index ) const;
+
+	/** Publishes the definition in the language index slot, index equal to the definitions count
+	 * adds a new slot. Must be called with mMutex locked. */
+	SyntaxDefinition& setDefinition( size_t index, SyntaxDefinition&& def, bool loaded );
+
+	/** Adds a language loaded from a file, or replaces the language with the same name. */
+	void addLoaded( SyntaxDefinition&& def, std::vector<std::string>* addedLangs );
+
+	// Modification time of the source files compiled, by file name
+	using CompiledSources = UnorderedMap<std::string, Uint64>;
+
+	bool loadCompiled( const std::string& buffer, std::vector<std::string>* addedLangs,
+					   CompiledSources* sources = nullptr );
+
+	/** Loads the language if it's only pre-defined. */
+	const SyntaxDefinition& load( const SyntaxDefinition& def ) const;
+
+	void updateFileTypesIndex() const;
+
+	/** @return The pairs of language index and file type index that match, sorted. Patterns are
+	 * matched against patternSubject and plain file types against exactSubject. */
+	std::vector<std::pair<size_t, size_t>>
+	getFileTypesMatches( const std::string& patternSubject, const std::string& exactSubject ) const;
 };
 
 }}} // namespace EE::UI::Doc
@@ -1,8 +1,11 @@
 #ifndef EE_UI_DOC_SYNTAXHIGHLIGHTER_HPP
 #define EE_UI_DOC_SYNTAXHIGHLIGHTER_HPP
 
+#include <atomic>
+#include <eepp/ui/doc/structureindex.hpp>
 #include <eepp/ui/doc/syntaxtokenizer.hpp>
 #include <eepp/ui/doc/textdocument.hpp>
+#include <memory>
 #include <unordered_map>
 
 namespace EE { namespace UI { namespace Doc {
@@ -19,6 +22,43 @@ struct EE_API TokenizedLine {
 	static Uint64 calcSignature( const std::vector<SyntaxTokenPosition>& tokens );
 };
 
+/** Line-indexed storage of tokenized lines.
+ * Lines are kept in fixed capacity chunks, so inserting or removing lines only shifts the lines
+ * of the affected chunk. Lines are moved by insert and erase: a reference to a line is only valid
+ * until the next insert, erase or clear, and must be used while holding the highlighter lines
+ * mutex. A line with a zero hash is considered not tokenized. */
+class EE_API TokenizedLines {
+  public:
+	explicit TokenizedLines( size_t chunkCapacity = 512 );
+
+	size_t size() const { return mSize; }
+
+	void clear();
+
+	/** @return The tokenized line at index or nullptr if the line has not been tokenized. */
+	TokenizedLine* find( size_t index );
+
+	TokenizedLine& operator[]( size_t index );
+
+	void insert( size_t index, size_t count );
+
+	void erase( size_t index, size_t count );
+
+  protected:
+	using Chunk = std::vector<TokenizedLine>;
+
+	std::vector<std::unique_ptr<Chunk>> mChunks;
+	std::vector<size_t> mChunkStart;
+	size_t mChunkCapacity;
+	size_t mSize{ 0 };
+
+	std::unique_ptr<Chunk> newChunk() const;
+
+	size_t chunkIndex( size_t index ) const;
+
+	void updateChunkStarts( size_t fromChunk );
+};
+
 class EE_API SyntaxHighlighter {
   public:
 	explicit SyntaxHighlighter( TextDocument* doc );
@@ -50,6 +90,14 @@ class EE_API SyntaxHighlighter {
 
 	void mergeLine( const size_t& line, const TokenizedLine& tokenization );
 
+	/** Sets a layer of tokens that is merged over the tokenizer output, like the semantic tokens
+	 * of a language server. Replaces the previous layer.
+	 * A line is merged when it's requested, so only the displayed lines pay for it. A layer line
+	 * only applies while the document line keeps the hash of the layer line. */
+	void setOverlayLines( UnorderedMap<size_t, TokenizedLine>&& lines );
+
+	void clearOverlayLines();
+
 	TokenizedLine tokenizeLine( const size_t& line, const SyntaxState& state = SyntaxState{} );
 
 	Mutex& getLinesMutex();
@@ -62,6 +110,25 @@ class EE_API SyntaxHighlighter {
 
 	void setMaxTokenizationLength( const Int64& maxTokenizationLength );
 
+	/** @return True if the line is longer than the max tokenization length. Long lines are split
+	 * in segments of max tokenization length characters that are tokenized on demand. */
+	bool isLongLine( const size_t& index ) const;
+
+	size_t getLongLineSegmentsCount( const size_t& index ) const;
+
+	/** Tokenizes (or returns the cached tokenization of) a segment of a long line. Token positions
+	 * are line columns. A segment is tokenized from the exit state of the previous one, so the
+	 * segments before it are tokenized first if their state is not cached yet. */
+	std::vector<SyntaxTokenPosition> getLongLineSegment( const size_t& index,
+														 const size_t& segment );
+
+	/** The brackets and indentation index of the document, it's kept up to date with every line
+	 * that gets tokenized, including the lines tokenized in the background. */
+	StructureIndex& getStructureIndex() { return mStructure; }
+
+	/** Indexes the line structure, tokenizing it if needed. */
+	void indexStructure( const size_t& index );
+
 	void tokenizeAsync( std::shared_ptr<ThreadPool> pool,
 						const std::function<void()>& onDone = {} );
 
@@ -69,16 +136,47 @@ class EE_API SyntaxHighlighter {
 
 	void setStopTokenizingAsync() { mStopTokenizing = true; }
 
+	/** Stores the valid tokenized lines of the document into a cache file. */
+	bool saveCache( const std::string& path );
+
+	/** Serializes the valid tokenized lines of the document in the cache file format, so the
+	 * file can be written from another thread.
+	 * @return False if there's nothing to store. */
+	bool saveCache( std::vector<Uint8>& data );
+
+	/** Restores the tokenization from a cache file. Only the lines before the first line that
+	 * changed since the cache was saved are restored.
+	 * @return The number of lines restored. */
+	Int64 loadCache( const std::string& path );
+
   protected:
 	TextDocument* mDoc;
-	std::unordered_map<size_t, TokenizedLine> mLines;
+	TokenizedLines mLines;
+	// Original tokenizer output of the lines modified by mergeLine or by the overlay
 	UnorderedMap<size_t, TokenizedLine> mTokenizerLines;
+	UnorderedMap<size_t, TokenizedLine> mOverlayLines;
+	struct LongLineSegments {
+		String::HashType hash{ 0 };
+		SyntaxState initState;
+		UnorderedMap<size_t, std::vector<SyntaxTokenPosition>> segments;
+		// Exit state of every segment tokenized so far, in segment order
+		std::vector<SyntaxState> states;
+	};
+	UnorderedMap<size_t, LongLineSegments> mLongLines;
 	Mutex mLinesMutex;
+	StructureIndex mStructure;
 	Int64 mFirstInvalidLine;
 	Int64 mMaxWantedLine;
 	Int64 mMaxTokenizationLength{ 0 };
-	bool mTokenizeAsync{ false };
-	bool mStopTokenizing{ false };
+	std::atomic<bool> mTokenizeAsync{ false };
+	std::atomic<bool> mStopTokenizing{ false };
+
+	void updateStructure( const size_t& index, const TokenizedLine& line );
+
+	void applyOverlay( const size_t& index, TokenizedLine& line );
+
+	void tokenizeSpeculative( std::shared_ptr<ThreadPool> pool, Int64 fromLine, Int64 toLine,
+							  Int64 numChunks, const std::function<void()>& onDone );
 };
 
 }}} // namespace EE::UI::Doc
@@ -14,6 +14,7 @@
 #include <eepp/system/time.hpp>
 #include <eepp/ui/doc/syntaxdefinition.hpp>
 #include <eepp/ui/doc/textdocumentline.hpp>
+#include <eepp/ui/doc/textdocumentsnapshot.hpp>
 #include <eepp/ui/doc/textformat.hpp>
 #include <eepp/ui/doc/textposition.hpp>
 #include <eepp/ui/doc/textrange.hpp>
@@ -50,6 +51,20 @@ class EE_API TextDocument {
 		virtual ~Client();
 		virtual void onDocumentLoaded( TextDocument* ){};
 		virtual void onDocumentTextChanged( const DocumentContentChange& ) = 0;
+		/** Changes from a batched edit, sorted from the top to the bottom of the document. Each
+		 * range is expressed in the document with the previous changes applied, so they can be
+		 * applied sequentially. By default each change is notified as the removal of its range
+		 * followed by the insertion of its text, like single edits are. */
+		virtual void
+		onDocumentBatchTextChanged( const std::vector<DocumentContentChange>& changes ) {
+			for ( const auto& change : changes ) {
+				if ( change.range.hasSelection() )
+					onDocumentTextChanged( { change.range, String() } );
+				if ( !change.text.empty() )
+					onDocumentTextChanged(
+						{ { change.range.start(), change.range.start() }, change.text } );
+			}
+		}
 		virtual void onDocumentUndoRedo( const UndoRedo& eventType ) = 0;
 		virtual void onDocumentCursorChange( const TextPosition& ) = 0;
 		virtual void onDocumentInterestingCursorChange( const TextPosition& ){};
@@ -72,6 +87,8 @@ class EE_API TextDocument {
 
 	typedef std::function<void()> DocumentCommand;
 	typedef std::function<void( Client* )> DocumentRefCommand;
+	typedef std::function<void( const TextRanges& )> FindAllResultsCb;
+	typedef std::function<void( TextRanges&&, bool cancelled )> FindAllDoneCb;
 
 
 	TextDocument( bool verbose = true );
@@ -178,6 +195,17 @@ class EE_API TextDocument {
 
 	size_t remove( const size_t& cursorIdx, TextRange range );
 
+	/** Applies several edits as a single transaction. Each edit replaces its range (in current
+	 * document coordinates) with its text. Edits are applied in one sorted pass, overlapping
+	 * edits are discarded, selections are remapped once, clients receive the whole set of changes
+	 * at once and the batch is recorded as a single undo group.
+	 * @param cursorIdxs The cursor of each edit, recorded in the undo history. Edits without one
+	 * are recorded for the first cursor.
+	 * @return The resulting range of each edit in the order they were provided, invalid for the
+	 * discarded ones. */
+	std::vector<TextRange> applyEdits( const std::vector<DocumentContentChange>& edits,
+									   const std::vector<size_t>& cursorIdxs = {} );
+
 	TextPosition positionOffset( TextPosition position, int columnOffset ) const;
 
 	TextPosition positionOffset( TextPosition position, TextPosition offset ) const;
@@ -358,6 +386,16 @@ class EE_API TextDocument {
 						FindReplaceType type = FindReplaceType::Normal,
 						TextRange restrictRange = TextRange(), size_t maxResults = 0 );
 
+	/** Searches all the occurrences in parallel in the thread pool, the call returns immediately.
+	 * The document lines are split in chunks, the chunks closer to the priority range (usually the
+	 * visible range) are searched first and their results are streamed to onResults as soon as
+	 * they are ready (called from the thread pool). onDone receives all the results sorted. The
+	 * search is cancelled by stopActiveFindAll. */
+	void findAllAsync( std::shared_ptr<ThreadPool> pool, const String& text, bool caseSensitive,
+					   bool wholeWord, FindReplaceType type, TextRange restrictRange,
+					   TextRange priorityRange, const FindAllResultsCb& onResults,
+					   const FindAllDoneCb& onDone );
+
 	int replaceAll( const String& text, const String& replace, const bool& caseSensitive = true,
 					const bool& wholeWord = false, FindReplaceType type = FindReplaceType::Normal,
 					TextRange restrictRange = TextRange() );
@@ -549,6 +587,10 @@ class EE_API TextDocument {
 								  const String& closeBracket, MatchDirection dir,
 								  bool matchingXMLTags = false );
 
+	/** @return The foldable range that starts at line, based on its brackets or its indentation.
+	 * @see StructureIndex::getFoldRange */
+	TextRange getFoldRange( Int64 line );
+
 	SyntaxHighlighter* getHighlighter() const;
 
 	TextRange getWordRangeInPosition( const TextPosition& pos, bool basedOnHighlighter = true );
@@ -571,6 +613,11 @@ class EE_API TextDocument {
 
 	const Uint64& getModificationId() const;
 
+	/** @return An immutable snapshot of the current document lines tagged with the modification
+	 * id, that can be read from any thread. Must be called from the thread that edits the
+	 * document. Repeated calls without modifications return the same snapshot. */
+	std::shared_ptr<const TextDocumentSnapshot> getSnapshot();
+
 	void stopActiveFindAll();
 
 	bool isDoingTextInput() const;
@@ -583,13 +630,38 @@ class EE_API TextDocument {
 
 	void setEncoding( TextFormat::Encoding encoding );
 
+	const std::string& getTokenizationCachePath() const;
+
+	/** Sets the directory used to persist the document tokenization between sessions. Large
+	 * documents will restore their highlighting from it instead of tokenizing everything again.
+	 * An empty path disables the cache. */
+	void setTokenizationCachePath( const std::string& tokenizationCachePath );
+
+	const std::string& getUndoHistoryPath() const;
+
+	/** Sets the directory used to persist the undo history between sessions. The history is
+	 * stored every time the document is saved and when it's closed, and it's only restored if the
+	 * file did not change since it was stored. An empty path disables it. */
+	void setUndoHistoryPath( const std::string& undoHistoryPath );
+
+	/** Sets the thread pool used to write the tokenization cache and the undo history, so closing
+	 * a document doesn't wait for them to be written. Without a pool they are written in the
+	 * calling thread. */
+	void setPersistencePool( std::shared_ptr<ThreadPool> pool );
+
+	TextUndoStack& getUndoStack();
+
   protected:
 	friend class TextUndoStack;
 
 	Uint64 mModificationId{ 0 };
+	std::shared_ptr<const TextDocumentSnapshot> mSnapshot;
 	TextUndoStack mUndoStack;
 	std::string mFilePath;
 	std::string mLoadingFilePath;
+	std::string mTokenizationCachePath;
+	std::string mUndoHistoryPath;
+	std::shared_ptr<ThreadPool> mPersistencePool;
 	std::array<Uint8, 16> mHash;
 	URI mFileURI;
 	URI mLoadingFileURI;
@@ -646,6 +718,8 @@ class EE_API TextDocument {
 
 	void notifyTextChanged( const DocumentContentChange& );
 
+	void notifyTextChanged( const std::vector<DocumentContentChange>& changes );
+
 	void notifyCursorChanged( TextPosition selection = TextPosition() );
 
 	void notifySelectionChanged( TextRange selection = TextRange() );
@@ -687,6 +761,14 @@ class EE_API TextDocument {
 
 	void guessIndentType();
 
+	void applyLinesDiff( const std::vector<TextDocumentLine>& newLines );
+
+	std::string getTokenizationCacheFilePath() const;
+
+	std::string getUndoHistoryFilePath() const;
+
+	void saveUndoHistory();
+
 	std::vector<bool> autoCloseBrackets( const String& text );
 
 	LoadStatus loadFromStream( IOStream& file, std::string path, bool callReset );
@@ -698,6 +780,14 @@ class EE_API TextDocument {
 	TextRange findTextLast( String text, TextPosition from = { 0, 0 }, bool caseSensitive = true,
 							bool wholeWord = false, FindReplaceType type = FindReplaceType::Normal,
 							TextRange restrictRange = TextRange() );
+
+	TextRanges findAllInRange( const String& text, bool caseSensitive, bool wholeWord,
+							   FindReplaceType type, TextRange restrictRange, size_t maxResults,
+							   bool* stopFlag );
+
+	bool* registerStopFlag();
+
+	void unregisterStopFlag( bool* stopFlag );
 };
 
 struct TextSearchParams {
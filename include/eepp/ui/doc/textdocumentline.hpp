@@ -9,6 +9,18 @@ class EE_API TextDocumentLine {
   public:
 	TextDocumentLine( const String& text ) : mText( text ) { updateHash(); }
 
+	TextDocumentLine( String&& text ) { setText( std::move( text ) ); }
+
+	TextDocumentLine( const TextDocumentLine& ) = default;
+
+	TextDocumentLine( TextDocumentLine&& line ) noexcept : mHash( line.mHash ) {
+		mText = std::move( line.mText );
+	}
+
+	TextDocumentLine& operator=( const TextDocumentLine& ) = default;
+
+	TextDocumentLine& operator=( TextDocumentLine&& ) = default;
+
 	void setText( String&& text ) {
 		mText = std::move( text );
 		updateHash();
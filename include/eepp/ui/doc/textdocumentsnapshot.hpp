@@ -0,0 +1,56 @@
+#ifndef EE_UI_DOC_TEXTDOCUMENTSNAPSHOT_HPP
+#define EE_UI_DOC_TEXTDOCUMENTSNAPSHOT_HPP
+
+#include <eepp/config.hpp>
+#include <eepp/core/string.hpp>
+#include <eepp/ui/doc/textdocumentline.hpp>
+#include <eepp/ui/doc/textrange.hpp>
+#include <memory>
+#include <vector>
+
+namespace EE { namespace UI { namespace Doc {
+
+/** An immutable view of the document lines at a given version, safe to read from any thread.
+ * The lines are stored in chunks shared between consecutive snapshots, so a new snapshot only
+ * copies the chunks that changed since the previous one. */
+class EE_API TextDocumentSnapshot {
+  public:
+	static constexpr Int64 CHUNK_LINES = 256;
+
+	struct Chunk {
+		std::vector<String> lines;
+		std::vector<String::HashType> hashes;
+	};
+
+	/** Creates a snapshot of lines reusing the unchanged chunks of the previous snapshot. */
+	static std::shared_ptr<const TextDocumentSnapshot>
+	create( const std::vector<TextDocumentLine>& lines, Uint64 version,
+			const TextDocumentSnapshot* previous = nullptr );
+
+	/** @return The document modification id when the snapshot was taken. */
+	const Uint64& getVersion() const { return mVersion; }
+
+	Int64 linesCount() const { return mLinesCount; }
+
+	/** @return The line text, including its line break. */
+	const String& line( Int64 index ) const;
+
+	String getText( const TextRange& range ) const;
+
+	String getText() const;
+
+	const std::vector<std::shared_ptr<const Chunk>>& getChunks() const { return mChunks; }
+
+  protected:
+	Uint64 mVersion{ 0 };
+	Int64 mLinesCount{ 0 };
+	std::vector<std::shared_ptr<const Chunk>> mChunks;
+	// First line of every chunk
+	std::vector<Int64> mChunksStart;
+
+	void addChunk( std::shared_ptr<const Chunk> chunk );
+};
+
+}}} // namespace EE::UI::Doc
+
+#endif // EE_UI_DOC_TEXTDOCUMENTSNAPSHOT_HPP
@@ -4,6 +4,7 @@
 #include <deque>
 #include <eepp/config.hpp>
 #include <eepp/core/string.hpp>
+#include <eepp/system/iostream.hpp>
 #include <eepp/system/time.hpp>
 #include <eepp/ui/doc/textrange.hpp>
 
@@ -27,10 +28,19 @@ class EE_API TextUndoCommand {
 
 	const Time& getTimestamp() const;
 
+	/** The last time the command was updated. Differs from the timestamp when consecutive
+	 * commands were coalesced into this one. */
+	const Time& getLastTimestamp() const;
+
+	virtual size_t getMemoryUsage() const = 0;
+
   protected:
+	friend class TextUndoStack;
+
 	Uint64 mId;
 	TextUndoCommandType mType;
 	Time mTimestamp;
+	Time mLastTimestamp;
 };
 
 class EE_API TextUndoCommandInsert : public TextUndoCommand {
@@ -38,14 +48,34 @@ class EE_API TextUndoCommandInsert : public TextUndoCommand {
 	TextUndoCommandInsert( const Uint64& id, const size_t& cursorIdx, const String& text,
 						   const TextPosition& position, const Time& timestamp );
 
-	const String& getText() const;
+	TextUndoCommandInsert( const Uint64& id, const size_t& cursorIdx, std::string&& utf8Text,
+						   const TextPosition& position, const Time& timestamp );
+
+	String getText() const;
+
+	std::string getUtf8Text() const;
 
 	const TextPosition& getPosition() const;
 
 	size_t getCursorIdx() const;
 
+	size_t getMemoryUsage() const;
+
+	bool isCompressed() const { return mUncompressedSize != 0; }
+
+	/** Compresses the text payload. Small texts and texts that didn't shrink in a previous try are
+	 * kept as is.
+	 * @return True if the payload was compressed. */
+	bool compress();
+
   protected:
-	String mText;
+	friend class TextUndoStack;
+
+	// UTF-8 text, deflated when mUncompressedSize is not 0
+	std::string mText;
+	Uint32 mUncompressedSize{ 0 };
+	// The text didn't shrink when compressed, it's not tried again until it changes
+	bool mIncompressible{ false };
 	TextPosition mPosition;
 	size_t mCursorIdx;
 };
@@ -59,7 +89,11 @@ class EE_API TextUndoCommandRemove : public TextUndoCommand {
 
 	size_t getCursorIdx() const;
 
+	size_t getMemoryUsage() const;
+
   protected:
+	friend class TextUndoStack;
+
 	TextRange mRange;
 	size_t mCursorIdx;
 };
@@ -73,6 +107,8 @@ class EE_API TextUndoCommandSelection : public TextUndoCommand {
 
 	size_t getCursorIdx() const;
 
+	size_t getMemoryUsage() const;
+
   protected:
 	TextRanges mSelection;
 	size_t mCursorIdx;
@@ -108,6 +144,23 @@ class EE_API TextUndoStack {
 
 	Uint64 getCurrentChangeId() const;
 
+	/** @return The approximate memory used by the undo and redo stacks, in bytes. */
+	size_t getMemoryUsage() const;
+
+	const size_t& getMaxMemoryUsage() const;
+
+	/** Sets the memory cap of the undo history, in bytes (0 means unbounded). The undo and the
+	 * redo stacks are capped separately. Once reached, the payload of the oldest commands is
+	 * compressed, and if that's not enough the oldest commands are discarded. */
+	void setMaxMemoryUsage( const size_t& maxMemoryUsage );
+
+	/** Serializes the undo and redo history. The document hash is stored to validate that the
+	 * history can be applied to the document when it's restored. */
+	bool save( IOStream& stream );
+
+	/** Restores the undo and redo history if it was saved for the current document contents. */
+	bool load( IOStream& stream );
+
   protected:
 	friend class TextDocument;
 
@@ -117,9 +170,25 @@ class EE_API TextUndoStack {
 	UndoStackContainer mUndoStack;
 	UndoStackContainer mRedoStack;
 	Time mMergeTimeout;
+	size_t mUndoMemoryUsage{ 0 };
+	size_t mRedoMemoryUsage{ 0 };
+	size_t mMaxMemoryUsage{ 0 };
+	bool mSkipCoalescing{ false };
 
 	void pushUndo( UndoStackContainer& undoStack, TextUndoCommand* cmd );
 
+	void popFront( UndoStackContainer& undoStack );
+
+	void enforceMemoryLimit( UndoStackContainer& undoStack );
+
+	size_t& getStackMemoryUsage( const UndoStackContainer& undoStack );
+
+	bool coalesceInsert( UndoStackContainer& undoStack, const String& string,
+						 const size_t& cursorIdx, const TextPosition& position, const Time& time );
+
+	bool coalesceRemove( UndoStackContainer& undoStack, const size_t& cursorIdx,
+						 const TextRange& range, const Time& time );
+
 	void pushInsert( UndoStackContainer& undoStack, const String& string, const size_t& cursorIdx,
 					 const TextPosition& position, const Time& time );
 
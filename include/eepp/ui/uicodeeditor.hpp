@@ -2,12 +2,14 @@
 #define EE_UI_UICODEEDIT_HPP
 
 #include <eepp/graphics/text.hpp>
+#include <eepp/ui/doc/linewrapindex.hpp>
 #include <eepp/ui/doc/syntaxcolorscheme.hpp>
 #include <eepp/ui/doc/syntaxhighlighter.hpp>
 #include <eepp/ui/doc/textdocument.hpp>
 #include <eepp/ui/keyboardshortcut.hpp>
 #include <eepp/ui/uifontstyleconfig.hpp>
 #include <eepp/ui/uiwidget.hpp>
+#include <list>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -16,6 +18,7 @@ using namespace EE::UI::Doc;
 
 namespace EE { namespace Graphics {
 class Font;
+class Primitives;
 }} // namespace EE::Graphics
 
 namespace EE { namespace UI {
@@ -633,6 +636,26 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 	bool getDisplayLockedIcon() const;
 	void setDisplayLockedIcon( bool displayLockedIcon );
 
+	size_t getGlyphRunCacheMaxLines() const;
+
+	/** Sets the maximum number of lines kept in the glyph run cache, the least recently drawn
+	 * lines are evicted first. Zero disables the cache. */
+	void setGlyphRunCacheMaxLines( size_t maxLines );
+
+	const LineWrapMode& getLineWrapMode() const;
+
+	/** Enables soft wrap: lines wider than the viewport are displayed in several visual lines. */
+	void setLineWrapMode( const LineWrapMode& lineWrapMode );
+
+	/** @return The number of visual lines, equals the lines count when soft wrap is disabled. */
+	Int64 getVisualLinesCount() const;
+
+	/** @return The visual line where a document position is displayed. */
+	Int64 getVisualLine( const TextPosition& position ) const;
+
+	/** @return The offset of a document position relative to the start of the text area. */
+	Vector2f getTextPositionOffset( const TextPosition& position ) const;
+
   protected:
 	struct LastXOffset {
 		TextPosition position{ 0, 0 };
@@ -672,6 +695,15 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 	bool mShowLinesRelativePosition{ false };
 	bool mDisplayLockedIcon{ false };
 	std::atomic<size_t> mHighlightWordProcessing{ false };
+	std::atomic<size_t> mLineWrapProcessing{ 0 };
+	std::atomic<Uint64> mLineWrapGeneration{ 0 };
+	std::atomic<size_t> mMinimapTilesProcessing{ 0 };
+	std::atomic<Uint64> mMinimapTilesGeneration{ 0 };
+	LineWrapMode mLineWrapMode{ LineWrapMode::NoWrap };
+	LineWrapIndex mLineWrap;
+	Float mLineWrapWidth{ 0 };
+	bool mLineWrapDirty{ false };
+	std::vector<Int64> mLineWrapPendingLines;
 	TextRange mLinkPosition;
 	String mLink;
 	Uint32 mTabWidth;
@@ -713,6 +745,8 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 	Clock mLastActivity;
 	TextSearchParams mHighlightWord;
 	TextRanges mHighlightWordCache;
+	Uint64 mHighlightWordCacheId{ 0 };
+	std::atomic<Uint64> mHighlightWordSearchId{ 0 };
 	Mutex mHighlightWordCacheMutex;
 	TextRange mHighlightTextRange;
 	Color mPreviewColor;
@@ -729,7 +763,44 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 		String::HashType hash;
 	};
 	mutable UnorderedMap<Int64, TextLine> mTextCache;
+	struct GlyphQuad {
+		Vector2f position;
+		Sizef size;
+		Rectf texCoords;
+		Color color;
+		bool fakeItalic;
+	};
+	struct GlyphBackground {
+		Float x;
+		Float width;
+		Color color;
+	};
+	/** The glyph quads of a line ready to be batched, relative to the line origin. Lines are keyed
+	 * by content and tokenization, so identical or moved lines share the same entry. */
+	struct LineGlyphRun {
+		String::HashType hash{ 0 };
+		Uint64 signature{ 0 };
+		bool cacheable{ true };
+		std::vector<GlyphQuad> quads;
+		std::vector<GlyphBackground> backgrounds;
+		std::list<size_t>::iterator lruIt;
+	};
+	UnorderedMap<size_t, LineGlyphRun> mGlyphRunCache;
+	std::list<size_t> mGlyphRunCacheLRU;
+	Font* mGlyphRunCacheFont{ nullptr };
+	Float mGlyphRunCacheFontSize{ 0 };
+	Uint32 mGlyphRunCacheTabWidth{ 0 };
+	size_t mGlyphRunCacheMaxLines{ 2048 };
 	UnorderedMap<Int64, std::pair<String::HashType, Float>> mLinesWidthCache;
+	/** Lines longer than the highlighter max tokenization length are measured by segments of that
+	 * length, segmentX keeps the prefix sums of the segments widths (the last one being the line
+	 * width), so column and x offsets are mapped with a binary search plus one segment scan. */
+	struct LongLineLayout {
+		String::HashType hash{ 0 };
+		Int64 segmentLength{ 0 };
+		std::vector<Float> segmentX;
+	};
+	mutable UnorderedMap<Int64, LongLineLayout> mLongLinesLayout;
 	Tools::UIDocFindReplace* mFindReplace{ nullptr };
 	struct PluginRequestedSpace {
 		UICodeEditorPlugin* plugin;
@@ -738,6 +809,32 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 	};
 	std::vector<PluginRequestedSpace> mPluginGutterSpaces;
 	Float mPluginsGutterSpace{ 0 };
+	/** The minimap text is rasterized in tiles of a fixed amount of lines. Tiles are rebuilt in
+	 * the thread pool when their lines change, and only their composite is drawn every frame. */
+	struct MinimapTileConfig {
+		int width{ 0 };
+		int charHeight{ 0 };
+		int charSpacing{ 0 };
+		int lineSpacing{ 0 };
+		int tabWidth{ 0 };
+		bool syntaxHighlight{ true };
+
+		bool operator==( const MinimapTileConfig& other ) const {
+			return width == other.width && charHeight == other.charHeight &&
+				   charSpacing == other.charSpacing && lineSpacing == other.lineSpacing &&
+				   tabWidth == other.tabWidth && syntaxHighlight == other.syntaxHighlight;
+		}
+	};
+	struct MinimapTile {
+		Texture* texture{ nullptr };
+		Uint64 version{ 0 };
+		bool dirty{ true };
+		// Built before the tokenization of its lines was complete
+		bool provisional{ false };
+		bool building{ false };
+	};
+	UnorderedMap<Int64, MinimapTile> mMinimapTiles;
+	MinimapTileConfig mMinimapTileConfig;
 	std::vector<PluginRequestedSpace> mPluginTopSpaces;
 	Float mPluginsTopSpace{ 0 };
 	Uint64 mLastExecuteEventId{ 0 };
@@ -813,6 +910,8 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 
 	virtual void onDocumentLineChanged( const Int64& lineNumber );
 
+	virtual void onDocumentLineMove( const Int64& fromLine, const Int64& numLines );
+
 	virtual void onDocumentUndoRedo( const TextDocument::UndoRedo& );
 
 	virtual void onDocumentSaved( TextDocument* );
@@ -835,6 +934,9 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 	virtual void drawLineText( const Int64& line, Vector2f position, const Float& fontSize,
 							   const Float& lineHeight );
 
+	virtual void drawWrappedLineText( const Int64& line, Vector2f position, const Float& fontSize,
+									  const Float& lineHeight );
+
 	virtual void drawSelectionMatch( const std::pair<int, int>& lineRange,
 									 const Vector2f& startScroll, const Float& lineHeight );
 
@@ -897,6 +999,15 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 
 	void drawMinimap( const Vector2f& start, const std::pair<Uint64, Uint64>& lineRange );
 
+	void drawMinimapTiles( const Vector2f& start, const MinimapTileConfig& config,
+						   const Int64& startLine, const Int64& endLine );
+
+	void updateMinimapTile( const Int64& tileIndex, MinimapTile& tile );
+
+	void invalidateMinimapTiles();
+
+	void invalidateMinimapTiles( const Int64& fromLine, bool linesMoved );
+
 	Float getMinimapLineSpacing() const;
 
 	bool isMinimapFileTooLarge() const;
@@ -923,6 +1034,8 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 
 	void updateHighlightWordCache();
 
+	void highlightWordAsync( Uint64 searchId, TextRange priorityRange );
+
 	template <typename StringType> size_t characterWidth( const StringType& str ) const;
 
 	template <typename StringType> Float getTextWidth( const StringType& text ) const;
@@ -930,6 +1043,45 @@ class EE_API UICodeEditor : public UIWidget, public TextDocument::Client {
 	void updateIMELocation();
 
 	void drawLockedIcon( const Vector2f start );
+
+	void invalidateGlyphRunCache();
+
+	const LineGlyphRun& getLineGlyphRun( const Int64& line, const Float& fontSize );
+
+	/** Draws a line from the glyph run cache.
+	 * @return False if the line can't be drawn from the cache. */
+	bool drawLineGlyphRun( const Int64& line, const Vector2f& position, const Float& fontSize,
+						   const Float& lineHeight );
+
+	bool isLongLine( const Int64& line ) const;
+
+	const LongLineLayout& getLongLineLayout( const Int64& line ) const;
+
+	/** Draws only the horizontally visible segments of a long line. */
+	void drawLongLineText( const Int64& line, Vector2f position, const Float& fontSize,
+						   const Float& lineHeight );
+
+	Int64 getColFromXOffset( const String& text, const Float& x ) const;
+
+	void drawLineColumnsRange( Primitives& primitives, const Int64& line, Int64 startCol,
+							   Int64 endCol, const Vector2f& startScroll, const Float& lineHeight );
+
+	bool isLineWrapActive() const;
+
+	Float getLineWrapWidth() const;
+
+	LineWrapIndex::CharWidthFn getLineWrapCharWidthFn() const;
+
+	void invalidateLineWrap();
+
+	void updateLineWrap();
+
+	void updateLineWrapPendingLines();
+
+	std::pair<Int64, Int64> getVisibleVisualLineRange() const;
+
+	/** @return The document position in a visual line closest to the x offset. */
+	TextPosition getVisualLinePosition( Int64 visualLine, const Float& x ) const;
 };
 
 }} // namespace EE::UI
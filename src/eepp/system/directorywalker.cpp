@@ -0,0 +1,293 @@
+#include <cstring>
+#include <eepp/system/directorywalker.hpp>
+#include <eepp/system/filesystem.hpp>
+#include <sys/stat.h>
+
+#if EE_PLATFORM == EE_PLATFORM_WIN
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace EE { namespace System {
+
+std::shared_ptr<DirectoryWalker>
+DirectoryWalker::createShared( const std::string& path, std::shared_ptr<const Filter> filter,
+							   bool followLinks ) {
+	return std::make_shared<DirectoryWalker>( path, filter, followLinks );
+}
+
+DirectoryWalker::DirectoryWalker( const std::string& path, std::shared_ptr<const Filter> filter,
+								  bool followLinks ) :
+	mPath( path ), mFilter( filter ), mFollowLinks( followLinks ) {
+	FileSystem::dirAddSlashAtEnd( mPath );
+}
+
+void DirectoryWalker::run( std::shared_ptr<ThreadPool> pool, const BatchCb& onBatch,
+						   const DoneCb& onDone, size_t batchSize ) {
+	size_t numThreads = pool ? pool->numThreads() : 0;
+	if ( numThreads == 0 ) {
+		run( onBatch, batchSize );
+		if ( onDone )
+			onDone();
+		return;
+	}
+
+	mOnBatch = onBatch;
+	mOnDone = onDone;
+	mBatchSize = batchSize;
+	PendingDirectory root( start() );
+	{
+		std::lock_guard<std::mutex> l( mMutex );
+		mActive++;
+	}
+	post( pool, std::move( root ) );
+}
+
+void DirectoryWalker::run( const BatchCb& onBatch, size_t batchSize ) {
+	std::vector<PendingDirectory> pending{ start() };
+	std::vector<Entry> batch;
+	{
+		std::lock_guard<std::mutex> l( mMutex );
+		mWorkers++;
+	}
+
+	while ( !pending.empty() && !mStopped ) {
+		PendingDirectory dir( std::move( pending.back() ) );
+		pending.pop_back();
+		readDirectory( dir, batch, pending, onBatch, batchSize );
+	}
+
+	if ( !mStopped )
+		flush( batch, onBatch );
+
+	{
+		std::lock_guard<std::mutex> l( mMutex );
+		mDone = true;
+		mWorkers--;
+	}
+	mCond.notify_all();
+}
+
+void DirectoryWalker::stop() {
+	std::lock_guard<std::mutex> l( mMutex );
+	mStopped = true;
+	mCond.notify_all();
+}
+
+void DirectoryWalker::wait() {
+	std::unique_lock<std::mutex> l( mMutex );
+	mCond.wait( l, [this] { return mWorkers == 0 && ( mDone || mStopped || !mRunning ); } );
+}
+
+bool DirectoryWalker::isRunning() const {
+	std::lock_guard<std::mutex> l( mMutex );
+	return mRunning && !mDone && !( mStopped && mWorkers == 0 );
+}
+
+bool DirectoryWalker::isStopped() const {
+	return mStopped;
+}
+
+DirectoryWalker::PendingDirectory DirectoryWalker::start() {
+	std::lock_guard<std::mutex> l( mMutex );
+	eeASSERT( !mRunning );
+	mRunning = true;
+	std::string realPath( FileSystem::getRealPath( mPath ) );
+	if ( realPath.empty() )
+		realPath = mPath;
+	FileSystem::dirAddSlashAtEnd( realPath );
+	mVisited.insert( realPath );
+	return { mPath, realPath, mFilter };
+}
+
+void DirectoryWalker::post( const std::shared_ptr<ThreadPool>& pool, PendingDirectory&& dir ) {
+	// The tasks only keep a weak reference to the pool, a task can't own the pool that runs it
+	std::weak_ptr<ThreadPool> weakPool( pool );
+	auto walker = shared_from_this();
+	pool->run( [walker, weakPool, dir = std::move( dir )] { walker->walk( weakPool, dir ); } );
+}
+
+void DirectoryWalker::walk( const std::weak_ptr<ThreadPool>& weakPool,
+							const PendingDirectory& dir ) {
+	{
+		// The tasks still queued when the walk is stopped don't call any callback
+		std::lock_guard<std::mutex> l( mMutex );
+		if ( mStopped ) {
+			mActive--;
+			return;
+		}
+		mWorkers++;
+	}
+
+	std::vector<Entry> batch;
+	std::vector<PendingDirectory> subdirs;
+	readDirectory( dir, batch, subdirs, mOnBatch, mBatchSize );
+
+	auto pool = weakPool.lock();
+	if ( !pool )
+		mStopped = true;
+
+	if ( !mStopped ) {
+		{
+			std::lock_guard<std::mutex> l( mMutex );
+			mActive += subdirs.size();
+		}
+		for ( auto& subdir : subdirs )
+			post( pool, std::move( subdir ) );
+		collect( batch );
+	}
+
+	{
+		std::lock_guard<std::mutex> l( mMutex );
+		mActive--;
+		// Finished when no directory is left, or stopped and no other task is reading
+		if ( mDone || ( mActive > 0 && !( mStopped && mWorkers == 1 ) ) ) {
+			mWorkers--;
+			mCond.notify_all();
+			return;
+		}
+		mDone = true;
+	}
+
+	if ( !mStopped ) {
+		std::lock_guard<std::mutex> l( mBatchMutex );
+		if ( !mBatch.empty() && mOnBatch )
+			mOnBatch( std::move( mBatch ) );
+		mBatch.clear();
+	}
+	if ( mOnDone )
+		mOnDone();
+
+	{
+		std::lock_guard<std::mutex> l( mMutex );
+		mWorkers--;
+	}
+	mCond.notify_all();
+}
+
+bool DirectoryWalker::visit( const std::string& realPath ) {
+	std::lock_guard<std::mutex> l( mMutex );
+	return mVisited.insert( realPath ).second;
+}
+
+void DirectoryWalker::flush( std::vector<Entry>& batch, const BatchCb& onBatch ) {
+	if ( batch.empty() )
+		return;
+	std::lock_guard<std::mutex> l( mBatchMutex );
+	if ( onBatch )
+		onBatch( std::move( batch ) );
+	batch.clear();
+}
+
+void DirectoryWalker::collect( std::vector<Entry>& batch ) {
+	if ( batch.empty() )
+		return;
+	std::lock_guard<std::mutex> l( mBatchMutex );
+	mBatch.insert( mBatch.end(), std::make_move_iterator( batch.begin() ),
+				   std::make_move_iterator( batch.end() ) );
+	batch.clear();
+	if ( mBatch.size() >= mBatchSize ) {
+		if ( mOnBatch )
+			mOnBatch( std::move( mBatch ) );
+		mBatch.clear();
+	}
+}
+
+void DirectoryWalker::readDirectory( const PendingDirectory& dir, std::vector<Entry>& batch,
+									 std::vector<PendingDirectory>& subdirs,
+									 const BatchCb& onBatch, size_t batchSize ) {
+	const auto addEntry = [&]( Entry&& entry ) {
+		if ( dir.filter && dir.filter->ignore( entry ) )
+			return;
+
+		if ( entry.isDirectory && ( !entry.isLink || mFollowLinks ) ) {
+			std::string path( entry.getPath() );
+			std::string realPath;
+			if ( entry.isLink ) {
+				realPath = FileSystem::getRealPath( path );
+				if ( realPath.empty() )
+					realPath = path;
+			} else {
+				realPath = dir.realPath + entry.name;
+			}
+			FileSystem::dirAddSlashAtEnd( path );
+			FileSystem::dirAddSlashAtEnd( realPath );
+			if ( visit( realPath ) ) {
+				auto filter = dir.filter ? dir.filter->enterDirectory( path ) : nullptr;
+				subdirs.push_back( { std::move( path ), std::move( realPath ), filter } );
+			}
+		}
+
+		batch.emplace_back( std::move( entry ) );
+		if ( batch.size() >= batchSize )
+			flush( batch, onBatch );
+	};
+
+#if EE_PLATFORM == EE_PLATFORM_WIN
+	WIN32_FIND_DATAW findFileData;
+	HANDLE hFind = FindFirstFileW( String( dir.path + "*" ).toWideString().c_str(), &findFileData );
+	if ( hFind == INVALID_HANDLE_VALUE )
+		return;
+
+	do {
+		if ( mStopped )
+			break;
+		std::string name( String( findFileData.cFileName ).toUtf8() );
+		if ( name == "." || name == ".." )
+			continue;
+		Entry entry;
+		entry.directory = dir.path;
+		entry.name = std::move( name );
+		entry.isDirectory = ( findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+		entry.isLink = ( findFileData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) != 0;
+		addEntry( std::move( entry ) );
+	} while ( FindNextFileW( hFind, &findFileData ) );
+
+	FindClose( hFind );
+#else
+	DIR* dp = opendir( dir.path.c_str() );
+	if ( dp == NULL )
+		return;
+
+	struct dirent* dirp;
+	while ( ( dirp = readdir( dp ) ) != NULL ) {
+		if ( mStopped )
+			break;
+		if ( strcmp( dirp->d_name, "." ) == 0 || strcmp( dirp->d_name, ".." ) == 0 )
+			continue;
+		Entry entry;
+		entry.directory = dir.path;
+		entry.name = dirp->d_name;
+#if defined( _DIRENT_HAVE_D_TYPE ) || defined( DT_DIR )
+		// The type comes with the listing in most file systems, only links and unknown types need
+		// to be stat'ed
+		if ( dirp->d_type == DT_DIR ) {
+			entry.isDirectory = true;
+		} else if ( dirp->d_type == DT_LNK || dirp->d_type == DT_UNKNOWN ) {
+#endif
+			std::string path( entry.getPath() );
+			struct stat st;
+			if ( lstat( path.c_str(), &st ) == 0 ) {
+				entry.isLink = S_ISLNK( st.st_mode );
+				if ( entry.isLink && stat( path.c_str(), &st ) != 0 )
+					st.st_mode = 0;
+				entry.isDirectory = S_ISDIR( st.st_mode );
+			}
+#if defined( _DIRENT_HAVE_D_TYPE ) || defined( DT_DIR )
+		}
+#endif
+		addEntry( std::move( entry ) );
+	}
+
+	closedir( dp );
+#endif
+}
+
+}} // namespace EE::System
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <eepp/ui/doc/linewrapindex.hpp>
+
+namespace EE { namespace UI { namespace Doc {
+
+static const std::vector<Int64> EMPTY_BREAKS;
+
+std::vector<Int64> LineWrapIndex::computeLineBreaks( const String& text, Float maxWidth,
+													 LineWrapMode mode,
+													 const CharWidthFn& charWidth ) {
+	std::vector<Int64> breaks;
+	if ( mode == LineWrapMode::NoWrap || maxWidth <= 0 )
+		return breaks;
+
+	Int64 len = text.size();
+	Int64 segmentStart = 0;
+	Int64 lastWordStart = -1;
+	Float width = 0;
+
+	for ( Int64 i = 0; i < len; i++ ) {
+		String::StringBaseType ch = text[i];
+		if ( ch == '\n' )
+			break;
+
+		Float chWidth = charWidth( ch );
+		if ( width + chWidth > maxWidth && i > segmentStart ) {
+			Int64 breakCol = i;
+			if ( mode == LineWrapMode::Word && lastWordStart > segmentStart )
+				breakCol = lastWordStart;
+			breaks.push_back( breakCol );
+			segmentStart = breakCol;
+			lastWordStart = -1;
+			width = 0;
+			for ( Int64 j = breakCol; j < i; j++ )
+				width += charWidth( text[j] );
+		}
+
+		width += chWidth;
+
+		if ( ch == ' ' || ch == '\t' )
+			lastWordStart = i + 1;
+	}
+
+	return breaks;
+}
+
+void LineWrapIndex::reset( Int64 linesCount ) {
+	mBreaks.clear();
+	mBreaks.resize( linesCount );
+	buildTree();
+}
+
+void LineWrapIndex::clear() {
+	mBreaks.clear();
+	mTree.clear();
+}
+
+Int64 LineWrapIndex::linesCount() const {
+	return mBreaks.size();
+}
+
+Int64 LineWrapIndex::visualLinesCount() const {
+	return prefixSum( mBreaks.size() );
+}
+
+void LineWrapIndex::setLineBreaks( Int64 line, std::vector<Int64>&& breaks ) {
+	if ( line < 0 || line >= (Int64)mBreaks.size() )
+		return;
+	Int64 delta = (Int64)breaks.size() - (Int64)mBreaks[line].size();
+	mBreaks[line] = std::move( breaks );
+	if ( delta != 0 )
+		add( line, delta );
+}
+
+void LineWrapIndex::setLinesBreaks( std::vector<std::vector<Int64>>&& breaks ) {
+	mBreaks = std::move( breaks );
+	buildTree();
+}
+
+const std::vector<Int64>& LineWrapIndex::getLineBreaks( Int64 line ) const {
+	if ( line < 0 || line >= (Int64)mBreaks.size() )
+		return EMPTY_BREAKS;
+	return mBreaks[line];
+}
+
+void LineWrapIndex::insertLines( Int64 at, Int64 count ) {
+	at = eeclamp<Int64>( at, 0, mBreaks.size() );
+	mBreaks.insert( mBreaks.begin() + at, count, std::vector<Int64>() );
+	buildTree();
+}
+
+void LineWrapIndex::removeLines( Int64 at, Int64 count ) {
+	if ( at < 0 || at >= (Int64)mBreaks.size() )
+		return;
+	count = eemin<Int64>( count, mBreaks.size() - at );
+	mBreaks.erase( mBreaks.begin() + at, mBreaks.begin() + at + count );
+	buildTree();
+}
+
+Int64 LineWrapIndex::getVisualLine( Int64 line ) const {
+	return prefixSum( eeclamp<Int64>( line, 0, mBreaks.size() ) );
+}
+
+Int64 LineWrapIndex::getVisualLine( const TextPosition& position ) const {
+	const auto& breaks = getLineBreaks( position.line() );
+	Int64 segment = std::upper_bound( breaks.begin(), breaks.end(), position.column() ) -
+					breaks.begin();
+	return getVisualLine( position.line() ) + segment;
+}
+
+Int64 LineWrapIndex::getSegmentStart( const TextPosition& position ) const {
+	const auto& breaks = getLineBreaks( position.line() );
+	auto it = std::upper_bound( breaks.begin(), breaks.end(), position.column() );
+	return it == breaks.begin() ? 0 : *( it - 1 );
+}
+
+TextPosition LineWrapIndex::getVisualLineStart( Int64 visualLine ) const {
+	Int64 count = mBreaks.size();
+	if ( count == 0 || visualLine <= 0 )
+		return { 0, 0 };
+
+	// Fenwick tree descent: find the last line whose first visual line is <= visualLine
+	Int64 pos = 0;
+	Int64 remaining = visualLine;
+	Int64 step = 1;
+	while ( ( step << 1 ) <= count )
+		step <<= 1;
+	for ( ; step > 0; step >>= 1 ) {
+		if ( pos + step <= count && mTree[pos + step] <= remaining ) {
+			pos += step;
+			remaining -= mTree[pos];
+		}
+	}
+
+	if ( pos >= count )
+		return { count - 1, mBreaks[count - 1].empty() ? 0 : mBreaks[count - 1].back() };
+
+	const auto& breaks = mBreaks[pos];
+	remaining = eemin<Int64>( remaining, breaks.size() );
+	return { pos, remaining == 0 ? 0 : breaks[remaining - 1] };
+}
+
+Int64 LineWrapIndex::getVisualLineEnd( Int64 visualLine, Int64 lineLength ) const {
+	TextPosition start( getVisualLineStart( visualLine ) );
+	const auto& breaks = getLineBreaks( start.line() );
+	auto it = std::upper_bound( breaks.begin(), breaks.end(), start.column() );
+	return it == breaks.end() ? lineLength : *it;
+}
+
+void LineWrapIndex::buildTree() {
+	Int64 count = mBreaks.size();
+	mTree.assign( count + 1, 0 );
+	for ( Int64 i = 1; i <= count; i++ ) {
+		mTree[i] += 1 + mBreaks[i - 1].size();
+		Int64 parent = i + ( i & -i );
+		if ( parent <= count )
+			mTree[parent] += mTree[i];
+	}
+}
+
+void LineWrapIndex::add( Int64 line, Int64 delta ) {
+	Int64 count = mBreaks.size();
+	for ( Int64 i = line + 1; i <= count; i += i & -i )
+		mTree[i] += delta;
+}
+
+Int64 LineWrapIndex::prefixSum( Int64 count ) const {
+	Int64 sum = 0;
+	for ( Int64 i = count; i > 0; i -= i & -i )
+		sum += mTree[i];
+	return sum;
+}
+
+}}} // namespace EE::UI::Doc
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <eepp/system/lock.hpp>
+#include <eepp/ui/doc/structureindex.hpp>
+
+namespace EE { namespace UI { namespace Doc {
+
+// Large enough to never be reached by a depth sum, small enough to not overflow when added
+static constexpr Int32 INF = 1 << 28;
+static constexpr Int32 TAB_WIDTH = 4;
+
+static const StructureIndex::Bracket* findBracket( const std::vector<StructureIndex::Bracket>& v,
+												   Int64 column, size_t& index ) {
+	auto it = std::lower_bound(
+		v.begin(), v.end(), column,
+		[]( const StructureIndex::Bracket& b, Int64 col ) { return b.column < col; } );
+	if ( it == v.end() || it->column != column )
+		return nullptr;
+	index = std::distance( v.begin(), it );
+	return &*it;
+}
+
+static inline Int32 bracketValue( const StructureIndex::Bracket& bracket ) {
+	return StructureIndex::isOpenBracket( bracket.ch ) ? 1 : -1;
+}
+
+bool StructureIndex::isOpenBracket( String::StringBaseType ch ) {
+	return ch == '{' || ch == '(' || ch == '[';
+}
+
+bool StructureIndex::isCloseBracket( String::StringBaseType ch ) {
+	return ch == '}' || ch == ')' || ch == ']';
+}
+
+String::StringBaseType StructureIndex::getPairBracket( String::StringBaseType ch ) {
+	switch ( ch ) {
+		case '{':
+			return '}';
+		case '(':
+			return ')';
+		case '[':
+			return ']';
+		case '}':
+			return '{';
+		case ')':
+			return '(';
+		case ']':
+			return '[';
+		default:
+			return 0;
+	}
+}
+
+void StructureIndex::reset( Int64 linesCount ) {
+	Lock l( mMutex );
+	mLines.clear();
+	mLines.resize( linesCount );
+	buildTree();
+}
+
+void StructureIndex::clear() {
+	Lock l( mMutex );
+	mLines.clear();
+	mTree.clear();
+	mTreeSize = 0;
+}
+
+Int64 StructureIndex::linesCount() const {
+	Lock l( mMutex );
+	return mLines.size();
+}
+
+void StructureIndex::setLine( Int64 line, const String& text,
+							  const std::vector<SyntaxTokenPosition>* tokens ) {
+	if ( line < 0 )
+		return;
+
+	Line ln;
+	ln.known = true;
+	ln.length = text.size();
+
+	Int32 indent = 0;
+	for ( const auto& ch : text ) {
+		if ( ch == ' ' ) {
+			indent++;
+		} else if ( ch == '\t' ) {
+			indent += TAB_WIDTH - indent % TAB_WIDTH;
+		} else {
+			if ( ch != '\n' && ch != '\r' )
+				ln.indent = indent;
+			break;
+		}
+	}
+
+	auto addBrackets = [&ln, &text]( Int64 from, Int64 to ) {
+		to = eemin<Int64>( to, text.size() );
+		for ( Int64 i = from; i < to; i++ ) {
+			if ( isOpenBracket( text[i] ) || isCloseBracket( text[i] ) )
+				ln.brackets.push_back( { static_cast<Int32>( i ), text[i] } );
+		}
+	};
+
+	if ( tokens ) {
+		Int64 col = 0;
+		for ( const auto& token : *tokens ) {
+			if ( token.type != "comment"_sst && token.type != "string"_sst )
+				addBrackets( col, col + token.len );
+			col += token.len;
+		}
+	} else {
+		addBrackets( 0, text.size() );
+	}
+
+	Lock l( mMutex );
+	if ( line >= (Int64)mLines.size() ) {
+		// Lines are usually appended one by one while the document is tokenized, so the tree is
+		// only rebuilt when it runs out of leaves
+		Int64 oldSize = mLines.size();
+		mLines.resize( line + 1 );
+		mLines[line] = std::move( ln );
+		if ( line >= mTreeSize ) {
+			buildTree();
+		} else {
+			for ( Int64 i = oldSize; i <= line; i++ )
+				updateTree( i );
+		}
+		return;
+	}
+	mLines[line] = std::move( ln );
+	updateTree( line );
+}
+
+void StructureIndex::invalidateLine( Int64 line ) {
+	Lock l( mMutex );
+	if ( line < 0 || line >= (Int64)mLines.size() || !mLines[line].known )
+		return;
+	mLines[line] = Line();
+	updateTree( line );
+}
+
+void StructureIndex::moveLines( Int64 fromLine, Int64 numLines ) {
+	// Shifting the lines is linear, as it is for the document and the highlighter lines that move
+	// along with them. The tree is not rebuilt from the lines brackets: the leaves after the moved
+	// lines are shifted and only the nodes above them are combined again.
+	Lock l( mMutex );
+	Int64 oldCount = mLines.size();
+	Int64 at = eeclamp<Int64>( fromLine + 1, 0, oldCount );
+	if ( numLines > 0 ) {
+		mLines.insert( mLines.begin() + at, numLines, Line() );
+	} else if ( numLines < 0 && at < oldCount ) {
+		Int64 count = eemin<Int64>( -numLines, oldCount - at );
+		mLines.erase( mLines.begin() + at, mLines.begin() + at + count );
+	} else {
+		return;
+	}
+
+	Int64 count = mLines.size();
+	if ( count >= mTreeSize ) {
+		buildTree();
+		return;
+	}
+
+	auto leaves = mTree.begin() + mTreeSize;
+	if ( count > oldCount ) {
+		std::move_backward( leaves + at, leaves + oldCount, leaves + count );
+		std::fill( leaves + at, leaves + at + numLines, leaf( Line() ) );
+	} else {
+		std::move( leaves + at + ( oldCount - count ), leaves + oldCount, leaves + at );
+		std::fill( leaves + count, leaves + oldCount, Node{ 0, INF, -INF, INF } );
+	}
+
+	Int64 lo = ( mTreeSize + at ) >> 1;
+	Int64 hi = ( mTreeSize + eemax( count, oldCount ) - 1 ) >> 1;
+	for ( ; lo > 0; lo >>= 1, hi >>= 1 ) {
+		for ( Int64 node = lo; node <= hi; node++ )
+			mTree[node] = combine( mTree[node * 2], mTree[node * 2 + 1] );
+	}
+}
+
+StructureIndex::Node StructureIndex::leaf( const Line& line ) {
+	// Unknown lines stop every search, so they are always reported
+	if ( !line.known )
+		return { 0, -INF, INF, -INF };
+	Node node{ 0, INF, -INF, line.indent < 0 ? INF : line.indent };
+	for ( const auto& bracket : line.brackets ) {
+		node.sum += bracketValue( bracket );
+		node.minPrefix = eemin( node.minPrefix, node.sum );
+	}
+	Int32 suffix = 0;
+	for ( auto it = line.brackets.rbegin(); it != line.brackets.rend(); ++it ) {
+		suffix += bracketValue( *it );
+		node.maxSuffix = eemax( node.maxSuffix, suffix );
+	}
+	return node;
+}
+
+StructureIndex::Node StructureIndex::combine( const Node& left, const Node& right ) {
+	return { left.sum + right.sum, eemin( left.minPrefix, left.sum + right.minPrefix ),
+			 eemax( right.maxSuffix, right.sum + left.maxSuffix ),
+			 eemin( left.minIndent, right.minIndent ) };
+}
+
+void StructureIndex::buildTree() {
+	Int64 count = mLines.size();
+	mTreeSize = 1;
+	while ( mTreeSize <= count )
+		mTreeSize <<= 1;
+	mTree.assign( mTreeSize * 2, { 0, INF, -INF, INF } );
+	for ( Int64 i = 0; i < count; i++ )
+		mTree[mTreeSize + i] = leaf( mLines[i] );
+	for ( Int64 i = mTreeSize - 1; i > 0; i-- )
+		mTree[i] = combine( mTree[i * 2], mTree[i * 2 + 1] );
+}
+
+void StructureIndex::updateTree( Int64 line ) {
+	Int64 node = mTreeSize + line;
+	mTree[node] = leaf( mLines[line] );
+	for ( node >>= 1; node > 0; node >>= 1 )
+		mTree[node] = combine( mTree[node * 2], mTree[node * 2 + 1] );
+}
+
+Int64 StructureIndex::findForward( Int64 node, Int64 nodeStart, Int64 nodeEnd, Int64 from,
+								   Int64& acc, Int64 threshold ) const {
+	if ( nodeEnd <= from || nodeStart >= (Int64)mLines.size() )
+		return -1;
+	const Node& n = mTree[node];
+	if ( nodeStart >= from && acc + n.minPrefix > threshold ) {
+		acc += n.sum;
+		return -1;
+	}
+	if ( nodeEnd - nodeStart == 1 )
+		return nodeStart;
+	Int64 mid = ( nodeStart + nodeEnd ) / 2;
+	Int64 res = findForward( node * 2, nodeStart, mid, from, acc, threshold );
+	if ( res != -1 )
+		return res;
+	return findForward( node * 2 + 1, mid, nodeEnd, from, acc, threshold );
+}
+
+Int64 StructureIndex::findBackward( Int64 node, Int64 nodeStart, Int64 nodeEnd, Int64 to,
+									Int64& acc, Int64 threshold ) const {
+	if ( nodeStart >= to )
+		return -1;
+	const Node& n = mTree[node];
+	if ( nodeEnd <= to && acc + n.maxSuffix < threshold ) {
+		acc += n.sum;
+		return -1;
+	}
+	if ( nodeEnd - nodeStart == 1 )
+		return nodeStart;
+	Int64 mid = ( nodeStart + nodeEnd ) / 2;
+	Int64 res = findBackward( node * 2 + 1, mid, nodeEnd, to, acc, threshold );
+	if ( res != -1 )
+		return res;
+	return findBackward( node * 2, nodeStart, mid, to, acc, threshold );
+}
+
+Int64 StructureIndex::findIndentation( Int64 node, Int64 nodeStart, Int64 nodeEnd, Int64 from,
+									   Int64 indent ) const {
+	if ( nodeEnd <= from || nodeStart >= (Int64)mLines.size() || mTree[node].minIndent > indent )
+		return -1;
+	if ( nodeEnd - nodeStart == 1 )
+		return nodeStart;
+	Int64 mid = ( nodeStart + nodeEnd ) / 2;
+	Int64 res = findIndentation( node * 2, nodeStart, mid, from, indent );
+	if ( res != -1 )
+		return res;
+	return findIndentation( node * 2 + 1, mid, nodeEnd, from, indent );
+}
+
+TextPosition StructureIndex::matchForward( Int64 line, size_t index, Int64* unknownLine ) const {
+	// Depth relative to the opening bracket, the match is where it drops to -1
+	const auto& brackets = mLines[line].brackets;
+	Int64 depth = 0;
+	for ( size_t i = index + 1; i < brackets.size(); i++ ) {
+		depth += bracketValue( brackets[i] );
+		if ( depth == -1 )
+			return { line, brackets[i].column };
+	}
+
+	Int64 acc = 0;
+	Int64 found = findForward( 1, 0, mTreeSize, line + 1, acc, -1 - depth );
+	if ( found == -1 )
+		return {};
+	if ( !mLines[found].known ) {
+		if ( unknownLine )
+			*unknownLine = found;
+		return {};
+	}
+
+	depth += acc;
+	for ( const auto& bracket : mLines[found].brackets ) {
+		depth += bracketValue( bracket );
+		if ( depth == -1 )
+			return { found, bracket.column };
+	}
+	return {};
+}
+
+TextPosition StructureIndex::matchBackward( Int64 line, size_t index, Int64* unknownLine ) const {
+	// Depth relative to the closing bracket walking backwards, the match is where it reaches 1
+	const auto& brackets = mLines[line].brackets;
+	Int64 depth = 0;
+	for ( Int64 i = (Int64)index - 1; i >= 0; i-- ) {
+		depth += bracketValue( brackets[i] );
+		if ( depth == 1 )
+			return { line, brackets[i].column };
+	}
+
+	Int64 acc = 0;
+	Int64 found = findBackward( 1, 0, mTreeSize, line, acc, 1 - depth );
+	if ( found == -1 )
+		return {};
+	if ( !mLines[found].known ) {
+		if ( unknownLine )
+			*unknownLine = found;
+		return {};
+	}
+
+	depth += acc;
+	const auto& foundBrackets = mLines[found].brackets;
+	for ( auto it = foundBrackets.rbegin(); it != foundBrackets.rend(); ++it ) {
+		depth += bracketValue( *it );
+		if ( depth == 1 )
+			return { found, it->column };
+	}
+	return {};
+}
+
+TextPosition StructureIndex::getMatchingBracket( const TextPosition& position,
+												 Int64* unknownLine ) const {
+	Lock l( mMutex );
+	if ( position.line() < 0 || position.line() >= (Int64)mLines.size() )
+		return {};
+	const Line& line = mLines[position.line()];
+	if ( !line.known ) {
+		if ( unknownLine )
+			*unknownLine = position.line();
+		return {};
+	}
+
+	size_t index = 0;
+	const Bracket* bracket = findBracket( line.brackets, position.column(), index );
+	if ( bracket == nullptr )
+		return {};
+
+	bool isOpen = isOpenBracket( bracket->ch );
+	TextPosition match = isOpen ? matchForward( position.line(), index, unknownLine )
+								: matchBackward( position.line(), index, unknownLine );
+	if ( !match.isValid() )
+		return {};
+
+	// Mixed bracket types are counted together, a different pair means unbalanced brackets
+	size_t matchIndex = 0;
+	const Bracket* matchBracket =
+		findBracket( mLines[match.line()].brackets, match.column(), matchIndex );
+	if ( matchBracket == nullptr || matchBracket->ch != getPairBracket( bracket->ch ) )
+		return {};
+	return match;
+}
+
+TextRange StructureIndex::getFoldRange( Int64 line, Int64* unknownLine ) const {
+	Lock l( mMutex );
+	if ( line < 0 || line >= (Int64)mLines.size() )
+		return {};
+	const Line& ln = mLines[line];
+	if ( !ln.known ) {
+		if ( unknownLine )
+			*unknownLine = line;
+		return {};
+	}
+
+	// The outermost bracket left open at the end of the line
+	std::vector<size_t> open;
+	for ( size_t i = 0; i < ln.brackets.size(); i++ ) {
+		if ( isOpenBracket( ln.brackets[i].ch ) ) {
+			open.push_back( i );
+		} else if ( !open.empty() ) {
+			open.pop_back();
+		}
+	}
+
+	if ( !open.empty() ) {
+		Int64 unknown = -1;
+		TextPosition match = matchForward( line, open.front(), &unknown );
+		if ( match.isValid() )
+			return { { line, ln.brackets[open.front()].column }, match };
+		if ( unknown != -1 ) {
+			if ( unknownLine )
+				*unknownLine = unknown;
+			return {};
+		}
+	}
+
+	if ( ln.indent < 0 )
+		return {};
+
+	Int64 found = findIndentation( 1, 0, mTreeSize, line + 1, ln.indent );
+	if ( found != -1 && !mLines[found].known ) {
+		if ( unknownLine )
+			*unknownLine = found;
+		return {};
+	}
+
+	Int64 end = found == -1 ? (Int64)mLines.size() - 1 : found - 1;
+	while ( end > line && mLines[end].indent < 0 )
+		end--;
+	if ( end <= line )
+		return {};
+	return { { line, eemax<Int64>( 0, ln.length - 1 ) },
+			 { end, eemax<Int64>( 0, mLines[end].length - 1 ) } };
+}
+
+Int64 StructureIndex::getIndentation( Int64 line ) const {
+	Lock l( mMutex );
+	if ( line < 0 || line >= (Int64)mLines.size() )
+		return -1;
+	return mLines[line].indent;
+}
+
+}}} // namespace EE::UI::Doc
@@ -1,6 +1,8 @@
 #include <eepp/core/memorymanager.hpp>
 #include <eepp/core/string.hpp>
 #include <eepp/ui/doc/syntaxdefinition.hpp>
+#include <eepp/ui/doc/syntaxdefinitionmanager.hpp>
+#include <unordered_set>
 
 namespace EE { namespace UI { namespace Doc {
 
@@ -83,6 +85,47 @@ UnorderedMap<std::string, std::string> SyntaxDefinition::getSymbolNames() const
 	return mSymbolNames;
 }
 
+Uint64 SyntaxDefinition::getSignature() const {
+	// The tokenizer output also depends on the sub syntaxes, and the states store their language
+	// indices
+	std::size_t signature = 0;
+	std::unordered_set<std::string> visited{ mLanguageName };
+	std::vector<const SyntaxDefinition*> pending{ this };
+	while ( !pending.empty() ) {
+		const SyntaxDefinition* def = pending.back();
+		pending.pop_back();
+		signature = hashCombine( signature, def->getOwnSignature() );
+		for ( const auto& pattern : def->mPatterns ) {
+			// The sub syntaxes selected at runtime are unknown
+			if ( pattern.dynSyntax )
+				return 0;
+			if ( pattern.syntax.empty() || !visited.insert( pattern.syntax ).second )
+				continue;
+			const SyntaxDefinition* subDef =
+				SyntaxDefinitionManager::instance()->getPtrByLanguageName( pattern.syntax );
+			if ( subDef )
+				pending.push_back( subDef );
+		}
+	}
+	return signature;
+}
+
+Uint64 SyntaxDefinition::getOwnSignature() const {
+	std::size_t signature = hashCombine( String::hash( mLanguageName ), mLanguageIndex );
+	for ( const auto& pattern : mPatterns ) {
+		for ( const auto& ptrn : pattern.patterns )
+			signature = hashCombine( signature, String::hash( ptrn ) );
+		for ( const auto& type : pattern.types )
+			signature = hashCombine( signature, type );
+		signature = hashCombine( signature, String::hash( pattern.syntax ) );
+	}
+	// Symbols are unordered, combine them in an order independent way
+	std::size_t symbols = 0;
+	for ( const auto& symbol : mSymbols )
+		symbols += hashCombine( String::hash( symbol.first ), symbol.second );
+	return hashCombine( signature, symbols );
+}
+
 const std::vector<SyntaxPattern>& SyntaxDefinition::getPatterns() const {
 	return mPatterns;
 }
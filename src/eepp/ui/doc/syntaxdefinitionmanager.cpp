@@ -2,6 +2,7 @@
 #include <eepp/system/filesystem.hpp>
 #include <eepp/system/iostreamfile.hpp>
 #include <eepp/system/iostreammemory.hpp>
+#include <eepp/system/lock.hpp>
 #include <eepp/system/log.hpp>
 #include <eepp/system/luapattern.hpp>
 #include <eepp/system/packmanager.hpp>
@@ -1682,93 +1683,163 @@ SyntaxDefinitionManager::SyntaxDefinitionManager() {
 	if ( ms_singleton == nullptr )
 		ms_singleton = this;
 
-	mDefinitions.reserve( 83 );
-
-	// Register some languages support.
+	// Register some languages support. Only the plain text definition is built right away, the
+	// rest of the languages are built the first time they are requested.
 	addPlainText();
-	addAngelScript();
-	addBash();
-	addBatchScript();
-	addBlueprint();
-	addC();
-	addCMake();
-	addContainerfile();
-	addCPP();
-	addCrystal();
-	addCSharp();
-	addCSS();
-	addD();
-	addDart();
-	addDiff();
-	addElixir();
-	addElm();
-	addEnv();
-	addFstab();
-	addGDScript();
-	addGLSL();
-	addGo();
-	addGraphQL();
-	addHaskell();
-	addHare();
-	addHaxe();
-	addHLSL();
-	addHtaccessFile();
-	addHTML();
-	addIgnore();
-	addIni();
-	addJai();
-	addJava();
-	addJavaScript();
-	addJulia();
-	addJSON();
-	addJSX();
-	addKotlin();
-	addLatex();
-	addLobster();
-	addLua();
-	addMakefile();
-	addMarkdown();
-	addMeson();
-	addMoonscript();
-	addNelua();
-	addNim();
-	addObjeck();
-	addObjetiveC();
-	addOdin();
-	addPascal();
-	addPerl();
-	addPICO8();
-	addPHP();
-	addPO();
-	addPony();
-	addPostgreSQL();
-	addPowerShell();
-	addPython();
-	addR();
-	addRuby();
-	addRust();
-	addSass();
-	addScala();
-	addSolidity();
-	addSQL();
-	addSwift();
-	addTeal();
-	addToml();
-	addTypeScript();
-	addV();
-	addVerilog();
-	addVisualBasic();
-	addVue();
-	addWren();
-	addX86Assembly();
-	addxit();
-	addXML();
-	addYAML();
-	addZig();
-}
-
-const std::vector<SyntaxDefinition>& SyntaxDefinitionManager::getDefinitions() const {
-	return mDefinitions;
+	addPreDefinition( { "AngelScript", [] { addAngelScript(); }, { "%.as$", "%.asc$" } } );
+	addPreDefinition( { "Shell script",
+						[] { addBash(); },
+						{ "%.sh$", "%.bash$", "^%.bashrc$", "^%.bash_profile$", "^%.profile$",
+						  "%.zsh$", "%.fish$" },
+						{ "^#!.*[ /]bash", "^#!.*[ /]sh" },
+						"shellscript" } );
+	addPreDefinition( { "Batch Script",
+						[] { addBatchScript(); },
+						{ "%.bat$", "%.cmd$" },
+						{},
+						"bat" } );
+	addPreDefinition( { "Blueprint", [] { addBlueprint(); }, { "%.blp$" } } );
+	addPreDefinition( { "C", [] { addC(); }, { "%.c$", "%.C", "%.h$", "%.icc" } } );
+	addPreDefinition( { "CMake",
+						[] { addCMake(); },
+						{ "%.cmake$", "CMakeLists.txt$" },
+						{ "^cmake_minimum_required.*%c" } } );
+	addPreDefinition( { "Containerfile",
+						[] { addContainerfile(); },
+						{ "^[Cc]ontainerfile$", "^[dD]ockerfile$" },
+						{},
+						"dockerfile" } );
+	addPreDefinition( { "C++",
+						[] { addCPP(); },
+						{ "%.cpp$", "%.cc$", "%.cxx$", "%.c++$", "%.hh$", "%.inl$", "%.hxx$",
+						  "%.hpp$", "%.h++$" },
+						{},
+						"cpp" } );
+	addPreDefinition( { "Crystal", [] { addCrystal(); }, { "%.cr$" } } );
+	addPreDefinition( { "C#", [] { addCSharp(); }, { "%.cs$", "%.csx$" }, {}, "csharp" } );
+	addPreDefinition( { "CSS", [] { addCSS(); }, { "%.css$" } } );
+	addPreDefinition( { "D", [] { addD(); }, { "%.d$", "%.di$" } } );
+	addPreDefinition( { "Dart", [] { addDart(); }, { "%.dart$" } } );
+	addPreDefinition( { "Diff File", [] { addDiff(); }, { "%.diff$", "%.patch$" }, {}, "diff" } );
+	addPreDefinition( { "Elixir", [] { addElixir(); }, { "%.ex$", "%.exs$" } } );
+	addPreDefinition( { "Elm", [] { addElm(); }, { "%.elm$" } } );
+	addPreDefinition( { "Environment File", [] { addEnv(); }, { "%.env$", "%.env.[%w%-%_]*$" } } );
+	addPreDefinition( { "fstab", [] { addFstab(); }, { "fstab" } } );
+	addPreDefinition( { "GDScript", [] { addGDScript(); }, { "%.gd$" } } );
+	addPreDefinition( { "GLSL",
+						[] { addGLSL(); },
+						{ "%.glsl$", "%.frag$", "%.vert$", "%.fs$", "%.vs$", "%.tesc",
+						  "%.tese" } } );
+	addPreDefinition( { "Go", [] { addGo(); }, { "%.go$" } } );
+	addPreDefinition( { "GraphQL", [] { addGraphQL(); }, { "%.graphql$", "%.gql$" } } );
+	addPreDefinition( { "Haskell", [] { addHaskell(); }, { "%.hs$" } } );
+	addPreDefinition( { "Hare", [] { addHare(); }, { "%.ha$" } } );
+	addPreDefinition( { "Haxe Compiler Arguments", [] { addHaxe(); }, { "%.hxml$" } } );
+	addPreDefinition( { "HaxeStringInterpolation", [] { addHaxe(); }, {}, {}, "", false } );
+	addPreDefinition( { "HaxeRegularExpressions", [] { addHaxe(); }, {}, {}, "", false } );
+	addPreDefinition( { "Haxe", [] { addHaxe(); }, { "%.hx$" } } );
+	addPreDefinition( { "HLSL", [] { addHLSL(); }, { "%.hlsl$" } } );
+	addPreDefinition( { ".htaccess", [] { addHtaccessFile(); }, { "^%.htaccess$" } } );
+	addPreDefinition( { "HTML",
+						[] { addHTML(); },
+						{ "%.html?$", "%.phtml", "%.handlebars" },
+						{ "<html", "<![Dd][Oo][Cc][Tt][Yy][Pp][Ee]%s[Hh][Tt][Mm][Ll]>" } } );
+	addPreDefinition( { ".ignore file", [] { addIgnore(); }, { "%..*ignore$" } } );
+	addPreDefinition( { "Config File",
+						[] { addIni(); },
+						{ "%.ini$", "%.conf$", "%.desktop$", "%.service$", "%.cfg$",
+						  "%.properties$", "Doxyfile" },
+						{ "^%[.-%]%f[^\n]" },
+						"ini" } );
+	addPreDefinition( { "Jai", [] { addJai(); }, { "%.jai$" } } );
+	addPreDefinition( { "Java", [] { addJava(); }, { "%.java$" } } );
+	addPreDefinition( { "JavaScript", [] { addJavaScript(); }, { "%.js$" } } );
+	addPreDefinition( { "Julia", [] { addJulia(); }, { "%.jl$" } } );
+	addPreDefinition( { "JSON", [] { addJSON(); }, { "%.json$", "%.cson$", "%.webmanifest" } } );
+	addPreDefinition( { "JSX", [] { addJSX(); }, { "%.jsx$" } } );
+	addPreDefinition( { "Kotlin", [] { addKotlin(); }, { "%.kt$" } } );
+	addPreDefinition( { "LaTeX", [] { addLatex(); }, { "%.tex$" } } );
+	addPreDefinition( { "Lobster", [] { addLobster(); }, { "%.lobster$" } } );
+	addPreDefinition( { "Lua", [] { addLua(); }, { "%.lua$" }, { "^#!.*[ /]lua" } } );
+	addPreDefinition( { "Makefile",
+						[] { addMakefile(); },
+						{ "Makefile", "makefile", "%.mk$", "%.make$" } } );
+	addPreDefinition( { "Markdown", [] { addMarkdown(); }, { "%.md$", "%.markdown$" } } );
+	addPreDefinition( { "Meson", [] { addMeson(); }, { "meson.build$" } } );
+	addPreDefinition( { "MoonScript", [] { addMoonscript(); }, { "%.moon$" } } );
+	addPreDefinition( { "Nelua", [] { addNelua(); }, { "%.nelua$" }, { "^#!.*[ /]nelua" } } );
+	addPreDefinition( { "Nim", [] { addNim(); }, { "%.nim$", "%.nims$", "%.nimble$" } } );
+	addPreDefinition( { "Objeck", [] { addObjeck(); }, { "%.obs$" } } );
+	addPreDefinition( { "Objective-C", [] { addObjetiveC(); }, { "%.m$" } } );
+	addPreDefinition( { "Odin", [] { addOdin(); }, { "%.odin$" } } );
+	addPreDefinition( { "Pascal", [] { addPascal(); }, { "%.pas$" } } );
+	addPreDefinition( { "Perl", [] { addPerl(); }, { "%.pm$", "%.pl$" }, { "^#!.*[ /]perl" } } );
+	addPreDefinition( { "PICO-8", [] { addPICO8(); }, { "%.p8$" } } );
+	addPreDefinition( { "PHP",
+						[] { addPHP(); },
+						{ "%.php$", "%.php3$", "%.php4$", "%.php5$" },
+						{ "^#!.*[ /]php" } } );
+	addPreDefinition( { "PHPCore", [] { addPHP(); }, {}, {}, "php", false } );
+	addPreDefinition( { "PO", [] { addPO(); }, { "%.po$", "%.pot$" } } );
+	addPreDefinition( { "pony", [] { addPony(); }, { "%.pony$" } } );
+	addPreDefinition( { "PostgreSQL", [] { addPostgreSQL(); }, { "%.sql$", "%.psql$" } } );
+	addPreDefinition( { "PowerShell",
+						[] { addPowerShell(); },
+						{ "%.ps1$", "%.psm1$", "%.psd1$", "%.ps1xml$", "%.pssc$", "%.psrc$",
+						  "%.cdxml$" } } );
+	addPreDefinition( { "Python",
+						[] { addPython(); },
+						{ "%.py$", "%.pyw$" },
+						{ "^#!.*[ /]python", "^#!.*[ /]python3" } } );
+	addPreDefinition( { "R", [] { addR(); }, { "%.r$", "%.rds$", "%.rda$", "%.rdata$", "%.R$" } } );
+	addPreDefinition( { "Ruby",
+						[] { addRuby(); },
+						{ "%.rb", "%.gemspec", "%.ruby" },
+						{ "^#!.*[ /]ruby" } } );
+	addPreDefinition( { "Rust", [] { addRust(); }, { "%.rs$" } } );
+	addPreDefinition( { "Sass", [] { addSass(); }, { "%.sass$", "%.scss$" } } );
+	addPreDefinition( { "Scala", [] { addScala(); }, { "%.sc$", "%.scala$" } } );
+	addPreDefinition( { "Solidity", [] { addSolidity(); }, { "%.sol$" } } );
+	addPreDefinition( { "SQL", [] { addSQL(); }, { "%.sql$", "%.psql$" } } );
+	addPreDefinition( { "Swift", [] { addSwift(); }, { "%.swift$" } } );
+	addPreDefinition( { "Teal", [] { addTeal(); }, { "%.tl$", "%.d.tl$" }, { "^#!.*[ /]tl" } } );
+	addPreDefinition( { "TOML", [] { addToml(); }, { "%.toml$" } } );
+	addPreDefinition( { "TypeScript", [] { addTypeScript(); }, { "%.ts$", "%.d.ts$" } } );
+	addPreDefinition( { "TSX", [] { addTypeScript(); }, { "%.tsx$" } } );
+	addPreDefinition( { "V", [] { addV(); }, { "%.v$", "%.vsh$" }, {}, "", true, true } );
+	addPreDefinition( { "Verilog", [] { addVerilog(); }, { "%.V$", "%.vl$", "%.vh$", "%.v$" } } );
+	addPreDefinition( { "Visual Basic",
+						[] { addVisualBasic(); },
+						{ "%.bas$", "%.cls$", "%.ctl$", "%.dob$", "%.dsm$", "%.dsr$", "%.frm$",
+						  "%.pag$", "%.vb$", "%.vba$", "%.vbs$" } } );
+	addPreDefinition( { "Vue-HTML", [] { addVue(); }, {}, {}, "", false } );
+	addPreDefinition( { "Vue", [] { addVue(); }, { "%.vue?$" } } );
+	addPreDefinition( { "Wren", [] { addWren(); }, { "%.wren$" } } );
+	addPreDefinition( { "x86 Assembly", [] { addX86Assembly(); }, { "%.asm$", "%.[sS]$" } } );
+	addPreDefinition( { "[x]it!", [] { addxit(); }, { "%.xit$" } } );
+	addPreDefinition( { "XML", [] { addXML(); }, { "%.xml$", "%.svg$" }, { "<%?xml" } } );
+	addPreDefinition( { "YAML", [] { addYAML(); }, { "%.yml$", "%.yaml$" } } );
+	addPreDefinition( { "Zig", [] { addZig(); }, { "%.zig$" } } );
+}
+
+std::vector<const SyntaxDefinition*> SyntaxDefinitionManager::getDefinitionsMetadata() const {
+	Lock l( mMutex );
+	std::vector<const SyntaxDefinition*> defs;
+	size_t count = mDefinitionsCount;
+	defs.reserve( count );
+	for ( size_t i = 0; i < count; ++i )
+		defs.push_back( &getDefinition( i ) );
+	return defs;
+}
+
+std::vector<const SyntaxDefinition*> SyntaxDefinitionManager::loadAllDefinitions() const {
+	Lock l( mMutex );
+	std::vector<const SyntaxDefinition*> defs;
+	size_t count = mDefinitionsCount;
+	defs.reserve( count );
+	for ( size_t i = 0; i < count; ++i )
+		defs.push_back( &load( getDefinition( i ) ) );
+	return defs;
 }
 
 static json toJson( const SyntaxDefinition& def ) {
@@ -1827,20 +1898,226 @@ bool SyntaxDefinitionManager::save( const std::string& path,
 		return FileSystem::fileWrite( path, j.dump( 2 ) );
 	} else {
 		json j = json::array();
-		for ( const auto& d : mDefinitions )
-			j.emplace_back( toJson( d ) );
+		for ( const auto& d : loadAllDefinitions() )
+			j.emplace_back( toJson( *d ) );
 		return FileSystem::fileWrite( path, j.dump( 2 ) );
 	}
 	return false;
 }
 
-std::optional<size_t> SyntaxDefinitionManager::getLanguageIndex( const std::string& langName ) {
-	size_t pos = 0;
-	for ( const auto& def : mDefinitions ) {
-		if ( def.getLanguageName() == langName ) {
-			return pos;
+// Precompiled definitions: the magic and the format version, the source files compiled (file name
+// and modification time) and the definitions count followed by the definitions. Integers are
+// stored as native Uint32 (Uint64 for times) and strings as its length and its bytes. Style types
+// are not stored, they are hashed from the types names when loaded.
+static constexpr char SYNTAX_COMPILED_MAGIC[4] = { 'E', 'S', 'D', 'B' };
+static constexpr Uint32 SYNTAX_COMPILED_VERSION = 2;
+
+namespace {
+
+struct CompiledWriter {
+	std::string buffer;
+
+	void write( Uint32 val ) { buffer.append( (const char*)&val, sizeof( val ) ); }
+
+	void writeUint64( Uint64 val ) { buffer.append( (const char*)&val, sizeof( val ) ); }
+
+	void write( const std::string& str ) {
+		write( (Uint32)str.size() );
+		buffer.append( str );
+	}
+
+	void write( const std::vector<std::string>& strs ) {
+		write( (Uint32)strs.size() );
+		for ( const auto& str : strs )
+			write( str );
+	}
+};
+
+struct CompiledReader {
+	const std::string& buffer;
+	size_t pos{ 0 };
+	bool ok{ true };
+
+	bool canRead( size_t size ) {
+		ok = ok && buffer.size() - pos >= size;
+		return ok;
+	}
+
+	Uint32 readUint32() {
+		Uint32 val = 0;
+		if ( canRead( sizeof( val ) ) ) {
+			memcpy( &val, buffer.data() + pos, sizeof( val ) );
+			pos += sizeof( val );
+		}
+		return val;
+	}
+
+	Uint64 readUint64() {
+		Uint64 val = 0;
+		if ( canRead( sizeof( val ) ) ) {
+			memcpy( &val, buffer.data() + pos, sizeof( val ) );
+			pos += sizeof( val );
+		}
+		return val;
+	}
+
+	std::string readString() {
+		Uint32 size = readUint32();
+		if ( !canRead( size ) )
+			return {};
+		std::string str( buffer.data() + pos, size );
+		pos += size;
+		return str;
+	}
+
+	std::vector<std::string> readStrings() {
+		Uint32 count = readUint32();
+		std::vector<std::string> strs;
+		if ( !canRead( count * sizeof( Uint32 ) ) )
+			return strs;
+		strs.reserve( count );
+		for ( Uint32 i = 0; i < count && ok; i++ )
+			strs.emplace_back( readString() );
+		return strs;
+	}
+};
+
+} // namespace
+
+// Patterns that select its sub-language with a function can't be stored
+static bool canBeCompiled( const SyntaxDefinition& def ) {
+	for ( const auto& ptrn : def.getPatterns() ) {
+		if ( ptrn.dynSyntax )
+			return false;
+	}
+	return true;
+}
+
+static void writeCompiled( CompiledWriter& writer, const SyntaxDefinition& def ) {
+	writer.write( def.getLanguageName() );
+	writer.write( def.getLSPName() );
+	writer.write( def.getFiles() );
+	writer.write( def.getComment() );
+	writer.write( def.getHeaders() );
+	writer.write( ( def.isVisible() ? 1 : 0 ) | ( def.getAutoCloseXMLTags() ? 2 : 0 ) |
+				  ( def.hasExtensionPriority() ? 4 : 0 ) );
+	writer.write( (Uint32)def.getPatterns().size() );
+	for ( const auto& ptrn : def.getPatterns() ) {
+		writer.write( ptrn.patterns );
+		writer.write( ptrn.typesNames );
+		writer.write( ptrn.syntax );
+	}
+	auto symbols = def.getSymbolNames();
+	writer.write( (Uint32)symbols.size() );
+	for ( const auto& sym : symbols ) {
+		writer.write( sym.first );
+		writer.write( sym.second );
+	}
+}
+
+static SyntaxDefinition readCompiled( CompiledReader& reader ) {
+	SyntaxDefinition def;
+	def.setLanguageName( reader.readString() );
+	def.setLSPName( reader.readString() );
+	def.setFileTypes( reader.readStrings() );
+	def.setComment( reader.readString() );
+	def.setHeaders( reader.readStrings() );
+	Uint32 flags = reader.readUint32();
+	def.setVisible( flags & 1 );
+	def.setAutoCloseXMLTags( flags & 2 );
+	def.setExtensionPriority( flags & 4 );
+	Uint32 patternsCount = reader.readUint32();
+	for ( Uint32 i = 0; i < patternsCount && reader.ok; i++ ) {
+		auto patterns = reader.readStrings();
+		auto types = reader.readStrings();
+		auto syntax = reader.readString();
+		def.addPattern( SyntaxPattern( std::move( patterns ), std::move( types ), syntax ) );
+	}
+	Uint32 symbolsCount = reader.readUint32();
+	for ( Uint32 i = 0; i < symbolsCount && reader.ok; i++ ) {
+		auto name = reader.readString();
+		def.addSymbol( name, reader.readString() );
+	}
+	return def;
+}
+
+bool SyntaxDefinitionManager::saveCompiled( const std::string& path,
+											const std::vector<SyntaxDefinition>& def,
+											const std::vector<std::string>& sourceFiles ) {
+	std::vector<const SyntaxDefinition*> defs;
+	if ( !def.empty() ) {
+		for ( const auto& d : def )
+			defs.push_back( &d );
+	} else {
+		defs = loadAllDefinitions();
+	}
+
+	CompiledWriter writer;
+	writer.buffer.append( SYNTAX_COMPILED_MAGIC, sizeof( SYNTAX_COMPILED_MAGIC ) );
+	writer.write( SYNTAX_COMPILED_VERSION );
+	writer.write( (Uint32)sourceFiles.size() );
+	for ( const auto& sourceFile : sourceFiles ) {
+		writer.write( FileSystem::fileNameFromPath( sourceFile ) );
+		writer.writeUint64( FileInfo( sourceFile ).getModificationTime() );
+	}
+
+	// Languages that can't be compiled keep using its built-in (or JSON) definition
+	std::vector<const SyntaxDefinition*> compiled;
+	for ( const auto* d : defs ) {
+		if ( canBeCompiled( *d ) ) {
+			compiled.push_back( d );
+		} else {
+			Log::warning( "SyntaxDefinitionManager::saveCompiled: %s uses a dynamic syntax, "
+						  "skipped",
+						  d->getLanguageName().c_str() );
 		}
-		++pos;
+	}
+	writer.write( (Uint32)compiled.size() );
+	for ( const auto* d : compiled )
+		writeCompiled( writer, *d );
+	return FileSystem::fileWrite( path, writer.buffer );
+}
+
+bool SyntaxDefinitionManager::loadCompiled( const std::string& buffer,
+											std::vector<std::string>* addedLangs,
+											CompiledSources* sources ) {
+	CompiledReader reader{ buffer, sizeof( SYNTAX_COMPILED_MAGIC ) };
+	if ( reader.readUint32() != SYNTAX_COMPILED_VERSION ) {
+		Log::error( "SyntaxDefinitionManager::loadCompiled: unsupported format version" );
+		return false;
+	}
+
+	CompiledSources compiledSources;
+	Uint32 sourcesCount = reader.readUint32();
+	for ( Uint32 i = 0; i < sourcesCount && reader.ok; i++ ) {
+		auto fileName = reader.readString();
+		compiledSources[fileName] = reader.readUint64();
+	}
+
+	Uint32 count = reader.readUint32();
+	std::vector<SyntaxDefinition> defs;
+	for ( Uint32 i = 0; i < count && reader.ok; i++ )
+		defs.emplace_back( readCompiled( reader ) );
+
+	if ( !reader.ok ) {
+		Log::error( "SyntaxDefinitionManager::loadCompiled: truncated or corrupted file" );
+		return false;
+	}
+
+	Lock l( mMutex );
+	for ( auto& def : defs )
+		addLoaded( std::move( def ), addedLangs );
+	if ( sources )
+		sources->insert( compiledSources.begin(), compiledSources.end() );
+	return true;
+}
+
+std::optional<size_t>
+SyntaxDefinitionManager::getLanguageIndex( const std::string& langName ) const {
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		if ( getDefinition( i ).getLanguageName() == langName )
+			return i;
 	}
 	return {};
 }
@@ -1926,14 +2203,159 @@ namespace EE { namespace UI { namespace Doc { namespace Language {
 	return std::make_pair( std::move( header ), std::move( buf ) );
 }
 
+SyntaxDefinitionManager::DefinitionSlot& SyntaxDefinitionManager::getSlot( size_t index ) const {
+	return mSlots[index / SLOTS_PER_CHUNK].load( std::memory_order_acquire )
+		->slots[index % SLOTS_PER_CHUNK];
+}
+
+SyntaxDefinition& SyntaxDefinitionManager::getDefinition( size_t index ) const {
+	return *getSlot( index ).definition.load( std::memory_order_acquire );
+}
+
+SyntaxDefinition& SyntaxDefinitionManager::setDefinition( size_t index, SyntaxDefinition&& def,
+														  bool loaded ) {
+	size_t count = mDefinitionsCount;
+	eeASSERT( index <= count && index < SLOTS_PER_CHUNK * mSlots.size() );
+	if ( index == count && index % SLOTS_PER_CHUNK == 0 ) {
+		mSlotsChunks.emplace_back( std::make_unique<SlotsChunk>() );
+		mSlots[index / SLOTS_PER_CHUNK].store( mSlotsChunks.back().get(),
+											   std::memory_order_release );
+	}
+	def.mLanguageIndex = index;
+	mDefinitions.emplace_back( std::make_unique<SyntaxDefinition>( std::move( def ) ) );
+	DefinitionSlot& slot = getSlot( index );
+	slot.definition.store( mDefinitions.back().get(), std::memory_order_release );
+	slot.loaded.store( loaded, std::memory_order_release );
+	if ( index == count )
+		mDefinitionsCount.store( count + 1, std::memory_order_release );
+	mFileTypesIndexDirty = true;
+	return *mDefinitions.back();
+}
+
 SyntaxDefinition& SyntaxDefinitionManager::add( SyntaxDefinition&& syntaxStyle ) {
-	syntaxStyle.mLanguageIndex = mDefinitions.size();
-	mDefinitions.emplace_back( std::move( syntaxStyle ) );
-	return mDefinitions.back();
+	Lock l( mMutex );
+
+	// A pre-defined language being loaded takes the slot of its pre-definition and keeps its
+	// metadata, so the lookups don't change once the language is loaded. It's flagged as loaded
+	// by load, once the loader finished setting it up.
+	if ( !mPreDefinitions.empty() ) {
+		auto pos = getLanguageIndex( syntaxStyle.getLanguageName() );
+		if ( pos.has_value() && mPreDefinitions.erase( pos.value() ) ) {
+			const SyntaxDefinition& preDef = getDefinition( pos.value() );
+			eeASSERT( syntaxStyle.getFiles() == preDef.getFiles() );
+			syntaxStyle.setFileTypes( preDef.getFiles() );
+			syntaxStyle.setHeaders( preDef.getHeaders() );
+			syntaxStyle.setLSPName( preDef.getLSPName() );
+			syntaxStyle.setVisible( preDef.isVisible() );
+			syntaxStyle.setExtensionPriority( preDef.hasExtensionPriority() );
+			return setDefinition( pos.value(), std::move( syntaxStyle ), false );
+		}
+	}
+
+	return setDefinition( mDefinitionsCount, std::move( syntaxStyle ), true );
+}
+
+void SyntaxDefinitionManager::addPreDefinition( SyntaxPreDefinition&& preDefinition ) {
+	Lock l( mMutex );
+	SyntaxDefinition def( preDefinition.language, std::move( preDefinition.files ), {}, {}, "",
+						  std::move( preDefinition.headers ), preDefinition.lspName );
+	def.setVisible( preDefinition.visible );
+	def.setExtensionPriority( preDefinition.extensionPriority );
+	size_t index = mDefinitionsCount;
+	mPreDefinitions[index] = std::move( preDefinition.load );
+	setDefinition( index, std::move( def ), false );
+}
+
+const SyntaxDefinition& SyntaxDefinitionManager::load( const SyntaxDefinition& def ) const {
+	DefinitionSlot& slot = getSlot( def.getLanguageIndex() );
+	if ( slot.loaded.load( std::memory_order_acquire ) )
+		return *slot.definition.load( std::memory_order_acquire );
+
+	Lock l( mMutex );
+	auto found = mPreDefinitions.find( def.getLanguageIndex() );
+	if ( found != mPreDefinitions.end() ) {
+		// The loader can add more than one language, every language added takes the slot of its
+		// pre-definition. A loader that doesn't add its language leaves only the metadata.
+		auto loader = found->second;
+		loader();
+		mPreDefinitions.erase( def.getLanguageIndex() );
+	}
+	slot.loaded.store( true, std::memory_order_release );
+	return *slot.definition.load( std::memory_order_acquire );
+}
+
+static bool isFileTypePattern( const std::string& fileType ) {
+	return String::startsWith( fileType, "%." ) || String::startsWith( fileType, "^" ) ||
+		   String::endsWith( fileType, "$" );
+}
+
+static bool isExtensionPattern( const std::string& fileType ) {
+	if ( fileType.size() <= 3 || !String::startsWith( fileType, "%." ) ||
+		 !String::endsWith( fileType, "$" ) )
+		return false;
+	for ( size_t i = 2; i < fileType.size() - 1; ++i ) {
+		if ( !std::isalnum( static_cast<unsigned char>( fileType[i] ) ) && fileType[i] != '_' )
+			return false;
+	}
+	return true;
+}
+
+void SyntaxDefinitionManager::updateFileTypesIndex() const {
+	if ( !mFileTypesIndexDirty )
+		return;
+	mFileTypesByExtension.clear();
+	mFileTypesByName.clear();
+	mFileTypesPatterns.clear();
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& files = getDefinition( i ).getFiles();
+		for ( size_t f = 0; f < files.size(); ++f ) {
+			if ( isExtensionPattern( files[f] ) ) {
+				// "%.ext$" -> ".ext"
+				std::string extension( files[f].substr( 1, files[f].size() - 2 ) );
+				mFileTypesByExtension[extension].emplace_back( i, f );
+			} else if ( isFileTypePattern( files[f] ) ) {
+				mFileTypesPatterns.emplace_back( i, f );
+			} else {
+				mFileTypesByName[files[f]].emplace_back( i, f );
+			}
+		}
+	}
+	mFileTypesIndexDirty = false;
+}
+
+std::vector<std::pair<size_t, size_t>>
+SyntaxDefinitionManager::getFileTypesMatches( const std::string& patternSubject,
+											  const std::string& exactSubject ) const {
+	Lock l( mMutex );
+	updateFileTypesIndex();
+	std::vector<std::pair<size_t, size_t>> matches;
+
+	size_t dotPos = patternSubject.find_last_of( '.' );
+	if ( dotPos != std::string::npos ) {
+		auto found = mFileTypesByExtension.find( patternSubject.substr( dotPos ) );
+		if ( found != mFileTypesByExtension.end() )
+			matches.insert( matches.end(), found->second.begin(), found->second.end() );
+	}
+
+	auto found = mFileTypesByName.find( exactSubject );
+	if ( found != mFileTypesByName.end() )
+		matches.insert( matches.end(), found->second.begin(), found->second.end() );
+
+	for ( const auto& fileType : mFileTypesPatterns ) {
+		LuaPattern words( getDefinition( fileType.first ).getFiles()[fileType.second] );
+		int start, end;
+		if ( words.find( patternSubject, start, end ) )
+			matches.push_back( fileType );
+	}
+
+	// Keep the same precedence than a sequential scan of the languages file types
+	std::sort( matches.begin(), matches.end() );
+	return matches;
 }
 
 const SyntaxDefinition& SyntaxDefinitionManager::getPlainDefinition() const {
-	return mDefinitions[0];
+	return getDefinition( 0 );
 }
 
 SyntaxDefinition& SyntaxDefinitionManager::getByExtensionRef( const std::string& filePath ) {
@@ -1942,43 +2364,55 @@ SyntaxDefinition& SyntaxDefinitionManager::getByExtensionRef( const std::string&
 
 const SyntaxDefinition&
 SyntaxDefinitionManager::getByLanguageName( const std::string& name ) const {
-	for ( auto& style : mDefinitions ) {
+	Lock l( mMutex );
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( style.getLanguageName() == name )
-			return style;
+			return load( style );
 	}
-	return mDefinitions[0];
+	return getDefinition( 0 );
 }
 
 const SyntaxDefinition& SyntaxDefinitionManager::getByLanguageIndex( const Uint32& index ) const {
-	eeASSERT( index < mDefinitions.size() );
-	return mDefinitions[index];
+	eeASSERT( index < mDefinitionsCount );
+	return load( getDefinition( index ) );
 }
 
 const SyntaxDefinition&
 SyntaxDefinitionManager::getByLanguageNameInsensitive( std::string name ) const {
+	Lock l( mMutex );
 	String::toLowerInPlace( name );
-	for ( auto& style : mDefinitions ) {
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( String::toLower( style.getLanguageName() ) == name )
-			return style;
+			return load( style );
 	}
-	return mDefinitions[0];
+	return getDefinition( 0 );
 }
 
 const SyntaxDefinition& SyntaxDefinitionManager::getByLSPName( const std::string& name ) const {
-	for ( auto& style : mDefinitions ) {
+	Lock l( mMutex );
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( style.getLSPName() == name )
-			return style;
+			return load( style );
 	}
-	return mDefinitions[0];
+	return getDefinition( 0 );
 }
 
 const SyntaxDefinition&
 SyntaxDefinitionManager::getByLanguageId( const String::HashType& id ) const {
-	for ( auto& style : mDefinitions ) {
+	Lock l( mMutex );
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( style.getLanguageId() == id )
-			return style;
+			return load( style );
 	}
-	return mDefinitions[0];
+	return getDefinition( 0 );
 }
 
 SyntaxDefinition& SyntaxDefinitionManager::getByLanguageNameRef( const std::string& name ) {
@@ -1986,8 +2420,11 @@ SyntaxDefinition& SyntaxDefinitionManager::getByLanguageNameRef( const std::stri
 }
 
 std::vector<std::string> SyntaxDefinitionManager::getLanguageNames() const {
+	Lock l( mMutex );
 	std::vector<std::string> names;
-	for ( auto& style : mDefinitions ) {
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( style.isVisible() )
 			names.push_back( style.getLanguageName() );
 	}
@@ -1996,35 +2433,46 @@ std::vector<std::string> SyntaxDefinitionManager::getLanguageNames() const {
 }
 
 std::vector<std::string> SyntaxDefinitionManager::getExtensionsPatternsSupported() const {
+	Lock l( mMutex );
 	std::vector<std::string> exts;
-	for ( auto& style : mDefinitions )
-		for ( auto& pattern : style.getFiles() )
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i )
+		for ( auto& pattern : getDefinition( i ).getFiles() )
 			exts.emplace_back( pattern );
 	return exts;
 }
 
 const SyntaxDefinition*
 SyntaxDefinitionManager::getPtrByLanguageName( const std::string& name ) const {
-	for ( const auto& style : mDefinitions ) {
+	Lock l( mMutex );
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( style.getLanguageName() == name )
-			return &style;
+			return &load( style );
 	}
 	return nullptr;
 }
 
 const SyntaxDefinition* SyntaxDefinitionManager::getPtrByLSPName( const std::string& name ) const {
-	for ( const auto& style : mDefinitions ) {
+	Lock l( mMutex );
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( style.getLSPName() == name )
-			return &style;
+			return &load( style );
 	}
 	return nullptr;
 }
 
 const SyntaxDefinition*
 SyntaxDefinitionManager::getPtrByLanguageId( const String::HashType& id ) const {
-	for ( const auto& style : mDefinitions ) {
+	Lock l( mMutex );
+	size_t count = mDefinitionsCount;
+	for ( size_t i = 0; i < count; ++i ) {
+		const auto& style = getDefinition( i );
 		if ( style.getLanguageId() == id )
-			return &style;
+			return &load( style );
 	}
 	return nullptr;
 }
@@ -2116,6 +2564,18 @@ static SyntaxDefinition loadLanguage( const nlohmann::json& json ) {
 	return def;
 }
 
+void SyntaxDefinitionManager::addLoaded( SyntaxDefinition&& def,
+										 std::vector<std::string>* addedLangs ) {
+	if ( def.getLanguageName().empty() )
+		return;
+	if ( addedLangs )
+		addedLangs->push_back( def.getLanguageName() );
+	auto pos = getLanguageIndex( def.getLanguageName() );
+	if ( pos.has_value() )
+		mPreDefinitions.erase( pos.value() );
+	setDefinition( pos.value_or( mDefinitionsCount ), std::move( def ), true );
+}
+
 bool SyntaxDefinitionManager::loadFromStream( IOStream& stream,
 											  std::vector<std::string>* addedLangs ) {
 	if ( stream.getSize() == 0 )
@@ -2124,40 +2584,18 @@ bool SyntaxDefinitionManager::loadFromStream( IOStream& stream,
 	buffer.resize( stream.getSize() );
 	stream.read( buffer.data(), buffer.size() );
 
+	if ( buffer.size() >= sizeof( SYNTAX_COMPILED_MAGIC ) &&
+		 memcmp( buffer.data(), SYNTAX_COMPILED_MAGIC, sizeof( SYNTAX_COMPILED_MAGIC ) ) == 0 )
+		return loadCompiled( buffer, addedLangs );
+
 	nlohmann::json j = nlohmann::json::parse( buffer );
+	Lock l( mMutex );
 
 	if ( j.is_array() ) {
-		for ( const auto& lang : j ) {
-			auto res = loadLanguage( lang );
-			if ( !res.getLanguageName().empty() ) {
-				auto pos = getLanguageIndex( res.getLanguageName() );
-				if ( pos.has_value() ) {
-					if ( addedLangs )
-						addedLangs->push_back( res.getLanguageName() );
-					mDefinitions[pos.value()] = std::move( res );
-				} else {
-					if ( addedLangs )
-						addedLangs->push_back( res.getLanguageName() );
-					res.mLanguageIndex = mDefinitions.size();
-					mDefinitions.emplace_back( std::move( res ) );
-				}
-			}
-		}
+		for ( const auto& lang : j )
+			addLoaded( loadLanguage( lang ), addedLangs );
 	} else {
-		auto res = loadLanguage( j );
-		if ( !res.getLanguageName().empty() ) {
-			auto pos = getLanguageIndex( res.getLanguageName() );
-			if ( pos.has_value() ) {
-				if ( addedLangs )
-					addedLangs->push_back( res.getLanguageName() );
-				mDefinitions[pos.value()] = std::move( res );
-			} else {
-				if ( addedLangs )
-					addedLangs->push_back( res.getLanguageName() );
-				res.mLanguageIndex = mDefinitions.size();
-				mDefinitions.emplace_back( std::move( res ) );
-			}
-		}
+		addLoaded( loadLanguage( j ), addedLangs );
 	}
 
 	return true;
@@ -2204,8 +2642,22 @@ void SyntaxDefinitionManager::loadFromFolder( const std::string& folderPath ) {
 	auto files = FileSystem::filesInfoGetInPath( folderPath );
 	if ( files.empty() )
 		return;
+	CompiledSources compiledSources;
+	for ( const auto& file : files ) {
+		if ( !file.isRegularFile() || !file.isReadable() || file.getExtension() != "esdb" )
+			continue;
+		std::string buffer;
+		if ( FileSystem::fileGet( file.getFilepath(), buffer ) &&
+			 buffer.size() >= sizeof( SYNTAX_COMPILED_MAGIC ) &&
+			 memcmp( buffer.data(), SYNTAX_COMPILED_MAGIC, sizeof( SYNTAX_COMPILED_MAGIC ) ) == 0 )
+			loadCompiled( buffer, nullptr, &compiledSources );
+	}
 	for ( const auto& file : files ) {
-		if ( file.isRegularFile() && file.isReadable() && file.getExtension() == "json" )
+		if ( !file.isRegularFile() || !file.isReadable() || file.getExtension() != "json" )
+			continue;
+		auto compiled = compiledSources.find( file.getFileName() );
+		if ( compiled == compiledSources.end() ||
+			 file.getModificationTime() > compiled->second )
 			loadFromFile( file.getFilepath() );
 	}
 }
@@ -2219,19 +2671,8 @@ SyntaxDefinitionManager::languagesThatSupportExtension( std::string extension )
 	if ( extension[0] != '.' )
 		extension = '.' + extension;
 
-	for ( const auto& style : mDefinitions ) {
-		for ( const auto& ext : style.getFiles() ) {
-			if ( String::startsWith( ext, "%." ) || String::startsWith( ext, "^" ) ||
-				 String::endsWith( ext, "$" ) ) {
-				LuaPattern words( ext );
-				int start, end;
-				if ( words.find( extension, start, end ) )
-					langs.push_back( &style );
-			} else if ( extension == ext ) {
-				langs.push_back( &style );
-			}
-		}
-	}
+	for ( const auto& match : getFileTypesMatches( extension, extension ) )
+		langs.push_back( &load( getDefinition( match.first ) ) );
 	return langs;
 }
 
@@ -2241,30 +2682,12 @@ bool SyntaxDefinitionManager::extensionCanRepresentManyLanguages( std::string ex
 	if ( extension[0] != '.' )
 		extension = '.' + extension;
 
-	int count = 0;
-	for ( const auto& style : mDefinitions ) {
-		for ( const auto& ext : style.getFiles() ) {
-			if ( String::startsWith( ext, "%." ) || String::startsWith( ext, "^" ) ||
-				 String::endsWith( ext, "$" ) ) {
-				LuaPattern words( ext );
-				int start, end;
-				if ( words.find( extension, start, end ) ) {
-					count++;
-					if ( count > 1 )
-						return true;
-				}
-			} else if ( extension == ext ) {
-				count++;
-				if ( count > 1 )
-					return true;
-			}
-		}
-	}
-	return false;
+	return getFileTypesMatches( extension, extension ).size() > 1;
 }
 
 const SyntaxDefinition& SyntaxDefinitionManager::getByExtension( const std::string& filePath,
 																 bool hFileAsCPP ) const {
+	Lock l( mMutex );
 	std::string extension( FileSystem::fileExtension( filePath ) );
 	std::string fileName( FileSystem::fileNameFromPath( filePath ) );
 
@@ -2277,62 +2700,47 @@ const SyntaxDefinition& SyntaxDefinitionManager::getByExtension( const std::stri
 	const SyntaxDefinition* def = nullptr;
 
 	if ( !extension.empty() ) {
-		for ( const auto& style : mDefinitions ) {
-			for ( const auto& ext : style.getFiles() ) {
-				if ( String::startsWith( ext, "%." ) || String::startsWith( ext, "^" ) ||
-					 String::endsWith( ext, "$" ) ) {
-					LuaPattern words( ext );
-					int start, end;
-					if ( words.find( fileName, start, end ) ) {
-						if ( hFileAsCPP && style.getLSPName() == "c" && ext == "%.h$" )
-							return getByLSPName( "cpp" );
-
-						if ( extHasMultipleLangs && !style.hasExtensionPriority() ) {
-							def = &style;
-							continue;
-						}
-
-						return style;
-					}
-				} else if ( extension == ext ) {
-					if ( hFileAsCPP && style.getLSPName() == "c" && ext == ".h" )
-						return getByLSPName( "cpp" );
-
-					if ( extHasMultipleLangs && !style.hasExtensionPriority() ) {
-						def = &style;
-						continue;
-					}
-
-					return style;
-				}
+		for ( const auto& match : getFileTypesMatches( fileName, extension ) ) {
+			const SyntaxDefinition& style = getDefinition( match.first );
+			const std::string& ext = style.getFiles()[match.second];
+			if ( hFileAsCPP && style.getLSPName() == "c" && ( ext == "%.h$" || ext == ".h" ) )
+				return getByLSPName( "cpp" );
+
+			if ( extHasMultipleLangs && !style.hasExtensionPriority() ) {
+				def = &style;
+				continue;
 			}
+
+			return load( style );
 		}
 	}
 
-	return def != nullptr ? *def : mDefinitions[0];
+	return def != nullptr ? load( *def ) : getDefinition( 0 );
 }
 
 const SyntaxDefinition& SyntaxDefinitionManager::getByHeader( const std::string& header,
 															  bool /*hFileAsCPP*/ ) const {
+	Lock l( mMutex );
 	if ( !header.empty() ) {
-		for ( auto style = mDefinitions.rbegin(); style != mDefinitions.rend(); ++style ) {
-			for ( const auto& hdr : style->getHeaders() ) {
+		for ( size_t i = mDefinitionsCount; i-- > 0; ) {
+			const auto& style = getDefinition( i );
+			for ( const auto& hdr : style.getHeaders() ) {
 				LuaPattern words( hdr );
 				int start, end;
 				if ( words.find( header, start, end ) ) {
-					return *style;
+					return load( style );
 				}
 			}
 		}
 	}
-	return mDefinitions[0];
+	return getDefinition( 0 );
 }
 
 const SyntaxDefinition& SyntaxDefinitionManager::find( const std::string& filePath,
 													   const std::string& header,
 													   bool hFileAsCPP ) {
 	const SyntaxDefinition& def = getByHeader( header );
-	if ( def.getLanguageName() == mDefinitions[0].getLanguageName() )
+	if ( def.getLanguageName() == getPlainDefinition().getLanguageName() )
 		return getByExtension( filePath, hFileAsCPP );
 	return def;
 }
@@ -1,10 +1,104 @@
+#include <algorithm>
+#include <cstring>
+#include <eepp/system/filesystem.hpp>
 #include <eepp/system/log.hpp>
 #include <eepp/ui/doc/syntaxdefinitionmanager.hpp>
 #include <eepp/ui/doc/syntaxhighlighter.hpp>
 #include <eepp/ui/doc/syntaxtokenizer.hpp>
+#include <type_traits>
 
 namespace EE { namespace UI { namespace Doc {
 
+struct TokenizationCacheHeader {
+	char magic[4];
+	Uint32 version;
+	Uint64 definitionSignature;
+	Uint8 docHash[16];
+	Uint64 linesCount;
+};
+
+struct TokenizationCacheLine {
+	String::HashType hash;
+	Uint32 tokensCount;
+	SyntaxState initState;
+	SyntaxState state;
+	Uint64 signature;
+};
+
+static constexpr char TOKENIZATION_CACHE_MAGIC[4] = { 'E', 'E', 'T', 'K' };
+
+// Must be increased every time the cache format or the tokenizer output changes
+static constexpr Uint32 TOKENIZATION_CACHE_VERSION = 2;
+
+static_assert( std::is_trivially_copyable_v<TokenizationCacheLine>,
+			   "The tokenization cache lines are stored as raw bytes" );
+static_assert( std::is_trivially_copyable_v<SyntaxStyleType>,
+			   "The tokenization cache can't store the token types" );
+
+template <typename T> static void writeCacheValue( std::vector<Uint8>& data, const T& val ) {
+	size_t offset = data.size();
+	data.resize( offset + sizeof( val ) );
+	memcpy( &data[offset], &val, sizeof( val ) );
+}
+
+template <typename T>
+static bool readCacheValue( const Uint8*& ptr, const Uint8* end, T& val ) {
+	if ( (size_t)( end - ptr ) < sizeof( val ) )
+		return false;
+	memcpy( &val, ptr, sizeof( val ) );
+	ptr += sizeof( val );
+	return true;
+}
+
+// Minimum amount of lines per chunk for the speculative parallel tokenization to be worth it.
+static constexpr Int64 SPECULATIVE_MIN_CHUNK_LINES = 4096;
+
+// Maximum amount of tokenized segments kept per long line.
+static constexpr size_t LONG_LINE_MAX_CACHED_SEGMENTS = 64;
+
+template <typename T>
+static void shiftLines( UnorderedMap<size_t, T>& lines, Int64 fromLine, Int64 numLines ) {
+	if ( numLines == 0 || lines.empty() )
+		return;
+	UnorderedMap<size_t, T> shiftedLines;
+	for ( auto& line : lines ) {
+		if ( (Int64)line.first <= fromLine ) {
+			shiftedLines[line.first] = std::move( line.second );
+		} else if ( (Int64)line.first > fromLine - numLines ) {
+			shiftedLines[line.first + numLines] = std::move( line.second );
+		}
+	}
+	lines = std::move( shiftedLines );
+}
+
+// Splits the tokens that fully contain a token of the overlay, the overlay tokens that cross a
+// token boundary are ignored. Both token lists must be sorted by position.
+static std::vector<SyntaxTokenPosition>
+mergeTokens( const std::vector<SyntaxTokenPosition>& tokens,
+			 const std::vector<SyntaxTokenPosition>& overlay ) {
+	std::vector<SyntaxTokenPosition> merged;
+	merged.reserve( tokens.size() + overlay.size() * 2 );
+	size_t o = 0;
+	for ( const auto& token : tokens ) {
+		size_t pos = token.pos;
+		size_t end = token.pos + token.len;
+		while ( o < overlay.size() && overlay[o].pos < token.pos )
+			o++;
+		while ( o < overlay.size() && overlay[o].pos + overlay[o].len <= end ) {
+			const auto& otoken = overlay[o++];
+			if ( otoken.len == 0 || otoken.pos < pos )
+				continue;
+			if ( otoken.pos > pos )
+				merged.emplace_back( token.type, pos, otoken.pos - pos );
+			merged.emplace_back( otoken );
+			pos = otoken.pos + otoken.len;
+		}
+		if ( pos < end || token.len == 0 )
+			merged.emplace_back( token.type, pos, end - pos );
+	}
+	return merged;
+}
+
 Uint64 TokenizedLine::calcSignature( const std::vector<SyntaxTokenPosition>& tokens ) {
 	if ( !tokens.empty() ) {
 		return String::hash( reinterpret_cast<const char*>( tokens.data() ),
@@ -17,6 +111,138 @@ void TokenizedLine::updateSignature() {
 	this->signature = calcSignature( tokens );
 }
 
+TokenizedLines::TokenizedLines( size_t chunkCapacity ) : mChunkCapacity( chunkCapacity ) {}
+
+void TokenizedLines::clear() {
+	mChunks.clear();
+	mChunkStart.clear();
+	mSize = 0;
+}
+
+std::unique_ptr<TokenizedLines::Chunk> TokenizedLines::newChunk() const {
+	auto chunk = std::make_unique<Chunk>();
+	// Chunks must never reallocate, references to its lines are returned to the users.
+	chunk->reserve( mChunkCapacity );
+	return chunk;
+}
+
+size_t TokenizedLines::chunkIndex( size_t index ) const {
+	auto it = std::upper_bound( mChunkStart.begin(), mChunkStart.end(), index );
+	return std::distance( mChunkStart.begin(), it ) - 1;
+}
+
+void TokenizedLines::updateChunkStarts( size_t fromChunk ) {
+	mChunkStart.resize( mChunks.size() );
+	if ( fromChunk >= mChunks.size() )
+		return;
+	size_t start =
+		fromChunk == 0 ? 0 : mChunkStart[fromChunk - 1] + mChunks[fromChunk - 1]->size();
+	for ( size_t i = fromChunk; i < mChunks.size(); ++i ) {
+		mChunkStart[i] = start;
+		start += mChunks[i]->size();
+	}
+}
+
+TokenizedLine* TokenizedLines::find( size_t index ) {
+	if ( index >= mSize )
+		return nullptr;
+	size_t c = chunkIndex( index );
+	TokenizedLine& line = ( *mChunks[c] )[index - mChunkStart[c]];
+	return line.hash != 0 ? &line : nullptr;
+}
+
+TokenizedLine& TokenizedLines::operator[]( size_t index ) {
+	while ( index >= mSize ) {
+		if ( mChunks.empty() || mChunks.back()->size() >= mChunkCapacity ) {
+			mChunkStart.push_back( mSize );
+			mChunks.emplace_back( newChunk() );
+		}
+		mChunks.back()->emplace_back();
+		mSize++;
+	}
+	size_t c = chunkIndex( index );
+	return ( *mChunks[c] )[index - mChunkStart[c]];
+}
+
+void TokenizedLines::insert( size_t index, size_t count ) {
+	if ( index >= mSize || count == 0 )
+		return;
+
+	size_t c = chunkIndex( index );
+	size_t offset = index - mChunkStart[c];
+	Chunk& chunk = *mChunks[c];
+
+	if ( chunk.size() + count <= mChunkCapacity ) {
+		chunk.insert( chunk.begin() + offset, count, TokenizedLine{} );
+	} else {
+		// Split the chunk at the insertion point and fill the space in between with new chunks
+		std::vector<std::unique_ptr<Chunk>> newChunks;
+		auto tail = newChunk();
+		tail->insert( tail->end(), std::make_move_iterator( chunk.begin() + offset ),
+					  std::make_move_iterator( chunk.end() ) );
+		chunk.erase( chunk.begin() + offset, chunk.end() );
+
+		size_t remaining = count;
+		size_t fill = eemin( remaining, mChunkCapacity - chunk.size() );
+		chunk.resize( chunk.size() + fill );
+		remaining -= fill;
+
+		while ( remaining > 0 ) {
+			auto lines = newChunk();
+			fill = eemin( remaining, mChunkCapacity );
+			lines->resize( fill );
+			remaining -= fill;
+			newChunks.emplace_back( std::move( lines ) );
+		}
+
+		if ( !tail->empty() )
+			newChunks.emplace_back( std::move( tail ) );
+
+		mChunks.insert( mChunks.begin() + c + 1, std::make_move_iterator( newChunks.begin() ),
+						std::make_move_iterator( newChunks.end() ) );
+	}
+
+	mSize += count;
+	updateChunkStarts( c );
+}
+
+void TokenizedLines::erase( size_t index, size_t count ) {
+	if ( index >= mSize || count == 0 )
+		return;
+
+	count = eemin( count, mSize - index );
+	size_t first = chunkIndex( index );
+	size_t c = first;
+	size_t offset = index - mChunkStart[c];
+	size_t remaining = count;
+
+	while ( remaining > 0 && c < mChunks.size() ) {
+		Chunk& chunk = *mChunks[c];
+		size_t len = eemin( remaining, chunk.size() - offset );
+		chunk.erase( chunk.begin() + offset, chunk.begin() + offset + len );
+		remaining -= len;
+		offset = 0;
+		if ( chunk.empty() ) {
+			mChunks.erase( mChunks.begin() + c );
+		} else {
+			++c;
+		}
+	}
+
+	// Merge the chunk with its next sibling if both fit together, to avoid fragmentation
+	if ( first + 1 < mChunks.size() &&
+		 mChunks[first]->size() + mChunks[first + 1]->size() <= mChunkCapacity ) {
+		Chunk& chunk = *mChunks[first];
+		Chunk& next = *mChunks[first + 1];
+		chunk.insert( chunk.end(), std::make_move_iterator( next.begin() ),
+					  std::make_move_iterator( next.end() ) );
+		mChunks.erase( mChunks.begin() + first + 1 );
+	}
+
+	mSize -= count;
+	updateChunkStarts( first );
+}
+
 SyntaxHighlighter::SyntaxHighlighter( TextDocument* doc ) :
 	mDoc( doc ), mFirstInvalidLine( 0 ), mMaxWantedLine( 0 ) {
 	reset();
@@ -30,6 +256,7 @@ SyntaxHighlighter::~SyntaxHighlighter() {
 
 void SyntaxHighlighter::changeDoc( TextDocument* doc ) {
 	mDoc = doc;
+	clearOverlayLines();
 	reset();
 	mMaxWantedLine = (Int64)mDoc->linesCount() - 1;
 }
@@ -37,6 +264,9 @@ void SyntaxHighlighter::changeDoc( TextDocument* doc ) {
 void SyntaxHighlighter::reset() {
 	Lock l( mLinesMutex );
 	mLines.clear();
+	mTokenizerLines.clear();
+	mLongLines.clear();
+	mStructure.reset( mDoc->linesCount() );
 	mFirstInvalidLine = 0;
 	mMaxWantedLine = 0;
 }
@@ -57,9 +287,7 @@ TokenizedLine SyntaxHighlighter::tokenizeLine( const size_t& line, const SyntaxS
 		while ( textSize > 0 ) {
 			SyntaxTokenLen chunkSize =
 				textSize > mMaxTokenizationLength ? mMaxTokenizationLength : textSize;
-			SyntaxTokenPosition token{ SyntaxStyleTypes::Normal, pos, chunkSize };
-			token.len = ln.size();
-			tokenizedLine.tokens.emplace_back( token );
+			tokenizedLine.tokens.emplace_back( SyntaxStyleTypes::Normal, pos, chunkSize );
 			textSize -= chunkSize;
 			pos += chunkSize;
 		}
@@ -79,40 +307,105 @@ Mutex& SyntaxHighlighter::getLinesMutex() {
 }
 
 void SyntaxHighlighter::moveHighlight( const Int64& fromLine, const Int64& numLines ) {
+	// The modified line keeps its (now outdated) tokenization and will be re-tokenized once its
+	// hash is checked, only the lines after it need to be shifted.
 	Lock l( mLinesMutex );
-	if ( mLines.find( fromLine ) == mLines.end() )
-		return;
-	Int64 linesCount = mDoc->linesCount();
 	if ( numLines > 0 ) {
-		for ( Int64 i = linesCount - 1; i >= fromLine; --i ) {
-			auto lineIt = mLines.find( i - numLines );
-			if ( lineIt != mLines.end() ) {
-				const auto& line = lineIt->second;
-				if ( line.hash == mDoc->line( i ).getHash() ) {
-					auto nl = mLines.extract( lineIt );
-					nl.key() = i;
-					mLines.insert( std::move( nl ) );
-				}
-			}
-		}
+		mLines.insert( fromLine + 1, numLines );
 	} else if ( numLines < 0 ) {
-		for ( Int64 i = fromLine; i < linesCount; i++ ) {
-			auto lineIt = mLines.find( i - numLines );
-			if ( lineIt != mLines.end() && lineIt->second.hash == mDoc->line( i ).getHash() ) {
-				auto nl = mLines.extract( lineIt );
-				nl.key() = i;
-				mLines[i] = std::move( nl.mapped() );
-			}
+		mLines.erase( fromLine + 1, -numLines );
+	}
+
+	shiftLines( mTokenizerLines, fromLine, numLines );
+	shiftLines( mOverlayLines, fromLine, numLines );
+	shiftLines( mLongLines, fromLine, numLines );
+	mStructure.moveLines( fromLine, numLines );
+}
+
+bool SyntaxHighlighter::isLongLine( const size_t& index ) const {
+	return mMaxTokenizationLength != 0 && index < mDoc->linesCount() &&
+		   (Int64)mDoc->line( index ).size() > mMaxTokenizationLength;
+}
+
+size_t SyntaxHighlighter::getLongLineSegmentsCount( const size_t& index ) const {
+	if ( !isLongLine( index ) )
+		return 1;
+	return ( mDoc->line( index ).size() + mMaxTokenizationLength - 1 ) / mMaxTokenizationLength;
+}
+
+std::vector<SyntaxTokenPosition> SyntaxHighlighter::getLongLineSegment( const size_t& index,
+																		const size_t& segment ) {
+	if ( !isLongLine( index ) )
+		return getLine( index );
+
+	const auto& ln = mDoc->line( index );
+	size_t start = segment * mMaxTokenizationLength;
+	if ( start >= ln.size() )
+		return {};
+	SyntaxTokenLen len = eemin<size_t>( mMaxTokenizationLength, ln.size() - start );
+
+	if ( mDoc->getSyntaxDefinition().getPatterns().empty() )
+		return { { SyntaxStyleTypes::Normal, static_cast<SyntaxTokenLen>( start ), len } };
+
+	SyntaxState initState;
+	SyntaxState state;
+	size_t fromSegment = 0;
+	{
+		Lock l( mLinesMutex );
+		if ( index > 0 ) {
+			auto prevLine = mLines.find( index - 1 );
+			if ( prevLine )
+				initState = prevLine->state;
 		}
+		auto& longLine = mLongLines[index];
+		if ( longLine.hash != ln.getHash() || longLine.initState != initState ) {
+			longLine.hash = ln.getHash();
+			longLine.initState = initState;
+			longLine.segments.clear();
+			longLine.states.clear();
+		}
+		auto found = longLine.segments.find( segment );
+		if ( found != longLine.segments.end() )
+			return found->second;
+		fromSegment = eemin( segment, longLine.states.size() );
+		state = fromSegment > 0 ? longLine.states[fromSegment - 1] : initState;
+	}
+
+	// Every segment continues from the exit state of the previous one, the segments whose exit
+	// state is still unknown are tokenized in order up to the requested one
+	std::vector<SyntaxTokenPosition> tokens;
+	std::vector<SyntaxState> states;
+	for ( size_t i = fromSegment; i <= segment; i++ ) {
+		size_t segmentStart = i * mMaxTokenizationLength;
+		SyntaxTokenLen segmentLen =
+			eemin<size_t>( mMaxTokenizationLength, ln.size() - segmentStart );
+		auto res = SyntaxTokenizer::tokenizePosition(
+			mDoc->getSyntaxDefinition(),
+			ln.getText().substr( segmentStart, segmentLen ).toUtf8(), state );
+		state = res.second;
+		states.push_back( state );
+		tokens = std::move( res.first );
+		for ( auto& token : tokens )
+			token.pos += segmentStart;
 	}
+
+	Lock l( mLinesMutex );
+	auto& longLine = mLongLines[index];
+	if ( longLine.hash == ln.getHash() && longLine.initState == initState &&
+		 longLine.states.size() >= fromSegment ) {
+		for ( size_t i = longLine.states.size() - fromSegment; i < states.size(); i++ )
+			longLine.states.push_back( states[i] );
+		if ( longLine.segments.size() >= LONG_LINE_MAX_CACHED_SEGMENTS )
+			longLine.segments.clear();
+		longLine.segments[segment] = tokens;
+	}
+	return tokens;
 }
 
 Uint64 SyntaxHighlighter::getTokenizedLineSignature( const size_t& index ) {
 	Lock l( mLinesMutex );
 	auto line = mLines.find( index );
-	if ( line != mLines.end() )
-		return line->second.signature;
-	return 0;
+	return line ? line->signature : 0;
 }
 
 const Int64& SyntaxHighlighter::getMaxTokenizationLength() const {
@@ -128,14 +421,243 @@ void SyntaxHighlighter::tokenizeAsync( std::shared_ptr<ThreadPool> pool,
 	if ( mTokenizeAsync )
 		return;
 	mTokenizeAsync = true;
-	pool->run( [this, onDone] {
-		for ( size_t i = mFirstInvalidLine; i < mDoc->linesCount() && !mStopTokenizing; i++ )
-			getLine( i );
+
+	Int64 fromLine = mFirstInvalidLine;
+	Int64 linesCount = mDoc->linesCount();
+	Int64 numChunks = eemin<Int64>( pool->numThreads(),
+									( linesCount - fromLine ) / SPECULATIVE_MIN_CHUNK_LINES );
+
+	if ( numChunks <= 1 || mDoc->getSyntaxDefinition().getPatterns().empty() ) {
+		pool->run( [this, onDone] {
+			// Plain text lines are not stored, so they are indexed here
+			bool plainText = mDoc->getSyntaxDefinition().getPatterns().empty();
+			for ( size_t i = mFirstInvalidLine; i < mDoc->linesCount() && !mStopTokenizing; i++ ) {
+				if ( plainText ) {
+					indexStructure( i );
+				} else {
+					getLine( i );
+				}
+			}
+			mStopTokenizing = false;
+			mTokenizeAsync = false;
+			if ( onDone )
+				onDone();
+		} );
+		return;
+	}
+
+	tokenizeSpeculative( pool, fromLine, linesCount, numChunks, onDone );
+}
+
+void SyntaxHighlighter::tokenizeSpeculative( std::shared_ptr<ThreadPool> pool, Int64 fromLine,
+											 Int64 toLine, Int64 numChunks,
+											 const std::function<void()>& onDone ) {
+	// Every chunk except the first one starts from a guessed (default) state. Most grammars
+	// resynchronize after a few lines, so the verification pass only needs to re-tokenize the
+	// head of the chunks whose guessed entry state did not match the real one.
+	struct SpeculativeChunk {
+		Int64 start;
+		Int64 end;
+		std::vector<TokenizedLine> lines;
+	};
+
+	struct SpeculativeJob {
+		std::vector<SpeculativeChunk> chunks;
+		std::atomic<Int64> pending{ 0 };
+		SyntaxState initState;
+		// The chunks are only valid for the document version they were tokenized from
+		Uint64 modificationId{ 0 };
+	};
+
+	auto job = std::make_shared<SpeculativeJob>();
+	Int64 chunkSize = ( toLine - fromLine ) / numChunks;
+	for ( Int64 i = 0; i < numChunks; ++i ) {
+		Int64 start = fromLine + i * chunkSize;
+		Int64 end = i == numChunks - 1 ? toLine : start + chunkSize;
+		job->chunks.push_back( { start, end, {} } );
+	}
+	job->pending = numChunks;
+	job->modificationId = mDoc->getModificationId();
+
+	if ( fromLine > 0 ) {
+		Lock l( mLinesMutex );
+		auto prevLine = mLines.find( fromLine - 1 );
+		if ( prevLine )
+			job->initState = prevLine->state;
+	}
+
+	auto verifyAndCommit = [this, job, onDone] {
+		SyntaxState prevState = job->initState;
+
+		for ( auto& chunk : job->chunks ) {
+			if ( mStopTokenizing || mDoc->getModificationId() != job->modificationId )
+				break;
+
+			for ( size_t i = 0; i < chunk.lines.size(); ++i ) {
+				if ( chunk.lines[i].initState == prevState )
+					break;
+				if ( chunk.start + (Int64)i >= (Int64)mDoc->linesCount() )
+					break;
+				chunk.lines[i] = tokenizeLine( chunk.start + i, prevState );
+				prevState = chunk.lines[i].state;
+			}
+
+			if ( !chunk.lines.empty() )
+				prevState = chunk.lines.back().state;
+
+			Lock l( mLinesMutex );
+			// Lines inserted or removed while tokenizing would shift the indices, the lines left
+			// are tokenized again when requested
+			if ( mDoc->getModificationId() != job->modificationId )
+				break;
+			for ( size_t i = 0; i < chunk.lines.size(); ++i ) {
+				if ( !mTokenizerLines.empty() )
+					mTokenizerLines.erase( chunk.start + i );
+				mLines[chunk.start + i] = std::move( chunk.lines[i] );
+				updateStructure( chunk.start + i, mLines[chunk.start + i] );
+			}
+			mMaxWantedLine = eemax<Int64>( mMaxWantedLine, chunk.end - 1 );
+			chunk.lines.clear();
+		}
+
 		mStopTokenizing = false;
 		mTokenizeAsync = false;
 		if ( onDone )
 			onDone();
-	} );
+	};
+
+	for ( Int64 c = 0; c < numChunks; ++c ) {
+		pool->run( [this, job, c, verifyAndCommit] {
+			auto& chunk = job->chunks[c];
+			SyntaxState state = c == 0 ? job->initState : SyntaxState{};
+			chunk.lines.reserve( chunk.end - chunk.start );
+			for ( Int64 i = chunk.start;
+				  i < chunk.end && i < (Int64)mDoc->linesCount() && !mStopTokenizing; ++i ) {
+				chunk.lines.emplace_back( tokenizeLine( i, state ) );
+				state = chunk.lines.back().state;
+			}
+			// The last chunk to finish runs the in-order verification, so no pool thread is
+			// ever blocked waiting for another one.
+			if ( --job->pending == 0 )
+				verifyAndCommit();
+		} );
+	}
+}
+
+bool SyntaxHighlighter::saveCache( const std::string& path ) {
+	std::vector<Uint8> data;
+	return saveCache( data ) && FileSystem::fileWrite( path, data );
+}
+
+bool SyntaxHighlighter::saveCache( std::vector<Uint8>& data ) {
+	if ( mDoc->getSyntaxDefinition().getPatterns().empty() )
+		return false;
+
+	TokenizationCacheHeader header{};
+	memcpy( header.magic, TOKENIZATION_CACHE_MAGIC, sizeof( header.magic ) );
+	header.version = TOKENIZATION_CACHE_VERSION;
+	header.definitionSignature = mDoc->getSyntaxDefinition().getSignature();
+	if ( header.definitionSignature == 0 )
+		return false;
+	// The content hash is only valid if the buffer is the same as the file
+	if ( !mDoc->isDirty() )
+		memcpy( header.docHash, mDoc->getHash().data(), sizeof( header.docHash ) );
+
+	data.resize( sizeof( header ) );
+
+	Lock l( mLinesMutex );
+	SyntaxState prevState;
+	size_t linesCount = eemin( mLines.size(), mDoc->linesCount() );
+
+	// Only the consecutive valid lines from the start are stored
+	for ( ; header.linesCount < linesCount; ++header.linesCount ) {
+		size_t index = header.linesCount;
+		TokenizedLine* line = mLines.find( index );
+		if ( !line || line->hash != mDoc->line( index ).getHash() ||
+			 line->initState != prevState )
+			break;
+
+		auto tokenizerLine = mTokenizerLines.find( index );
+		if ( tokenizerLine != mTokenizerLines.end() && tokenizerLine->second.hash == line->hash )
+			line = &tokenizerLine->second;
+
+		TokenizationCacheLine cacheLine{ line->hash, (Uint32)line->tokens.size(),
+										 line->initState, line->state, line->signature };
+		writeCacheValue( data, cacheLine );
+		// Tokens are written field by field, the token struct is not a raw bytes format
+		for ( const auto& token : line->tokens ) {
+			writeCacheValue( data, token.type );
+			writeCacheValue( data, token.pos );
+			writeCacheValue( data, token.len );
+		}
+		prevState = line->state;
+	}
+
+	if ( header.linesCount == 0 )
+		return false;
+
+	memcpy( data.data(), &header, sizeof( header ) );
+	return true;
+}
+
+Int64 SyntaxHighlighter::loadCache( const std::string& path ) {
+	std::vector<Uint8> data;
+	if ( mDoc->getSyntaxDefinition().getPatterns().empty() || !FileSystem::fileExists( path ) ||
+		 !FileSystem::fileGet( path, data ) || data.size() < sizeof( TokenizationCacheHeader ) )
+		return 0;
+
+	TokenizationCacheHeader header;
+	memcpy( &header, data.data(), sizeof( header ) );
+
+	if ( memcmp( header.magic, TOKENIZATION_CACHE_MAGIC, sizeof( header.magic ) ) != 0 ||
+		 header.version != TOKENIZATION_CACHE_VERSION || header.definitionSignature == 0 ||
+		 header.definitionSignature != mDoc->getSyntaxDefinition().getSignature() )
+		return 0;
+
+	// If the file did not change there's no need to compare each line hash
+	static const std::array<Uint8, 16> emptyHash{};
+	bool hasDocHash = memcmp( header.docHash, emptyHash.data(), sizeof( header.docHash ) ) != 0;
+	bool sameContent =
+		hasDocHash &&
+		memcmp( header.docHash, mDoc->getHash().data(), sizeof( header.docHash ) ) == 0;
+
+	const Uint8* ptr = data.data() + sizeof( header );
+	const Uint8* end = data.data() + data.size();
+	Int64 loaded = 0;
+
+	Lock l( mLinesMutex );
+	for ( Uint64 i = 0; i < header.linesCount && i < mDoc->linesCount(); ++i ) {
+		TokenizationCacheLine cacheLine;
+		if ( !readCacheValue( ptr, end, cacheLine ) )
+			break;
+
+		size_t tokensSize = ( sizeof( SyntaxStyleType ) + 2 * sizeof( SyntaxTokenLen ) ) *
+							(size_t)cacheLine.tokensCount;
+		if ( (size_t)( end - ptr ) < tokensSize ||
+			 ( !sameContent && cacheLine.hash != mDoc->line( i ).getHash() ) )
+			break;
+
+		TokenizedLine& line = mLines[i];
+		line.hash = cacheLine.hash;
+		line.initState = cacheLine.initState;
+		line.state = cacheLine.state;
+		line.signature = cacheLine.signature;
+		line.tokens.clear();
+		line.tokens.reserve( cacheLine.tokensCount );
+		for ( Uint32 t = 0; t < cacheLine.tokensCount; ++t ) {
+			SyntaxTokenPosition token{ SyntaxStyleTypes::Normal, 0, 0 };
+			readCacheValue( ptr, end, token.type );
+			readCacheValue( ptr, end, token.pos );
+			readCacheValue( ptr, end, token.len );
+			line.tokens.emplace_back( token );
+		}
+		updateStructure( i, line );
+		loaded++;
+	}
+
+	mFirstInvalidLine = eemax<Int64>( mFirstInvalidLine, loaded );
+	mMaxWantedLine = eemax<Int64>( mMaxWantedLine, loaded - 1 );
+	return loaded;
 }
 
 const std::vector<SyntaxTokenPosition>& SyntaxHighlighter::getLine( const size_t& index,
@@ -149,13 +671,14 @@ const std::vector<SyntaxTokenPosition>& SyntaxHighlighter::getLine( const size_t
 
 	{
 		Lock l( mLinesMutex );
-		auto it = mLines.find( index );
+		auto line = mLines.find( index );
 		bool needsTokenize =
-			it == mLines.end() ||
-			( index < mDoc->linesCount() && mDoc->line( index ).getHash() != it->second.hash );
+			!line || ( index < mDoc->linesCount() && mDoc->line( index ).getHash() != line->hash );
 		if ( !needsTokenize ) {
+			if ( !mOverlayLines.empty() )
+				applyOverlay( index, *line );
 			mMaxWantedLine = eemax<Int64>( mMaxWantedLine, index );
-			return it->second.tokens;
+			return line->tokens;
 		}
 	}
 
@@ -167,17 +690,22 @@ const std::vector<SyntaxTokenPosition>& SyntaxHighlighter::getLine( const size_t
 	SyntaxState prevState;
 	if ( index > 0 ) {
 		Lock l( mLinesMutex );
-		auto prevIt = mLines.find( index - 1 );
-		if ( prevIt != mLines.end() )
-			prevState = prevIt->second.state;
+		auto prevLine = mLines.find( index - 1 );
+		if ( prevLine )
+			prevState = prevLine->state;
 	}
 	auto tokenizedLine = tokenizeLine( index, prevState );
 
 	Lock l( mLinesMutex );
-	mLines[index] = std::move( tokenizedLine );
-	mTokenizerLines[index] = mLines[index];
+	auto& line = mLines[index];
+	line = std::move( tokenizedLine );
+	updateStructure( index, line );
+	if ( !mTokenizerLines.empty() )
+		mTokenizerLines.erase( index );
+	if ( !mOverlayLines.empty() )
+		applyOverlay( index, line );
 	mMaxWantedLine = eemax<Int64>( mMaxWantedLine, index );
-	return mLines[index].tokens;
+	return line.tokens;
 }
 
 Int64 SyntaxHighlighter::getFirstInvalidLine() const {
@@ -201,19 +729,18 @@ bool SyntaxHighlighter::updateDirty( int visibleLinesCount ) {
 			SyntaxState state;
 			if ( index > 0 ) {
 				Lock l( mLinesMutex );
-				auto prevIt = mLines.find( index - 1 );
-				if ( prevIt != mLines.end() )
-					state = prevIt->second.state;
+				auto prevLine = mLines.find( index - 1 );
+				if ( prevLine )
+					state = prevLine->state;
 			}
 
 			bool mustTokenize = false;
 
 			{
 				Lock l( mLinesMutex );
-				const auto& it = mLines.find( index );
-				mustTokenize = it == mLines.end() ||
-							   it->second.hash != mDoc->line( index ).getHash() ||
-							   it->second.initState != state;
+				auto line = mLines.find( index );
+				mustTokenize = !line || line->hash != mDoc->line( index ).getHash() ||
+							   line->initState != state;
 			}
 
 			if ( mustTokenize ) {
@@ -221,7 +748,9 @@ bool SyntaxHighlighter::updateDirty( int visibleLinesCount ) {
 
 				Lock l( mLinesMutex );
 				mLines[index] = std::move( tokenizedLine );
-				mTokenizerLines[index] = mLines[index];
+				updateStructure( index, mLines[index] );
+				if ( !mTokenizerLines.empty() )
+					mTokenizerLines.erase( index );
 				changed = true;
 			}
 		}
@@ -239,10 +768,10 @@ SyntaxHighlighter::getSyntaxDefinitionFromTextPosition( const TextPosition& posi
 	{
 		Lock l( mLinesMutex );
 		auto found = mLines.find( position.line() );
-		if ( found == mLines.end() ) {
+		if ( !found ) {
 			return SyntaxDefinitionManager::instance()->getPlainDefinition();
 		} else {
-			lineState = found->second.state;
+			lineState = found->state;
 		}
 	}
 
@@ -288,6 +817,7 @@ SyntaxTokenPosition SyntaxHighlighter::getTokenPositionAt( const TextPosition& p
 void SyntaxHighlighter::setLine( const size_t& line, const TokenizedLine& tokenization ) {
 	Lock l( mLinesMutex );
 	mLines[line] = tokenization;
+	updateStructure( line, mLines[line] );
 }
 
 void SyntaxHighlighter::mergeLine( const size_t& line, const TokenizedLine& tokenization ) {
@@ -295,10 +825,17 @@ void SyntaxHighlighter::mergeLine( const size_t& line, const TokenizedLine& toke
 	{
 		mLinesMutex.lock();
 		auto found = mTokenizerLines.find( line );
+		TokenizedLine* cur = nullptr;
 		if ( found != mTokenizerLines.end() &&
 			 mDoc->line( line ).getHash() == found->second.hash ) {
 			tline = found->second;
 			mLinesMutex.unlock();
+		} else if ( found == mTokenizerLines.end() && ( cur = mLines.find( line ) ) &&
+					mDoc->line( line ).getHash() == cur->hash ) {
+			// Lines without a tokenizer backup have not been merged yet
+			tline = *cur;
+			mTokenizerLines[line] = tline;
+			mLinesMutex.unlock();
 		} else {
 			mLinesMutex.unlock();
 			tline = tokenizeLine( line );
@@ -343,6 +880,59 @@ void SyntaxHighlighter::mergeLine( const size_t& line, const TokenizedLine& toke
 	tline.signature = tokenization.signature;
 	Lock l( mLinesMutex );
 	mLines[line] = std::move( tline );
+	updateStructure( line, mLines[line] );
+}
+
+void SyntaxHighlighter::setOverlayLines( UnorderedMap<size_t, TokenizedLine>&& lines ) {
+	Lock l( mLinesMutex );
+	// Restore the lines merged with an overlay line that changed, they are merged again when
+	// requested
+	for ( auto it = mTokenizerLines.begin(); it != mTokenizerLines.end(); ) {
+		auto newLine = lines.find( it->first );
+		auto oldLine = mOverlayLines.find( it->first );
+		if ( newLine != lines.end() && oldLine != mOverlayLines.end() &&
+			 newLine->second.hash == oldLine->second.hash &&
+			 newLine->second.signature == oldLine->second.signature ) {
+			++it;
+			continue;
+		}
+		auto* line = mLines.find( it->first );
+		if ( line && line->hash == it->second.hash ) {
+			*line = std::move( it->second );
+			updateStructure( it->first, *line );
+		}
+		it = mTokenizerLines.erase( it );
+	}
+	mOverlayLines = std::move( lines );
+}
+
+void SyntaxHighlighter::clearOverlayLines() {
+	setOverlayLines( {} );
+}
+
+void SyntaxHighlighter::applyOverlay( const size_t& index, TokenizedLine& line ) {
+	auto overlay = mOverlayLines.find( index );
+	// Lines with a tokenizer backup are already merged
+	if ( overlay == mOverlayLines.end() || overlay->second.hash != line.hash ||
+		 mTokenizerLines.find( index ) != mTokenizerLines.end() )
+		return;
+	mTokenizerLines[index] = line;
+	line.tokens = mergeTokens( line.tokens, overlay->second.tokens );
+	line.signature = hashCombine( line.signature, overlay->second.signature );
+	updateStructure( index, line );
+}
+
+void SyntaxHighlighter::updateStructure( const size_t& index, const TokenizedLine& line ) {
+	// The tokenization might belong to a previous version of the line
+	if ( index < mDoc->linesCount() && mDoc->line( index ).getHash() == line.hash )
+		mStructure.setLine( index, mDoc->line( index ).getText(), &line.tokens );
+}
+
+void SyntaxHighlighter::indexStructure( const size_t& index ) {
+	if ( index >= mDoc->linesCount() )
+		return;
+	auto tokens = getLine( index );
+	mStructure.setLine( index, mDoc->line( index ).getText(), &tokens );
 }
 
 }}} // namespace EE::UI::Doc
@@ -1,9 +1,11 @@
-﻿#include <cstdio>
+﻿#include <algorithm>
+#include <cstdio>
 #include <eepp/core/debug.hpp>
 #include <eepp/network/uri.hpp>
 #include <eepp/system/filesystem.hpp>
 #include <eepp/system/iostreamfile.hpp>
 #include <eepp/system/iostreammemory.hpp>
+#include <eepp/system/iostreamstring.hpp>
 #include <eepp/system/log.hpp>
 #include <eepp/system/luapattern.hpp>
 #include <eepp/system/md5.hpp>
@@ -25,6 +27,26 @@ namespace EE { namespace UI { namespace Doc {
 
 static constexpr char DEFAULT_NON_WORD_CHARS[] = " \t\n/\\()\"':,.;<>~!@#$%^&*|+=[]{}`?-";
 
+// Documents smaller than this are fast enough to tokenize, they are not worth caching
+static constexpr size_t TOKENIZATION_CACHE_MIN_LINES = 10000;
+
+// Number of lines searched by each findAllAsync task at a time
+static constexpr Int64 FIND_ALL_CHUNK_LINES = 2048;
+
+// Edit distance limit of the reload line diff, bigger changes are replaced as a single block
+static constexpr int LINES_DIFF_MAX_DISTANCE = 2048;
+
+template <typename T>
+static void writePersistedFile( std::shared_ptr<ThreadPool> pool, const std::string& path,
+								T&& data ) {
+	if ( !pool ) {
+		FileSystem::fileWrite( path, data );
+		return;
+	}
+	auto buffer = std::make_shared<std::decay_t<T>>( std::forward<T>( data ) );
+	pool->run( [path, buffer] { FileSystem::fileWrite( path, *buffer ); } );
+}
+
 bool TextDocument::isNonWord( String::StringBaseType ch ) const {
 	return mNonWordChars.find_first_of( ch ) != String::InvalidPos;
 }
@@ -56,6 +78,17 @@ TextDocument::~TextDocument() {
 		mLoading = false;
 		Lock l( mLoadingMutex );
 	}
+
+	if ( !mTokenizationCachePath.empty() && hasFilepath() &&
+		 linesCount() >= TOKENIZATION_CACHE_MIN_LINES ) {
+		std::vector<Uint8> data;
+		if ( mHighlighter->saveCache( data ) )
+			writePersistedFile( mPersistencePool, getTokenizationCacheFilePath(),
+								std::move( data ) );
+	}
+
+	saveUndoHistory();
+
 	notifyDocumentClosed();
 	if ( mDeleteOnClose )
 		FileSystem::fileRemove( mFilePath );
@@ -87,6 +120,7 @@ void TextDocument::reset() {
 	mLastSelection = 0;
 	mLines.clear();
 	mLines.emplace_back( String( "\n" ) );
+	mModificationId++;
 	mSyntaxDefinition = SyntaxDefinitionManager::instance()->getPlainDefinition();
 	mUndoStack.clear();
 	cleanChangeId();
@@ -298,6 +332,11 @@ TextDocument::LoadStatus TextDocument::loadFromStream( IOStream& file, std::stri
 		mLines.push_back( String( "\n" ) );
 	}
 
+	mModificationId++;
+	// A reload applies the differences to the current lines, which keep the index up to date
+	if ( callReset )
+		mHighlighter->getStructureIndex().reset( mLines.size() );
+
 	if ( mAutoDetectIndentType )
 		guessIndentType();
 
@@ -493,6 +532,15 @@ TextDocument::LoadStatus TextDocument::loadFromFile( const std::string& path ) {
 	mFileRealPath = FileInfo::isLink( mFilePath ) ? FileInfo( FileInfo( mFilePath ).linksTo() )
 												  : FileInfo( mFilePath );
 	resetSyntax();
+	if ( ret == LoadStatus::Loaded && !mTokenizationCachePath.empty() &&
+		 linesCount() >= TOKENIZATION_CACHE_MIN_LINES )
+		mHighlighter->loadCache( getTokenizationCacheFilePath() );
+	if ( ret == LoadStatus::Loaded && !mUndoHistoryPath.empty() &&
+		 FileSystem::fileExists( getUndoHistoryFilePath() ) ) {
+		IOStreamFile file( getUndoHistoryFilePath(), "rb" );
+		if ( mUndoStack.load( file ) )
+			cleanChangeId();
+	}
 	mLoading = false;
 	if ( !mLoadingAsync )
 		notifyDocumentLoaded();
@@ -608,20 +656,168 @@ bool TextDocument::loadAsyncFromURL( const std::string& url,
 	return true;
 }
 
+struct LinesDiffHunk {
+	int oldStart;
+	int oldEnd;
+	int newStart;
+	int newEnd;
+};
+
+// Myers line diff over the line hashes, the common prefix and suffix are trimmed first since
+// external changes usually touch a small part of the document
+static std::vector<LinesDiffHunk> diffLines( const std::vector<TextDocumentLine>& oldLines,
+											 const std::vector<TextDocumentLine>& newLines ) {
+	auto equals = [&oldLines, &newLines]( int oldIdx, int newIdx ) {
+		return oldLines[oldIdx].getHash() == newLines[newIdx].getHash() &&
+			   oldLines[oldIdx].getText() == newLines[newIdx].getText();
+	};
+
+	std::vector<LinesDiffHunk> hunks;
+	int start = 0;
+	int oldEnd = oldLines.size();
+	int newEnd = newLines.size();
+
+	while ( start < oldEnd && start < newEnd && equals( start, start ) )
+		start++;
+
+	while ( oldEnd > start && newEnd > start && equals( oldEnd - 1, newEnd - 1 ) ) {
+		oldEnd--;
+		newEnd--;
+	}
+
+	if ( start == oldEnd && start == newEnd )
+		return hunks;
+
+	int n = oldEnd - start;
+	int m = newEnd - start;
+	int maxD = eemin( n + m, LINES_DIFF_MAX_DISTANCE );
+	int offset = maxD + 1;
+	std::vector<int> v( 2 * maxD + 3, 0 );
+	std::vector<std::vector<int>> trace;
+	bool found = false;
+
+	for ( int d = 0; d <= maxD && !found; ++d ) {
+		trace.emplace_back( v.begin() + offset - d - 1, v.begin() + offset + d + 2 );
+		for ( int k = -d; k <= d; k += 2 ) {
+			int x = ( k == -d || ( k != d && v[offset + k - 1] < v[offset + k + 1] ) )
+						? v[offset + k + 1]
+						: v[offset + k - 1] + 1;
+			int y = x - k;
+			while ( x < n && y < m && equals( start + x, start + y ) ) {
+				x++;
+				y++;
+			}
+			v[offset + k] = x;
+			if ( x >= n && y >= m ) {
+				found = true;
+				break;
+			}
+		}
+	}
+
+	if ( !found ) {
+		hunks.push_back( { start, oldEnd, start, newEnd } );
+		return hunks;
+	}
+
+	// Walk back the edit path collecting the matching lines
+	std::vector<std::pair<int, int>> matches;
+	int x = n;
+	int y = m;
+	for ( int d = (int)trace.size() - 1; d >= 0; --d ) {
+		const auto& tv = trace[d];
+		int k = x - y;
+		int prevK =
+			( k == -d || ( k != d && tv[k - 1 + d + 1] < tv[k + 1 + d + 1] ) ) ? k + 1 : k - 1;
+		int prevX = tv[prevK + d + 1];
+		int prevY = prevX - prevK;
+		while ( x > prevX && y > prevY ) {
+			x--;
+			y--;
+			matches.emplace_back( x, y );
+		}
+		x = prevX;
+		y = prevY;
+	}
+
+	int oldIdx = 0;
+	int newIdx = 0;
+	for ( auto it = matches.rbegin(); it != matches.rend(); ++it ) {
+		if ( it->first > oldIdx || it->second > newIdx )
+			hunks.push_back(
+				{ start + oldIdx, start + it->first, start + newIdx, start + it->second } );
+		oldIdx = it->first + 1;
+		newIdx = it->second + 1;
+	}
+
+	if ( oldIdx < n || newIdx < m )
+		hunks.push_back( { start + oldIdx, oldEnd, start + newIdx, newEnd } );
+
+	return hunks;
+}
+
+void TextDocument::applyLinesDiff( const std::vector<TextDocumentLine>& newLines ) {
+	auto hunks = diffLines( mLines, newLines );
+	if ( hunks.empty() )
+		return;
+
+	Int64 linesCount = mLines.size();
+	std::vector<DocumentContentChange> edits;
+	edits.reserve( hunks.size() );
+
+	for ( const auto& hunk : hunks ) {
+		String text;
+		for ( int i = hunk.newStart; i < hunk.newEnd; ++i )
+			text += newLines[i].getText();
+
+		if ( hunk.oldEnd < linesCount ) {
+			edits.push_back( { { { hunk.oldStart, 0 }, { hunk.oldEnd, 0 } }, text } );
+			continue;
+		}
+
+		// The last line break belongs to the end of the document, keep it out of the edit
+		if ( !text.empty() )
+			text.resize( text.size() - 1 );
+		TextPosition end( linesCount - 1, (Int64)mLines[linesCount - 1].size() - 1 );
+
+		if ( hunk.oldStart == 0 ) {
+			edits.push_back( { { { 0, 0 }, end }, text } );
+		} else {
+			TextPosition start( hunk.oldStart - 1,
+								(Int64)mLines[hunk.oldStart - 1].size() - 1 );
+			edits.push_back(
+				{ { start, end }, hunk.newStart < hunk.newEnd ? String( "\n" ) + text : text } );
+		}
+	}
+
+	applyEdits( edits );
+}
+
 TextDocument::LoadStatus TextDocument::reload() {
 	TextDocument::LoadStatus ret = LoadStatus::Failed;
 	std::string path( mFilePath );
 	if ( mFileRealPath.exists() ) {
 		auto selection = mSelection;
-		mUndoStack.clear();
-		cleanChangeId();
+		std::vector<TextDocumentLine> lines( std::move( mLines ) );
 		IOStreamFile file( path, "rb" );
 		ret = loadFromStream( file, path, false );
 		mFileRealPath = FileInfo::isLink( mFilePath ) ? FileInfo( FileInfo( mFilePath ).linksTo() )
 													  : FileInfo( mFilePath );
-		resetSyntax();
-		notifyDocumentReloaded();
-		setSelection( sanitizeRange( selection ) );
+		if ( ret == LoadStatus::Loaded ) {
+			// Apply only the differences with the current buffer, so highlighting, selections,
+			// undo history and clients only see the lines that actually changed
+			std::vector<TextDocumentLine> newLines( std::move( mLines ) );
+			mLines = std::move( lines );
+			applyLinesDiff( newLines );
+			cleanChangeId();
+		} else {
+			mUndoStack.clear();
+			cleanChangeId();
+			mHighlighter->getStructureIndex().reset( mLines.size() );
+			resetSyntax();
+			notifyDocumentReloaded();
+			setSelection( sanitizeRange( selection ) );
+		}
 	}
 	return ret;
 }
@@ -642,6 +838,8 @@ bool TextDocument::save( const std::string& path ) {
 			mFileRealPath =
 				FileInfo::isLink( mFilePath ) ? FileInfo( mFilePath ).linksTo() : mFilePath;
 			mSaving = false;
+			// Stored on every save, so the history survives a crash
+			saveUndoHistory();
 			notifyDocumentSaved();
 			return true;
 		} else {
@@ -1285,6 +1483,227 @@ size_t TextDocument::remove( const size_t& cursorIdx, TextRange range,
 	return linesRemoved;
 }
 
+std::vector<TextRange> TextDocument::applyEdits( const std::vector<DocumentContentChange>& edits,
+												const std::vector<size_t>& cursorIdxs ) {
+	struct Edit {
+		size_t index;
+		TextRange range;
+		TextRange newRange;
+		String removed;
+	};
+
+	std::vector<TextRange> result( edits.size() );
+	std::vector<Edit> sorted;
+	sorted.reserve( edits.size() );
+
+	for ( size_t i = 0; i < edits.size(); ++i ) {
+		TextRange range( sanitizeRange( edits[i].range.normalized() ) );
+		if ( !range.hasSelection() && edits[i].text.empty() ) {
+			result[i] = range;
+			continue;
+		}
+		sorted.push_back( { i, range, {}, {} } );
+	}
+
+	std::stable_sort( sorted.begin(), sorted.end(), []( const Edit& left, const Edit& right ) {
+		return left.range.start() < right.range.start();
+	} );
+
+	// Overlapping edits can't be applied in a single pass, the first one wins
+	size_t count = 0;
+	for ( size_t i = 0; i < sorted.size(); ++i ) {
+		if ( count > 0 && sorted[i].range.start() < sorted[count - 1].range.end() )
+			continue;
+		if ( count != i )
+			sorted[count] = std::move( sorted[i] );
+		count++;
+	}
+	sorted.resize( count );
+
+	if ( sorted.empty() )
+		return result;
+
+	mModificationId++;
+
+	size_t lineCount = mLines.size();
+	Int64 linesDelta = 0;
+	bool inPlace = true;
+	for ( auto& edit : sorted ) {
+		const String& text = edits[edit.index].text;
+		edit.removed = getText( edit.range );
+		Int64 delta = static_cast<Int64>( std::count( text.begin(), text.end(), '\n' ) ) -
+					  ( edit.range.end().line() - edit.range.start().line() );
+		inPlace = inPlace && delta == 0;
+		linesDelta += delta;
+	}
+
+	// Only the lines from the first to the last edit are rebuilt, composed from the text
+	// surrounding the edits plus the new text. If no edit changes its line count the edited lines
+	// are replaced in place, otherwise the rebuilt lines are spliced into the document.
+	Int64 firstLine = sorted.front().range.start().line();
+	Int64 lastLine = sorted.back().range.end().line();
+	std::vector<TextDocumentLine> lines;
+	if ( !inPlace )
+		lines.reserve( lastLine - firstLine + 1 + linesDelta );
+	String cur;
+	Int64 outLine = firstLine;
+	auto pushLine = [this, &lines, &cur, &outLine, inPlace]() {
+		if ( inPlace ) {
+			mLines[outLine] = TextDocumentLine( std::move( cur ) );
+		} else {
+			lines.emplace_back( std::move( cur ) );
+		}
+		outLine++;
+		cur.clear();
+	};
+	Int64 nextLine = firstLine;
+	TextPosition prevEnd;
+
+	for ( auto& edit : sorted ) {
+		const TextPosition& start = edit.range.start();
+
+		if ( prevEnd.isValid() && prevEnd.line() == start.line() ) {
+			cur += mLines[start.line()].substr( prevEnd.column(),
+												start.column() - prevEnd.column() );
+		} else {
+			if ( prevEnd.isValid() ) {
+				cur += mLines[prevEnd.line()].substr( prevEnd.column() );
+				pushLine();
+			}
+			for ( ; nextLine < start.line(); ++nextLine, ++outLine ) {
+				if ( !inPlace )
+					lines.emplace_back( std::move( mLines[nextLine] ) );
+			}
+			cur = mLines[start.line()].substr( 0, start.column() );
+		}
+
+		const String& text = edits[edit.index].text;
+		edit.newRange.setStart( { outLine, (Int64)cur.size() } );
+		size_t pos = 0;
+		size_t newLinePos;
+		while ( ( newLinePos = text.find( '\n', pos ) ) != String::InvalidPos ) {
+			cur += text.substr( pos, newLinePos - pos + 1 );
+			pushLine();
+			pos = newLinePos + 1;
+		}
+		cur += text.substr( pos );
+		edit.newRange.setEnd( { outLine, (Int64)cur.size() } );
+
+		prevEnd = edit.range.end();
+		nextLine = prevEnd.line() + 1;
+	}
+
+	cur += mLines[prevEnd.line()].substr( prevEnd.column() );
+	if ( cur.empty() || cur[cur.size() - 1] != '\n' )
+		cur += '\n';
+	pushLine();
+
+	if ( !inPlace ) {
+		size_t oldCount = lastLine - firstLine + 1;
+		size_t common = eemin( oldCount, lines.size() );
+		auto linesStart = mLines.begin() + firstLine;
+		std::move( lines.begin(), lines.begin() + common, linesStart );
+		if ( lines.size() > oldCount ) {
+			mLines.insert( linesStart + oldCount, std::make_move_iterator( lines.begin() + common ),
+						   std::make_move_iterator( lines.end() ) );
+		} else if ( lines.size() < oldCount ) {
+			mLines.erase( linesStart + common, linesStart + oldCount );
+		}
+	}
+
+	// Remap all the selections at once
+	std::vector<Int64> linesShift( sorted.size() );
+	Int64 shift = 0;
+	for ( size_t i = 0; i < sorted.size(); ++i ) {
+		shift += ( sorted[i].newRange.end().line() - sorted[i].newRange.start().line() ) -
+				 ( sorted[i].range.end().line() - sorted[i].range.start().line() );
+		linesShift[i] = shift;
+	}
+
+	auto mapPosition = [&sorted, &linesShift]( const TextPosition& position ) -> TextPosition {
+		auto it = std::upper_bound(
+			sorted.begin(), sorted.end(), position,
+			[]( const TextPosition& pos, const Edit& edit ) { return pos < edit.range.end(); } );
+		if ( it != sorted.end() && it->range.start() < position )
+			return it->newRange.end();
+		if ( it == sorted.begin() )
+			return position;
+		size_t idx = std::distance( sorted.begin(), it ) - 1;
+		const Edit& edit = sorted[idx];
+		if ( position.line() == edit.range.end().line() )
+			return { edit.newRange.end().line(),
+					 edit.newRange.end().column() + position.column() - edit.range.end().column() };
+		return { position.line() + linesShift[idx], position.column() };
+	};
+
+	TextRanges oldSelection( mSelection );
+	for ( auto& sel : mSelection )
+		sel = TextRange( mapPosition( sel.start() ), mapPosition( sel.end() ) );
+
+	// The whole batch shares the same timestamp so it's undone as a single group
+	mUndoStack.clearRedoStack();
+	Time time( mTimer.getElapsedTime() );
+	auto& undoStack = mUndoStack.getUndoStackContainer();
+	{
+		BoolScopedOp op( mUndoStack.mSkipCoalescing, true );
+		mUndoStack.pushSelection( undoStack, 0, oldSelection, time );
+		for ( const auto& edit : sorted ) {
+			size_t cursorIdx = edit.index < cursorIdxs.size() ? cursorIdxs[edit.index] : 0;
+			if ( !edit.removed.empty() )
+				mUndoStack.pushInsert( undoStack, edit.removed, cursorIdx, edit.newRange.start(),
+									   time );
+			if ( edit.newRange.hasSelection() )
+				mUndoStack.pushRemove( undoStack, cursorIdx, edit.newRange, time );
+		}
+	}
+
+	for ( auto it = sorted.rbegin(); it != sorted.rend(); ++it ) {
+		Int64 delta = ( it->newRange.end().line() - it->newRange.start().line() ) -
+					  ( it->range.end().line() - it->range.start().line() );
+		if ( delta != 0 ) {
+			mHighlighter->moveHighlight( it->range.start().line(), delta );
+			notifiyDocumenLineMove( it->range.start().line(), delta );
+		}
+	}
+
+	// Each change range is expressed in the document with the previous changes applied, so its
+	// start is also the final position of the edit
+	std::vector<DocumentContentChange> changes;
+	changes.reserve( sorted.size() );
+	for ( const auto& edit : sorted ) {
+		const TextPosition& start = edit.newRange.start();
+		TextPosition end( edit.range.end() );
+		if ( edit.range.start().line() == end.line() ) {
+			end = { start.line(), start.column() + end.column() - edit.range.start().column() };
+		} else {
+			end.setLine( start.line() + end.line() - edit.range.start().line() );
+		}
+		changes.push_back( { { start, end }, edits[edit.index].text } );
+	}
+
+	Int64 lastNotifiedLine = -1;
+	for ( const auto& edit : sorted ) {
+		result[edit.index] = edit.newRange;
+		for ( Int64 line = eemax( lastNotifiedLine + 1, edit.newRange.start().line() );
+			  line <= edit.newRange.end().line(); ++line ) {
+			notifyLineChanged( line );
+			lastNotifiedLine = line;
+		}
+	}
+
+	notifyTextChanged( changes );
+
+	if ( lineCount != mLines.size() )
+		notifyLineCountChanged( lineCount, mLines.size() );
+
+	if ( oldSelection != mSelection ) {
+		notifySelectionChanged();
+		notifyCursorChanged();
+	}
+
+	return result;
+}
+
 TextPosition TextDocument::positionOffset( TextPosition position, int columnOffset ) const {
 	position = sanitizePosition( position );
 	position.setColumn( position.column() + columnOffset );
@@ -1593,7 +2012,31 @@ void TextDocument::textInput( const String& text, bool mightBeInteresting ) {
 	}
 
 	auto crPOS = text.find_first_of( '\r' );
-	if ( crPOS != String::InvalidPos ) {
+
+	if ( mSelection.size() > 1 ) {
+		String textCpy( text );
+		if ( crPOS != String::InvalidPos )
+			textCpy.replaceAll( "\r", "" );
+
+		std::vector<DocumentContentChange> edits;
+		std::vector<size_t> cursorIdxs;
+		edits.reserve( mSelection.size() );
+		cursorIdxs.reserve( mSelection.size() );
+		for ( size_t i = 0; i < mSelection.size(); ++i ) {
+			edits.push_back( { mSelection[i], textCpy } );
+			cursorIdxs.push_back( i );
+		}
+
+		auto ranges = applyEdits( edits, cursorIdxs );
+		TextRanges selection;
+		selection.reserve( ranges.size() );
+		for ( const auto& range : ranges ) {
+			if ( range.isValid() )
+				selection.push_back( { range.end(), range.end() } );
+		}
+		if ( !selection.empty() )
+			resetSelection( selection );
+	} else if ( crPOS != String::InvalidPos ) {
 		String textCpy( text );
 		textCpy.replaceAll( "\r", "" );
 
@@ -1876,6 +2319,12 @@ const Uint64& TextDocument::getModificationId() const {
 	return mModificationId;
 }
 
+std::shared_ptr<const TextDocumentSnapshot> TextDocument::getSnapshot() {
+	if ( !mSnapshot || mSnapshot->getVersion() != mModificationId )
+		mSnapshot = TextDocumentSnapshot::create( mLines, mModificationId, mSnapshot.get() );
+	return mSnapshot;
+}
+
 void TextDocument::selectWord( bool withMulticursor ) {
 	if ( !hasSelection() ) {
 		setSelection( { nextWordBoundary( getSelection().start(), false ),
@@ -2632,19 +3081,25 @@ bool TextDocument::isInsertingText() const {
 	return mInsertingText;
 }
 
-TextRanges TextDocument::findAll( const String& text, bool caseSensitive, bool wholeWord,
-								  FindReplaceType type, TextRange restrictRange,
-								  size_t maxResults ) {
-	TextRanges all;
-	TextRange found;
-	TextPosition from = startOfDoc();
+bool* TextDocument::registerStopFlag() {
 	auto stopFlagUP = std::make_unique<bool>( false );
 	bool* stopFlag = stopFlagUP.get();
-	{
-		Lock l( mStopFlagsMutex );
-		mStopFlags.insert( { stopFlag, std::move( stopFlagUP ) } );
-	}
+	Lock l( mStopFlagsMutex );
+	mStopFlags.insert( { stopFlag, std::move( stopFlagUP ) } );
+	return stopFlag;
+}
 
+void TextDocument::unregisterStopFlag( bool* stopFlag ) {
+	Lock l( mStopFlagsMutex );
+	mStopFlags.erase( stopFlag );
+}
+
+TextRanges TextDocument::findAllInRange( const String& text, bool caseSensitive, bool wholeWord,
+										 FindReplaceType type, TextRange restrictRange,
+										 size_t maxResults, bool* stopFlag ) {
+	TextRanges all;
+	TextRange found;
+	TextPosition from = startOfDoc();
 	if ( restrictRange.isValid() )
 		from = restrictRange.normalized().start();
 	do {
@@ -2658,14 +3113,119 @@ TextRanges TextDocument::findAll( const String& text, bool caseSensitive, bool w
 				break;
 		}
 	} while ( found.isValid() );
+	return all;
+}
+
+TextRanges TextDocument::findAll( const String& text, bool caseSensitive, bool wholeWord,
+								  FindReplaceType type, TextRange restrictRange,
+								  size_t maxResults ) {
+	bool* stopFlag = registerStopFlag();
+	TextRanges all = findAllInRange( text, caseSensitive, wholeWord, type, restrictRange,
+									 maxResults, stopFlag );
 	if ( !all.empty() )
 		all.setSorted();
+	unregisterStopFlag( stopFlag );
+	return all;
+}
 
-	{
-		Lock l( mStopFlagsMutex );
-		mStopFlags.erase( stopFlag );
+void TextDocument::findAllAsync( std::shared_ptr<ThreadPool> pool, const String& text,
+								 bool caseSensitive, bool wholeWord, FindReplaceType type,
+								 TextRange restrictRange, TextRange priorityRange,
+								 const FindAllResultsCb& onResults, const FindAllDoneCb& onDone ) {
+	if ( !pool || text.empty() ) {
+		TextRanges all( findAll( text, caseSensitive, wholeWord, type, restrictRange ) );
+		if ( onResults && !all.empty() )
+			onResults( all );
+		if ( onDone )
+			onDone( std::move( all ), false );
+		return;
+	}
+
+	struct FindAllJob {
+		std::vector<std::pair<Int64, Int64>> chunks;
+		std::vector<size_t> order;
+		std::vector<TextRanges> results;
+		std::atomic<size_t> nextChunk{ 0 };
+		std::atomic<size_t> pending{ 0 };
+		bool* stopFlag{ nullptr };
+		FindAllResultsCb onResults;
+		FindAllDoneCb onDone;
+	};
+
+	if ( restrictRange.isValid() )
+		restrictRange = sanitizeRange( restrictRange.normalized() );
+
+	Int64 linesCount = mLines.size();
+	Int64 firstLine = restrictRange.isValid() ? restrictRange.start().line() : 0;
+	Int64 lastLine = restrictRange.isValid() ? restrictRange.end().line() : linesCount - 1;
+	Int64 priorityLine = priorityRange.isValid() ? priorityRange.normalized().start().line() : 0;
+	// Matches spanning several lines belong to the chunk where they start
+	Int64 extraLines = static_cast<Int64>( std::count( text.begin(), text.end(), '\n' ) );
+
+	auto job = std::make_shared<FindAllJob>();
+	for ( Int64 line = firstLine; line <= lastLine; line += FIND_ALL_CHUNK_LINES )
+		job->chunks.emplace_back( line, eemin( line + FIND_ALL_CHUNK_LINES, lastLine + 1 ) );
+	job->results.resize( job->chunks.size() );
+	job->order.resize( job->chunks.size() );
+	for ( size_t i = 0; i < job->order.size(); ++i )
+		job->order[i] = i;
+
+	// Search the chunks nearest to the priority range first
+	Int64 priorityChunk = eeclamp<Int64>( ( priorityLine - firstLine ) / FIND_ALL_CHUNK_LINES, 0,
+										  (Int64)job->chunks.size() - 1 );
+	std::stable_sort( job->order.begin(), job->order.end(),
+					  [priorityChunk]( size_t left, size_t right ) {
+						  return eeabs( (Int64)left - priorityChunk ) <
+								 eeabs( (Int64)right - priorityChunk );
+					  } );
+
+	size_t numTasks = eemin<size_t>( eemax<size_t>( 1, pool->numThreads() ), job->chunks.size() );
+	job->pending = numTasks;
+	job->stopFlag = registerStopFlag();
+	job->onResults = onResults;
+	job->onDone = onDone;
+
+	for ( size_t task = 0; task < numTasks; ++task ) {
+		pool->run( [this, job, text, caseSensitive, wholeWord, type, restrictRange, linesCount,
+					extraLines]() {
+			size_t idx;
+			while ( !*job->stopFlag && ( idx = job->nextChunk++ ) < job->order.size() ) {
+				size_t chunkIdx = job->order[idx];
+				const auto& chunk = job->chunks[chunkIdx];
+				TextPosition end( chunk.second + extraLines < linesCount
+									  ? TextPosition( chunk.second + extraLines, 0 )
+									  : endOfDoc() );
+				TextRange range( { chunk.first, 0 }, end );
+				if ( restrictRange.isValid() ) {
+					range.setStart( eemax( range.start(), restrictRange.start() ) );
+					range.setEnd( eemin( range.end(), restrictRange.end() ) );
+				}
+				if ( range.start() >= range.end() )
+					continue;
+
+				TextRanges found( findAllInRange( text, caseSensitive, wholeWord, type, range, 0,
+												  job->stopFlag ) );
+				while ( !found.empty() && found.back().start().line() >= chunk.second )
+					found.pop_back();
+				if ( !found.empty() && job->onResults && !*job->stopFlag )
+					job->onResults( found );
+				job->results[chunkIdx] = std::move( found );
+			}
+
+			if ( --job->pending != 0 )
+				return;
+
+			// Last task running, merge the chunks results in document order
+			TextRanges all;
+			for ( auto& results : job->results )
+				all.insert( all.end(), results.begin(), results.end() );
+			all.setSorted();
+			bool cancelled = *job->stopFlag;
+			if ( job->onDone )
+				job->onDone( std::move( all ), cancelled );
+			unregisterStopFlag( job->stopFlag );
+		} );
 	}
-	return all;
 }
 
 int TextDocument::replaceAll( const String& text, const String& replace, const bool& caseSensitive,
@@ -2676,23 +3236,23 @@ int TextDocument::replaceAll( const String& text, const String& replace, const b
 	bool wasRunningTransaction = isRunningTransaction();
 	if ( !wasRunningTransaction )
 		setRunningTransaction( true );
+
+	// All the replacements are applied as a single batched edit
+	TextRanges found( findAll( text, caseSensitive, wholeWord, type, restrictRange ) );
+	std::vector<DocumentContentChange> edits;
+	edits.reserve( found.size() );
+	for ( const auto& range : found )
+		edits.push_back( { range, replace } );
+
 	int count = 0;
-	TextRange found;
-	TextPosition startedPosition = getSelection().start();
-	TextPosition from = startOfDoc();
-	if ( restrictRange.isValid() )
-		from = restrictRange.normalized().start();
-	do {
-		found = find( text, from, caseSensitive, wholeWord, type, restrictRange );
-		if ( found.isValid() ) {
-			setSelection( found );
-			from = replaceSelection( replace );
+	for ( const auto& range : applyEdits( edits ) ) {
+		if ( range.isValid() )
 			count++;
-		}
-	} while ( found.isValid() && endOfDoc() != found.end() );
+	}
+
 	if ( !wasRunningTransaction )
 		setRunningTransaction( false );
-	setSelection( startedPosition );
+	setSelection( getSelection().start() );
 	return count;
 }
 
@@ -2769,6 +3329,9 @@ void TextDocument::setEncoding( TextFormat::Encoding encoding ) {
 	mEncoding = encoding;
 }
 
+// Max lines indexed on demand by a single bracket query before falling back to a linear scan
+static constexpr int STRUCTURE_MAX_LINES_INDEXED = 64;
+
 static inline void changeDepth( SyntaxHighlighter* highlighter, int& depth, const TextPosition& pos,
 								int dir ) {
 	if ( highlighter ) {
@@ -2785,6 +3348,28 @@ TextPosition TextDocument::getMatchingBracket( TextPosition sp,
 											   const String::StringBaseType& closeBracket,
 											   MatchDirection dir, bool allowDepth ) {
 	SyntaxHighlighter* highlighter = getHighlighter();
+
+	// Standard brackets are resolved by the structure index without scanning the document, the
+	// lines it doesn't know yet are indexed on demand
+	auto startChar = getChar( sp );
+	if ( highlighter && allowDepth &&
+		 StructureIndex::getPairBracket( openBracket ) == closeBracket &&
+		 ( ( dir == MatchDirection::Forward && startChar == openBracket &&
+			 StructureIndex::isOpenBracket( openBracket ) ) ||
+		   ( dir == MatchDirection::Backward && startChar == closeBracket &&
+			 StructureIndex::isCloseBracket( closeBracket ) ) ) ) {
+		auto& structure = highlighter->getStructureIndex();
+		for ( int i = 0; i < STRUCTURE_MAX_LINES_INDEXED; i++ ) {
+			Int64 unknownLine = -1;
+			TextPosition match = structure.getMatchingBracket( sp, &unknownLine );
+			if ( match.isValid() )
+				return match;
+			if ( unknownLine == -1 )
+				break;
+			highlighter->indexStructure( unknownLine );
+		}
+	}
+
 	int depth = 0;
 	while ( sp.isValid() ) {
 		auto byte = getChar( sp );
@@ -2810,6 +3395,18 @@ TextPosition TextDocument::getMatchingBracket( TextPosition sp,
 	return {};
 }
 
+TextRange TextDocument::getFoldRange( Int64 line ) {
+	auto& structure = mHighlighter->getStructureIndex();
+	for ( int i = 0; i < STRUCTURE_MAX_LINES_INDEXED; i++ ) {
+		Int64 unknownLine = -1;
+		TextRange range = structure.getFoldRange( line, &unknownLine );
+		if ( unknownLine == -1 )
+			return range;
+		mHighlighter->indexStructure( unknownLine );
+	}
+	return {};
+}
+
 TextRange TextDocument::getMatchingBracket( TextPosition start, const String& openBracket,
 											const String& closeBracket, MatchDirection dir,
 											bool matchingXMLTags ) {
@@ -3013,6 +3610,13 @@ void TextDocument::notifyTextChanged( const DocumentContentChange& change ) {
 	}
 }
 
+void TextDocument::notifyTextChanged( const std::vector<DocumentContentChange>& changes ) {
+	Lock l( mClientsMutex );
+	for ( auto& client : mClients ) {
+		client->onDocumentBatchTextChanged( changes );
+	}
+}
+
 void TextDocument::notifyCursorChanged( TextPosition selection ) {
 	if ( !selection.isValid() )
 		selection = getSelection().start();
@@ -3076,6 +3680,7 @@ void TextDocument::notifyLineCountChanged( const size_t& lastCount, const size_t
 }
 
 void TextDocument::notifyLineChanged( const Int64& lineIndex ) {
+	mHighlighter->getStructureIndex().invalidateLine( lineIndex );
 	Lock l( mClientsMutex );
 	for ( auto& client : mClients ) {
 		client->onDocumentLineChanged( lineIndex );
@@ -3223,4 +3828,50 @@ bool TextSearchParams::isEmpty() {
 	return text.empty();
 }
 
+const std::string& TextDocument::getTokenizationCachePath() const {
+	return mTokenizationCachePath;
+}
+
+void TextDocument::setTokenizationCachePath( const std::string& tokenizationCachePath ) {
+	mTokenizationCachePath = tokenizationCachePath;
+	if ( !mTokenizationCachePath.empty() )
+		FileSystem::dirAddSlashAtEnd( mTokenizationCachePath );
+}
+
+std::string TextDocument::getTokenizationCacheFilePath() const {
+	return mTokenizationCachePath + MD5::fromString( mFilePath ).toHexString() + ".tokens";
+}
+
+const std::string& TextDocument::getUndoHistoryPath() const {
+	return mUndoHistoryPath;
+}
+
+void TextDocument::setUndoHistoryPath( const std::string& undoHistoryPath ) {
+	mUndoHistoryPath = undoHistoryPath;
+	if ( !mUndoHistoryPath.empty() )
+		FileSystem::dirAddSlashAtEnd( mUndoHistoryPath );
+}
+
+void TextDocument::setPersistencePool( std::shared_ptr<ThreadPool> pool ) {
+	mPersistencePool = pool;
+}
+
+void TextDocument::saveUndoHistory() {
+	// The history can only be restored if the file contents are the same than the document
+	if ( mUndoHistoryPath.empty() || !hasFilepath() || isDirty() ||
+		 ( !mUndoStack.hasUndo() && !mUndoStack.hasRedo() ) )
+		return;
+	IOStreamString stream;
+	if ( mUndoStack.save( stream ) )
+		writePersistedFile( mPersistencePool, getUndoHistoryFilePath(), stream.getStream() );
+}
+
+std::string TextDocument::getUndoHistoryFilePath() const {
+	return mUndoHistoryPath + MD5::fromString( mFilePath ).toHexString() + ".undo";
+}
+
+TextUndoStack& TextDocument::getUndoStack() {
+	return mUndoStack;
+}
+
 }}} // namespace EE::UI::Doc
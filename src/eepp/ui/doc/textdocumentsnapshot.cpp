@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <eepp/ui/doc/textdocumentsnapshot.hpp>
+
+namespace EE { namespace UI { namespace Doc {
+
+static bool chunkMatches( const TextDocumentSnapshot::Chunk& chunk,
+						  const std::vector<TextDocumentLine>& lines, Int64 from ) {
+	for ( size_t i = 0; i < chunk.lines.size(); i++ ) {
+		const TextDocumentLine& line = lines[from + i];
+		if ( chunk.hashes[i] != line.getHash() || chunk.lines[i].size() != line.size() )
+			return false;
+	}
+	return true;
+}
+
+static std::shared_ptr<const TextDocumentSnapshot::Chunk>
+makeChunk( const std::vector<TextDocumentLine>& lines, Int64 from, Int64 count ) {
+	auto chunk = std::make_shared<TextDocumentSnapshot::Chunk>();
+	chunk->lines.reserve( count );
+	chunk->hashes.reserve( count );
+	for ( Int64 i = from; i < from + count; i++ ) {
+		chunk->lines.emplace_back( lines[i].getText() );
+		chunk->hashes.emplace_back( lines[i].getHash() );
+	}
+	return chunk;
+}
+
+std::shared_ptr<const TextDocumentSnapshot>
+TextDocumentSnapshot::create( const std::vector<TextDocumentLine>& lines, Uint64 version,
+							  const TextDocumentSnapshot* previous ) {
+	auto snapshot = std::make_shared<TextDocumentSnapshot>();
+	snapshot->mVersion = version;
+	Int64 count = lines.size();
+	Int64 start = 0;
+	Int64 end = count;
+	size_t front = 0;
+	size_t back = 0;
+
+	// Keep the chunks that still match the beginning and the end of the document, only the
+	// region in between (the edited one) is copied
+	if ( previous ) {
+		const auto& chunks = previous->mChunks;
+		while ( front < chunks.size() &&
+				start + (Int64)chunks[front]->lines.size() <= count &&
+				chunkMatches( *chunks[front], lines, start ) ) {
+			start += chunks[front]->lines.size();
+			front++;
+		}
+		back = chunks.size();
+		while ( back > front && end - (Int64)chunks[back - 1]->lines.size() >= start &&
+				chunkMatches( *chunks[back - 1], lines,
+							  end - (Int64)chunks[back - 1]->lines.size() ) ) {
+			end -= chunks[back - 1]->lines.size();
+			back--;
+		}
+		for ( size_t i = 0; i < front; i++ )
+			snapshot->addChunk( chunks[i] );
+	}
+
+	// Split the region in chunks between CHUNK_LINES and CHUNK_LINES * 2 lines, so small edits
+	// don't fragment the snapshot
+	Int64 regionLines = end - start;
+	Int64 regionChunks = eemax<Int64>( 1, regionLines / CHUNK_LINES );
+	for ( Int64 i = 0; i < regionChunks && regionLines > 0; i++ ) {
+		Int64 from = start + regionLines * i / regionChunks;
+		Int64 to = start + regionLines * ( i + 1 ) / regionChunks;
+		snapshot->addChunk( makeChunk( lines, from, to - from ) );
+	}
+
+	if ( previous ) {
+		for ( size_t i = back; i < previous->mChunks.size(); i++ )
+			snapshot->addChunk( previous->mChunks[i] );
+	}
+
+	return snapshot;
+}
+
+void TextDocumentSnapshot::addChunk( std::shared_ptr<const Chunk> chunk ) {
+	if ( chunk->lines.empty() )
+		return;
+	mChunksStart.push_back( mLinesCount );
+	mLinesCount += chunk->lines.size();
+	mChunks.emplace_back( std::move( chunk ) );
+}
+
+const String& TextDocumentSnapshot::line( Int64 index ) const {
+	static const String EMPTY;
+	if ( index < 0 || index >= mLinesCount )
+		return EMPTY;
+	auto it = std::upper_bound( mChunksStart.begin(), mChunksStart.end(), index );
+	size_t chunk = std::distance( mChunksStart.begin(), it ) - 1;
+	return mChunks[chunk]->lines[index - mChunksStart[chunk]];
+}
+
+String TextDocumentSnapshot::getText( const TextRange& range ) const {
+	if ( mLinesCount == 0 )
+		return String();
+	TextRange nrange( range.normalized() );
+	Int64 startLine = eeclamp<Int64>( nrange.start().line(), 0, mLinesCount - 1 );
+	Int64 endLine = eeclamp<Int64>( nrange.end().line(), 0, mLinesCount - 1 );
+	const String& first = line( startLine );
+	Int64 startCol = eeclamp<Int64>( nrange.start().column(), 0, first.size() );
+	if ( startLine == endLine ) {
+		Int64 endCol = eeclamp<Int64>( nrange.end().column(), startCol, first.size() );
+		return first.substr( startCol, endCol - startCol );
+	}
+	String text( first.substr( startCol ) );
+	for ( Int64 i = startLine + 1; i < endLine; i++ )
+		text += line( i );
+	const String& last = line( endLine );
+	text += last.substr( 0, eeclamp<Int64>( nrange.end().column(), 0, last.size() ) );
+	return text;
+}
+
+String TextDocumentSnapshot::getText() const {
+	if ( mLinesCount == 0 )
+		return String();
+	const String& last = line( mLinesCount - 1 );
+	return getText( { { 0, 0 }, { mLinesCount - 1, (Int64)last.size() - 1 } } );
+}
+
+}}} // namespace EE::UI::Doc
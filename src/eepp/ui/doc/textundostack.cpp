@@ -1,4 +1,8 @@
 #include <eepp/core/core.hpp>
+#include <eepp/system/compression.hpp>
+#include <eepp/system/iostreammemory.hpp>
+#include <eepp/system/iostreamstring.hpp>
+#include <eepp/system/log.hpp>
 #include <eepp/ui/doc/textdocument.hpp>
 #include <eepp/ui/doc/textundostack.hpp>
 
@@ -8,7 +12,7 @@ namespace EE { namespace UI { namespace Doc {
 
 TextUndoCommand::TextUndoCommand( const Uint64& id, const TextUndoCommandType& type,
 								  const Time& timestamp ) :
-	mId( id ), mType( type ), mTimestamp( timestamp ) {}
+	mId( id ), mType( type ), mTimestamp( timestamp ), mLastTimestamp( timestamp ) {}
 
 TextUndoCommand::~TextUndoCommand() {}
 
@@ -24,16 +28,63 @@ const Time& TextUndoCommand::getTimestamp() const {
 	return mTimestamp;
 }
 
+const Time& TextUndoCommand::getLastTimestamp() const {
+	return mLastTimestamp;
+}
+
 TextUndoCommandInsert::TextUndoCommandInsert( const Uint64& id, const size_t& cursorIdx,
 											  const String& text, const TextPosition& position,
 											  const Time& timestamp ) :
 	TextUndoCommand( id, TextUndoCommandType::Insert, timestamp ),
-	mText( text ),
+	mText( text.toUtf8() ),
 	mPosition( position ),
 	mCursorIdx( cursorIdx ) {}
 
-const String& TextUndoCommandInsert::getText() const {
-	return mText;
+TextUndoCommandInsert::TextUndoCommandInsert( const Uint64& id, const size_t& cursorIdx,
+											  std::string&& utf8Text,
+											  const TextPosition& position,
+											  const Time& timestamp ) :
+	TextUndoCommand( id, TextUndoCommandType::Insert, timestamp ),
+	mText( std::move( utf8Text ) ),
+	mPosition( position ),
+	mCursorIdx( cursorIdx ) {}
+
+std::string TextUndoCommandInsert::getUtf8Text() const {
+	if ( !isCompressed() )
+		return mText;
+	std::string text( mUncompressedSize, '\0' );
+	if ( Compression::decompress( (Uint8*)text.data(), text.size(), (const Uint8*)mText.data(),
+								  mText.size() ) != Compression::OK ) {
+		Log::error( "TextUndoCommandInsert: failed to decompress the command %llu text",
+					(unsigned long long)mId );
+		return "";
+	}
+	return text;
+}
+
+String TextUndoCommandInsert::getText() const {
+	return String::fromUtf8( getUtf8Text() );
+}
+
+bool TextUndoCommandInsert::compress() {
+	// Not worth it for small payloads
+	if ( isCompressed() || mIncompressible || mText.size() < 256 )
+		return false;
+	IOStreamMemory src( mText.data(), mText.size() );
+	IOStreamString dst;
+	if ( Compression::compress( dst, src ) != Compression::OK ||
+		 dst.getStream().size() >= mText.size() ) {
+		mIncompressible = true;
+		return false;
+	}
+	mUncompressedSize = mText.size();
+	mText = dst.getStream();
+	mText.shrink_to_fit();
+	return true;
+}
+
+size_t TextUndoCommandInsert::getMemoryUsage() const {
+	return sizeof( TextUndoCommandInsert ) + mText.capacity();
 }
 
 const TextPosition& TextUndoCommandInsert::getPosition() const {
@@ -58,6 +109,10 @@ size_t TextUndoCommandRemove::getCursorIdx() const {
 	return mCursorIdx;
 }
 
+size_t TextUndoCommandRemove::getMemoryUsage() const {
+	return sizeof( TextUndoCommandRemove );
+}
+
 TextUndoCommandSelection::TextUndoCommandSelection( const Uint64& id, const size_t& cursorIdx,
 													const TextRanges& selection,
 													const Time& timestamp ) :
@@ -73,6 +128,10 @@ size_t TextUndoCommandSelection::getCursorIdx() const {
 	return mCursorIdx;
 }
 
+size_t TextUndoCommandSelection::getMemoryUsage() const {
+	return sizeof( TextUndoCommandSelection ) + mSelection.capacity() * sizeof( TextRange );
+}
+
 TextUndoStack::TextUndoStack( TextDocument* owner, const Uint32& maxStackSize ) :
 	mDoc( owner ),
 	mMaxStackSize( maxStackSize ),
@@ -89,36 +148,143 @@ void TextUndoStack::clear() {
 }
 
 void TextUndoStack::clearUndoStack() {
-	for ( TextUndoCommand* cmd : mUndoStack ) {
+	for ( TextUndoCommand* cmd : mUndoStack )
 		eeDelete( cmd );
-	}
 	mUndoStack.clear();
+	mUndoMemoryUsage = 0;
 }
 
 void TextUndoStack::clearRedoStack() {
-	for ( TextUndoCommand* cmd : mRedoStack ) {
+	for ( TextUndoCommand* cmd : mRedoStack )
 		eeDelete( cmd );
-	}
 	mRedoStack.clear();
+	mRedoMemoryUsage = 0;
+}
+
+size_t& TextUndoStack::getStackMemoryUsage( const UndoStackContainer& undoStack ) {
+	return &undoStack == &mRedoStack ? mRedoMemoryUsage : mUndoMemoryUsage;
+}
+
+void TextUndoStack::popFront( UndoStackContainer& undoStack ) {
+	getStackMemoryUsage( undoStack ) -= undoStack.front()->getMemoryUsage();
+	eeDelete( undoStack.front() );
+	undoStack.pop_front();
 }
 
 void TextUndoStack::pushUndo( UndoStackContainer& undoStack, TextUndoCommand* cmd ) {
 	undoStack.push_back( cmd );
-	while ( undoStack.size() > mMaxStackSize ) {
-		eeDelete( undoStack.front() );
-		undoStack.pop_front();
+	size_t& memoryUsage = getStackMemoryUsage( undoStack );
+	memoryUsage += cmd->getMemoryUsage();
+	while ( undoStack.size() > mMaxStackSize )
+		popFront( undoStack );
+	if ( mMaxMemoryUsage != 0 && memoryUsage > mMaxMemoryUsage )
+		enforceMemoryLimit( undoStack );
+}
+
+void TextUndoStack::enforceMemoryLimit( UndoStackContainer& undoStack ) {
+	size_t& memoryUsage = getStackMemoryUsage( undoStack );
+	// First compress the payload of the oldest commands, keeping the latest ones uncompressed
+	// since those are the most likely to be undone
+	for ( size_t i = 0; i + 1 < undoStack.size() && memoryUsage > mMaxMemoryUsage; ++i ) {
+		TextUndoCommand* cmd = undoStack[i];
+		if ( cmd->getType() != TextUndoCommandType::Insert )
+			continue;
+		TextUndoCommandInsert* insert = static_cast<TextUndoCommandInsert*>( cmd );
+		size_t oldUsage = insert->getMemoryUsage();
+		if ( insert->compress() )
+			memoryUsage = memoryUsage - oldUsage + insert->getMemoryUsage();
 	}
+
+	// If that's not enough discard the oldest history
+	while ( undoStack.size() > 1 && memoryUsage > mMaxMemoryUsage )
+		popFront( undoStack );
+}
+
+bool TextUndoStack::coalesceInsert( UndoStackContainer& undoStack, const String& string,
+									const size_t& cursorIdx, const TextPosition& position,
+									const Time& time ) {
+	// Consecutive deletions of single line text (backspace / delete) are merged into the
+	// previous insert command, dropping the intermediate selection
+	if ( mSkipCoalescing || undoStack.size() < 2 || string.find( '\n' ) != String::InvalidPos )
+		return false;
+
+	TextUndoCommand* top = undoStack.back();
+	TextUndoCommand* prev = undoStack[undoStack.size() - 2];
+	if ( top->getType() != TextUndoCommandType::Selection ||
+		 prev->getType() != TextUndoCommandType::Insert ||
+		 static_cast<TextUndoCommandSelection*>( top )->getCursorIdx() != cursorIdx ||
+		 ( time - prev->getLastTimestamp() ).asMilliseconds() >= mMergeTimeout.asMilliseconds() )
+		return false;
+
+	TextUndoCommandInsert* insert = static_cast<TextUndoCommandInsert*>( prev );
+	if ( insert->getCursorIdx() != cursorIdx || insert->isCompressed() ||
+		 insert->mText.find( '\n' ) != std::string::npos ||
+		 insert->mPosition.line() != position.line() )
+		return false;
+
+	size_t oldUsage = insert->getMemoryUsage();
+	if ( position.column() + (Int64)string.size() == insert->mPosition.column() ) {
+		insert->mText = string.toUtf8() + insert->mText;
+		insert->mPosition = position;
+	} else if ( position == insert->mPosition ) {
+		insert->mText += string.toUtf8();
+	} else {
+		return false;
+	}
+
+	size_t& memoryUsage = getStackMemoryUsage( undoStack );
+	memoryUsage = memoryUsage - oldUsage + insert->getMemoryUsage();
+	insert->mIncompressible = false;
+	insert->mId = ++mChangeIdCounter;
+	insert->mLastTimestamp = time;
+	memoryUsage -= top->getMemoryUsage();
+	eeDelete( top );
+	undoStack.pop_back();
+	return true;
+}
+
+bool TextUndoStack::coalesceRemove( UndoStackContainer& undoStack, const size_t& cursorIdx,
+									const TextRange& range, const Time& time ) {
+	// Consecutive single line typing is merged into the previous remove command, dropping the
+	// intermediate selection
+	if ( mSkipCoalescing || undoStack.size() < 2 || range.start().line() != range.end().line() )
+		return false;
+
+	TextUndoCommand* top = undoStack.back();
+	TextUndoCommand* prev = undoStack[undoStack.size() - 2];
+	if ( top->getType() != TextUndoCommandType::Selection ||
+		 prev->getType() != TextUndoCommandType::Remove ||
+		 static_cast<TextUndoCommandSelection*>( top )->getCursorIdx() != cursorIdx ||
+		 ( time - prev->getLastTimestamp() ).asMilliseconds() >= mMergeTimeout.asMilliseconds() )
+		return false;
+
+	TextUndoCommandRemove* remove = static_cast<TextUndoCommandRemove*>( prev );
+	if ( remove->getCursorIdx() != cursorIdx || remove->mRange.end() != range.start() ||
+		 remove->mRange.start().line() != remove->mRange.end().line() )
+		return false;
+
+	remove->mRange.setEnd( range.end() );
+	remove->mId = ++mChangeIdCounter;
+	remove->mLastTimestamp = time;
+	getStackMemoryUsage( undoStack ) -= top->getMemoryUsage();
+	eeDelete( top );
+	undoStack.pop_back();
+	return true;
 }
 
 void TextUndoStack::pushInsert( UndoStackContainer& undoStack, const String& string,
 								const size_t& cursorIdx, const TextPosition& position,
 								const Time& time ) {
+	if ( coalesceInsert( undoStack, string, cursorIdx, position, time ) )
+		return;
 	pushUndo( undoStack, eeNew( TextUndoCommandInsert,
 								( ++mChangeIdCounter, cursorIdx, string, position, time ) ) );
 }
 
 void TextUndoStack::pushRemove( UndoStackContainer& undoStack, const size_t& cursorIdx,
 								const TextRange& range, const Time& time ) {
+	if ( coalesceRemove( undoStack, cursorIdx, range, time ) )
+		return;
 	pushUndo( undoStack,
 			  eeNew( TextUndoCommandRemove, ( ++mChangeIdCounter, cursorIdx, range, time ) ) );
 }
@@ -136,6 +302,7 @@ void TextUndoStack::popUndo( UndoStackContainer& undoStack, UndoStackContainer&
 	TextUndoCommand* cmd = undoStack.back();
 	Time lastTimestamp = cmd->getTimestamp();
 	undoStack.pop_back();
+	getStackMemoryUsage( undoStack ) -= cmd->getMemoryUsage();
 
 	switch ( cmd->getType() ) {
 		case TextUndoCommandType::Insert: {
@@ -160,18 +327,22 @@ void TextUndoStack::popUndo( UndoStackContainer& undoStack, UndoStackContainer&
 	eeSAFE_DELETE( cmd );
 
 	if ( !undoStack.empty() &&
-		 eeabs( ( lastTimestamp - undoStack.back()->getTimestamp() ).asMilliseconds() ) <
+		 eeabs( ( lastTimestamp - undoStack.back()->getLastTimestamp() ).asMilliseconds() ) <
 			 mMergeTimeout.asMilliseconds() ) {
 		popUndo( undoStack, redoStack );
 	}
 }
 
 void TextUndoStack::undo() {
+	mSkipCoalescing = true;
 	popUndo( mUndoStack, mRedoStack );
+	mSkipCoalescing = false;
 }
 
 void TextUndoStack::redo() {
+	mSkipCoalescing = true;
 	popUndo( mRedoStack, mUndoStack );
+	mSkipCoalescing = false;
 }
 
 bool TextUndoStack::hasUndo() const {
@@ -200,6 +371,215 @@ Uint64 TextUndoStack::getCurrentChangeId() const {
 	return mUndoStack.back()->getId();
 }
 
+size_t TextUndoStack::getMemoryUsage() const {
+	return mUndoMemoryUsage + mRedoMemoryUsage;
+}
+
+const size_t& TextUndoStack::getMaxMemoryUsage() const {
+	return mMaxMemoryUsage;
+}
+
+void TextUndoStack::setMaxMemoryUsage( const size_t& maxMemoryUsage ) {
+	mMaxMemoryUsage = maxMemoryUsage;
+	if ( mMaxMemoryUsage == 0 )
+		return;
+	if ( mUndoMemoryUsage > mMaxMemoryUsage )
+		enforceMemoryLimit( mUndoStack );
+	if ( mRedoMemoryUsage > mMaxMemoryUsage )
+		enforceMemoryLimit( mRedoStack );
+}
+
+static constexpr char UNDO_HISTORY_MAGIC[4] = { 'E', 'E', 'U', 'S' };
+
+static constexpr Uint32 UNDO_HISTORY_VERSION = 1;
+
+template <typename T> static void writeValue( IOStream& stream, const T& value ) {
+	stream.write( reinterpret_cast<const char*>( &value ), sizeof( T ) );
+}
+
+template <typename T> static bool readValue( IOStream& stream, T& value ) {
+	return stream.read( reinterpret_cast<char*>( &value ), sizeof( T ) ) == sizeof( T );
+}
+
+static void writePosition( IOStream& stream, const TextPosition& position ) {
+	writeValue<Int64>( stream, position.line() );
+	writeValue<Int64>( stream, position.column() );
+}
+
+static bool readPosition( IOStream& stream, TextPosition& position ) {
+	Int64 line, column;
+	if ( !readValue( stream, line ) || !readValue( stream, column ) )
+		return false;
+	position = { line, column };
+	return true;
+}
+
+static void writeCommand( IOStream& stream, TextUndoCommand* cmd ) {
+	writeValue<Uint8>( stream, static_cast<Uint8>( cmd->getType() ) );
+	writeValue<Uint64>( stream, cmd->getId() );
+	writeValue<Int64>( stream, cmd->getTimestamp().asMicroseconds() );
+	writeValue<Int64>( stream, cmd->getLastTimestamp().asMicroseconds() );
+
+	switch ( cmd->getType() ) {
+		case TextUndoCommandType::Insert: {
+			TextUndoCommandInsert* insert = static_cast<TextUndoCommandInsert*>( cmd );
+			std::string text( insert->getUtf8Text() );
+			writeValue<Uint64>( stream, insert->getCursorIdx() );
+			writePosition( stream, insert->getPosition() );
+			writeValue<Uint32>( stream, text.size() );
+			stream.write( text.data(), text.size() );
+			break;
+		}
+		case TextUndoCommandType::Remove: {
+			TextUndoCommandRemove* remove = static_cast<TextUndoCommandRemove*>( cmd );
+			writeValue<Uint64>( stream, remove->getCursorIdx() );
+			writePosition( stream, remove->getRange().start() );
+			writePosition( stream, remove->getRange().end() );
+			break;
+		}
+		case TextUndoCommandType::Selection: {
+			TextUndoCommandSelection* selection = static_cast<TextUndoCommandSelection*>( cmd );
+			writeValue<Uint64>( stream, selection->getCursorIdx() );
+			writeValue<Uint64>( stream, selection->getSelection().size() );
+			for ( const auto& range : selection->getSelection() ) {
+				writePosition( stream, range.start() );
+				writePosition( stream, range.end() );
+			}
+			break;
+		}
+	}
+}
+
+static TextUndoCommand* readCommand( IOStream& stream, Time& lastTime ) {
+	Uint8 type;
+	Uint64 id, cursorIdx;
+	Int64 timestamp, lastTimestamp;
+
+	if ( !readValue( stream, type ) || !readValue( stream, id ) ||
+		 !readValue( stream, timestamp ) || !readValue( stream, lastTimestamp ) ||
+		 !readValue( stream, cursorIdx ) )
+		return nullptr;
+
+	Time time( Microseconds( timestamp ) );
+	TextUndoCommand* cmd = nullptr;
+
+	switch ( static_cast<TextUndoCommandType>( type ) ) {
+		case TextUndoCommandType::Insert: {
+			TextPosition position;
+			Uint32 size;
+			if ( !readPosition( stream, position ) || !readValue( stream, size ) )
+				return nullptr;
+			std::string text( size, '\0' );
+			if ( stream.read( text.data(), size ) != (ios_size)size )
+				return nullptr;
+			cmd = eeNew( TextUndoCommandInsert,
+						 ( id, cursorIdx, std::move( text ), position, time ) );
+			break;
+		}
+		case TextUndoCommandType::Remove: {
+			TextPosition start, end;
+			if ( !readPosition( stream, start ) || !readPosition( stream, end ) )
+				return nullptr;
+			cmd = eeNew( TextUndoCommandRemove, ( id, cursorIdx, { start, end }, time ) );
+			break;
+		}
+		case TextUndoCommandType::Selection: {
+			Uint64 count;
+			if ( !readValue( stream, count ) )
+				return nullptr;
+			TextRanges selection;
+			for ( Uint64 i = 0; i < count; ++i ) {
+				TextPosition start, end;
+				if ( !readPosition( stream, start ) || !readPosition( stream, end ) )
+					return nullptr;
+				selection.push_back( { start, end } );
+			}
+			cmd = eeNew( TextUndoCommandSelection, ( id, cursorIdx, selection, time ) );
+			break;
+		}
+		default:
+			return nullptr;
+	}
+
+	lastTime = Microseconds( lastTimestamp );
+	return cmd;
+}
+
+bool TextUndoStack::save( IOStream& stream ) {
+	if ( !stream.isOpen() )
+		return false;
+	stream.write( UNDO_HISTORY_MAGIC, sizeof( UNDO_HISTORY_MAGIC ) );
+	writeValue<Uint32>( stream, UNDO_HISTORY_VERSION );
+	stream.write( reinterpret_cast<const char*>( mDoc->getHash().data() ),
+				  mDoc->getHash().size() );
+	writeValue<Uint64>( stream, mChangeIdCounter );
+	writeValue<Uint64>( stream, mUndoStack.size() );
+	writeValue<Uint64>( stream, mRedoStack.size() );
+	for ( TextUndoCommand* cmd : mUndoStack )
+		writeCommand( stream, cmd );
+	for ( TextUndoCommand* cmd : mRedoStack )
+		writeCommand( stream, cmd );
+	return true;
+}
+
+bool TextUndoStack::load( IOStream& stream ) {
+	char magic[4];
+	Uint32 version;
+	std::array<Uint8, 16> hash;
+	Uint64 changeIdCounter, undoCount, redoCount;
+
+	if ( !stream.isOpen() || !readValue( stream, magic ) ||
+		 memcmp( magic, UNDO_HISTORY_MAGIC, sizeof( magic ) ) != 0 ||
+		 !readValue( stream, version ) || version != UNDO_HISTORY_VERSION ||
+		 !readValue( stream, hash ) || hash != mDoc->getHash() ||
+		 !readValue( stream, changeIdCounter ) || !readValue( stream, undoCount ) ||
+		 !readValue( stream, redoCount ) )
+		return false;
+
+	// Timestamps are relative to the document timer, move the restored history to the past so
+	// it's never merged with the new changes
+	Time timeOffset = mDoc->mTimer.getElapsedTime() - mMergeTimeout * 2.f;
+	UndoStackContainer undoStack;
+	UndoStackContainer redoStack;
+	Time lastTime;
+	bool failed = false;
+
+	for ( Uint64 i = 0; i < undoCount + redoCount; ++i ) {
+		Time cmdLastTime;
+		TextUndoCommand* cmd = readCommand( stream, cmdLastTime );
+		if ( nullptr == cmd ) {
+			failed = true;
+			break;
+		}
+		cmd->mLastTimestamp = cmdLastTime;
+		lastTime = eemax( lastTime, cmdLastTime );
+		( i < undoCount ? undoStack : redoStack ).push_back( cmd );
+	}
+
+	if ( failed ) {
+		for ( TextUndoCommand* cmd : undoStack )
+			eeDelete( cmd );
+		for ( TextUndoCommand* cmd : redoStack )
+			eeDelete( cmd );
+		return false;
+	}
+
+	clear();
+	timeOffset -= lastTime;
+	for ( TextUndoCommand* cmd : undoStack ) {
+		cmd->mTimestamp += timeOffset;
+		cmd->mLastTimestamp += timeOffset;
+		pushUndo( mUndoStack, cmd );
+	}
+	for ( TextUndoCommand* cmd : redoStack ) {
+		cmd->mTimestamp += timeOffset;
+		cmd->mLastTimestamp += timeOffset;
+		pushUndo( mRedoStack, cmd );
+	}
+	mChangeIdCounter = changeIdCounter;
+	return true;
+}
+
 UndoStackContainer& TextUndoStack::getUndoStackContainer() {
 	return mUndoStack;
 }
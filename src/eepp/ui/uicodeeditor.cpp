@@ -3,6 +3,7 @@
 #include <eepp/graphics/fonttruetype.hpp>
 #include <eepp/graphics/globalbatchrenderer.hpp>
 #include <eepp/graphics/primitives.hpp>
+#include <eepp/graphics/texturefactory.hpp>
 #include <eepp/scene/scenemanager.hpp>
 #include <eepp/system/luapattern.hpp>
 #include <eepp/ui/doc/syntaxdefinitionmanager.hpp>
@@ -25,6 +26,9 @@ using namespace EE::UI::Tools;
 
 namespace EE { namespace UI {
 
+// Documents with fewer lines than this are re-wrapped synchronously
+static const Int64 LINE_WRAP_ASYNC_MIN_LINES = 4096;
+
 UICodeEditor* UICodeEditor::New() {
 	return eeNew( UICodeEditor, ( true, true ) );
 }
@@ -185,11 +189,17 @@ UICodeEditor::~UICodeEditor() {
 	// Remember to stop all the async find jobs
 	mDoc->stopActiveFindAll();
 
+	// Cancels any running background re-wrap and minimap tile build
+	mLineWrapGeneration++;
+	mMinimapTilesGeneration++;
+
 	// TODO: Use a condition variable to wait the thread pool to finish
-	// Wait to end all the async find jobs
-	while ( mHighlightWordProcessing )
+	// Wait to end all the async find, re-wrap and minimap jobs
+	while ( mHighlightWordProcessing || mLineWrapProcessing || mMinimapTilesProcessing )
 		Sys::sleep( Milliseconds( 0.1 ) );
 
+	invalidateMinimapTiles();
+
 	if ( mDoc.use_count() == 1 ) {
 		DocEvent event( this, mDoc.get(), Event::OnDocumentClosed );
 		sendEvent( &event );
@@ -235,6 +245,11 @@ void UICodeEditor::draw() {
 	if ( mDoc->isLoading() )
 		return;
 
+	if ( mLineWrapMode != LineWrapMode::NoWrap &&
+		 ( mLineWrapDirty || mLineWrapWidth != getLineWrapWidth() ||
+		   mLineWrap.linesCount() != (Int64)mDoc->linesCount() ) )
+		updateLineWrap();
+
 	if ( mDirtyEditor )
 		updateEditor();
 
@@ -267,7 +282,7 @@ void UICodeEditor::draw() {
 			primitives.setColor( Color( mCurrentLineBackgroundColor ).blendAlpha( mAlpha ) );
 			primitives.drawRectangle(
 				Rectf( Vector2f( startScroll.x + mScroll.x,
-								 startScroll.y + sel.start().line() * lineHeight ),
+								 startScroll.y + getVisualLine( sel.start() ) * lineHeight ),
 					   Sizef( mSize.getWidth(), lineHeight ) ) );
 		}
 	}
@@ -320,14 +335,20 @@ void UICodeEditor::draw() {
 		drawLineEndings( lineRange, startScroll, lineHeight );
 	}
 
+	bool lineWrap = isLineWrapActive();
 	for ( unsigned long i = lineRange.first; i <= lineRange.second; i++ ) {
+		Int64 visualLine = lineWrap ? mLineWrap.getVisualLine( (Int64)i ) : (Int64)i;
 		Vector2f curScroll(
-			{ startScroll.x, static_cast<float>( startScroll.y + lineHeight * (double)i ) } );
+			{ startScroll.x,
+			  static_cast<float>( startScroll.y + lineHeight * (double)visualLine ) } );
 
 		for ( auto& plugin : mPlugins )
 			plugin->drawBeforeLineText( this, i, curScroll, charSize, lineHeight );
 
-		drawLineText( i, curScroll, charSize, lineHeight );
+		if ( lineWrap )
+			drawWrappedLineText( i, curScroll, charSize, lineHeight );
+		else
+			drawLineText( i, curScroll, charSize, lineHeight );
 
 		for ( auto& plugin : mPlugins )
 			plugin->drawAfterLineText( this, i, curScroll, charSize, lineHeight );
@@ -346,8 +367,8 @@ void UICodeEditor::draw() {
 	}
 
 	if ( hasFocus() && getUISceneNode()->getWindow()->getIME().isEditing() ) {
-		Vector2f cursorPos( startScroll.x + getXOffsetCol( cursor ),
-							startScroll.y + cursor.line() * lineHeight + getLineOffset() );
+		Vector2f cursorPos( startScroll + getTextPositionOffset( cursor ) );
+		cursorPos.y += getLineOffset();
 		FontStyleConfig config( mFontStyleConfig );
 		config.FontColor = mFontStyleConfig.getFontSelectedColor();
 		getUISceneNode()->getWindow()->getIME().draw( cursorPos, getFontHeight(), config,
@@ -568,15 +589,24 @@ UICodeEditor* UICodeEditor::setFont( Font* font ) {
 
 void UICodeEditor::onFontChanged() {
 	invalidateLinesCache();
+	invalidateGlyphRunCache();
+	mLongLinesLayout.clear();
 	udpateGlyphWidth();
+	invalidateLineWrap();
 }
 
 void UICodeEditor::onFontStyleChanged() {
 	invalidateLinesCache();
+	invalidateGlyphRunCache();
+	mLongLinesLayout.clear();
 	udpateGlyphWidth();
+	invalidateLineWrap();
 }
 
-void UICodeEditor::onDocumentLoaded( TextDocument* ) {}
+void UICodeEditor::onDocumentLoaded( TextDocument* ) {
+	invalidateLineWrap();
+	invalidateMinimapTiles();
+}
 
 void UICodeEditor::onDocumentReloaded( TextDocument* ) {
 	onDocumentClosed( mDoc.get() );
@@ -697,7 +727,11 @@ const Uint32& UICodeEditor::getTabWidth() const {
 }
 
 UICodeEditor* UICodeEditor::setTabWidth( const Uint32& tabWidth ) {
-	mTabWidth = tabWidth;
+	if ( mTabWidth != tabWidth ) {
+		mTabWidth = tabWidth;
+		mLongLinesLayout.clear();
+		invalidateLineWrap();
+	}
 	return this;
 }
 
@@ -825,6 +859,8 @@ void UICodeEditor::updateColorScheme() {
 	mMinimapHoverColor = mColorScheme.getEditorColor( "minimap_hover"_sst );
 	mMinimapHighlightColor = mColorScheme.getEditorColor( "minimap_highlight"_sst );
 	mMinimapSelectionColor = mColorScheme.getEditorColor( "minimap_selection"_sst );
+	invalidateGlyphRunCache();
+	invalidateMinimapTiles();
 }
 
 void UICodeEditor::setColorScheme( const SyntaxColorScheme& colorScheme ) {
@@ -856,6 +892,8 @@ void UICodeEditor::setDocument( std::shared_ptr<TextDocument> doc ) {
 			onDocumentClosed( mDoc.get() );
 		mDoc = doc;
 		mDoc->registerClient( this );
+		invalidateLineWrap();
+		invalidateMinimapTiles();
 		invalidateEditor();
 		invalidateLongestLineWidth();
 		invalidateDraw();
@@ -1016,6 +1054,14 @@ TextPosition UICodeEditor::resolveScreenPosition( const Vector2f& position, bool
 	localPos.y -= mPaddingPx.Top;
 	localPos.y -= getPluginsTopSpace();
 	Int64 line = (Int64)eefloor( localPos.y / getLineHeight() );
+	if ( isLineWrapActive() ) {
+		Int64 visualLinesCount = mLineWrap.visualLinesCount();
+		if ( clamp || ( line >= 0 && line < visualLinesCount ) )
+			return getVisualLinePosition( eeclamp<Int64>( line, 0, visualLinesCount - 1 ),
+										  localPos.x );
+		line = line < 0 ? line : (Int64)mDoc->linesCount() + line - visualLinesCount;
+		return TextPosition( line, getColFromXOffset( line, localPos.x ) );
+	}
 	if ( clamp )
 		line = eeclamp<Int64>( line, 0, (Int64)( mDoc->linesCount() - 1 ) );
 	return TextPosition( line, getColFromXOffset( line, localPos.x ) );
@@ -1026,6 +1072,10 @@ Rectf UICodeEditor::getScreenPosition( const TextPosition& position ) const {
 	Vector2f screenStart( getScreenStart() );
 	Vector2f start( screenStart.x + getGutterWidth(), screenStart.y );
 	Vector2f startScroll( start - mScroll );
+	if ( isLineWrapActive() ) {
+		TextPosition pos( mDoc->sanitizePosition( position ) );
+		return { startScroll + getTextPositionOffset( pos ), { getGlyphWidth(), lineHeight } };
+	}
 	return { { startScroll.x + getXOffsetColSanitized( position ),
 			   startScroll.y + lineHeight * position.line() },
 			 { getGlyphWidth(), lineHeight } };
@@ -1045,11 +1095,12 @@ Vector2f UICodeEditor::getViewPortLineCount() const {
 
 Sizef UICodeEditor::getMaxScroll() const {
 	Vector2f vplc( getViewPortLineCount() );
-	return Sizef( eemax( 0.f, mLongestLineWidth - getViewportWidth() ),
-				  vplc.y > mDoc->linesCount() - 1
+	Int64 linesCount = getVisualLinesCount();
+	return Sizef( mLineWrapMode != LineWrapMode::NoWrap
 					  ? 0.f
-					  : eefloor( mDoc->linesCount() - getViewPortLineCount().y ) *
-							getLineHeight() );
+					  : eemax( 0.f, mLongestLineWidth - getViewportWidth() ),
+				  vplc.y > linesCount - 1 ? 0.f
+										  : eefloor( linesCount - vplc.y ) * getLineHeight() );
 }
 
 UIMenuItem* UICodeEditor::menuAdd( UIPopUpMenu* menu, const String& translateString,
@@ -1505,9 +1556,8 @@ Vector2f UICodeEditor::getRelativeScreenPosition( const TextPosition& pos ) {
 	Float gutterWidth = getGutterWidth();
 	Vector2f start( gutterWidth, getPluginsTopSpace() );
 	Vector2f startScroll( start - mScroll );
-	auto lineHeight = getLineHeight();
-	return { startScroll.x + getXOffsetCol( pos ),
-			 startScroll.y + pos.line() * lineHeight + getLineOffset() };
+	Vector2f offset( getTextPositionOffset( pos ) );
+	return { startScroll.x + offset.x, startScroll.y + offset.y + getLineOffset() };
 }
 
 bool UICodeEditor::getShowLinesRelativePosition() const {
@@ -1526,11 +1576,11 @@ UIScrollBar* UICodeEditor::getHScrollBar() const {
 	return mHScrollBar;
 }
 
-void UICodeEditor::drawCursor( const Vector2f& startScroll, const Float& lineHeight,
+void UICodeEditor::drawCursor( const Vector2f& startScroll, const Float& /*lineHeight*/,
 							   const TextPosition& cursor ) {
 	if ( mCursorVisible && !mLocked && isTextSelectionEnabled() ) {
-		Vector2f cursorPos( startScroll.x + getXOffsetCol( cursor ),
-							startScroll.y + cursor.line() * lineHeight + getLineOffset() );
+		Vector2f cursorPos( startScroll + getTextPositionOffset( cursor ) );
+		cursorPos.y += getLineOffset();
 		Primitives primitives;
 		primitives.setColor( Color( mCaretColor ).blendAlpha( mAlpha ) );
 		primitives.drawRectangle(
@@ -1560,6 +1610,10 @@ void UICodeEditor::findLongestLine() {
 Float UICodeEditor::getLineWidth( const Int64& lineIndex ) {
 	if ( lineIndex >= (Int64)mDoc->linesCount() )
 		return 0;
+	if ( mFont && isLongLine( lineIndex ) ) {
+		return getLongLineLayout( lineIndex ).segmentX.back() +
+			   ( mFont->isMonospace() ? 0.f : getGlyphWidth() );
+	}
 	if ( mFont && !mFont->isMonospace() ) {
 		auto line = mDoc->line( lineIndex );
 		auto found = mLinesWidthCache.find( lineIndex );
@@ -1573,7 +1627,8 @@ Float UICodeEditor::getLineWidth( const Int64& lineIndex ) {
 }
 
 void UICodeEditor::updateScrollBar() {
-	int notVisibleLineCount = (int)mDoc->linesCount() - (int)getViewPortLineCount().y;
+	Int64 linesCount = getVisualLinesCount();
+	Int64 notVisibleLineCount = linesCount - (Int64)getViewPortLineCount().y;
 
 	if ( mLongestLineWidthDirty && mFont )
 		updateLongestLineWidth();
@@ -1583,7 +1638,7 @@ void UICodeEditor::updateScrollBar() {
 
 	mVScrollBar->setPixelsSize( mVScrollBar->getPixelsSize().getWidth(), mSize.getHeight() );
 
-	if ( mHorizontalScrollBarEnabled ) {
+	if ( mHorizontalScrollBarEnabled && mLineWrapMode == LineWrapMode::NoWrap ) {
 		mHScrollBar->setPixelsPosition( 0, mSize.getHeight() -
 											   mHScrollBar->getPixelsSize().getHeight() );
 		mHScrollBar->setPixelsSize( mSize.getWidth() -
@@ -1599,7 +1654,7 @@ void UICodeEditor::updateScrollBar() {
 	}
 
 	mVScrollBar->setPixelsPosition( mSize.getWidth() - mVScrollBar->getPixelsSize().getWidth(), 0 );
-	mVScrollBar->setPageStep( getViewPortLineCount().y / (float)mDoc->linesCount() );
+	mVScrollBar->setPageStep( getViewPortLineCount().y / (float)linesCount );
 	mVScrollBar->setClickStep( 0.2f );
 	mVScrollBar->setEnabled( mVerticalScrollBarEnabled && notVisibleLineCount > 0 );
 	mVScrollBar->setVisible( mVerticalScrollBarEnabled && notVisibleLineCount > 0 );
@@ -1727,10 +1782,35 @@ void UICodeEditor::onDocumentLineCountChange( const size_t&, const size_t& ) {
 
 void UICodeEditor::onDocumentLineChanged( const Int64& lineNumber ) {
 	mDoc->getHighlighter()->invalidate( lineNumber );
+	invalidateMinimapTiles( lineNumber, false );
+
+	if ( mLineWrapMode != LineWrapMode::NoWrap ) {
+		// While lines are being inserted the index is behind the document until the line move is
+		// notified, the line is re-wrapped after that.
+		mLineWrapPendingLines.push_back( lineNumber );
+		if ( mLineWrap.linesCount() == (Int64)mDoc->linesCount() )
+			updateLineWrapPendingLines();
+	}
 
 	updateHighlightWordCache();
 }
 
+void UICodeEditor::onDocumentLineMove( const Int64& fromLine, const Int64& numLines ) {
+	invalidateMinimapTiles( fromLine, true );
+
+	if ( mLineWrapMode == LineWrapMode::NoWrap || mLineWrap.linesCount() == 0 )
+		return;
+
+	if ( numLines > 0 ) {
+		mLineWrap.insertLines( fromLine + 1, numLines );
+	} else if ( numLines < 0 ) {
+		mLineWrap.removeLines( fromLine + 1, -numLines );
+	}
+
+	if ( mLineWrap.linesCount() == (Int64)mDoc->linesCount() )
+		updateLineWrapPendingLines();
+}
+
 void UICodeEditor::onDocumentUndoRedo( const TextDocument::UndoRedo& ) {
 	onDocumentSelectionChange( {} );
 	DocEvent event( this, mDoc.get(), Event::OnDocumentUndoRedo );
@@ -1757,12 +1837,22 @@ void UICodeEditor::onDocumentDirtyOnFileSystem( TextDocument* doc ) {
 	sendEvent( &event );
 }
 
-std::pair<Uint64, Uint64> UICodeEditor::getVisibleLineRange() const {
+std::pair<Int64, Int64> UICodeEditor::getVisibleVisualLineRange() const {
 	Float lineHeight = getLineHeight();
 	Float minLine = eemax( 0.f, eefloor( mScroll.y / lineHeight ) );
-	Float maxLine = eemin( mDoc->linesCount() - 1.f,
+	Float maxLine = eemin( getVisualLinesCount() - 1.f,
 						   eefloor( ( mSize.getHeight() + mScroll.y ) / lineHeight ) + 1 );
-	return std::make_pair<Uint64, Uint64>( (Uint64)minLine, (Uint64)maxLine );
+	return std::make_pair<Int64, Int64>( (Int64)minLine, (Int64)maxLine );
+}
+
+std::pair<Uint64, Uint64> UICodeEditor::getVisibleLineRange() const {
+	auto range = getVisibleVisualLineRange();
+	if ( isLineWrapActive() ) {
+		range.first = mLineWrap.getVisualLineStart( range.first ).line();
+		range.second = mLineWrap.getVisualLineStart( range.second ).line();
+	}
+	return std::make_pair<Uint64, Uint64>( (Uint64)eemax<Int64>( 0, range.first ),
+										   (Uint64)eemax<Int64>( 0, range.second ) );
 }
 
 TextRange UICodeEditor::getVisibleRange() const {
@@ -1805,34 +1895,32 @@ void UICodeEditor::scrollTo( TextPosition position, bool centered, bool forceExa
 void UICodeEditor::scrollTo( TextRange position, bool centered, bool forceExactPosition,
 							 bool scrollX ) {
 	position.normalize();
-	auto lineRange = getVisibleLineRange();
+	auto lineRange = getVisibleVisualLineRange();
+	Int64 endLine = getVisualLine( position.end() );
 
 	Int64 minDistance = mHScrollBar->isVisible() ? 3 : 2;
 
-	if ( forceExactPosition || position.end().line() <= (Int64)lineRange.first ||
-		 position.end().line() >= (Int64)lineRange.second - minDistance ) {
+	if ( forceExactPosition || endLine <= lineRange.first ||
+		 endLine >= lineRange.second - minDistance ) {
 		// Vertical Scroll
 		Float lineHeight = getLineHeight();
-		Float min = eefloor( lineHeight * ( eemax<Float>( 0, position.end().line() - 1 ) ) );
-		Float max =
-			eefloor( lineHeight * ( position.end().line() + minDistance ) - mSize.getHeight() );
+		Float min = eefloor( lineHeight * ( eemax<Float>( 0, endLine - 1 ) ) );
+		Float max = eefloor( lineHeight * ( endLine + minDistance ) - mSize.getHeight() );
 		Float halfScreenLines = eefloor( mSize.getHeight() / lineHeight * 0.5f );
 
 		if ( forceExactPosition ) {
 			setScrollY( lineHeight *
-						( eemax<Float>( 0, position.end().line() - 1 -
-											   ( centered ? halfScreenLines : 0 ) ) ) );
+						( eemax<Float>( 0, endLine - 1 - ( centered ? halfScreenLines : 0 ) ) ) );
 		} else if ( min < mScroll.y ) {
 			if ( centered ) {
-				if ( position.end().line() - 1 - halfScreenLines >= 0 )
-					min = eefloor( lineHeight * ( eemax<Float>( 0, position.end().line() - 1 -
-																	   halfScreenLines ) ) );
+				if ( endLine - 1 - halfScreenLines >= 0 )
+					min = eefloor( lineHeight *
+								   ( eemax<Float>( 0, endLine - 1 - halfScreenLines ) ) );
 			}
 			setScrollY( min );
 		} else if ( max > mScroll.y ) {
 			if ( centered ) {
-				max = eefloor( lineHeight *
-								   ( position.end().line() + minDistance + halfScreenLines ) -
+				max = eefloor( lineHeight * ( endLine + minDistance + halfScreenLines ) -
 							   mSize.getHeight() );
 				max = eemin( max, getMaxScroll().y );
 			}
@@ -1841,7 +1929,7 @@ void UICodeEditor::scrollTo( TextRange position, bool centered, bool forceExactP
 	}
 
 	// Horizontal Scroll
-	if ( !scrollX )
+	if ( !scrollX || mLineWrapMode != LineWrapMode::NoWrap )
 		return;
 	Float offsetXEnd = getXOffsetCol( position.end() );
 	Float minVisibility = getGlyphWidth();
@@ -1903,6 +1991,15 @@ void UICodeEditor::setScrollY( const Float& val, bool emmitEvent ) {
 }
 
 Float UICodeEditor::getXOffsetCol( const TextPosition& position ) const {
+	if ( mFont && isLongLine( position.line() ) ) {
+		const LongLineLayout& layout = getLongLineLayout( position.line() );
+		const String& text = mDoc->line( position.line() ).getText();
+		Int64 col = eeclamp<Int64>( position.column(), 0, text.size() );
+		Int64 segment = col / layout.segmentLength;
+		Int64 start = segment * layout.segmentLength;
+		return layout.segmentX[segment] + getTextWidth( text.view().substr( start, col - start ) );
+	}
+
 	if ( mFont && !mFont->isMonospace() ) {
 		return Text::findCharacterPos(
 				   ( position.column() == (Int64)mDoc->line( position.line() ).getText().size() )
@@ -2432,12 +2529,29 @@ Int64 UICodeEditor::getColFromXOffset( Int64 lineNumber, const Float& x ) const
 
 	TextPosition pos = mDoc->sanitizePosition( TextPosition( lineNumber, 0 ) );
 
-	if ( mFont && !mFont->isMonospace() )
-		return Text::findCharacterFromPos( Vector2i( x, 0 ), true, mFont, getCharacterSize(),
-										   mDoc->line( pos.line() ).getText(),
+	if ( isLongLine( pos.line() ) ) {
+		const LongLineLayout& layout = getLongLineLayout( pos.line() );
+		const String& text = mDoc->line( pos.line() ).getText();
+		Int64 segment = std::upper_bound( layout.segmentX.begin(), layout.segmentX.end(), x ) -
+						layout.segmentX.begin() - 1;
+		if ( segment >= (Int64)layout.segmentX.size() - 1 )
+			return static_cast<Int64>( text.size() ) - 1;
+		Int64 start = segment * layout.segmentLength;
+		return start + getColFromXOffset( text.substr( start, layout.segmentLength ),
+										  x - layout.segmentX[segment] );
+	}
+
+	return getColFromXOffset( mDoc->line( pos.line() ).getText(), x );
+}
+
+Int64 UICodeEditor::getColFromXOffset( const String& line, const Float& x ) const {
+	if ( x <= 0 )
+		return 0;
+
+	if ( !mFont->isMonospace() )
+		return Text::findCharacterFromPos( Vector2i( x, 0 ), true, mFont, getCharacterSize(), line,
 										   mFontStyleConfig.Style, mTabWidth );
 
-	const String& line = mDoc->line( pos.line() ).getText();
 	Int64 len = line.length();
 	Float glyphWidth = getGlyphWidth();
 	Float xOffset = 0;
@@ -2567,6 +2681,14 @@ void UICodeEditor::resetCursor() {
 TextPosition UICodeEditor::moveToLineOffset( const TextPosition& position, int offset,
 											 const size_t& cursorIdx ) {
 	auto& xo = mLastXOffset[cursorIdx];
+	if ( isLineWrapActive() ) {
+		if ( xo.position != position )
+			xo.offset = getTextPositionOffset( mDoc->sanitizePosition( position ) ).x;
+		Int64 visualLine = eeclamp<Int64>( mLineWrap.getVisualLine( position ) + offset, 0,
+										   mLineWrap.visualLinesCount() - 1 );
+		xo.position = getVisualLinePosition( visualLine, xo.offset );
+		return xo.position;
+	}
 	if ( xo.position != position )
 		xo.offset = getXOffsetColSanitized( position );
 	xo.position.setLine( position.line() + offset );
@@ -2585,7 +2707,7 @@ void UICodeEditor::moveToNextLine() {
 void UICodeEditor::jumpLinesUp( int offset ) {
 	for ( size_t i = 0; i < mDoc->getSelections().size(); ++i ) {
 		TextPosition position = mDoc->getSelections()[i].start();
-		if ( position.line() == 0 ) {
+		if ( getVisualLine( position ) == 0 ) {
 			mDoc->setSelection( i, mDoc->startOfDoc(), mDoc->startOfDoc() );
 		} else {
 			mDoc->moveTo( i, moveToLineOffset( position, offset, i ) );
@@ -2597,7 +2719,7 @@ void UICodeEditor::jumpLinesUp( int offset ) {
 void UICodeEditor::jumpLinesDown( int offset ) {
 	for ( size_t i = 0; i < mDoc->getSelections().size(); ++i ) {
 		TextPosition position = mDoc->getSelections()[i].start();
-		if ( position.line() >= (Int64)mDoc->linesCount() - offset ) {
+		if ( getVisualLine( position ) >= getVisualLinesCount() - offset ) {
 			mDoc->setSelection( i, mDoc->endOfDoc(), mDoc->endOfDoc() );
 		} else {
 			mDoc->moveTo( i, moveToLineOffset( position, offset, i ) );
@@ -2617,7 +2739,7 @@ void UICodeEditor::jumpLinesDown() {
 void UICodeEditor::selectToPreviousLine() {
 	for ( size_t i = 0; i < mDoc->getSelections().size(); ++i ) {
 		TextPosition position = mDoc->getSelectionIndex( i ).start();
-		if ( position.line() == 0 ) {
+		if ( getVisualLine( position ) == 0 ) {
 			mDoc->selectTo( i, mDoc->startOfDoc() );
 		} else {
 			mDoc->selectTo( i, moveToLineOffset( position, -1 ) );
@@ -2628,7 +2750,7 @@ void UICodeEditor::selectToPreviousLine() {
 void UICodeEditor::selectToNextLine() {
 	for ( size_t i = 0; i < mDoc->getSelections().size(); ++i ) {
 		TextPosition position = mDoc->getSelectionIndex( i ).start();
-		if ( position.line() == (Int64)mDoc->linesCount() - 1 ) {
+		if ( getVisualLine( position ) == getVisualLinesCount() - 1 ) {
 			mDoc->selectTo( i, mDoc->endOfDoc() );
 		} else {
 			mDoc->selectTo( i, moveToLineOffset( position, 1 ) );
@@ -2671,6 +2793,208 @@ void UICodeEditor::setDisplayLockedIcon( bool displayLockedIcon ) {
 	mDisplayLockedIcon = displayLockedIcon;
 }
 
+size_t UICodeEditor::getGlyphRunCacheMaxLines() const {
+	return mGlyphRunCacheMaxLines;
+}
+
+void UICodeEditor::setGlyphRunCacheMaxLines( size_t maxLines ) {
+	mGlyphRunCacheMaxLines = maxLines;
+	while ( mGlyphRunCache.size() > mGlyphRunCacheMaxLines ) {
+		mGlyphRunCache.erase( mGlyphRunCacheLRU.back() );
+		mGlyphRunCacheLRU.pop_back();
+	}
+}
+
+const LineWrapMode& UICodeEditor::getLineWrapMode() const {
+	return mLineWrapMode;
+}
+
+void UICodeEditor::setLineWrapMode( const LineWrapMode& lineWrapMode ) {
+	if ( lineWrapMode != mLineWrapMode ) {
+		mLineWrapMode = lineWrapMode;
+		updateLineWrap();
+		setScrollX( 0 );
+		invalidateDraw();
+	}
+}
+
+Int64 UICodeEditor::getVisualLinesCount() const {
+	return isLineWrapActive() ? mLineWrap.visualLinesCount() : (Int64)mDoc->linesCount();
+}
+
+Int64 UICodeEditor::getVisualLine( const TextPosition& position ) const {
+	return isLineWrapActive() ? mLineWrap.getVisualLine( position ) : position.line();
+}
+
+Vector2f UICodeEditor::getTextPositionOffset( const TextPosition& position ) const {
+	if ( !isLineWrapActive() )
+		return { getXOffsetCol( position ), position.line() * getLineHeight() };
+	Int64 segmentStart = mLineWrap.getSegmentStart( position );
+	Float x = getXOffsetCol( position );
+	if ( segmentStart > 0 )
+		x -= getXOffsetCol( { position.line(), segmentStart } );
+	return { x, mLineWrap.getVisualLine( position ) * getLineHeight() };
+}
+
+bool UICodeEditor::isLineWrapActive() const {
+	return mLineWrapMode != LineWrapMode::NoWrap && mLineWrap.linesCount() > 0 &&
+		   mLineWrap.linesCount() == (Int64)mDoc->linesCount();
+}
+
+Float UICodeEditor::getLineWrapWidth() const {
+	// Leaves room for the cursor at the end of the line
+	return eemax( 0.f, getViewportWidth( true ) - getGlyphWidth() );
+}
+
+LineWrapIndex::CharWidthFn UICodeEditor::getLineWrapCharWidthFn() const {
+	Uint32 tabWidth = mTabWidth;
+	if ( mFont && !mFont->isMonospace() ) {
+		Font* font = mFont;
+		unsigned int characterSize = getCharacterSize();
+		bool bold = mFontStyleConfig.Style & Text::Bold;
+		bool italic = mFontStyleConfig.Style & Text::Italic;
+		Float spaceWidth = font->getGlyph( ' ', characterSize, bold, italic ).advance;
+		return [font, characterSize, bold, italic, spaceWidth,
+				tabWidth]( String::StringBaseType ch ) -> Float {
+			if ( ch == '\t' )
+				return spaceWidth * tabWidth;
+			if ( ch == '\r' )
+				return 0.f;
+			return font->getGlyph( ch, characterSize, bold, italic ).advance;
+		};
+	}
+
+	// Pure arithmetic, safe to be used from the thread pool
+	Float glyphWidth = getGlyphWidth();
+	return [glyphWidth, tabWidth]( String::StringBaseType ch ) -> Float {
+		return ch == '\t' ? glyphWidth * tabWidth : ( ch == '\r' ? 0.f : glyphWidth );
+	};
+}
+
+void UICodeEditor::invalidateLineWrap() {
+	if ( mLineWrapMode != LineWrapMode::NoWrap )
+		mLineWrapDirty = true;
+}
+
+void UICodeEditor::updateLineWrap() {
+	Uint64 generation = ++mLineWrapGeneration;
+	mLineWrapDirty = false;
+	mLineWrapPendingLines.clear();
+
+	if ( mLineWrapMode == LineWrapMode::NoWrap || mFont == nullptr || mDoc->isLoading() ) {
+		mLineWrapWidth = 0;
+		mLineWrap.clear();
+		if ( mFont )
+			updateScrollBar();
+		return;
+	}
+
+	Float lineHeight = getLineHeight();
+
+	// Keeps the first visible line in place while the visual lines change
+	Int64 topVisualLine = (Int64)eefloor( mScroll.y / lineHeight );
+	TextPosition top( eemin<Int64>( topVisualLine, mDoc->linesCount() - 1 ), 0 );
+	if ( isLineWrapActive() )
+		top = mLineWrap.getVisualLineStart( topVisualLine );
+
+	Int64 linesCount = mDoc->linesCount();
+	Float width = getLineWrapWidth();
+	LineWrapMode mode = mLineWrapMode;
+	auto charWidth = getLineWrapCharWidthFn();
+	mLineWrapWidth = width;
+
+	if ( !getUISceneNode()->hasThreadPool() || !mFont->isMonospace() ||
+		 linesCount < LINE_WRAP_ASYNC_MIN_LINES ) {
+		std::vector<std::vector<Int64>> breaks( linesCount );
+		for ( Int64 i = 0; i < linesCount; i++ )
+			breaks[i] = LineWrapIndex::computeLineBreaks( mDoc->line( i ).getText(), width, mode,
+														  charWidth );
+		mLineWrap.setLinesBreaks( std::move( breaks ) );
+		setScrollY( mLineWrap.getVisualLine( top ) * lineHeight );
+		updateScrollBar();
+		return;
+	}
+
+	// The visible lines are wrapped right away, the rest of the document is wrapped in the thread
+	// pool. Meanwhile the lines keep their previous breaks.
+	if ( mLineWrap.linesCount() != linesCount )
+		mLineWrap.reset( linesCount );
+	Int64 lastVisibleLine =
+		eemin<Int64>( linesCount - 1, top.line() + getViewPortLineCount().y + 1 );
+	for ( Int64 i = top.line(); i <= lastVisibleLine; i++ )
+		mLineWrap.setLineBreaks( i, LineWrapIndex::computeLineBreaks( mDoc->line( i ).getText(),
+																	  width, mode, charWidth ) );
+	setScrollY( mLineWrap.getVisualLine( top ) * lineHeight );
+	updateScrollBar();
+
+	mLineWrapProcessing++;
+	Uint64 modificationId = mDoc->getModificationId();
+	// The document keeps being edited in the main thread, the lines are read from a snapshot
+	auto snapshot = mDoc->getSnapshot();
+	getUISceneNode()->getThreadPool()->run( [this, generation, modificationId, snapshot, width,
+											 mode, charWidth] {
+		Int64 snapshotLinesCount = snapshot->linesCount();
+		std::vector<std::vector<Int64>> breaks( snapshotLinesCount );
+		for ( Int64 i = 0; i < snapshotLinesCount && generation == mLineWrapGeneration; i++ )
+			breaks[i] =
+				LineWrapIndex::computeLineBreaks( snapshot->line( i ), width, mode, charWidth );
+
+		if ( generation == mLineWrapGeneration ) {
+			runOnMainThread( [this, generation, modificationId,
+							  breaks = std::move( breaks )]() mutable {
+				if ( generation != mLineWrapGeneration )
+					return;
+				if ( modificationId != mDoc->getModificationId() ||
+					 breaks.size() != mDoc->linesCount() ) {
+					// The document changed while it was being wrapped, start over
+					invalidateLineWrap();
+					invalidateDraw();
+					return;
+				}
+				Float lineHeight = getLineHeight();
+				TextPosition top(
+					mLineWrap.getVisualLineStart( eefloor( mScroll.y / lineHeight ) ) );
+				mLineWrap.setLinesBreaks( std::move( breaks ) );
+				setScrollY( mLineWrap.getVisualLine( top ) * lineHeight );
+				updateScrollBar();
+				invalidateDraw();
+			} );
+		}
+
+		mLineWrapProcessing--;
+	} );
+}
+
+void UICodeEditor::updateLineWrapPendingLines() {
+	if ( mLineWrapPendingLines.empty() )
+		return;
+	Int64 visualLinesCount = mLineWrap.visualLinesCount();
+	Int64 linesCount = mDoc->linesCount();
+	auto charWidth = getLineWrapCharWidthFn();
+	for ( Int64 line : mLineWrapPendingLines ) {
+		if ( line < 0 || line >= linesCount )
+			continue;
+		mLineWrap.setLineBreaks( line,
+								 LineWrapIndex::computeLineBreaks( mDoc->line( line ).getText(),
+																   mLineWrapWidth, mLineWrapMode,
+																   charWidth ) );
+	}
+	mLineWrapPendingLines.clear();
+	if ( visualLinesCount != mLineWrap.visualLinesCount() )
+		updateScrollBar();
+}
+
+TextPosition UICodeEditor::getVisualLinePosition( Int64 visualLine, const Float& x ) const {
+	TextPosition start( mLineWrap.getVisualLineStart( visualLine ) );
+	Int64 lineLength = mDoc->line( start.line() ).size();
+	Int64 end = mLineWrap.getVisualLineEnd( visualLine, lineLength );
+	Float segmentX = start.column() > 0 ? getXOffsetCol( start ) : 0.f;
+	Int64 col = getColFromXOffset( start.line(), x + segmentX );
+	// A position at the break column is displayed at the start of the next visual line
+	Int64 maxCol = eemax( start.column(), ( end < lineLength ? end : lineLength ) - 1 );
+	return { start.line(), eeclamp( col, start.column(), maxCol ) };
+}
+
 void UICodeEditor::indent() {
 	UIEventDispatcher* eventDispatcher =
 		static_cast<UIEventDispatcher*>( getUISceneNode()->getEventDispatcher() );
@@ -2756,33 +3080,14 @@ void UICodeEditor::updateHighlightWordCache() {
 		removeActionsByTag( tag );
 		runOnMainThread(
 			[this, tag]() {
+				if ( mDoc->isRunningTransaction() )
+					return;
+				// A search not started yet is superseded by this one
 				getUISceneNode()->getThreadPool()->removeWithTag( tag );
+				Uint64 searchId = ++mHighlightWordSearchId;
+				TextRange range( getVisibleRange() );
 				getUISceneNode()->getThreadPool()->run(
-					[this]() {
-						if ( mDoc->isRunningTransaction() )
-							return;
-						Clock docSearch;
-						mHighlightWordProcessing++;
-						mDoc->stopActiveFindAll();
-
-						auto wordCache = mDoc->findAll(
-							mHighlightWord.escapeSequences ? String::unescape( mHighlightWord.text )
-														   : mHighlightWord.text,
-							mHighlightWord.caseSensitive, mHighlightWord.wholeWord,
-							mHighlightWord.type, mHighlightWord.range );
-
-						{
-							Lock l( mHighlightWordCacheMutex );
-							mHighlightWordCache = std::move( wordCache );
-						}
-
-						Log::info( "Document search triggered in document: \"%s\", searched for "
-								   "\"%s\" and took %.2f ms",
-								   mDoc->getFilename().c_str(),
-								   mHighlightWord.text.toUtf8().c_str(),
-								   docSearch.getElapsedTime().asMilliseconds() );
-					},
-					[this]( const auto& ) { mHighlightWordProcessing--; }, tag );
+					[this, searchId, range] { highlightWordAsync( searchId, range ); }, {}, tag );
 			},
 			Milliseconds( 16 ), tag );
 	} else {
@@ -2796,6 +3101,54 @@ void UICodeEditor::updateHighlightWordCache() {
 	}
 }
 
+void UICodeEditor::highlightWordAsync( Uint64 searchId, TextRange priorityRange ) {
+	mHighlightWordProcessing++;
+	mDoc->stopActiveFindAll();
+
+	mDoc->findAllAsync(
+		getUISceneNode()->getThreadPool(),
+		mHighlightWord.escapeSequences ? String::unescape( mHighlightWord.text )
+									   : mHighlightWord.text,
+		mHighlightWord.caseSensitive, mHighlightWord.wholeWord, mHighlightWord.type,
+		mHighlightWord.range, priorityRange,
+		[this, searchId]( const TextRanges& ranges ) {
+			// Partial results are displayed as they arrive, visible ones come first
+			{
+				Lock l( mHighlightWordCacheMutex );
+				if ( searchId != mHighlightWordSearchId )
+					return;
+				if ( mHighlightWordCacheId != searchId ) {
+					mHighlightWordCache.clear();
+					mHighlightWordCacheId = searchId;
+				}
+				// The chunks arrive out of order, they are merged to keep the cache sorted
+				size_t size = mHighlightWordCache.size();
+				mHighlightWordCache.insert( mHighlightWordCache.end(), ranges.begin(),
+											ranges.end() );
+				std::inplace_merge( mHighlightWordCache.begin(), mHighlightWordCache.begin() + size,
+									mHighlightWordCache.end() );
+				mHighlightWordCache.setSorted();
+			}
+			runOnMainThread( [this] { invalidateDraw(); } );
+		},
+		[this, searchId, docSearch = Clock()]( TextRanges&& ranges, bool cancelled ) mutable {
+			if ( !cancelled ) {
+				Lock l( mHighlightWordCacheMutex );
+				if ( searchId == mHighlightWordSearchId ) {
+					mHighlightWordCache = std::move( ranges );
+					mHighlightWordCacheId = searchId;
+				}
+			}
+
+			Log::info( "Document search triggered in document: \"%s\", searched for "
+					   "\"%s\" and took %.2f ms",
+					   mDoc->getFilename().c_str(), mHighlightWord.text.toUtf8().c_str(),
+					   docSearch.getElapsedTime().asMilliseconds() );
+
+			mHighlightWordProcessing--;
+		} );
+}
+
 void UICodeEditor::setHighlightWord( const TextSearchParams& highlightWord ) {
 	if ( mHighlightWord != highlightWord ) {
 		mHighlightWord = highlightWord;
@@ -2869,8 +3222,7 @@ void UICodeEditor::drawMatchingBrackets( const Vector2f& startScroll, const Floa
 		primitive.setForceDraw( false );
 		primitive.setColor( Color( mMatchingBracketColor ).blendAlpha( mAlpha ) );
 		auto drawBracket = [&]( const TextPosition& pos ) {
-			primitive.drawRectangle( Rectf( Vector2f( startScroll.x + getXOffsetCol( pos ),
-													  startScroll.y + pos.line() * lineHeight ),
+			primitive.drawRectangle( Rectf( startScroll + getTextPositionOffset( pos ),
 											Sizef( getGlyphWidth(), lineHeight ) ) );
 		};
 		drawBracket( mMatchingBrackets.start() );
@@ -2919,14 +3271,8 @@ void UICodeEditor::drawWordRanges( const TextRanges& ranges, const std::pair<int
 		if ( !range.inSameLine() )
 			continue;
 
-		Rectf selRect;
-		Int64 startCol = range.start().column();
-		Int64 endCol = range.end().column();
-		selRect.Top = startScroll.y + range.start().line() * lineHeight;
-		selRect.Bottom = selRect.Top + lineHeight;
-		selRect.Left = startScroll.x + getXOffsetCol( { range.start().line(), startCol } );
-		selRect.Right = startScroll.x + getXOffsetCol( { range.start().line(), endCol } );
-		primitives.drawRectangle( selRect );
+		drawLineColumnsRange( primitives, range.start().line(), range.start().column(),
+							  range.end().column(), startScroll, lineHeight );
 	}
 
 	primitives.setForceDraw( true );
@@ -2960,14 +3306,9 @@ void UICodeEditor::drawWordMatch( const String& text, const std::pair<int, int>&
 					}
 				}
 
-				Rectf selRect;
 				Int64 startCol = pos;
 				Int64 endCol = pos + text.size();
-				selRect.Top = startScroll.y + ln * lineHeight;
-				selRect.Bottom = selRect.Top + lineHeight;
-				selRect.Left = startScroll.x + getXOffsetCol( { ln, startCol } );
-				selRect.Right = startScroll.x + getXOffsetCol( { ln, endCol } );
-				primitives.drawRectangle( selRect );
+				drawLineColumnsRange( primitives, ln, startCol, endCol, startScroll, lineHeight );
 				pos = endCol;
 			} else {
 				break;
@@ -2979,6 +3320,14 @@ void UICodeEditor::drawWordMatch( const String& text, const std::pair<int, int>&
 
 void UICodeEditor::drawLineText( const Int64& line, Vector2f position, const Float& fontSize,
 								 const Float& lineHeight ) {
+	if ( isLongLine( line ) ) {
+		drawLongLineText( line, position, fontSize, lineHeight );
+		return;
+	}
+
+	if ( drawLineGlyphRun( line, position, fontSize, lineHeight ) )
+		return;
+
 	Vector2f originalPosition( position );
 	auto& tokens = mDoc->getHighlighter()->getLine( line );
 	const String& strLine = mDoc->line( line ).getText();
@@ -3150,6 +3499,145 @@ void UICodeEditor::drawLineText( const Int64& line, Vector2f position, const Flo
 	}
 }
 
+bool UICodeEditor::isLongLine( const Int64& line ) const {
+	return mDoc->getHighlighter() && mDoc->getHighlighter()->isLongLine( line );
+}
+
+const UICodeEditor::LongLineLayout& UICodeEditor::getLongLineLayout( const Int64& line ) const {
+	const auto& docLine = mDoc->line( line );
+	Int64 segmentLength = mDoc->getHighlighter()->getMaxTokenizationLength();
+	LongLineLayout& layout = mLongLinesLayout[line];
+	if ( layout.hash == docLine.getHash() && layout.segmentLength == segmentLength &&
+		 !layout.segmentX.empty() )
+		return layout;
+
+	const String& text = docLine.getText();
+	Int64 len = text.size();
+	layout.hash = docLine.getHash();
+	layout.segmentLength = segmentLength;
+	layout.segmentX.clear();
+	layout.segmentX.reserve( len / segmentLength + 2 );
+	layout.segmentX.push_back( 0 );
+	Float x = 0;
+	for ( Int64 start = 0; start < len; start += segmentLength ) {
+		x += getTextWidth( text.view().substr( start, segmentLength ) );
+		layout.segmentX.push_back( x );
+	}
+	return layout;
+}
+
+void UICodeEditor::drawLongLineText( const Int64& line, Vector2f position, const Float& fontSize,
+									 const Float& lineHeight ) {
+	const LongLineLayout& layout = getLongLineLayout( line );
+	const String& strLine = mDoc->line( line ).getText();
+	Float visibleLeft = mScreenPos.x;
+	Float visibleRight = mScreenPos.x + mSize.getWidth();
+	Float lineOffset = getLineOffset();
+	Primitives primitives;
+	FontStyleConfig fontStyle( mFontStyleConfig );
+	fontStyle.CharacterSize = fontSize;
+	bool isFallbackFont = false;
+	bool isEmojiFallbackFont = false;
+	if ( mDoc->mightBeBinary() && mFont->getType() == FontType::TTF ) {
+		FontTrueType* ttf = static_cast<FontTrueType*>( mFont );
+		isFallbackFont = ttf->isFallbackFontEnabled();
+		isEmojiFallbackFont = ttf->isEmojiFallbackEnabled();
+		ttf->setEnableFallbackFont( false );
+		ttf->setEnableEmojiFallback( false );
+	}
+
+	size_t segment = eemax<Int64>(
+		0, std::upper_bound( layout.segmentX.begin(), layout.segmentX.end(),
+							 visibleLeft - position.x ) -
+			   layout.segmentX.begin() - 1 );
+
+	for ( ; segment + 1 < layout.segmentX.size() &&
+			position.x + layout.segmentX[segment] <= visibleRight;
+		  segment++ ) {
+		Float x = position.x + layout.segmentX[segment];
+		auto tokens = mDoc->getHighlighter()->getLongLineSegment( line, segment );
+		for ( const auto& token : tokens ) {
+			String::View text( strLine.view().substr( token.pos, token.len ) );
+			Float textWidth = getTextWidth( text );
+			if ( x > visibleRight )
+				break;
+			if ( x + textWidth >= visibleLeft ) {
+				const SyntaxColorScheme::Style& style = mColorScheme.getSyntaxStyle( token.type );
+				fontStyle.Style = style.style;
+				fontStyle.FontColor = Color( style.color ).blendAlpha( mAlpha );
+				fontStyle.OutlineThickness = style.outlineThickness;
+				if ( fontStyle.OutlineThickness )
+					fontStyle.OutlineColor = style.outlineColor;
+				if ( style.background != Color::Transparent ) {
+					primitives.setColor( Color( style.background ).blendAlpha( mAlpha ) );
+					primitives.drawRectangle(
+						Rectf( { x, position.y }, Sizef( textWidth, lineHeight ) ) );
+				}
+				Text::draw( text, { x, position.y + lineOffset }, fontStyle, mTabWidth );
+			}
+			x += textWidth;
+		}
+	}
+
+	if ( mDoc->mightBeBinary() && mFont->getType() == FontType::TTF ) {
+		FontTrueType* ttf = static_cast<FontTrueType*>( mFont );
+		ttf->setEnableFallbackFont( isFallbackFont );
+		ttf->setEnableEmojiFallback( isEmojiFallbackFont );
+	}
+}
+
+void UICodeEditor::drawWrappedLineText( const Int64& line, Vector2f position,
+										const Float& fontSize, const Float& lineHeight ) {
+	auto& tokens = mDoc->getHighlighter()->getLine( line );
+	const String& strLine = mDoc->line( line ).getText();
+	const auto& breaks = mLineWrap.getLineBreaks( line );
+	Primitives primitives;
+	Float lineOffset = getLineOffset();
+	Float startX = position.x;
+	Float visibleBottom = mScreenPos.y + mSize.getHeight();
+	Int64 len = strLine.size();
+	Int64 pos = 0;
+	size_t nextBreak = 0;
+	FontStyleConfig fontStyle( mFontStyleConfig );
+	fontStyle.CharacterSize = fontSize;
+
+	for ( const auto& token : tokens ) {
+		const SyntaxColorScheme::Style& style = mColorScheme.getSyntaxStyle( token.type );
+		fontStyle.Style = style.style;
+		fontStyle.FontColor = Color( style.color ).blendAlpha( mAlpha );
+		fontStyle.OutlineThickness = style.outlineThickness;
+		if ( fontStyle.OutlineThickness )
+			fontStyle.OutlineColor = style.outlineColor;
+
+		// A token crossing a break is drawn in one piece per visual line
+		Int64 tokenEnd = eemin<Int64>( pos + token.len, len );
+		while ( pos < tokenEnd ) {
+			if ( nextBreak < breaks.size() && pos == breaks[nextBreak] ) {
+				position = { startX, position.y + lineHeight };
+				nextBreak++;
+			}
+
+			Int64 end = nextBreak < breaks.size() ? eemin( tokenEnd, breaks[nextBreak] ) : tokenEnd;
+			String::View text( strLine.view().substr( pos, end - pos ) );
+			Float textWidth = getTextWidth( text );
+
+			if ( position.y + lineHeight >= mScreenPos.y && position.y <= visibleBottom ) {
+				if ( style.background != Color::Transparent ) {
+					primitives.setColor( Color( style.background ).blendAlpha( mAlpha ) );
+					primitives.drawRectangle( Rectf( position, Sizef( textWidth, lineHeight ) ) );
+				}
+				Text::draw( text, { position.x, position.y + lineOffset }, fontStyle, mTabWidth );
+			}
+
+			position.x += textWidth;
+			pos = end;
+		}
+
+		if ( position.y > visibleBottom )
+			break;
+	}
+}
+
 void UICodeEditor::drawTextRange( const TextRange& range, const std::pair<int, int>& lineRange,
 								  const Vector2f& startScroll, const Float& lineHeight,
 								  const Color& backgroundColor ) {
@@ -3162,29 +3650,47 @@ void UICodeEditor::drawTextRange( const TextRange& range, const std::pair<int, i
 
 	for ( auto ln = startLine; ln <= endLine; ln++ ) {
 		const String& line = mDoc->line( ln ).getText();
+		Int64 startCol = range.start().line() == ln ? range.start().column() : 0;
+		Int64 endCol = range.end().line() == ln ? range.end().column()
+												: static_cast<Int64>( line.length() );
+		drawLineColumnsRange( primitives, ln, startCol, endCol, startScroll, lineHeight );
+	}
+	primitives.setForceDraw( true );
+}
+
+void UICodeEditor::drawLineColumnsRange( Primitives& primitives, const Int64& line,
+										 Int64 startCol, Int64 endCol, const Vector2f& startScroll,
+										 const Float& lineHeight ) {
+	if ( !isLineWrapActive() ) {
 		Rectf selRect;
-		selRect.Top = startScroll.y + ln * lineHeight;
+		selRect.Top = startScroll.y + line * lineHeight;
 		selRect.Bottom = selRect.Top + lineHeight;
-		if ( range.start().line() == ln ) {
-			selRect.Left = startScroll.x + getXOffsetCol( { ln, range.start().column() } );
-			if ( range.end().line() == ln ) {
-				selRect.Right = startScroll.x + getXOffsetCol( { ln, range.end().column() } );
-			} else {
-				selRect.Right =
-					startScroll.x + getXOffsetCol( { ln, static_cast<Int64>( line.length() ) } );
-			}
-		} else if ( range.end().line() == ln ) {
-			selRect.Left = startScroll.x + getXOffsetCol( { ln, 0 } );
-			selRect.Right = startScroll.x + getXOffsetCol( { ln, range.end().column() } );
-		} else {
-			selRect.Left = startScroll.x + getXOffsetCol( { ln, 0 } );
-			selRect.Right =
-				startScroll.x + getXOffsetCol( { ln, static_cast<Int64>( line.length() ) } );
-		}
-
+		selRect.Left = startScroll.x + getXOffsetCol( { line, startCol } );
+		selRect.Right = startScroll.x + getXOffsetCol( { line, endCol } );
 		primitives.drawRectangle( selRect );
+		return;
+	}
+
+	// Draws one rectangle for each visual line covered by the columns range
+	const auto& breaks = mLineWrap.getLineBreaks( line );
+	Int64 visualLine = mLineWrap.getVisualLine( line );
+	Int64 segmentStart = 0;
+	for ( size_t i = 0; i <= breaks.size(); i++, visualLine++ ) {
+		Int64 segmentEnd = i < breaks.size() ? breaks[i] : std::numeric_limits<Int64>::max();
+		if ( startCol <= segmentEnd && endCol >= segmentStart &&
+			 ( startCol < segmentEnd || i == breaks.size() ) ) {
+			Float segmentX = startScroll.x - getXOffsetCol( { line, segmentStart } );
+			Rectf selRect;
+			selRect.Top = startScroll.y + visualLine * lineHeight;
+			selRect.Bottom = selRect.Top + lineHeight;
+			selRect.Left = segmentX + getXOffsetCol( { line, eemax( startCol, segmentStart ) } );
+			selRect.Right = segmentX + getXOffsetCol( { line, eemin( endCol, segmentEnd ) } );
+			primitives.drawRectangle( selRect );
+		}
+		if ( endCol <= segmentEnd )
+			break;
+		segmentStart = segmentEnd;
 	}
-	primitives.setForceDraw( true );
 }
 
 void UICodeEditor::drawLineNumbers( const std::pair<int, int>& lineRange,
@@ -3197,7 +3703,10 @@ void UICodeEditor::drawLineNumbers( const std::pair<int, int>& lineRange,
 	TextRange selection = mDoc->getSelection( true );
 	Float lineOffset = getLineOffset();
 
+	bool lineWrap = isLineWrapActive();
+
 	for ( int i = lineRange.first; i <= lineRange.second; i++ ) {
+		Int64 visualLine = lineWrap ? mLineWrap.getVisualLine( (Int64)i ) : i;
 		String pos;
 		if ( mShowLinesRelativePosition && selection.start().line() != i ) {
 			pos = String( String::toString( eeabs( i - selection.start().line() ) ) )
@@ -3207,7 +3716,7 @@ void UICodeEditor::drawLineNumbers( const std::pair<int, int>& lineRange,
 		}
 		Text::draw( pos,
 					Vector2f( screenStart.x + mLineNumberPaddingLeft,
-							  startScroll.y + lineHeight * (double)i + lineOffset ),
+							  startScroll.y + lineHeight * (double)visualLine + lineOffset ),
 					mFontStyleConfig.Font, fontSize,
 					( i >= selection.start().line() && i <= selection.end().line() )
 						? mLineNumberActiveFontColor
@@ -3221,12 +3730,12 @@ void UICodeEditor::drawLineNumbers( const std::pair<int, int>& lineRange,
 void UICodeEditor::drawColorPreview( const Vector2f& startScroll, const Float& lineHeight ) {
 	Primitives primitives;
 	primitives.setColor( mPreviewColor );
-	Float startX = getXOffsetCol( mPreviewColorRange.start() );
-	Float endX = getXOffsetCol( mPreviewColorRange.end() );
+	Vector2f start( getTextPositionOffset( mPreviewColorRange.start() ) );
+	Float endX = start.x + getXOffsetCol( mPreviewColorRange.end() ) -
+				 getXOffsetCol( mPreviewColorRange.start() );
 	primitives.drawRectangle( Rectf(
-		Vector2f( startScroll.x + mScroll.x + startX,
-				  startScroll.y + mPreviewColorRange.start().line() * lineHeight + lineHeight ),
-		Sizef( endX - startX, lineHeight * 2 ) ) );
+		Vector2f( startScroll.x + mScroll.x + start.x, startScroll.y + start.y + lineHeight ),
+		Sizef( endX - start.x, lineHeight * 2 ) ) );
 }
 
 void UICodeEditor::drawWhitespaces( const std::pair<int, int>& lineRange,
@@ -3243,10 +3752,29 @@ void UICodeEditor::drawWhitespaces( const std::pair<int, int>& lineRange,
 	cpoint->setDrawMode( GlyphDrawable::DrawMode::Text );
 	adv->setColor( color );
 	cpoint->setColor( color );
+	bool lineWrap = isLineWrapActive();
 	for ( int index = lineRange.first; index <= lineRange.second; index++ ) {
-		Vector2f position( { startScroll.x, startScroll.y + lineHeight * index } );
+		Int64 visualLine = lineWrap ? mLineWrap.getVisualLine( (Int64)index ) : index;
+		Vector2f position( { startScroll.x, startScroll.y + lineHeight * visualLine } );
 		const auto& text = mDoc->line( index ).getText();
-		for ( size_t i = 0; i < text.size(); i++ ) {
+		const auto& breaks = mLineWrap.getLineBreaks( lineWrap ? index : -1 );
+		size_t nextBreak = 0;
+		size_t i = 0;
+		if ( !lineWrap && isLongLine( index ) ) {
+			// Start from the first visible segment
+			const LongLineLayout& layout = getLongLineLayout( index );
+			size_t segment = eemax<Int64>(
+				0, std::upper_bound( layout.segmentX.begin(), layout.segmentX.end(), mScroll.x ) -
+					   layout.segmentX.begin() - 1 );
+			segment = eemin( segment, layout.segmentX.size() - 1 );
+			i = segment * layout.segmentLength;
+			position.x += layout.segmentX[segment];
+		}
+		for ( ; i < text.size(); i++ ) {
+			if ( nextBreak < breaks.size() && (Int64)i == breaks[nextBreak] ) {
+				position = { startScroll.x, position.y + lineHeight };
+				nextBreak++;
+			}
 			if ( position.x + mScroll.x + ( text[i] == '\t' ? tabWidth : glyphW ) >= mScreenPos.x &&
 				 position.x <= mScreenPos.x + mScroll.x + mSize.getWidth() ) {
 				if ( ' ' == text[i] ) {
@@ -3300,8 +3828,10 @@ void UICodeEditor::drawIndentationGuides( const std::pair<int, int>& lineRange,
 	int indentSize = mDoc->getIndentType() == TextDocument::IndentType::IndentTabs
 						 ? getTabWidth()
 						 : mDoc->getIndentWidth();
+	bool lineWrap = isLineWrapActive();
 	for ( int index = lineRange.first; index <= lineRange.second; index++ ) {
-		Vector2f position( { startScroll.x, startScroll.y + lineHeight * index } );
+		Int64 visualLine = lineWrap ? mLineWrap.getVisualLine( (Int64)index ) : index;
+		Vector2f position( { startScroll.x, startScroll.y + lineHeight * visualLine } );
 		int spaces = getLineIndentGuideSpaces( *mDoc.get(), index, indentSize );
 		for ( int i = 0; i < spaces; i += indentSize )
 			p.drawRectangle( Rectf( { position.x + spaceW * i, position.y }, { w, lineHeight } ) );
@@ -3318,9 +3848,16 @@ void UICodeEditor::drawLineEndings( const std::pair<int, int>& lineRange,
 		nl = mFont->getGlyphDrawable( 172 /* '¬'*/, fontSize );
 	nl->setDrawMode( GlyphDrawable::DrawMode::Text );
 	nl->setColor( color );
+	bool lineWrap = isLineWrapActive();
 	for ( int index = lineRange.first; index <= lineRange.second; index++ ) {
-		Vector2f position( { startScroll.x + getLineWidth( index ) - getGlyphWidth(),
-							 startScroll.y + lineHeight * index } );
+		Vector2f position;
+		if ( lineWrap ) {
+			Int64 lineEnd = eemax<Int64>( 0, mDoc->line( index ).size() - 1 );
+			position = startScroll + getTextPositionOffset( { index, lineEnd } );
+		} else {
+			position = { startScroll.x + getLineWidth( index ) - getGlyphWidth(),
+						 startScroll.y + lineHeight * index };
+		}
 		nl->draw( Vector2f( position.x, position.y ) );
 	}
 }
@@ -3580,33 +4117,9 @@ void UICodeEditor::drawMinimap( const Vector2f& start,
 	Float gutterWidth = PixelDensity::dpToPx( mMinimapConfig.gutterWidth );
 	Float lineY = rect.Top;
 
-	const auto* batchSyntaxType = &SYNTAX_NORMAL;
-	Color color = mColorScheme.getSyntaxStyle( *batchSyntaxType ).color;
-	color.a *= 0.5f;
-	Float batchWidth = 0;
-	Float batchStart = rect.Left;
+	Float batchStart = rect.Left + gutterWidth;
 	Float minimapCutoffX = rect.Left + rect.getWidth();
 	Float widthScale = charSpacing / getGlyphWidth();
-	auto flushBatch = [this, &color, &batchSyntaxType, &batchStart, &batchWidth, &lineY, &BR,
-					   &charHeight]( const SyntaxStyleType& type ) {
-		Color oldColor = color;
-		color = mColorScheme.getSyntaxStyle( *batchSyntaxType ).color;
-		if ( mMinimapConfig.syntaxHighlight && color != Color::Transparent ) {
-			color.a *= 0.5f;
-		} else {
-			color = oldColor;
-		}
-
-		if ( batchWidth > 0 ) {
-			BR->quadsSetColor( color.blendAlpha( mAlpha ) );
-			BR->batchQuad( { { batchStart, lineY }, { batchWidth, charHeight } } );
-		}
-
-		batchSyntaxType = &type;
-		batchStart += batchWidth;
-		batchWidth = 0;
-	};
-
 	int endidx = minimapStartLine + maxMinmapLines;
 	endidx = eemin( endidx, lineCount - 1 );
 
@@ -3726,138 +4239,293 @@ void UICodeEditor::drawMinimap( const Vector2f& start,
 		drawWordRanges( mHighlightWordCache );
 	}
 
-	if ( mMinimapConfig.syntaxHighlight ) {
+	if ( !mPlugins.empty() ) {
+		lineY = rect.Top;
 		for ( int index = minimapStartLine; index <= endidx; index++ ) {
-			batchSyntaxType = &SYNTAX_NORMAL;
-			batchStart = rect.Left + gutterWidth;
-			batchWidth = 0;
-
-			if ( mHighlightWord.isEmpty() && !selectionString.empty() )
-				drawWordMatch( selectionString, index );
-
 			for ( auto* plugin : mPlugins )
 				plugin->minimapDrawBeforeLineText( this, index, { rect.Left, lineY },
 												   { rect.getWidth(), charHeight }, charSpacing,
 												   gutterWidth );
+			lineY += lineSpacing;
+		}
+	}
 
-			const auto& tokens = mDoc->getHighlighter()->getLine( index, false );
-			const auto& text = mDoc->line( index ).getText();
-			size_t txtPos = 0;
-
-			for ( const auto& token : tokens ) {
-				if ( *batchSyntaxType != token.type ) {
-					flushBatch( *batchSyntaxType );
-					batchSyntaxType = &token.type;
-				}
-
-				size_t pos = txtPos;
-				size_t end = pos + token.len <= text.size() ? txtPos + token.len : text.size();
-
-				while ( pos < end ) {
-					String::StringBaseType ch = text[pos];
-					if ( ch == ' ' || ch == '\n' ) {
-						flushBatch( token.type );
-						batchStart += charSpacing;
-					} else if ( ch == '\t' ) {
-						flushBatch( token.type );
-						batchStart += charSpacing * mMinimapConfig.tabWidth;
-					} else if ( batchStart + batchWidth > minimapCutoffX ) {
-						flushBatch( token.type );
-						break;
-					} else {
-						batchWidth += charSpacing;
-					}
-					pos++;
-				};
+	if ( mHighlightWord.isEmpty() && !selectionString.empty() ) {
+		lineY = rect.Top;
+		for ( int index = minimapStartLine; index <= endidx; index++ ) {
+			drawWordMatch( selectionString, index );
+			lineY += lineSpacing;
+		}
+	}
 
-				txtPos += token.len;
-			}
+	MinimapTileConfig tileConfig;
+	tileConfig.width = eeceil( rect.getWidth() - gutterWidth );
+	tileConfig.charHeight = eemax( 1, (int)eeceil( charHeight ) );
+	tileConfig.charSpacing = charSpacing;
+	tileConfig.lineSpacing = lineSpacing;
+	tileConfig.tabWidth = mMinimapConfig.tabWidth;
+	tileConfig.syntaxHighlight = mMinimapConfig.syntaxHighlight;
+	drawMinimapTiles( { minimapStart, rect.Top }, tileConfig, minimapStartLine, endidx );
 
-			flushBatch( SYNTAX_NORMAL );
+	BR->setTexture( nullptr );
+	BR->setBlendMode( BlendMode::Alpha() );
+	BR->quadsBegin();
 
+	if ( !mPlugins.empty() ) {
+		lineY = rect.Top;
+		for ( int index = minimapStartLine; index <= endidx; index++ ) {
 			for ( auto* plugin : mPlugins )
 				plugin->minimapDrawAfterLineText( this, index, { rect.Left, lineY },
 												  { rect.getWidth(), charHeight }, charSpacing,
 												  gutterWidth );
+			lineY += lineSpacing;
+		}
+	}
 
-			if ( mHighlightTextRange.isValid() && mHighlightTextRange.hasSelection() ) {
-				drawTextRange( mHighlightTextRange, index,
-							   Color( mMinimapSelectionColor ).blendAlpha( mAlpha ) );
-			}
+	auto drawVisibleTextRange = [&]( const TextRange& range, const Color& backgroundColor ) {
+		Int64 from = eemax<Int64>( range.start().line(), minimapStartLine );
+		Int64 to = eemin<Int64>( range.end().line(), endidx );
+		for ( Int64 index = from; index <= to; index++ ) {
+			lineY = rect.Top + ( index - minimapStartLine ) * lineSpacing;
+			drawTextRange( range, index, backgroundColor );
+		}
+	};
 
-			if ( mDoc->hasSelection() ) {
-				Color selectionColor( Color( mMinimapSelectionColor ).blendAlpha( mAlpha ) );
-				auto selections = mDoc->getSelectionsSorted();
-				for ( const auto& sel : selections ) {
-					drawTextRange( sel, index, selectionColor );
-				}
-			}
+	if ( mHighlightTextRange.isValid() && mHighlightTextRange.hasSelection() ) {
+		drawVisibleTextRange( mHighlightTextRange.normalized(),
+							  Color( mMinimapSelectionColor ).blendAlpha( mAlpha ) );
+	}
 
-			lineY = lineY + lineSpacing;
-		}
-	} else {
-		for ( int index = minimapStartLine; index <= endidx; index++ ) {
-			batchSyntaxType = &SYNTAX_NORMAL;
-			batchStart = rect.Left + gutterWidth;
-			batchWidth = 0;
+	if ( mDoc->hasSelection() ) {
+		Color selectionColor( Color( mMinimapSelectionColor ).blendAlpha( mAlpha ) );
+		auto selections = mDoc->getSelectionsSorted();
+		for ( const auto& sel : selections )
+			drawVisibleTextRange( sel.normalized(), selectionColor );
+	}
 
-			for ( auto* plugin : mPlugins )
-				plugin->minimapDrawBeforeLineText( this, index, { rect.Left, lineY },
-												   { rect.getWidth(), charHeight }, charSpacing,
-												   gutterWidth );
+	for ( size_t i = 0; i < mDoc->getSelections().size(); ++i ) {
+		Float selectionY =
+			rect.Top +
+			( mDoc->getSelectionIndex( i ).start().line() - minimapStartLine ) * lineSpacing;
+		BR->quadsSetColor( Color( mMinimapCurrentLineColor ).blendAlpha( mAlpha ) );
+		BR->batchQuad( { { rect.Left, selectionY }, { rect.getWidth(), lineSpacing } } );
+	}
+
+	BR->draw();
+}
 
-			if ( mHighlightWord.isEmpty() && !selectionString.empty() )
-				drawWordMatch( selectionString, index );
-
-			const String& text( mDoc->line( index ).getText() );
-			for ( size_t i = 0; i < text.size(); ++i ) {
-				String::StringBaseType ch = text[i];
-				if ( ch == ' ' || ch == '\n' ) {
-					flushBatch( SYNTAX_NORMAL );
-					batchStart += charSpacing;
-				} else if ( ch == '\t' ) {
-					flushBatch( SYNTAX_NORMAL );
-					batchStart += charSpacing * mMinimapConfig.tabWidth;
-				} else if ( batchStart + batchWidth > minimapCutoffX ) {
-					flushBatch( SYNTAX_NORMAL );
-					break;
+// Lines rasterized per minimap tile
+static constexpr Int64 MINIMAP_TILE_LINES = 128;
+
+// Tiles kept alive out of the visible minimap area
+static constexpr size_t MINIMAP_MAX_TILES = 32;
+
+struct MinimapTileLine {
+	String text;
+	std::vector<std::pair<SyntaxTokenLen, Color>> runs;
+};
+
+static void rasterizeMinimapTile( const std::vector<MinimapTileLine>& lines,
+								  std::vector<Uint8>& pixels, int width, int height, int charHeight,
+								  int charSpacing, int lineSpacing, int tabWidth ) {
+	pixels.assign( (size_t)width * height * 4, 0 );
+	auto fill = [&]( int x, int y, const Color& color ) {
+		for ( int py = y; py < y + charHeight && py < height; py++ ) {
+			Uint8* row = &pixels[( (size_t)py * width ) * 4];
+			for ( int px = x; px < x + charSpacing && px < width; px++ ) {
+				Uint8* pixel = &row[px * 4];
+				pixel[0] = color.r;
+				pixel[1] = color.g;
+				pixel[2] = color.b;
+				pixel[3] = color.a;
+			}
+		}
+	};
+
+	for ( size_t l = 0; l < lines.size(); l++ ) {
+		const MinimapTileLine& line = lines[l];
+		int y = l * lineSpacing;
+		int x = 0;
+		size_t pos = 0;
+		for ( const auto& run : line.runs ) {
+			size_t end = eemin<size_t>( pos + run.first, line.text.size() );
+			for ( ; pos < end && x < width; pos++ ) {
+				String::StringBaseType ch = line.text[pos];
+				if ( ch == '\t' ) {
+					x += charSpacing * tabWidth;
 				} else {
-					batchWidth += charSpacing;
+					if ( ch != ' ' && ch != '\n' )
+						fill( x, y, run.second );
+					x += charSpacing;
 				}
 			}
-			flushBatch( SYNTAX_NORMAL );
+			if ( x >= width )
+				break;
+		}
+	}
+}
 
-			for ( auto* plugin : mPlugins )
-				plugin->minimapDrawAfterLineText( this, index, { rect.Left, lineY },
-												  { rect.getWidth(), charHeight }, charSpacing,
-												  gutterWidth );
+void UICodeEditor::invalidateMinimapTiles() {
+	mMinimapTilesGeneration++;
+	for ( auto& tile : mMinimapTiles ) {
+		if ( tile.second.texture )
+			TextureFactory::instance()->remove( tile.second.texture );
+	}
+	mMinimapTiles.clear();
+}
 
-			if ( mHighlightTextRange.isValid() && mHighlightTextRange.hasSelection() ) {
-				drawTextRange( mHighlightTextRange, index,
-							   Color( mMinimapSelectionColor ).blendAlpha( mAlpha ) );
+void UICodeEditor::invalidateMinimapTiles( const Int64& fromLine, bool linesMoved ) {
+	// A changed line can also change the tokenization of the lines after it, those tiles are
+	// rebuilt once the highlighter is done with them
+	Int64 tileIndex = fromLine / MINIMAP_TILE_LINES;
+	for ( auto& tile : mMinimapTiles ) {
+		if ( tile.first == tileIndex || ( linesMoved && tile.first > tileIndex ) ) {
+			tile.second.dirty = true;
+			tile.second.version++;
+		} else if ( tile.first > tileIndex ) {
+			tile.second.provisional = true;
+		}
+	}
+}
+
+void UICodeEditor::updateMinimapTile( const Int64& tileIndex, MinimapTile& tile ) {
+	Int64 from = tileIndex * MINIMAP_TILE_LINES;
+	Int64 to = eemin<Int64>( from + MINIMAP_TILE_LINES, mDoc->linesCount() );
+	MinimapTileConfig config( mMinimapTileConfig );
+	size_t maxChars = config.width / eemax( 1, config.charSpacing ) + 1;
+	auto* highlighter = mDoc->getHighlighter();
+	Color normalColor( mColorScheme.getSyntaxStyle( SYNTAX_NORMAL ).color );
+	normalColor.a *= 0.5f;
+
+	std::vector<MinimapTileLine> lines( eemax<Int64>( 0, to - from ) );
+	for ( Int64 index = from; index < to; index++ ) {
+		MinimapTileLine& line = lines[index - from];
+		const String& text = mDoc->line( index ).getText();
+		line.text = text.substr( 0, maxChars );
+		if ( !config.syntaxHighlight ) {
+			line.runs.emplace_back( line.text.size(), normalColor );
+			continue;
+		}
+		Color color( normalColor );
+		size_t len = 0;
+		for ( const auto& token : highlighter->getLine( index, false ) ) {
+			Color tokenColor( mColorScheme.getSyntaxStyle( token.type ).color );
+			if ( tokenColor != Color::Transparent ) {
+				color = tokenColor;
+				color.a *= 0.5f;
 			}
+			line.runs.emplace_back( token.len, color );
+			len += token.len;
+			if ( len >= maxChars )
+				break;
+		}
+	}
 
-			if ( mDoc->hasSelection() ) {
-				Color selectionColor( Color( mMinimapSelectionColor ).blendAlpha( mAlpha ) );
-				auto selections = mDoc->getSelectionsSorted();
-				for ( const auto& sel : selections ) {
-					drawTextRange( sel, index, selectionColor );
+	Int64 firstInvalidLine = highlighter->getFirstInvalidLine();
+	tile.provisional = !mDoc->getSyntaxDefinition().getPatterns().empty() &&
+					   firstInvalidLine < to && firstInvalidLine <= highlighter->getMaxWantedLine();
+	tile.dirty = false;
+	tile.building = true;
+
+	Uint64 version = tile.version;
+	Uint64 generation = mMinimapTilesGeneration;
+	mMinimapTilesProcessing++;
+	getUISceneNode()->getThreadPool()->run( [this, tileIndex, version, generation, config,
+											 lines = std::move( lines )] {
+		int height = MINIMAP_TILE_LINES * config.lineSpacing;
+		std::vector<Uint8> pixels;
+		if ( generation == mMinimapTilesGeneration ) {
+			rasterizeMinimapTile( lines, pixels, config.width, height, config.charHeight,
+								  config.charSpacing, config.lineSpacing, config.tabWidth );
+		}
+
+		if ( generation == mMinimapTilesGeneration ) {
+			runOnMainThread( [this, tileIndex, version, generation, config, height,
+							  pixels = std::move( pixels )] {
+				auto found = mMinimapTiles.find( tileIndex );
+				if ( generation != mMinimapTilesGeneration || found == mMinimapTiles.end() )
+					return;
+				MinimapTile& tile = found->second;
+				tile.building = false;
+				// Outdated tiles are scheduled again on the next draw
+				if ( tile.version == version ) {
+					if ( tile.texture && tile.texture->getWidth() == (Uint32)config.width &&
+						 tile.texture->getHeight() == (Uint32)height ) {
+						tile.texture->update( pixels.data() );
+					} else {
+						if ( tile.texture )
+							TextureFactory::instance()->remove( tile.texture );
+						tile.texture = TextureFactory::instance()->loadFromPixels(
+							pixels.data(), config.width, height, 4 );
+					}
 				}
-			}
+				invalidateDraw();
+			} );
+		}
+
+		mMinimapTilesProcessing--;
+	} );
+}
+
+void UICodeEditor::drawMinimapTiles( const Vector2f& start, const MinimapTileConfig& config,
+									 const Int64& startLine, const Int64& endLine ) {
+	if ( config.width <= 0 || endLine < startLine )
+		return;
 
-			lineY = lineY + lineSpacing;
+	if ( !( config == mMinimapTileConfig ) ) {
+		invalidateMinimapTiles();
+		mMinimapTileConfig = config;
+	}
+
+	auto* highlighter = mDoc->getHighlighter();
+	Int64 firstTile = startLine / MINIMAP_TILE_LINES;
+	Int64 lastTile = endLine / MINIMAP_TILE_LINES;
+	for ( Int64 tileIndex = firstTile; tileIndex <= lastTile; tileIndex++ ) {
+		MinimapTile& tile = mMinimapTiles[tileIndex];
+		if ( tile.provisional && !tile.dirty ) {
+			Int64 firstInvalidLine = highlighter->getFirstInvalidLine();
+			if ( firstInvalidLine >= ( tileIndex + 1 ) * MINIMAP_TILE_LINES ||
+				 firstInvalidLine > highlighter->getMaxWantedLine() ) {
+				tile.dirty = true;
+				tile.version++;
+			}
 		}
+		if ( tile.dirty && !tile.building )
+			updateMinimapTile( tileIndex, tile );
 	}
 
-	for ( size_t i = 0; i < mDoc->getSelections().size(); ++i ) {
-		Float selectionY =
-			rect.Top +
-			( mDoc->getSelectionIndex( i ).start().line() - minimapStartLine ) * lineSpacing;
-		BR->quadsSetColor( Color( mMinimapCurrentLineColor ).blendAlpha( mAlpha ) );
-		BR->batchQuad( { { rect.Left, selectionY }, { rect.getWidth(), lineSpacing } } );
+	BatchRenderer* BR = GlobalBatchRenderer::instance();
+	BR->setBlendMode( BlendMode::Alpha() );
+	for ( Int64 tileIndex = firstTile; tileIndex <= lastTile; tileIndex++ ) {
+		auto found = mMinimapTiles.find( tileIndex );
+		if ( found == mMinimapTiles.end() || !found->second.texture )
+			continue;
+		Texture* texture = found->second.texture;
+		Int64 tileStart = tileIndex * MINIMAP_TILE_LINES;
+		Int64 from = eemax( tileStart, startLine );
+		Int64 to = eemin( tileStart + MINIMAP_TILE_LINES - 1, endLine );
+		Float srcTop = ( from - tileStart ) * config.lineSpacing;
+		Float srcBottom = ( to + 1 - tileStart ) * config.lineSpacing;
+		BR->setTexture( texture, Texture::CoordinateType::Pixels );
+		BR->quadsBegin();
+		BR->quadsSetColor( Color( Color::White ).blendAlpha( mAlpha ) );
+		BR->quadsSetTexCoord( 0, srcTop, config.width, srcBottom );
+		BR->batchQuad( start.x, start.y + ( from - startLine ) * config.lineSpacing, config.width,
+					   srcBottom - srcTop );
+	}
+	BR->drawOpt();
+
+	if ( mMinimapTiles.size() > MINIMAP_MAX_TILES ) {
+		for ( auto it = mMinimapTiles.begin(); it != mMinimapTiles.end(); ) {
+			if ( it->first < firstTile - 1 || it->first > lastTile + 1 ) {
+				if ( it->second.texture )
+					TextureFactory::instance()->remove( it->second.texture );
+				it = mMinimapTiles.erase( it );
+			} else {
+				++it;
+			}
+		}
 	}
-
-	BR->draw();
 }
 
 Vector2f UICodeEditor::getScreenStart() const {
@@ -4008,6 +4676,177 @@ void UICodeEditor::invalidateLinesCache() {
 	}
 }
 
+void UICodeEditor::invalidateGlyphRunCache() {
+	mGlyphRunCache.clear();
+	mGlyphRunCacheLRU.clear();
+}
+
+const UICodeEditor::LineGlyphRun& UICodeEditor::getLineGlyphRun( const Int64& line,
+																 const Float& fontSize ) {
+	if ( mGlyphRunCacheFont != mFont || mGlyphRunCacheFontSize != fontSize ||
+		 mGlyphRunCacheTabWidth != mTabWidth ) {
+		invalidateGlyphRunCache();
+		mGlyphRunCacheFont = mFont;
+		mGlyphRunCacheFontSize = fontSize;
+		mGlyphRunCacheTabWidth = mTabWidth;
+	}
+
+	auto& tokens = mDoc->getHighlighter()->getLine( line );
+	const String& text = mDoc->line( line ).getText();
+	String::HashType hash = mDoc->line( line ).getHash();
+	Uint64 signature = mDoc->getHighlighter()->getTokenizedLineSignature( line );
+	if ( signature == 0 )
+		signature = TokenizedLine::calcSignature( tokens );
+
+	size_t key = hashCombine( hash, signature );
+	auto found = mGlyphRunCache.find( key );
+	if ( found != mGlyphRunCache.end() && found->second.hash == hash &&
+		 found->second.signature == signature ) {
+		mGlyphRunCacheLRU.splice( mGlyphRunCacheLRU.begin(), mGlyphRunCacheLRU,
+								  found->second.lruIt );
+		return found->second;
+	}
+
+	LineGlyphRun run;
+	run.hash = hash;
+	run.signature = signature;
+
+	// Same layout than Text::draw being called once per token
+	bool isMonospace = mFont->isMonospace();
+	Float x = 0;
+	size_t pos = 0;
+	for ( const auto& token : tokens ) {
+		if ( pos >= text.size() )
+			break;
+		String::View tokenText( text.view().substr( pos, token.len ) );
+		pos += token.len;
+
+		const SyntaxColorScheme::Style& style = mColorScheme.getSyntaxStyle( token.type );
+		if ( ( style.style & ( Text::Underlined | Text::StrikeThrough | Text::Shadow ) ) ||
+			 style.outlineThickness != 0.f ) {
+			run.cacheable = false;
+			run.quads.clear();
+			run.backgrounds.clear();
+			break;
+		}
+
+		bool isBold = ( style.style & Text::Bold ) != 0;
+		bool isItalic = ( style.style & Text::Italic ) != 0;
+		Float spaceAdvance = mFont->getGlyph( ' ', fontSize, isBold, isItalic ).advance;
+		String::StringBaseType prevChar = 0;
+		Float tokenX = x;
+
+		for ( size_t i = 0; i < tokenText.size(); ++i ) {
+			String::StringBaseType ch = tokenText[i];
+			if ( ch == '\r' || ch == '\n' )
+				continue;
+			if ( ch == '\t' || ch == ' ' ) {
+				tokenX += ch == '\t' ? spaceAdvance * mTabWidth : spaceAdvance;
+				prevChar = ch;
+				continue;
+			}
+
+			GlyphDrawable* gd = mFont->getGlyphDrawable( ch, fontSize, isBold, isItalic );
+			if ( gd ) {
+				const Rectf& src = gd->getSrcRect();
+				run.quads.push_back( { { tokenX + gd->getGlyphOffset().x, gd->getGlyphOffset().y },
+									   gd->getDestSize(),
+									   { src.Left, src.Top, src.Left + src.Right,
+										 src.Top + src.Bottom },
+									   style.color,
+									   isItalic && !gd->isItalic() } );
+				tokenX += gd->getAdvance();
+				if ( !isMonospace )
+					tokenX += mFont->getKerning( prevChar, ch, fontSize, isBold, isItalic );
+			}
+			prevChar = ch;
+		}
+
+		Float textWidth = isMonospace ? getTextWidth( tokenText ) : tokenX - x;
+		if ( style.background != Color::Transparent )
+			run.backgrounds.push_back( { x, textWidth, style.background } );
+		x += textWidth;
+	}
+
+	if ( found != mGlyphRunCache.end() ) {
+		// Hash collision, the entry is replaced
+		run.lruIt = found->second.lruIt;
+		mGlyphRunCacheLRU.splice( mGlyphRunCacheLRU.begin(), mGlyphRunCacheLRU, run.lruIt );
+		found->second = std::move( run );
+		return found->second;
+	}
+
+	while ( !mGlyphRunCacheLRU.empty() && mGlyphRunCache.size() >= mGlyphRunCacheMaxLines ) {
+		mGlyphRunCache.erase( mGlyphRunCacheLRU.back() );
+		mGlyphRunCacheLRU.pop_back();
+	}
+
+	mGlyphRunCacheLRU.push_front( key );
+	run.lruIt = mGlyphRunCacheLRU.begin();
+	auto& entry = mGlyphRunCache[key];
+	entry = std::move( run );
+	return entry;
+}
+
+bool UICodeEditor::drawLineGlyphRun( const Int64& line, const Vector2f& position,
+									 const Float& fontSize, const Float& lineHeight ) {
+	if ( mGlyphRunCacheMaxLines == 0 || mDoc->mightBeBinary() ||
+		 ( mHandShown && mLinkPosition.isValid() && mLinkPosition.start().line() == line ) )
+		return false;
+
+	const LineGlyphRun& run = getLineGlyphRun( line, fontSize );
+	if ( !run.cacheable )
+		return false;
+
+	if ( !run.backgrounds.empty() ) {
+		Primitives primitives;
+		for ( const auto& background : run.backgrounds ) {
+			primitives.setColor( Color( background.color ).blendAlpha( mAlpha ) );
+			primitives.drawRectangle( Rectf( { position.x + background.x, position.y },
+											 Sizef( background.width, lineHeight ) ) );
+		}
+	}
+
+	if ( run.quads.empty() )
+		return true;
+
+	// Only the glyphs inside the viewport are batched, glyphs are sorted by their x offset
+	Float left = mScreenPos.x - position.x - getGlyphWidth() * 4;
+	Float right = mScreenPos.x + mSize.getWidth() - position.x;
+	auto it = std::lower_bound(
+		run.quads.begin(), run.quads.end(), left,
+		[]( const GlyphQuad& quad, const Float& x ) { return quad.position.x < x; } );
+	if ( it == run.quads.end() )
+		return true;
+
+	Float y = position.y + getLineOffset();
+	BatchRenderer* BR = GlobalBatchRenderer::instance();
+	Texture* fontTexture = mFont->getTexture( fontSize );
+	BR->setBlendMode( BlendMode::Alpha() );
+	BR->quadsBegin();
+	BR->setTexture( fontTexture, fontTexture->getCoordinateType() );
+
+	for ( ; it != run.quads.end() && it->position.x <= right; ++it ) {
+		const GlyphQuad& quad = *it;
+		BR->quadsSetColor( Color( quad.color ).blendAlpha( mAlpha ) );
+		BR->quadsSetTexCoord( quad.texCoords.Left, quad.texCoords.Top, quad.texCoords.Right,
+							  quad.texCoords.Bottom );
+		Float qx = position.x + quad.position.x;
+		Float qy = y + quad.position.y;
+		if ( quad.fakeItalic ) {
+			Float italic = 0.208f * quad.size.getWidth(); // 12 degrees
+			BR->batchQuadFree( qx + italic, qy, qx, qy + quad.size.getHeight(),
+							   qx + quad.size.getWidth(), qy + quad.size.getHeight(),
+							   qx + quad.size.getWidth() + italic, qy );
+		} else {
+			BR->batchQuad( qx, qy, quad.size.getWidth(), quad.size.getHeight() );
+		}
+	}
+
+	BR->drawOpt();
+	return true;
+}
+
 bool UICodeEditor::stopMinimapDragging( const Vector2f& mousePos ) {
 	if ( mMinimapDragging ) {
 		mMinimapDragging = false;
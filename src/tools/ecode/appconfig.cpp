@@ -83,6 +83,7 @@ void AppConfig::load( const std::string& confPath, std::string& keybindingsPath,
 	editor.showWhiteSpaces = ini.getValueB( "editor", "show_white_spaces", true );
 	editor.showLineEndings = ini.getValueB( "editor", "show_line_endings", false );
 	editor.showIndentationGuides = ini.getValueB( "editor", "show_indentation_guides", false );
+	editor.lineWrap = ini.getValueB( "editor", "line_wrap", false );
 	editor.highlightMatchingBracket =
 		ini.getValueB( "editor", "highlight_matching_brackets", true );
 	editor.highlightCurrentLine = ini.getValueB( "editor", "highlight_current_line", true );
@@ -137,6 +138,9 @@ void AppConfig::load( const std::string& confPath, std::string& keybindingsPath,
 	editor.cursorBlinkingTime =
 		Time::fromString( ini.getValue( "editor", "cursor_blinking_time", "0.5s" ) );
 	editor.linesRelativePosition = ini.getValueB( "editor", "lines_relative_position", false );
+	editor.tokenizationCache = ini.getValueB( "editor", "tokenization_cache", false );
+	editor.persistUndoHistory = ini.getValueB( "editor", "persist_undo_history", false );
+	editor.undoMemoryLimitMb = eemax( 0, ini.getValueI( "editor", "undo_memory_limit_mb", 256 ) );
 
 	searchBarConfig.caseSensitive = ini.getValueB( "search_bar", "case_sensitive", false );
 	searchBarConfig.luaPattern = ini.getValueB( "search_bar", "lua_pattern", false );
@@ -160,6 +164,8 @@ void AppConfig::load( const std::string& confPath, std::string& keybindingsPath,
 	workspace.restoreLastSession = ini.getValueB( "workspace", "restore_last_session", false );
 	workspace.checkForUpdatesAtStartup =
 		ini.getValueB( "workspace", "check_for_updates_at_startup", true );
+	workspace.searchIndex = ini.getValueB( "workspace", "search_index", false );
+	workspace.symbolIndex = ini.getValueB( "workspace", "symbol_index", false );
 
 	std::map<std::string, bool> pluginsEnabled;
 	const auto& creators = pluginManager->getDefinitions();
@@ -217,6 +223,7 @@ void AppConfig::save( const std::vector<std::string>& recentFiles,
 	ini.setValueB( "editor", "show_line_numbers", editor.showLineNumbers );
 	ini.setValueB( "editor", "show_white_spaces", editor.showWhiteSpaces );
 	ini.setValueB( "editor", "show_indentation_guides", editor.showIndentationGuides );
+	ini.setValueB( "editor", "line_wrap", editor.lineWrap );
 	ini.setValueB( "editor", "show_line_endings", editor.showLineEndings );
 	ini.setValueB( "editor", "highlight_matching_brackets", editor.highlightMatchingBracket );
 	ini.setValueB( "editor", "highlight_current_line", editor.highlightCurrentLine );
@@ -259,6 +266,9 @@ void AppConfig::save( const std::vector<std::string>& recentFiles,
 	ini.setValue( "editor", "line_spacing", editor.lineSpacing.toString() );
 	ini.setValue( "editor", "cursor_blinking_time", editor.cursorBlinkingTime.toString() );
 	ini.setValueB( "editor", "lines_relative_position", editor.linesRelativePosition );
+	ini.setValueB( "editor", "tokenization_cache", editor.tokenizationCache );
+	ini.setValueB( "editor", "persist_undo_history", editor.persistUndoHistory );
+	ini.setValueI( "editor", "undo_memory_limit_mb", editor.undoMemoryLimitMb );
 
 	ini.setValueB( "search_bar", "case_sensitive", searchBarConfig.caseSensitive );
 	ini.setValueB( "search_bar", "lua_pattern", searchBarConfig.luaPattern );
@@ -286,6 +296,8 @@ void AppConfig::save( const std::vector<std::string>& recentFiles,
 	ini.setValueB( "workspace", "restore_last_session", workspace.restoreLastSession );
 	ini.setValueB( "workspace", "check_for_updates_at_startup",
 				   workspace.checkForUpdatesAtStartup );
+	ini.setValueB( "workspace", "search_index", workspace.searchIndex );
+	ini.setValueB( "workspace", "symbol_index", workspace.symbolIndex );
 
 	const auto& pluginsEnabled = pluginManager->getPluginsEnabled();
 	for ( const auto& plugin : pluginsEnabled )
@@ -60,6 +60,7 @@ struct CodeEditorConfig {
 	bool showWhiteSpaces{ true };
 	bool showLineEndings{ false };
 	bool showIndentationGuides{ false };
+	bool lineWrap{ false };
 	bool highlightMatchingBracket{ true };
 	bool verticalScrollbar{ true };
 	bool horizontalScrollbar{ true };
@@ -74,6 +75,9 @@ struct CodeEditorConfig {
 	bool syncProjectTreeWithEditor{ true };
 	bool autoCloseXMLTags{ true };
 	bool linesRelativePosition{ false };
+	bool tokenizationCache{ false };
+	bool persistUndoHistory{ false };
+	int undoMemoryLimitMb{ 256 };
 	std::string autoCloseBrackets{ "" };
 	Time cursorBlinkingTime{ Seconds( 0.5f ) };
 };
@@ -155,6 +159,8 @@ struct TerminalConfig {
 struct WorkspaceConfig {
 	bool restoreLastSession{ false };
 	bool checkForUpdatesAtStartup{ true };
+	bool searchIndex{ false };
+	bool symbolIndex{ false };
 };
 
 struct LanguagesExtensions {
@@ -14,6 +14,7 @@
 #include "version.hpp"
 #include <algorithm>
 #include <args/args.hxx>
+#include <chrono>
 #include <eepp/graphics/fontfamily.hpp>
 #include <filesystem>
 #include <iostream>
@@ -485,6 +486,36 @@ std::pair<bool, std::string> App::generateConfigPath() {
 	return { true, Sys::getConfigPath( "ecode" ) };
 }
 
+// Removes the cache files older than maxAge and, if the remaining files take more than maxSize,
+// the least recently written ones until they fit
+static void evictCacheFiles( const std::string& path, const std::string& extension,
+							 Uint64 maxSize, const Time& maxAge ) {
+	if ( !FileSystem::isDirectory( path ) )
+		return;
+	std::vector<FileInfo> files;
+	Uint64 totalSize = 0;
+	for ( auto& file : FileSystem::filesInfoGetInPath( path ) ) {
+		if ( !file.isRegularFile() || FileSystem::fileExtension( file.getFilepath() ) != extension )
+			continue;
+		totalSize += file.getSize();
+		files.emplace_back( std::move( file ) );
+	}
+	std::sort( files.begin(), files.end(), []( const FileInfo& a, const FileInfo& b ) {
+		return a.getModificationTime() < b.getModificationTime();
+	} );
+	Uint64 now = std::chrono::duration_cast<std::chrono::seconds>(
+					 std::chrono::system_clock::now().time_since_epoch() )
+					 .count();
+	Uint64 maxAgeSeconds = maxAge.asSeconds();
+	for ( const auto& file : files ) {
+		bool expired = file.getModificationTime() + maxAgeSeconds < now;
+		if ( !expired && totalSize <= maxSize )
+			break;
+		if ( FileSystem::fileRemove( file.getFilepath() ) )
+			totalSize -= file.getSize();
+	}
+}
+
 bool App::loadConfig( const LogLevel& logLevel, const Sizeu& displaySize, bool sync,
 					  bool stdOutLogs, bool disableFileLogs ) {
 	if ( !mPortableMode )
@@ -522,6 +553,12 @@ bool App::loadConfig( const LogLevel& logLevel, const Sizeu& displaySize, bool s
 	FileSystem::dirAddSlashAtEnd( mThemesPath );
 
 	mLogsPath = mConfigPath + "ecode.log";
+	mTokenizationCachePath = mConfigPath + "cache" + FileSystem::getOSSlash() + "tokens";
+	mUndoHistoryPath = mConfigPath + "cache" + FileSystem::getOSSlash() + "undo";
+	mSearchIndexPath = mConfigPath + "cache" + FileSystem::getOSSlash() + "search" +
+					   FileSystem::getOSSlash();
+	mSymbolIndexPath = mConfigPath + "cache" + FileSystem::getOSSlash() + "symbols" +
+					   FileSystem::getOSSlash();
 
 #ifndef EE_DEBUG
 	Log::create( mLogsPath, logLevel, stdOutLogs, !disableFileLogs );
@@ -541,6 +578,12 @@ bool App::loadConfig( const LogLevel& logLevel, const Sizeu& displaySize, bool s
 	mConfig.load( mConfigPath, mKeybindingsPath, mInitColorScheme, mRecentFiles, mRecentFolders,
 				  mResPath, mPluginManager.get(), displaySize.asInt(), sync );
 
+	mThreadPool->run( [this] {
+		evictCacheFiles( mTokenizationCachePath, "tokens", 128 * 1024 * 1024,
+						 Minutes( 30 * 24 * 60 ) );
+		evictCacheFiles( mUndoHistoryPath, "undo", 128 * 1024 * 1024, Minutes( 30 * 24 * 60 ) );
+	} );
+
 	return firstRun;
 }
 
@@ -2459,6 +2502,7 @@ void App::onCodeEditorCreated( UICodeEditor* editor, TextDocument& doc ) {
 	editor->setShowWhitespaces( config.showWhiteSpaces );
 	editor->setShowLineEndings( config.showLineEndings );
 	editor->setShowIndentationGuides( config.showIndentationGuides );
+	editor->setLineWrapMode( config.lineWrap ? LineWrapMode::Word : LineWrapMode::NoWrap );
 	editor->setHighlightMatchingBracket( config.highlightMatchingBracket );
 	editor->setVerticalScrollBarEnabled( config.verticalScrollbar );
 	editor->setHorizontalScrollBarEnabled( config.horizontalScrollbar );
@@ -2483,6 +2527,18 @@ void App::onCodeEditorCreated( UICodeEditor* editor, TextDocument& doc ) {
 	doc.setIndentWidth( docc.indentWidth );
 	doc.setAutoDetectIndentType( docc.autoDetectIndentType );
 	doc.setBOM( docc.writeUnicodeBOM );
+	if ( config.tokenizationCache ) {
+		if ( !FileSystem::fileExists( mTokenizationCachePath ) )
+			FileSystem::makeDir( mTokenizationCachePath, true );
+		doc.setTokenizationCachePath( mTokenizationCachePath );
+	}
+	if ( config.persistUndoHistory ) {
+		if ( !FileSystem::fileExists( mUndoHistoryPath ) )
+			FileSystem::makeDir( mUndoHistoryPath, true );
+		doc.setUndoHistoryPath( mUndoHistoryPath );
+	}
+	doc.setPersistencePool( mThreadPool );
+	doc.getUndoStack().setMaxMemoryUsage( (size_t)config.undoMemoryLimitMb * 1024 * 1024 );
 
 	editor->addKeyBinds( getLocalKeybindings() );
 	editor->addUnlockedCommands( getUnlockedCommands() );
@@ -2754,6 +2810,21 @@ void App::loadDirTree( const std::string& path ) {
 					mFileWatcher->addWatch( dirTree.getPath(), mFileSystemListener, true );
 			}
 			mFileSystemListener->setDirTree( mDirTree );
+			// The index is only reliable while the file watcher keeps it updated
+			if ( mFileWatcher && mConfig.workspace.searchIndex ) {
+				if ( !FileSystem::fileExists( mSearchIndexPath ) )
+					FileSystem::makeDir( mSearchIndexPath, true );
+				dirTree.buildSearchIndex( mSearchIndexPath +
+										  MD5::fromString( dirTree.getPath() ).toHexString() +
+										  ".idx" );
+			}
+			if ( mFileWatcher && mConfig.workspace.symbolIndex ) {
+				if ( !FileSystem::fileExists( mSymbolIndexPath ) )
+					FileSystem::makeDir( mSymbolIndexPath, true );
+				dirTree.buildSymbolIndex( mSymbolIndexPath +
+										  MD5::fromString( dirTree.getPath() ).toHexString() +
+										  ".idx" );
+			}
 		},
 		SyntaxDefinitionManager::instance()->getExtensionsPatternsSupported() );
 }
@@ -3879,6 +3950,35 @@ static void exportLanguages( const std::string& path, const std::string& langs )
 	}
 }
 
+static void compileLanguages( const std::string& path, const std::string& langsFolder ) {
+	SyntaxDefinitionManager* sdm = SyntaxDefinitionManager::instance();
+	std::vector<SyntaxDefinition> defs;
+	std::vector<std::string> sourceFiles;
+
+	if ( !langsFolder.empty() ) {
+		std::vector<std::string> addedLangs;
+		for ( const auto& file : FileSystem::filesInfoGetInPath( langsFolder ) ) {
+			if ( !file.isRegularFile() || file.getExtension() != "json" )
+				continue;
+			IOStreamFile sfile( file.getFilepath() );
+			if ( sfile.isOpen() && sdm->loadFromStream( sfile, &addedLangs ) )
+				sourceFiles.push_back( file.getFilepath() );
+		}
+		for ( const auto& lang : addedLangs )
+			defs.push_back( sdm->getByLanguageName( lang ) );
+		if ( defs.empty() ) {
+			std::cout << "No language definitions found\n";
+			return;
+		}
+	}
+
+	if ( sdm->saveCompiled( path, defs, sourceFiles ) ) {
+		std::cout << "Language definitions compiled!\n";
+	} else {
+		std::cout << "Could not write the file\n";
+	}
+}
+
 } // namespace ecode
 
 using namespace ecode;
@@ -3960,6 +4060,16 @@ EE_MAIN_FUNC int main( int argc, char* argv[] ) {
 		parser, "convert-lang-output",
 		"Sets the directory output path. If not set it will be printed to stdout",
 		{ "convert-lang-output" }, "" );
+	args::ValueFlag<std::string> compileLangPath(
+		parser, "compile-lang-path",
+		"Precompile language definitions into the file path. If no \"compile-lang-folder\" is "
+		"defined it will compile all the built-in languages.",
+		{ "compile-lang-path" }, "" );
+	args::ValueFlag<std::string> compileLangFolder(
+		parser, "compile-lang-folder",
+		"Folder with JSON language definitions to compile. Save the output in the user languages "
+		"folder with the .esdb extension to load it instead of the JSON files.",
+		{ "compile-lang-folder" }, "" );
 	args::Flag disableFileLogs( parser, "disable-file-logs", "Disables writing logs to a log file",
 								{ "disable-file-logs" } );
 	args::Flag openClean( parser, "open-clean",
@@ -4016,6 +4126,12 @@ EE_MAIN_FUNC int main( int argc, char* argv[] ) {
 		return EXIT_SUCCESS;
 	}
 
+	if ( compileLangPath && !compileLangPath.Get().empty() ) {
+		Sys::windowAttachConsole();
+		compileLanguages( compileLangPath.Get(), compileLangFolder.Get() );
+		return EXIT_SUCCESS;
+	}
+
 	if ( exportLangPath && !exportLangPath.Get().empty() ) {
 		Sys::windowAttachConsole();
 		exportLanguages( exportLangPath.Get(), exportLang.Get() );
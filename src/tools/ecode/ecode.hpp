@@ -472,6 +472,10 @@ class App : public UICodeEditorSplitter::Client {
 	std::string mLanguagesPath;
 	std::string mThemesPath;
 	std::string mLogsPath;
+	std::string mTokenizationCachePath;
+	std::string mUndoHistoryPath;
+	std::string mSearchIndexPath;
+	std::string mSymbolIndexPath;
 	std::string mi18nPath;
 	Float mDisplayDPI{ 96 };
 	std::shared_ptr<ThreadPool> mThreadPool;
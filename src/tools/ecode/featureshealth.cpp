@@ -29,7 +29,7 @@ std::vector<FeaturesHealth::LangHealth> FeaturesHealth::getHealth( PluginManager
 	bool ownsFormatter = false;
 	bool ownsLSP = false;
 
-	const auto& definitions = SyntaxDefinitionManager::instance()->getDefinitions();
+	const auto& definitions = SyntaxDefinitionManager::instance()->getDefinitionsMetadata();
 
 	LinterPlugin* linter = static_cast<LinterPlugin*>( pluginManager->get( "linter" ) );
 
@@ -52,19 +52,19 @@ std::vector<FeaturesHealth::LangHealth> FeaturesHealth::getHealth( PluginManager
 		lsp = static_cast<LSPClientPlugin*>( LSPClientPlugin::NewSync( pluginManager ) );
 	}
 
-	for ( const auto& def : definitions ) {
-		if ( !def.isVisible() )
+	for ( const auto* def : definitions ) {
+		if ( !def->isVisible() )
 			continue;
 
-		if ( !langFilter.empty() && langFilter != def.getLSPName() )
+		if ( !langFilter.empty() && langFilter != def->getLSPName() )
 			continue;
 
 		FeaturesHealth::LangHealth lang;
-		lang.lang = def.getLSPName();
+		lang.lang = def->getLSPName();
 		lang.syntaxHighlighting = true;
 
 		if ( linter ) {
-			Linter found = linter->getLinterForLang( def.getLSPName() );
+			Linter found = linter->getLinterForLang( def->getLSPName() );
 			if ( !found.command.empty() ) {
 				lang.linter.name = String::split( found.command, ' ' )[0];
 				lang.linter.path = Sys::which( lang.linter.name );
@@ -75,7 +75,7 @@ std::vector<FeaturesHealth::LangHealth> FeaturesHealth::getHealth( PluginManager
 
 		if ( formatter ) {
 			FormatterPlugin::Formatter found =
-				formatter->getFormatterForLang( def.getLSPName() );
+				formatter->getFormatterForLang( def->getLSPName() );
 			if ( !found.command.empty() ) {
 				lang.formatter.name = found.type == FormatterPlugin::FormatterType::Native
 										  ? "native"
@@ -89,7 +89,7 @@ std::vector<FeaturesHealth::LangHealth> FeaturesHealth::getHealth( PluginManager
 
 		if ( lsp ) {
 			LSPDefinition found =
-				lsp->getClientManager().getLSPForLang( def.getLSPName() );
+				lsp->getClientManager().getLSPForLang( def->getLSPName() );
 			if ( !found.command.empty() ) {
 				lang.lsp.name = found.name;
 				lang.lsp.url = found.url;
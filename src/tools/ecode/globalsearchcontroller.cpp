@@ -548,7 +548,9 @@ void GlobalSearchController::doGlobalSearch( String text, bool caseSensitive, bo
 			text.unescape();
 		std::string search( text.toUtf8() );
 		ProjectSearch::find(
-			mApp->getDirTree()->getFiles(), search,
+			luaPattern ? mApp->getDirTree()->getFiles()
+					   : mApp->getDirTree()->getSearchCandidates( search ),
+			search,
 #if EE_PLATFORM != EE_PLATFORM_EMSCRIPTEN || defined( __EMSCRIPTEN_PTHREADS__ )
 			mApp->getThreadPool(),
 #endif
@@ -1,7 +1,10 @@
 #include "ignorematcher.hpp"
 #include <algorithm>
+#include <bitset>
 #include <eepp/core/string.hpp>
 #include <eepp/system/filesystem.hpp>
+#include <limits>
+#include <map>
 
 namespace ecode {
 
@@ -189,34 +192,329 @@ bool GitIgnoreMatcher::parse() {
 		pattern = String::rTrim( pattern, '/' );
 		mPatterns.emplace_back( std::make_pair( pattern, negates ) );
 	}
+	compile();
 	return !mPatterns.empty();
 }
 
-bool GitIgnoreMatcher::match( const std::string& value ) const {
-	if ( mPatterns.empty() )
-		return false;
-	bool match = false;
+static constexpr const char* GLOB_CHARS = "*?[\\";
+
+void GitIgnoreMatcher::compile() {
+	mNegationsEnd.resize( mPatterns.size() );
+	for ( size_t i = mPatterns.size(); i-- > 0; ) {
+		mNegationsEnd[i] = i + 1 < mPatterns.size() && mPatterns[i + 1].second
+							   ? mNegationsEnd[i + 1]
+							   : static_cast<Uint32>( i + 1 );
+	}
+
+	mAnchoredTrie.assign( 1, {} );
+	mPathTrie.assign( 1, {} );
 	for ( size_t i = 0; i < mPatterns.size(); i++ ) {
-		auto& pattern = mPatterns[i];
-		match = gitignore_glob_match( value, pattern.first );
-		if ( pattern.second )
-			match = !match;
-		if ( match && !pattern.second ) {
-			if ( i + 1 < mPatterns.size() && mPatterns[i + 1].second ) {
-				for ( size_t n = i + 1; n < mPatterns.size(); n++ ) {
-					// Check if there's a positive negate after the match
-					if ( mPatterns[n].second ) {
-						if ( gitignore_glob_match( value, mPatterns[n].first ) )
-							return false;
-					} else {
-						break;
-					}
+		// Negations are only evaluated after a pattern matched
+		if ( mPatterns[i].second )
+			continue;
+		const std::string& glob = mPatterns[i].first;
+		Uint32 index = static_cast<Uint32>( i );
+		if ( glob.find( '/' ) == std::string::npos ) {
+			// Matched against the base name
+			size_t globPos = glob.find_first_of( GLOB_CHARS );
+			if ( globPos == std::string::npos ) {
+				mNames.emplace( glob, index );
+			} else if ( globPos == 0 && glob[0] == '*' &&
+						glob.find_first_of( GLOB_CHARS, 1 ) == std::string::npos ) {
+				if ( mSuffixes.emplace( glob.substr( 1 ), index ).second &&
+					 std::find( mSuffixesLengths.begin(), mSuffixesLengths.end(),
+								glob.size() - 1 ) == mSuffixesLengths.end() )
+					mSuffixesLengths.push_back( glob.size() - 1 );
+			} else {
+				mGlobs.push_back( index );
+			}
+		} else {
+			// Matched against the path, a pattern can only match the paths that start with its
+			// literal prefix
+			bool anchored = glob.size() > 1 && glob[0] == '/';
+			size_t start = anchored ? 1 : 0;
+			size_t globPos = glob.find_first_of( GLOB_CHARS, start );
+			trieInsert( anchored ? mAnchoredTrie : mPathTrie,
+						glob.substr( start, globPos == std::string::npos ? std::string::npos
+																		: globPos - start ),
+						index );
+		}
+	}
+
+	compileGlobs();
+}
+
+namespace {
+
+// A base name glob element: a single character out of a set of bytes, or a star
+struct GlobToken {
+	std::bitset<256> bytes;
+	bool star{ false };
+};
+
+} // namespace
+
+// Splits a base name glob in the elements gitignore_glob_match evaluates. Returns false if the glob
+// has a "**" that isn't trailing: the matcher fails right away when it reaches one before the end
+// of the text, without backtracking, which a DFA can't express.
+static bool parseGlobTokens( const std::string& glob, std::vector<GlobToken>& tokens ) {
+	size_t m = glob.size();
+	size_t j = 0;
+	while ( j < m ) {
+		GlobToken token;
+		switch ( glob[j] ) {
+			case '*':
+				if ( j + 1 < m && glob[j + 1] == '*' ) {
+					if ( j + 2 < m )
+						return false;
+					j = m;
+				} else {
+					j++;
+				}
+				token.star = true;
+				break;
+			case '?':
+				token.bytes.set();
+				j++;
+				break;
+			case '[': {
+				// Evaluates the character class for every byte, exactly as the matcher does
+				bool reverse = j + 1 < m && ( glob[j + 1] == '^' || glob[j + 1] == '!' );
+				if ( reverse )
+					j++;
+				size_t end = j;
+				for ( int c = 0; c < 256; c++ ) {
+					char chr = static_cast<char>( c );
+					bool matched = false;
+					int lastchr;
+					for ( end = j, lastchr = 256; ++end < m && glob[end] != ']';
+						  lastchr = glob[end] )
+						if ( lastchr < 256 && glob[end] == '-' && end + 1 < m &&
+									 glob[end + 1] != ']'
+								 ? chr <= glob[++end] && chr >= lastchr
+								 : chr == glob[end] )
+							matched = true;
+					token.bytes[c] = matched != reverse;
 				}
+				j = end < m ? end + 1 : end;
+				break;
 			}
-			return true;
+			case '\\':
+				if ( j + 1 < m )
+					j++;
+				token.bytes.set( static_cast<Uint8>( glob[j] ) );
+				j++;
+				break;
+			default:
+				token.bytes.set( static_cast<Uint8>( glob[j] ) );
+				j++;
+				break;
 		}
+		// Never matches a path separator
+		token.bytes.reset( static_cast<Uint8>( PATHSEP ) );
+		tokens.emplace_back( std::move( token ) );
 	}
-	return false;
+	return true;
+}
+
+void GitIgnoreMatcher::compileGlobs() {
+	static constexpr size_t MAX_STATES = 4096;
+	static constexpr Uint32 NO_PATTERN = std::numeric_limits<Uint32>::max();
+
+	// The NFA is the elements of every glob one after the other, each glob followed by a state
+	// that accepts it
+	std::vector<GlobToken> tokens;
+	std::vector<Uint32> accepts;
+	std::vector<Uint32> starts;
+	std::vector<Uint32> uncompiled;
+	for ( const auto& index : mGlobs ) {
+		std::vector<GlobToken> globTokens;
+		if ( !parseGlobTokens( mPatterns[index].first, globTokens ) ) {
+			uncompiled.push_back( index );
+			continue;
+		}
+		starts.push_back( static_cast<Uint32>( tokens.size() ) );
+		for ( auto& token : globTokens ) {
+			tokens.emplace_back( std::move( token ) );
+			accepts.push_back( NO_PATTERN );
+		}
+		tokens.emplace_back();
+		accepts.push_back( index );
+	}
+	if ( starts.empty() )
+		return;
+
+	// Splits the bytes in the classes that every element set agrees on
+	mGlobsByteClass.fill( 0 );
+	mGlobsClassesCount = 1;
+	for ( const auto& token : tokens ) {
+		if ( token.star || token.bytes.none() )
+			continue;
+		std::map<std::pair<Uint16, bool>, Uint16> classes;
+		for ( size_t c = 0; c < 256; c++ ) {
+			auto key = std::make_pair( mGlobsByteClass[c], token.bytes[c] );
+			auto it = classes.emplace( key, static_cast<Uint16>( classes.size() ) ).first;
+			mGlobsByteClass[c] = it->second;
+		}
+		mGlobsClassesCount = classes.size();
+	}
+	std::vector<Uint8> classByte( mGlobsClassesCount );
+	for ( size_t c = 256; c-- > 0; )
+		classByte[mGlobsByteClass[c]] = static_cast<Uint8>( c );
+
+	// A star can match nothing, so the element after it is reached too
+	const auto addState = [&tokens]( std::vector<Uint32>& set, Uint32 state ) {
+		set.push_back( state );
+		while ( tokens[state].star )
+			set.push_back( ++state );
+	};
+	const auto normalize = []( std::vector<Uint32>& set ) {
+		std::sort( set.begin(), set.end() );
+		set.erase( std::unique( set.begin(), set.end() ), set.end() );
+	};
+
+	std::vector<std::vector<Uint32>> states( 2 );
+	for ( const auto& start : starts )
+		addState( states[1], start );
+	normalize( states[1] );
+	std::map<std::vector<Uint32>, Uint32> ids{ { states[0], 0 }, { states[1], 1 } };
+	mGlobsTransitions.assign( 2 * mGlobsClassesCount, 0 );
+
+	for ( size_t state = 1; state < states.size(); state++ ) {
+		for ( size_t cls = 0; cls < mGlobsClassesCount; cls++ ) {
+			Uint8 chr = classByte[cls];
+			std::vector<Uint32> next;
+			for ( const auto& nfaState : states[state] ) {
+				if ( tokens[nfaState].star )
+					addState( next, nfaState );
+				else if ( tokens[nfaState].bytes[chr] )
+					addState( next, nfaState + 1 );
+			}
+			normalize( next );
+			auto it = ids.find( next );
+			if ( it == ids.end() ) {
+				if ( states.size() >= MAX_STATES ) {
+					mGlobsTransitions.clear();
+					return;
+				}
+				it = ids.emplace( next, static_cast<Uint32>( states.size() ) ).first;
+				states.emplace_back( std::move( next ) );
+				mGlobsTransitions.resize( states.size() * mGlobsClassesCount, 0 );
+			}
+			mGlobsTransitions[state * mGlobsClassesCount + cls] = it->second;
+		}
+	}
+
+	mGlobsAccept.assign( states.size(), static_cast<Uint32>( mPatterns.size() ) );
+	for ( size_t state = 0; state < states.size(); state++ ) {
+		for ( const auto& nfaState : states[state] ) {
+			if ( accepts[nfaState] != NO_PATTERN )
+				mGlobsAccept[state] = std::min( mGlobsAccept[state], accepts[nfaState] );
+		}
+	}
+	mGlobsCompiled = true;
+	mGlobs = std::move( uncompiled );
+}
+
+void GitIgnoreMatcher::trieInsert( std::vector<TrieNode>& trie, const std::string& prefix,
+								   Uint32 index ) {
+	Uint32 node = 0;
+	for ( const auto& chr : prefix ) {
+		auto it = trie[node].children.find( chr );
+		if ( it == trie[node].children.end() ) {
+			Uint32 child = static_cast<Uint32>( trie.size() );
+			trie[node].children[chr] = child;
+			trie.emplace_back();
+			node = child;
+		} else {
+			node = it->second;
+		}
+	}
+	trie[node].patterns.push_back( index );
+}
+
+void GitIgnoreMatcher::trieMatch( const std::vector<TrieNode>& trie, const std::string& value,
+								  size_t start, Uint32& first ) const {
+	Uint32 node = 0;
+	size_t pos = start;
+	while ( true ) {
+		for ( const auto& index : trie[node].patterns ) {
+			if ( index >= first )
+				break;
+			if ( gitignore_glob_match( value, mPatterns[index].first ) ) {
+				first = index;
+				break;
+			}
+		}
+		if ( pos >= value.size() )
+			break;
+		auto it = trie[node].children.find( value[pos] );
+		if ( it == trie[node].children.end() )
+			break;
+		node = it->second;
+		pos++;
+	}
+}
+
+bool GitIgnoreMatcher::match( const std::string& value ) const {
+	if ( mPatterns.empty() )
+		return false;
+
+	// The first pattern that matches decides, unless a negation right after it matches too
+	Uint32 first = static_cast<Uint32>( mPatterns.size() );
+	size_t sep = value.rfind( PATHSEP );
+	std::string name( sep == std::string::npos ? value : value.substr( sep + 1 ) );
+
+	auto nameIt = mNames.find( name );
+	if ( nameIt != mNames.end() )
+		first = nameIt->second;
+
+	for ( const auto& length : mSuffixesLengths ) {
+		if ( length > name.size() )
+			continue;
+		auto suffixIt = mSuffixes.find( name.substr( name.size() - length ) );
+		if ( suffixIt != mSuffixes.end() && suffixIt->second < first )
+			first = suffixIt->second;
+	}
+
+	trieMatch( mPathTrie, value, 0, first );
+
+	// Anchored patterns ignore the leading ./ pairs and slash, the same as gitignore_glob_match
+	size_t start = 0;
+	while ( start + 1 < value.size() && value[start] == '.' && value[start + 1] == PATHSEP )
+		start += 2;
+	if ( start < value.size() && value[start] == PATHSEP )
+		start++;
+	trieMatch( mAnchoredTrie, value, start, first );
+
+	if ( mGlobsCompiled ) {
+		Uint32 state = 1;
+		for ( const auto& chr : name ) {
+			state = mGlobsTransitions[state * mGlobsClassesCount +
+									  mGlobsByteClass[static_cast<Uint8>( chr )]];
+			if ( state == 0 )
+				break;
+		}
+		first = std::min( first, mGlobsAccept[state] );
+	}
+
+	for ( const auto& index : mGlobs ) {
+		if ( index >= first )
+			break;
+		if ( gitignore_glob_match( value, mPatterns[index].first ) ) {
+			first = index;
+			break;
+		}
+	}
+
+	if ( first == mPatterns.size() )
+		return false;
+
+	for ( size_t n = first + 1; n < mNegationsEnd[first]; n++ ) {
+		if ( gitignore_glob_match( value, mPatterns[n].first ) )
+			return false;
+	}
+	return true;
 }
 
 std::string GitIgnoreMatcher::findRepositoryRootPath() const {
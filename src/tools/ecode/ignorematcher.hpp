@@ -1,8 +1,10 @@
 #ifndef ECODE_IGNOREMATCHER_HPP
 #define ECODE_IGNOREMATCHER_HPP
 
+#include <array>
 #include <eepp/system/filesystem.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 using namespace EE;
@@ -49,11 +51,50 @@ class GitIgnoreMatcher : public IgnoreMatcher {
 	std::string findRepositoryRootPath() const override;
 
   protected:
+	struct TrieNode {
+		std::unordered_map<char, Uint32> children;
+		// Patterns whose literal prefix ends in this node
+		std::vector<Uint32> patterns;
+	};
+
 	std::string mIgnoreFileName;
 	std::string mIgnoreFilePath;
 	std::vector<std::pair<std::string, bool>> mPatterns;
+	// Index of the pattern after the negations that follow each pattern
+	std::vector<Uint32> mNegationsEnd;
+	// First pattern for each literal base name ("node_modules")
+	std::unordered_map<std::string, Uint32> mNames;
+	// First pattern for each literal base name suffix ("*.o")
+	std::unordered_map<std::string, Uint32> mSuffixes;
+	std::vector<size_t> mSuffixesLengths;
+	// Patterns with a slash by their literal prefix, anchored ("/build/*") or not ("src/*.o")
+	std::vector<TrieNode> mAnchoredTrie;
+	std::vector<TrieNode> mPathTrie;
+	// Base name patterns with wildcards that can't be indexed. They are compiled into a single
+	// DFA over the base name, the ones left are matched one by one: the globs with a "**" that
+	// isn't trailing, or all of them if the DFA has too many states.
+	std::vector<Uint32> mGlobs;
+	bool mGlobsCompiled{ false };
+	// Bytes that no glob tells apart share a class
+	std::array<Uint16, 256> mGlobsByteClass{};
+	size_t mGlobsClassesCount{ 0 };
+	// Next state by state and byte class. State 0 is the dead state and 1 the initial state.
+	std::vector<Uint32> mGlobsTransitions;
+	// First pattern accepted by each state, the patterns count if none
+	std::vector<Uint32> mGlobsAccept;
 
 	bool parse() override;
+
+	/** Indexes the patterns, so a match only evaluates the patterns that can match. */
+	void compile();
+
+	/** Builds the DFA of the base name globs. */
+	void compileGlobs();
+
+	static void trieInsert( std::vector<TrieNode>& trie, const std::string& prefix, Uint32 index );
+
+	void trieMatch( const std::vector<TrieNode>& trie, const std::string& value, size_t start,
+					Uint32& first ) const;
 };
 
 class IgnoreMatcherManager {
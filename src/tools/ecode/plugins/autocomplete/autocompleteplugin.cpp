@@ -5,6 +5,7 @@
 #include <eepp/system/lock.hpp>
 #include <eepp/system/luapattern.hpp>
 #include <eepp/ui/uiscenenode.hpp>
+#include <limits>
 #include <nlohmann/json.hpp>
 using namespace EE::Graphics;
 using namespace EE::System;
@@ -88,14 +89,18 @@ AutoCompletePlugin::~AutoCompletePlugin() {
 	mShuttingDown = true;
 	mManager->unsubscribeMessages( this );
 
-	Lock l( mDocMutex );
-	Lock l2( mLangSymbolsMutex );
+	Lock l( mLangSymbolsMutex );
+	Lock l2( mDocMutex );
 	Lock l3( mSuggestionsMutex );
 	for ( const auto& editor : mEditors ) {
 		for ( auto listener : editor.second )
 			editor.first->removeEventListener( listener );
 		editor.first->unregisterPlugin( this );
 	}
+	for ( const auto& cache : mDocCache ) {
+		if ( !cache.second.closed )
+			cache.first->unregisterClient( cache.second.client.get() );
+	}
 }
 
 void AutoCompletePlugin::onRegister( UICodeEditor* editor ) {
@@ -104,18 +109,15 @@ void AutoCompletePlugin::onRegister( UICodeEditor* editor ) {
 	listeners.push_back(
 		editor->addEventListener( Event::OnDocumentLoaded, [this, editor]( const Event* ) {
 			mDirty = true;
-			mDocs.insert( editor->getDocumentRef().get() );
+			registerDoc( editor->getDocumentRef().get() );
 			mEditorDocs[editor] = editor->getDocumentRef().get();
 			tryRequestCapabilities( editor );
 		} ) );
 
 	listeners.push_back(
 		editor->addEventListener( Event::OnDocumentClosed, [this]( const Event* event ) {
-			Lock l( mDocMutex );
 			const DocEvent* docEvent = static_cast<const DocEvent*>( event );
-			TextDocument* doc = docEvent->getDoc();
-			mDocs.erase( doc );
-			mDocCache.erase( doc );
+			unregisterDoc( docEvent->getDoc() );
 			mDirty = true;
 		} ) );
 
@@ -123,10 +125,16 @@ void AutoCompletePlugin::onRegister( UICodeEditor* editor ) {
 		editor->addEventListener( Event::OnDocumentChanged, [this, editor]( const Event* ) {
 			TextDocument* oldDoc = mEditorDocs[editor];
 			TextDocument* newDoc = editor->getDocumentRef().get();
-			Lock l( mDocMutex );
-			mDocs.erase( oldDoc );
-			mDocCache.erase( oldDoc );
-			mEditorDocs[editor] = newDoc;
+			bool oldDocVisible = false;
+			{
+				Lock l( mDocMutex );
+				mEditorDocs[editor] = newDoc;
+				for ( const auto& ceditor : mEditorDocs )
+					oldDocVisible = oldDocVisible || ceditor.second == oldDoc;
+			}
+			if ( !oldDocVisible )
+				unregisterDoc( oldDoc );
+			registerDoc( newDoc );
 			mDirty = true;
 		} ) );
 
@@ -152,21 +160,11 @@ void AutoCompletePlugin::onRegister( UICodeEditor* editor ) {
 	listeners.push_back( editor->addEventListener(
 		Event::OnDocumentSyntaxDefinitionChange, [this]( const Event* ev ) {
 			const DocSyntaxDefEvent* event = static_cast<const DocSyntaxDefEvent*>( ev );
-			std::string oldLang = event->getOldLang();
-			std::string newLang = event->getNewLang();
-#if defined( AUTO_COMPLETE_THREADED ) && AUTO_COMPLETE_THREADED == 1
-			mThreadPool->run( [this, oldLang, newLang] {
-				updateLangCache( oldLang );
-				updateLangCache( newLang );
-			} );
-#else
-			updateLangCache( oldLang );
-			updateLangCache( newLang );
-#endif
+			onDocumentSyntaxDefinitionChange( event->getDoc(), event->getNewLang() );
 		} ) );
 
 	mEditors.insert( { editor, listeners } );
-	mDocs.insert( editor->getDocumentRef().get() );
+	registerDoc( editor->getDocumentRef().get() );
 	mEditorDocs[editor] = editor->getDocumentRef().get();
 	mDirty = true;
 }
@@ -178,18 +176,20 @@ void AutoCompletePlugin::onUnregister( UICodeEditor* editor ) {
 		resetSuggestions( editor );
 	if ( mSignatureHelpEditor == editor )
 		resetSignatureHelp();
-	Lock l( mDocMutex );
-	TextDocument* doc = mEditorDocs[editor];
-	auto cbs = mEditors[editor];
-	for ( auto listener : cbs )
-		editor->removeEventListener( listener );
-	mEditors.erase( editor );
-	mEditorDocs.erase( editor );
-	for ( auto ceditor : mEditorDocs )
-		if ( ceditor.second == doc )
-			return;
-	mDocs.erase( doc );
-	mDocCache.erase( doc );
+	TextDocument* doc = nullptr;
+	{
+		Lock l( mDocMutex );
+		doc = mEditorDocs[editor];
+		auto cbs = mEditors[editor];
+		for ( auto listener : cbs )
+			editor->removeEventListener( listener );
+		mEditors.erase( editor );
+		mEditorDocs.erase( editor );
+		for ( auto ceditor : mEditorDocs )
+			if ( ceditor.second == doc )
+				return;
+	}
+	unregisterDoc( doc );
 	mDirty = true;
 }
 
@@ -396,64 +396,302 @@ bool AutoCompletePlugin::onTextInput( UICodeEditor* editor, const TextInputEvent
 	return false;
 }
 
-void AutoCompletePlugin::updateDocCache( TextDocument* doc ) {
-	{
-		Lock lu( mDocsUpdatingMutex );
-		mDocsUpdating[doc] = true;
-	}
-	Clock clock;
-	std::unordered_map<TextDocument*, DocCache>::iterator docCache;
-	{
-		Lock l( mDocMutex );
-		docCache = mDocCache.find( doc );
-		if ( docCache == mDocCache.end() || mShuttingDown )
-			return;
+// Line index after inserting (numLines > 0) or removing (numLines < 0) lines after fromLine, -1
+// if the line was removed
+static Int64 moveLine( Int64 line, Int64 fromLine, Int64 numLines ) {
+	if ( line <= fromLine )
+		return line;
+	if ( numLines < 0 && line <= fromLine - numLines )
+		return -1;
+	return line + numLines;
+}
+
+void AutoCompletePlugin::DocClient::onDocumentLineChanged( const Int64& lineIndex ) {
+	mParent->onDocumentLineChanged( mDoc, lineIndex );
+}
+
+void AutoCompletePlugin::DocClient::onDocumentLineMove( const Int64& fromLine,
+														const Int64& numLines ) {
+	mParent->onDocumentLineMove( mDoc, fromLine, numLines );
+}
+
+void AutoCompletePlugin::DocClient::onDocumentClosed( TextDocument* ) {
+	mParent->onDocumentClosed( mDoc );
+}
+
+void AutoCompletePlugin::registerDoc( TextDocument* doc ) {
+	Lock l( mDocMutex );
+	auto& cache = mDocCache[doc];
+	// Already registered, the document was (re)loaded
+	if ( cache.client ) {
+		cache.fullRebuild = true;
+		return;
 	}
+	cache.lang = doc->getSyntaxDefinition().getLanguageName();
+	cache.client = std::make_unique<DocClient>( this, doc );
+	doc->registerClient( cache.client.get() );
+}
 
-	auto changeId = doc->getCurrentChangeId();
-	auto symbols = getDocumentSymbols( doc );
+void AutoCompletePlugin::unregisterDoc( TextDocument* doc ) {
+	Lock l( mLangSymbolsMutex );
+	Lock l2( mDocMutex );
+	auto docCache = mDocCache.find( doc );
+	if ( docCache == mDocCache.end() )
+		return;
+	auto& cache = docCache->second;
+	auto lang = mLangCache.find( cache.lang );
+	if ( lang != mLangCache.end() ) {
+		for ( const auto& line : cache.lines )
+			removeLangSymbols( lang->second, line );
+	}
+	if ( !cache.closed )
+		doc->unregisterClient( cache.client.get() );
+	mDocCache.erase( docCache );
+}
 
-	{
-		Lock l( mDocMutex );
-		docCache = mDocCache.find( doc );
-		if ( docCache == mDocCache.end() || mShuttingDown )
-			return;
-		auto& cache = docCache->second;
-		cache.changeId = changeId;
-		cache.symbols = std::move( symbols );
+void AutoCompletePlugin::onDocumentClosed( TextDocument* doc ) {
+	Lock l( mLangSymbolsMutex );
+	Lock l2( mDocMutex );
+	auto docCache = mDocCache.find( doc );
+	if ( docCache == mDocCache.end() )
+		return;
+	auto& cache = docCache->second;
+	auto lang = mLangCache.find( cache.lang );
+	if ( lang != mLangCache.end() ) {
+		for ( const auto& line : cache.lines )
+			removeLangSymbols( lang->second, line );
 	}
+	cache.lines.clear();
+	cache.closed = true;
+}
 
-	std::string langName( doc->getSyntaxDefinition().getLanguageName() );
-	{
-		Lock l( mLangSymbolsMutex );
-		auto& lang = mLangCache[langName];
-		lang.clear();
-		Lock l2( mDocMutex );
-		for ( const auto& d : mDocCache ) {
-			if ( d.first->getSyntaxDefinition().getLanguageName() == langName )
-				lang.insert( lang.end(), d.second.symbols.begin(), d.second.symbols.end() );
+void AutoCompletePlugin::onDocumentLineChanged( TextDocument* doc, const Int64& lineIndex ) {
+	Lock l( mDocMutex );
+	auto docCache = mDocCache.find( doc );
+	if ( docCache == mDocCache.end() )
+		return;
+	auto& cache = docCache->second;
+	cache.dirtyLines[lineIndex] = ++cache.changeCounter;
+}
+
+void AutoCompletePlugin::onDocumentLineMove( TextDocument* doc, const Int64& fromLine,
+											  const Int64& numLines ) {
+	Lock l( mLangSymbolsMutex );
+	Lock l2( mDocMutex );
+	auto docCache = mDocCache.find( doc );
+	if ( docCache == mDocCache.end() || numLines == 0 )
+		return;
+	auto& cache = docCache->second;
+	if ( cache.updating )
+		cache.moves.emplace_back( fromLine, numLines );
+
+	Int64 at = eeclamp<Int64>( fromLine + 1, 0, cache.lines.size() );
+	if ( numLines > 0 ) {
+		cache.lines.insert( cache.lines.begin() + at, numLines, std::vector<Uint32>() );
+	} else {
+		Int64 count = eemin<Int64>( -numLines, cache.lines.size() - at );
+		auto lang = mLangCache.find( cache.lang );
+		if ( lang != mLangCache.end() ) {
+			for ( Int64 i = at; i < at + count; i++ )
+				removeLangSymbols( lang->second, cache.lines[i] );
 		}
+		cache.lines.erase( cache.lines.begin() + at, cache.lines.begin() + at + count );
 	}
-	Log::debug( "Dictionary for %s updated in: %.2fms", doc->getFilename().c_str(),
-				clock.getElapsedTime().asMilliseconds() );
-	{
-		Lock lu( mDocsUpdatingMutex );
-		mDocsUpdating[doc] = false;
+
+	if ( cache.ignoredLine >= 0 )
+		cache.ignoredLine = moveLine( cache.ignoredLine, fromLine, numLines );
+
+	std::unordered_map<Int64, Uint64> dirtyLines;
+	dirtyLines.reserve( cache.dirtyLines.size() );
+	for ( const auto& dirty : cache.dirtyLines ) {
+		Int64 line = moveLine( dirty.first, fromLine, numLines );
+		if ( line >= 0 )
+			dirtyLines[line] = dirty.second;
+	}
+	cache.dirtyLines = std::move( dirtyLines );
+
+	// The inserted lines are scanned in the next update. When they are most of the document it's
+	// cheaper to scan it all.
+	if ( numLines > (Int64)cache.lines.size() / 2 ) {
+		cache.fullRebuild = true;
+	} else {
+		for ( Int64 i = 1; i <= numLines; i++ )
+			cache.dirtyLines[fromLine + i] = ++cache.changeCounter;
 	}
 }
 
-void AutoCompletePlugin::updateLangCache( const std::string& langName ) {
+void AutoCompletePlugin::onDocumentSyntaxDefinitionChange( TextDocument* doc,
+															const std::string& newLang ) {
+	Lock l( mLangSymbolsMutex );
+	Lock l2( mDocMutex );
+	auto docCache = mDocCache.find( doc );
+	if ( docCache == mDocCache.end() || docCache->second.lang == newLang )
+		return;
+	// The symbols ids belong to the language, so the document is indexed again for the new one
+	auto& cache = docCache->second;
+	auto lang = mLangCache.find( cache.lang );
+	if ( lang != mLangCache.end() ) {
+		for ( const auto& line : cache.lines )
+			removeLangSymbols( lang->second, line );
+	}
+	cache.lines.clear();
+	cache.lang = newLang;
+	cache.fullRebuild = true;
+	mDirty = true;
+}
+
+Uint32 AutoCompletePlugin::getLangSymbolId( LangCache& lang, const std::string& symbol ) {
+	auto it = lang.ids.find( symbol );
+	if ( it != lang.ids.end() )
+		return it->second;
+	Uint32 id;
+	if ( !lang.freeIds.empty() ) {
+		id = lang.freeIds.back();
+		lang.freeIds.pop_back();
+	} else {
+		id = lang.entries.size();
+		lang.entries.emplace_back();
+	}
+	lang.ids[symbol] = id;
+	lang.entries[id] = { 0, lang.symbols.size() };
+	lang.symbols.emplace_back( symbol );
+	lang.symbolsIds.push_back( id );
+	return id;
+}
+
+void AutoCompletePlugin::releaseLangSymbol( LangCache& lang, Uint32 id ) {
+	// Swap with the last symbol so the removal doesn't move the whole list
+	size_t index = lang.entries[id].index;
+	size_t last = lang.symbols.size() - 1;
+	lang.ids.erase( lang.symbols[index].text );
+	if ( index != last ) {
+		lang.symbols[index] = std::move( lang.symbols[last] );
+		lang.symbolsIds[index] = lang.symbolsIds[last];
+		lang.entries[lang.symbolsIds[index]].index = index;
+	}
+	lang.symbols.pop_back();
+	lang.symbolsIds.pop_back();
+	lang.freeIds.push_back( id );
+}
+
+void AutoCompletePlugin::addLangSymbols( LangCache& lang, const std::vector<Uint32>& ids ) {
+	for ( const auto& id : ids )
+		lang.entries[id].count++;
+}
+
+void AutoCompletePlugin::removeLangSymbols( LangCache& lang, const std::vector<Uint32>& ids ) {
+	for ( const auto& id : ids ) {
+		if ( --lang.entries[id].count == 0 )
+			releaseLangSymbol( lang, id );
+	}
+}
+
+void AutoCompletePlugin::updateDocCache( TextDocument* doc,
+										  std::shared_ptr<const TextDocumentSnapshot> snapshot,
+										  std::vector<std::pair<Int64, Uint64>> dirtyLines,
+										  bool fullRebuild, Uint64 changeCounter,
+										  std::string current, TextPosition cursor ) {
 	Clock clock;
+	std::vector<Int64> lines;
+	lines.reserve( dirtyLines.size() );
+	for ( const auto& dirty : dirtyLines )
+		lines.push_back( dirty.first );
+
+	LinesSymbols symbols( getLinesSymbols( *snapshot, lines, current, cursor ) );
+
 	Lock l( mLangSymbolsMutex );
 	Lock l2( mDocMutex );
-	auto& lang = mLangCache[langName];
-	lang.clear();
-	for ( const auto& d : mDocCache ) {
-		if ( d.first->getSyntaxDefinition().getLanguageName() == langName )
-			lang.insert( lang.end(), d.second.symbols.begin(), d.second.symbols.end() );
+	auto docCache = mDocCache.find( doc );
+	if ( docCache == mDocCache.end() || mShuttingDown )
+		return;
+	auto& cache = docCache->second;
+	cache.updating = false;
+	if ( cache.closed )
+		return;
+
+	// A full rebuild also picks the current document language, in case it changed while it wasn't
+	// tracked
+	std::string langName( doc->getSyntaxDefinition().getLanguageName() );
+	if ( fullRebuild && cache.lang != langName ) {
+		auto oldLang = mLangCache.find( cache.lang );
+		if ( oldLang != mLangCache.end() ) {
+			for ( const auto& line : cache.lines )
+				removeLangSymbols( oldLang->second, line );
+		}
+		cache.lines.clear();
+		cache.lang = langName;
+	}
+
+	auto& lang = mLangCache[cache.lang];
+	// Scanned symbols ids in the language cache, resolved only for the lines that are applied.
+	// Every resolved symbol is referenced right away so it can't be released while applying.
+	std::vector<Uint32> ids( symbols.texts.size(), std::numeric_limits<Uint32>::max() );
+	auto langIds = [&]( const std::vector<Uint32>& lineSymbols ) {
+		std::vector<Uint32> lineIds;
+		lineIds.reserve( lineSymbols.size() );
+		for ( const auto& symbol : lineSymbols ) {
+			if ( ids[symbol] == std::numeric_limits<Uint32>::max() )
+				ids[symbol] = getLangSymbolId( lang, symbols.texts[symbol] );
+			lineIds.push_back( ids[symbol] );
+		}
+		addLangSymbols( lang, lineIds );
+		return lineIds;
+	};
+
+	if ( fullRebuild ) {
+		std::vector<std::vector<Uint32>> newLines;
+		newLines.reserve( symbols.lines.size() );
+		for ( const auto& line : symbols.lines )
+			newLines.emplace_back( langIds( line.second ) );
+
+		// Replay the line moves done while scanning, the inserted lines are already dirty
+		for ( const auto& move : cache.moves ) {
+			Int64 at = eeclamp<Int64>( move.first + 1, 0, newLines.size() );
+			if ( move.second > 0 ) {
+				newLines.insert( newLines.begin() + at, move.second, std::vector<Uint32>() );
+			} else {
+				Int64 count = eemin<Int64>( -move.second, newLines.size() - at );
+				for ( Int64 i = at; i < at + count; i++ )
+					removeLangSymbols( lang, newLines[i] );
+				newLines.erase( newLines.begin() + at, newLines.begin() + at + count );
+			}
+		}
+
+		for ( const auto& line : cache.lines )
+			removeLangSymbols( lang, line );
+		cache.lines = std::move( newLines );
+
+		for ( auto it = cache.dirtyLines.begin(); it != cache.dirtyLines.end(); ) {
+			if ( it->second <= changeCounter )
+				it = cache.dirtyLines.erase( it );
+			else
+				++it;
+		}
+	} else {
+		for ( size_t i = 0; i < symbols.lines.size(); i++ ) {
+			Int64 line = symbols.lines[i].first;
+			for ( const auto& move : cache.moves ) {
+				line = moveLine( line, move.first, move.second );
+				if ( line < 0 )
+					break;
+			}
+			if ( line < 0 || line >= (Int64)cache.lines.size() )
+				continue;
+
+			std::vector<Uint32> lineIds( langIds( symbols.lines[i].second ) );
+			removeLangSymbols( lang, cache.lines[line] );
+			cache.lines[line] = std::move( lineIds );
+
+			// The line could have changed again while it was being scanned
+			auto dirty = cache.dirtyLines.find( line );
+			if ( dirty != cache.dirtyLines.end() && dirty->second == dirtyLines[i].second )
+				cache.dirtyLines.erase( dirty );
+		}
 	}
-	Log::debug( "Lang dictionary for %s updated in: %.2fms", langName.c_str(),
-				clock.getElapsedTime().asMilliseconds() );
+	cache.moves.clear();
+
+	Log::debug( "Dictionary for %s updated (%zu lines) in: %.2fms", doc->getFilename().c_str(),
+				symbols.lines.size(), clock.getElapsedTime().asMilliseconds() );
 }
 
 void AutoCompletePlugin::pickSuggestion( UICodeEditor* editor ) {
@@ -504,7 +742,7 @@ AutoCompletePlugin::processCodeCompletion( const LSPCompletionList& completion )
 		SymbolsList fuzzySuggestions;
 		{
 			Lock l2( mLangSymbolsMutex );
-			auto& symbols = mLangCache[lang];
+			auto& symbols = mLangCache[lang].symbols;
 			fuzzySuggestions = fuzzyMatchSymbols( { &suggestions, &symbols }, symbol,
 												  eemax<size_t>( 100UL, suggestions.size() ) );
 		}
@@ -600,21 +838,50 @@ void AutoCompletePlugin::update( UICodeEditor* ) {
 		mClock.restart();
 		mDirty = false;
 		Lock l( mDocMutex );
-		for ( auto& doc : mDocs ) {
-			if ( !doc->isLoading() && mDocCache[doc].changeId != doc->getCurrentChangeId() ) {
-				{
-					Lock lu( mDocsUpdatingMutex );
-					auto du = mDocsUpdating.find( doc );
-					// Dont update the document cache if it's still updating the document
-					if ( du != mDocsUpdating.end() && du->second == true )
-						continue;
-				}
+		for ( auto& docCache : mDocCache ) {
+			TextDocument* doc = docCache.first;
+			auto& cache = docCache.second;
+			// Dont update the document cache if it's still updating the document
+			if ( cache.closed || cache.updating || doc->isLoading() )
+				continue;
+
+			auto cursor = doc->getSelection().end();
+			// The symbol that was being written is indexed once the cursor leaves its line
+			if ( cache.ignoredLine >= 0 && cache.ignoredLine != cursor.line() ) {
+				cache.dirtyLines[cache.ignoredLine] = ++cache.changeCounter;
+				cache.ignoredLine = -1;
+			}
+
+			if ( (Int64)cache.lines.size() != (Int64)doc->linesCount() ||
+				 cache.lang != doc->getSyntaxDefinition().getLanguageName() )
+				cache.fullRebuild = true;
+
+			if ( !cache.fullRebuild && cache.dirtyLines.empty() )
+				continue;
+
+			bool fullRebuild = cache.fullRebuild;
+			std::vector<std::pair<Int64, Uint64>> dirtyLines;
+			if ( !fullRebuild )
+				dirtyLines.assign( cache.dirtyLines.begin(), cache.dirtyLines.end() );
+			auto current = getPartialSymbol( doc );
+			if ( !current.empty() &&
+				 ( fullRebuild || cache.dirtyLines.count( cursor.line() ) > 0 ) )
+				cache.ignoredLine = cursor.line();
+			auto changeCounter = cache.changeCounter;
+			auto snapshot = doc->getSnapshot();
+			cache.fullRebuild = false;
+			cache.updating = true;
+			cache.moves.clear();
 #if AUTO_COMPLETE_THREADED
-				mThreadPool->run( [this, doc] { updateDocCache( doc ); } );
+			mThreadPool->run( [this, doc, snapshot, dirtyLines, fullRebuild, changeCounter,
+							   current, cursor] {
+				updateDocCache( doc, snapshot, dirtyLines, fullRebuild, changeCounter, current,
+								cursor );
+			} );
 #else
-				updateDocCache( doc );
+			updateDocCache( doc, snapshot, dirtyLines, fullRebuild, changeCounter, current,
+							cursor );
 #endif
-			}
 		}
 	}
 }
@@ -948,27 +1215,38 @@ void AutoCompletePlugin::resetSignatureHelp() {
 	mSignatureHelpEditor = nullptr;
 }
 
-AutoCompletePlugin::SymbolsList AutoCompletePlugin::getDocumentSymbols( TextDocument* doc ) {
+AutoCompletePlugin::LinesSymbols
+AutoCompletePlugin::getLinesSymbols( const TextDocumentSnapshot& snapshot,
+									 const std::vector<Int64>& lines, const std::string& current,
+									 const TextPosition& end ) {
 	LuaPattern pattern( mSymbolPattern );
-	AutoCompletePlugin::SymbolsList symbols;
-	Int64 lc = doc->linesCount();
-	if ( lc == 0 || lc > 50000 || mShuttingDown )
-		return symbols;
-	std::string current( getPartialSymbol( doc ) );
-	TextPosition end = doc->getSelection().end();
-	for ( Int64 i = 0; i < lc; i++ ) {
-		const auto& string = doc->line( i ).getText().toUtf8();
-		for ( auto& match : pattern.gmatch( string ) ) {
-			std::string matchStr( match[0] );
-			// Ignore the symbol if is actually the current symbol being written
-			if ( matchStr.size() < 3 || ( end.line() == i && current == matchStr ) )
-				continue;
-			if ( std::none_of( symbols.begin(), symbols.end(),
-							   [matchStr]( const Suggestion& suggestion ) {
-								   return suggestion.text == matchStr;
-							   } ) )
-				symbols.push_back( std::move( matchStr ) );
+	LinesSymbols symbols;
+	std::unordered_map<std::string, Uint32> ids;
+	Int64 lc = snapshot.linesCount();
+	Int64 count = lines.empty() ? lc : lines.size();
+	symbols.lines.reserve( count );
+	for ( Int64 i = 0; i < count; i++ ) {
+		Int64 index = lines.empty() ? i : lines[i];
+		std::vector<Uint32> lineSymbols;
+		if ( index >= 0 && index < lc ) {
+			const auto& string = snapshot.line( index ).toUtf8();
+			for ( auto& match : pattern.gmatch( string ) ) {
+				std::string matchStr( match[0] );
+				// Ignore the symbol if is actually the current symbol being written
+				if ( matchStr.size() < 3 || ( end.line() == index && current == matchStr ) )
+					continue;
+				auto id = ids.find( matchStr );
+				Uint32 symbolId = id != ids.end() ? id->second : symbols.texts.size();
+				if ( id == ids.end() ) {
+					ids[matchStr] = symbolId;
+					symbols.texts.emplace_back( std::move( matchStr ) );
+				}
+				if ( std::find( lineSymbols.begin(), lineSymbols.end(), symbolId ) ==
+					 lineSymbols.end() )
+					lineSymbols.push_back( symbolId );
+			}
 		}
+		symbols.lines.emplace_back( index, std::move( lineSymbols ) );
 		if ( mShuttingDown )
 			break;
 	}
@@ -999,7 +1277,7 @@ void AutoCompletePlugin::updateSuggestions( const std::string& symbol, UICodeEdi
 	auto langSuggestions = mLangCache.find( lang );
 	if ( langSuggestions == mLangCache.end() )
 		return;
-	const auto& symbols = langSuggestions->second;
+	const auto& symbols = langSuggestions->second.symbols;
 	{
 #if AUTO_COMPLETE_THREADED
 		mThreadPool->run(
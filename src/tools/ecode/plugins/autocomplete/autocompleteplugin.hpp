@@ -10,7 +10,6 @@
 #include <eepp/system/sys.hpp>
 #include <eepp/system/threadpool.hpp>
 #include <eepp/ui/uicodeeditor.hpp>
-#include <set>
 #include <unordered_map>
 using namespace EE;
 using namespace EE::System;
@@ -115,17 +114,75 @@ class AutoCompletePlugin : public Plugin {
 	Mutex mDocMutex;
 	Time mUpdateFreq{ Seconds( 5 ) };
 	std::unordered_map<UICodeEditor*, std::vector<Uint32>> mEditors;
-	std::set<TextDocument*> mDocs;
 	std::unordered_map<UICodeEditor*, TextDocument*> mEditorDocs;
 	bool mDirty{ false };
 	bool mReplacing{ false };
 	bool mSignatureHelpVisible{ false };
+
+	class DocClient : public TextDocument::Client {
+	  public:
+		explicit DocClient( AutoCompletePlugin* parent, TextDocument* doc ) :
+			mDoc( doc ), mParent( parent ) {}
+
+		virtual void onDocumentTextChanged( const DocumentContentChange& ){};
+		virtual void onDocumentUndoRedo( const TextDocument::UndoRedo& ){};
+		virtual void onDocumentCursorChange( const TextPosition& ){};
+		virtual void onDocumentSelectionChange( const TextRange& ){};
+		virtual void onDocumentLineCountChange( const size_t&, const size_t& ){};
+		virtual void onDocumentLineChanged( const Int64& lineIndex );
+		virtual void onDocumentSaved( TextDocument* ){};
+		virtual void onDocumentClosed( TextDocument* );
+		virtual void onDocumentDirtyOnFileSystem( TextDocument* ){};
+		virtual void onDocumentMoved( TextDocument* ){};
+		// The editors send OnDocumentClosed and OnDocumentLoaded when the document is reloaded
+		virtual void onDocumentReloaded( TextDocument* ){};
+		virtual void onDocumentLineMove( const Int64& fromLine, const Int64& numLines );
+
+	  protected:
+		TextDocument* mDoc{ nullptr };
+		AutoCompletePlugin* mParent{ nullptr };
+	};
+
 	struct DocCache {
-		Uint64 changeId{ static_cast<Uint64>( -1 ) };
+		std::string lang;
+		// Ids (in the language cache) of the symbols found in every line
+		std::vector<std::vector<Uint32>> lines;
+		// Lines that must be scanned again, and the change counter when they were marked
+		std::unordered_map<Int64, Uint64> dirtyLines;
+		// Line moves since the running update was dispatched
+		std::vector<std::pair<Int64, Int64>> moves;
+		Uint64 changeCounter{ 0 };
+		// Line where the symbol being written was ignored
+		Int64 ignoredLine{ -1 };
+		bool fullRebuild{ true };
+		bool updating{ false };
+		// The document was destroyed
+		bool closed{ false };
+		std::unique_ptr<DocClient> client;
+	};
+
+	struct LangCache {
+		struct Entry {
+			Uint32 count{ 0 };
+			size_t index{ 0 };
+		};
 		SymbolsList symbols;
+		// Symbol id of every item in symbols
+		std::vector<Uint32> symbolsIds;
+		std::unordered_map<std::string, Uint32> ids;
+		std::vector<Entry> entries;
+		std::vector<Uint32> freeIds;
 	};
+
+	// Symbols found while scanning a set of lines, the lines reference the symbols by their index
+	// in texts
+	struct LinesSymbols {
+		std::vector<std::pair<Int64, std::vector<Uint32>>> lines;
+		std::vector<std::string> texts;
+	};
+
 	std::unordered_map<TextDocument*, DocCache> mDocCache;
-	std::unordered_map<std::string, SymbolsList> mLangCache;
+	std::unordered_map<std::string, LangCache> mLangCache;
 
 	std::vector<Suggestion> mSuggestions;
 	Mutex mSuggestionsEditorMutex;
@@ -142,8 +199,6 @@ class AutoCompletePlugin : public Plugin {
 	Int32 mSignatureHelpSelected{ -1 };
 	Mutex mHandlesMutex;
 	std::unordered_map<TextDocument*, std::vector<PluginIDType>> mHandles;
-	std::unordered_map<TextDocument*, std::atomic<bool>> mDocsUpdating;
-	Mutex mDocsUpdatingMutex;
 
 	Float mRowHeight{ 0 };
 	Rectf mBoxRect;
@@ -154,17 +209,44 @@ class AutoCompletePlugin : public Plugin {
 
 	void updateSuggestions( const std::string& symbol, UICodeEditor* editor );
 
-	SymbolsList getDocumentSymbols( TextDocument* );
+	/** Scans the symbols of the lines of the snapshot (all of them if lines is empty). current is
+	 * the symbol being written at the cursor position, that is ignored. */
+	LinesSymbols getLinesSymbols( const TextDocumentSnapshot& snapshot,
+								  const std::vector<Int64>& lines, const std::string& current,
+								  const TextPosition& end );
 
-	void updateDocCache( TextDocument* doc );
+	/** Updates the document symbols of the lines marked as dirty (or of every line if the
+	 * document needs a full rebuild) from a snapshot. */
+	void updateDocCache( TextDocument* doc, std::shared_ptr<const TextDocumentSnapshot> snapshot,
+						 std::vector<std::pair<Int64, Uint64>> dirtyLines, bool fullRebuild,
+						 Uint64 changeCounter, std::string current, TextPosition cursor );
+
+	void registerDoc( TextDocument* doc );
+
+	void unregisterDoc( TextDocument* doc );
+
+	void onDocumentLineChanged( TextDocument* doc, const Int64& lineIndex );
+
+	void onDocumentLineMove( TextDocument* doc, const Int64& fromLine, const Int64& numLines );
+
+	void onDocumentClosed( TextDocument* doc );
+
+	void onDocumentSyntaxDefinitionChange( TextDocument* doc, const std::string& newLang );
+
+	/** @return The id of the symbol in the language cache, adding it if it's not there. */
+	Uint32 getLangSymbolId( LangCache& lang, const std::string& symbol );
+
+	void releaseLangSymbol( LangCache& lang, Uint32 id );
+
+	void addLangSymbols( LangCache& lang, const std::vector<Uint32>& ids );
+
+	void removeLangSymbols( LangCache& lang, const std::vector<Uint32>& ids );
 
 	std::string getPartialSymbol( TextDocument* doc );
 
 	void runUpdateSuggestions( const std::string& symbol, const SymbolsList& symbols,
 							   UICodeEditor* editor );
 
-	void updateLangCache( const std::string& langName );
-
 	void pickSuggestion( UICodeEditor* editor );
 
 	PluginRequestHandle processResponse( const PluginMessage& msg );
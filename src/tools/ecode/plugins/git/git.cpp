@@ -556,15 +556,19 @@ Git::Result Git::gitSimple( const std::string& cmd, const std::string& projectDi
 	return res;
 }
 
-Git::Status Git::status( bool recurseSubmodules, const std::string& projectDir ) {
-	static constexpr auto DIFF_CMD = "diff --numstat";
-	static constexpr auto DIFF_STAGED_CMD = "diff --numstat --staged";
-	static constexpr auto STATUS_CMD = "-c color.status=never status -b -u -s";
+Git::Status Git::status( bool recurseSubmodules, const std::string& projectDir,
+						 std::vector<std::string> paths ) {
+	std::string pathsArgs( paths.empty() ? "" : " -- " + asList( paths ) );
+	const std::string DIFF_CMD( "diff --numstat" + pathsArgs );
+	const std::string DIFF_STAGED_CMD( "diff --numstat --staged" + pathsArgs );
+	const std::string STATUS_CMD( "-c color.status=never status -b -u -s" + pathsArgs );
 	Status s;
 	std::string buf;
 
 	getSubModules( projectDir );
 	bool submodules = hasSubmodules( projectDir );
+	if ( !pathsArgs.empty() )
+		recurseSubmodules = false;
 
 	std::string enteringPtrn( "^Entering '(.*)'" );
 	LuaPattern subModulePattern( enteringPtrn );
@@ -243,7 +243,10 @@ class Git {
 
 	std::unordered_map<std::string, std::string> branches( const std::vector<std::string>& repos );
 
-	Status status( bool recurseSubmodules, const std::string& projectDir = "" );
+	/** @return The status of the repository, or only the status of the paths (relative to the
+	 * project directory) if any is provided. Submodules are not recursed for paths. */
+	Status status( bool recurseSubmodules, const std::string& projectDir = "",
+				   std::vector<std::string> paths = {} );
 
 	Result add( std::vector<std::string> files, const std::string& projectDir = "" );
 
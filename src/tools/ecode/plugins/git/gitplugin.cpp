@@ -1,6 +1,7 @@
 #include "gitplugin.hpp"
 #include "gitbranchmodel.hpp"
 #include "gitstatusmodel.hpp"
+#include <algorithm>
 #include <eepp/graphics/primitives.hpp>
 #include <eepp/scene/scenemanager.hpp>
 #include <eepp/system/filesystem.hpp>
@@ -292,10 +293,115 @@ void GitPlugin::updateUI() {
 	if ( !mGit || !getUISceneNode() )
 		return;
 
-	getUISceneNode()->debounce( [this] { updateUINow(); }, mRefreshFreq,
+	getUISceneNode()->debounce( [this] { updateStatusPending(); }, mRefreshFreq,
 								String::hash( "git::status-update" ) );
 }
 
+// More changed paths than this are updated with the whole status
+static constexpr size_t MAX_STATUS_PATHS = 256;
+
+void GitPlugin::updateStatusPending() {
+	if ( !mGit || !getUISceneNode() )
+		return;
+
+	if ( mRunningUpdateStatus ) {
+		// Keep the pending changes for when the running update finishes
+		updateUI();
+		return;
+	}
+
+	std::vector<std::string> paths;
+	bool full = false;
+	{
+		Lock l( mStatusPendingMutex );
+		full = mStatusPendingFull;
+		for ( const auto& path : mStatusPendingPaths ) {
+			std::string relPath( path );
+			if ( !String::startsWith( relPath, mGit->getProjectPath() ) )
+				continue;
+			FileSystem::filePathRemoveBasePath( mGit->getProjectPath(), relPath );
+			// The submodules status is only known by running the whole status
+			if ( mGit->repoPath( relPath ) != mGit->getProjectPath() )
+				full = true;
+			paths.emplace_back( std::move( relPath ) );
+		}
+		mStatusPendingPaths.clear();
+		mStatusPendingFull = false;
+	}
+
+	if ( full || !mGitStatusSeeded || paths.size() > MAX_STATUS_PATHS || gitMetadataChanged() ) {
+		updateUINow();
+	} else if ( !paths.empty() ) {
+		updateStatus( false, std::move( paths ) );
+	}
+}
+
+bool GitPlugin::gitMetadataChanged() {
+	std::string gitFolder( mGit->getGitFolder() );
+	// Worktrees and submodules keep the metadata somewhere else
+	if ( !FileSystem::isDirectory( gitFolder ) )
+		return true;
+	FileSystem::dirAddSlashAtEnd( gitFolder );
+	Uint64 indexTime = FileInfo( gitFolder + "index" ).getModificationTime();
+	Uint64 headTime = FileInfo( gitFolder + "HEAD" ).getModificationTime();
+	bool indexChanged = mGitIndexModificationTime.exchange( indexTime ) != indexTime;
+	bool headChanged = mGitHeadModificationTime.exchange( headTime ) != headTime;
+	return indexChanged || headChanged;
+}
+
+Git::Status GitPlugin::statusWithPaths( Git::Status status,
+										const std::vector<std::string>& paths ) {
+	Git::Status changes( mGit->status( false, "", paths ) );
+	UnorderedSet<std::string> reposChanged;
+
+	for ( const auto& path : paths ) {
+		auto repoIt = status.files.find( mGit->repoName( path ) );
+		if ( repoIt == status.files.end() )
+			continue;
+		std::string dir( path );
+		FileSystem::dirAddSlashAtEnd( dir );
+		auto& files = repoIt->second;
+		files.erase( std::remove_if( files.begin(), files.end(),
+									 [&path, &dir]( const Git::DiffFile& file ) {
+										 return file.file == path ||
+												String::startsWith( file.file, dir );
+									 } ),
+					 files.end() );
+		reposChanged.insert( repoIt->first );
+	}
+
+	for ( auto& repo : changes.files ) {
+		auto& files = status.files[repo.first];
+		for ( auto& file : repo.second )
+			files.emplace_back( std::move( file ) );
+		reposChanged.insert( repo.first );
+	}
+
+	for ( const auto& repo : reposChanged ) {
+		auto& files = status.files[repo];
+		if ( files.empty() ) {
+			status.files.erase( repo );
+			continue;
+		}
+		std::stable_sort(
+			files.begin(), files.end(),
+			[]( const Git::DiffFile& left, const Git::DiffFile& right ) {
+				return left.file < right.file;
+			} );
+	}
+
+	status.totalInserts = 0;
+	status.totalDeletions = 0;
+	for ( const auto& repo : status.files ) {
+		for ( const auto& file : repo.second ) {
+			status.totalInserts += file.inserts;
+			status.totalDeletions += file.deletes;
+		}
+	}
+
+	return status;
+}
+
 void GitPlugin::updateStatusBarSync() {
 	buildSidePanelTab();
 
@@ -387,24 +493,38 @@ void GitPlugin::updateStatusBarSync() {
 	mStatusButton->invalidateDraw();
 }
 
-void GitPlugin::updateStatus( bool force ) {
+void GitPlugin::updateStatus( bool force, std::vector<std::string> paths ) {
 	if ( !mGit || !mGitFound || mRunningUpdateStatus )
 		return;
 	mRunningUpdateStatus++;
 	mThreadPool->run(
-		[this, force] {
+		[this, force, paths = std::move( paths )] {
 			if ( !mGit || mGit->getGitFolder().empty() ) {
 				getUISceneNode()->runOnMainThread( [this] { updateStatusBarSync(); } );
 				return;
 			}
 
-			auto prevBranch = updateReposBranches();
+			decltype( mGitBranches ) prevBranch;
+			if ( paths.empty() ) {
+				prevBranch = updateReposBranches();
+			} else {
+				Lock l( mGitBranchMutex );
+				prevBranch = mGitBranches;
+			}
 			Git::Status prevGitStatus;
 			{
 				Lock l( mGitStatusMutex );
 				prevGitStatus = mGitStatus;
 			}
-			Git::Status newGitStatus = mGit->status( mStatusRecurseSubmodules );
+			Git::Status newGitStatus;
+			if ( paths.empty() ) {
+				// Remember the metadata state this status belongs to
+				gitMetadataChanged();
+				newGitStatus = mGit->status( mStatusRecurseSubmodules );
+				mGitStatusSeeded = true;
+			} else {
+				newGitStatus = statusWithPaths( prevGitStatus, paths );
+			}
 			UnorderedSet<std::string> cache;
 
 			for ( const auto& status : newGitStatus.files ) {
@@ -442,6 +562,7 @@ PluginRequestHandle GitPlugin::processMessage( const PluginMessage& msg ) {
 		case PluginMessageType::WorkspaceFolderChanged: {
 			if ( mGit ) {
 				mGit->setProjectPath( msg.asJSON()["folder"] );
+				mGitStatusSeeded = false;
 
 				{
 					Lock l( mGitBranchMutex );
@@ -495,9 +616,21 @@ void GitPlugin::onFileSystemEvent( const FileEvent& ev, const FileInfo& file ) {
 	if ( mShuttingDown || isLoading() )
 		return;
 
-	if ( String::startsWith( file.getFilepath(), mGit->getGitFolder() ) &&
-		 ( file.getExtension() == "lock" || file.isDirectory() ) )
-		return;
+	if ( String::startsWith( file.getFilepath(), mGit->getGitFolder() ) ) {
+		if ( file.getExtension() == "lock" || file.isDirectory() )
+			return;
+		// The index, HEAD or the refs changed, everything must be updated
+		Lock l( mStatusPendingMutex );
+		mStatusPendingFull = true;
+	} else {
+		Lock l( mStatusPendingMutex );
+		mStatusPendingPaths.insert( file.getFilepath() );
+		if ( ev.type == FileSystemEventType::Moved && !ev.oldFilename.empty() ) {
+			std::string dir( ev.directory );
+			FileSystem::dirAddSlashAtEnd( dir );
+			mStatusPendingPaths.insert( dir + ev.oldFilename );
+		}
+	}
 
 	updateUI();
 }
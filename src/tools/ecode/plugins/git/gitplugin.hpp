@@ -117,6 +117,14 @@ class GitPlugin : public PluginBase {
 	UILoader* mLoader{ nullptr };
 	std::atomic<int> mRunningUpdateBranches{ 0 };
 	std::atomic<int> mRunningUpdateStatus{ 0 };
+	// Paths changed since the last status update, mGitStatus is only updated for them unless
+	// something changed inside the git folder
+	UnorderedSet<std::string> mStatusPendingPaths;
+	bool mStatusPendingFull{ false };
+	Mutex mStatusPendingMutex;
+	std::atomic<bool> mGitStatusSeeded{ false };
+	std::atomic<Uint64> mGitIndexModificationTime{ 0 };
+	std::atomic<Uint64> mGitHeadModificationTime{ 0 };
 	Clock mLastBranchesUpdate;
 	Mutex mGitBranchMutex;
 	Mutex mGitStatusMutex;
@@ -188,7 +196,13 @@ class GitPlugin : public PluginBase {
 
 	void openFile( const std::string& file );
 
-	void updateStatus( bool force = false );
+	void updateStatus( bool force = false, std::vector<std::string> paths = {} );
+
+	void updateStatusPending();
+
+	Git::Status statusWithPaths( Git::Status status, const std::vector<std::string>& paths );
+
+	bool gitMetadataChanged();
 
 	void updateStatusBarSync();
 
@@ -32,7 +32,8 @@ Plugin* LinterPlugin::NewSync( PluginManager* pluginManager ) {
 	return eeNew( LinterPlugin, ( pluginManager, true ) );
 }
 
-LinterPlugin::LinterPlugin( PluginManager* pluginManager, bool sync ) : Plugin( pluginManager ) {
+LinterPlugin::LinterPlugin( PluginManager* pluginManager, bool sync ) :
+	Plugin( pluginManager ), mMaxJobs( eemax( 1, Sys::getCPUCount() / 2 ) ) {
 	if ( sync ) {
 		load( pluginManager );
 	} else {
@@ -49,11 +50,33 @@ LinterPlugin::~LinterPlugin() {
 	mManager->unsubscribeMessages( this );
 	unsubscribeFileSystemListener();
 
+	{
+		std::lock_guard l( mLintQueueMutex );
+		mLintQueue.clear();
+		mLintRequests.clear();
+	}
+
+	{
+		std::lock_guard l( mRunningProcessesMutex );
+		for ( auto& process : mRunningProcesses )
+			process.second->kill();
+	}
+
 	if ( mWorkersCount != 0 ) {
 		std::unique_lock<std::mutex> lock( mWorkMutex );
 		mWorkerCondition.wait( lock, [this]() { return mWorkersCount <= 0; } );
 	}
 
+	{
+		// onUnregister skips the cleanup while shutting down, remove the temporary copies here
+		std::lock_guard l( mLintQueueMutex );
+		for ( const auto& tempFile : mTempFiles ) {
+			if ( !tempFile.second.inDocFolder && !tempFile.second.path.empty() )
+				FileSystem::fileRemove( tempFile.second.path );
+		}
+		mTempFiles.clear();
+	}
+
 	for ( const auto& editor : mEditors ) {
 		for ( auto& kb : mKeyBindings ) {
 			editor.first->getKeyBindings().removeCommandKeybind( kb.first );
@@ -108,6 +131,11 @@ void LinterPlugin::loadLinterConfig( const std::string& path, bool updateConfigF
 		else if ( updateConfigFile )
 			config["delay_time"] = getDelayTime().toString();
 
+		if ( config.contains( "max_jobs" ) && config["max_jobs"].is_number_integer() )
+			mMaxJobs = eemax( 1, config["max_jobs"].get<int>() );
+		else if ( updateConfigFile )
+			config["max_jobs"] = mMaxJobs;
+
 		if ( config.contains( "enable_lsp_diagnostics" ) &&
 			 config["enable_lsp_diagnostics"].is_boolean() )
 			setEnableLSPDiagnostics( config["enable_lsp_diagnostics"].get<bool>() );
@@ -610,6 +638,7 @@ void LinterPlugin::onRegister( UICodeEditor* editor ) {
 			TextDocument* doc = docEvent->getDoc();
 			mDocs.erase( doc );
 			mDirtyDoc.erase( doc );
+			removeLintRequests( doc );
 			Lock matchesLock( mMatchesMutex );
 			mMatches.erase( doc );
 		} ) );
@@ -683,6 +712,7 @@ void LinterPlugin::onUnregister( UICodeEditor* editor ) {
 
 	mDocs.erase( doc );
 	mDirtyDoc.erase( doc );
+	removeLintRequests( doc );
 	Lock matchesLock( mMatchesMutex );
 	mMatches.erase( doc );
 }
@@ -692,14 +722,96 @@ void LinterPlugin::update( UICodeEditor* editor ) {
 	auto it = mDirtyDoc.find( doc.get() );
 	if ( it != mDirtyDoc.end() && it->second->getElapsedTime() >= mDelayTime ) {
 		mDirtyDoc.erase( doc.get() );
+		scheduleLint( doc );
+	}
+}
+
+void LinterPlugin::scheduleLint( std::shared_ptr<TextDocument> doc ) {
+	{
+		std::lock_guard l( mLintQueueMutex );
+		Uint64 modificationId = doc->getModificationId();
+		auto request = mLintRequests.find( doc.get() );
+		if ( request == mLintRequests.end() ) {
+			mLintQueue.push_back( doc.get() );
+			mLintRequests[doc.get()] = { doc, modificationId, Clock() };
+		} else {
+			// A newer version replaces the one waiting
+			request->second.modificationId = modificationId;
+		}
+
+		// The running lint of an older version is useless now
+		auto running = mLintsRunning.find( doc.get() );
+		if ( running != mLintsRunning.end() && running->second != modificationId ) {
+			std::lock_guard pl( mRunningProcessesMutex );
+			auto process = mRunningProcesses.find( doc.get() );
+			if ( process != mRunningProcesses.end() )
+				process->second->kill();
+		}
+	}
+
+	runLintQueue();
+}
+
+void LinterPlugin::runLintQueue() {
+	std::vector<LintRequest> requests;
+	{
+		std::lock_guard l( mLintQueueMutex );
+		for ( auto it = mLintQueue.begin();
+			  it != mLintQueue.end() && mLintsRunning.size() < mMaxJobs && !mShuttingDown; ) {
+			// Only one lint per document runs at a time, the next one waits for it
+			if ( mLintsRunning.find( *it ) != mLintsRunning.end() ) {
+				++it;
+				continue;
+			}
+			auto request = mLintRequests.find( *it );
+			mLintsRunning[*it] = request->second.modificationId;
+			requests.emplace_back( std::move( request->second ) );
+			mLintRequests.erase( request );
+			it = mLintQueue.erase( it );
+		}
+	}
+
+	for ( auto& request : requests ) {
+		const auto run = [this, request] {
+			ScopedOp op(
+				[this]() {
+					std::lock_guard l( mWorkMutex );
+					mWorkersCount++;
+				},
+				[this]() {
+					{
+						std::lock_guard l( mWorkMutex );
+						mWorkersCount--;
+					}
+					mWorkerCondition.notify_all();
+				} );
+			lintDoc( request.doc, request.queued.getElapsedTime() );
+			{
+				std::lock_guard l( mLintQueueMutex );
+				mLintsRunning.erase( request.doc.get() );
+			}
+			runLintQueue();
+		};
 #if LINTER_THREADED
-		mThreadPool->run( [this, doc] { lintDoc( doc ); } );
+		mThreadPool->run( run );
 #else
-		lintDoc( doc );
+		run();
 #endif
 	}
 }
 
+void LinterPlugin::removeLintRequests( TextDocument* doc ) {
+	std::lock_guard l( mLintQueueMutex );
+	if ( mLintRequests.erase( doc ) > 0 )
+		mLintQueue.erase( std::find( mLintQueue.begin(), mLintQueue.end(), doc ) );
+	auto tempFile = mTempFiles.find( doc );
+	if ( tempFile != mTempFiles.end() ) {
+		if ( !tempFile->second.inDocFolder )
+			FileSystem::fileRemove( tempFile->second.path );
+		mTempFiles.erase( tempFile );
+	}
+}
+
 const Time& LinterPlugin::getDelayTime() const {
 	return mDelayTime;
 }
@@ -739,61 +851,68 @@ Linter LinterPlugin::getLinterForLang( const std::string& lang ) {
 	return {};
 }
 
-void LinterPlugin::lintDoc( std::shared_ptr<TextDocument> doc ) {
+void LinterPlugin::lintDoc( std::shared_ptr<TextDocument> doc, const Time& queueTime ) {
 	if ( !mLanguagesDisabled.empty() &&
 		 mLanguagesDisabled.find( doc->getSyntaxDefinition().getLSPName() ) !=
 			 mLanguagesDisabled.end() )
 		return;
 
-	ScopedOp op(
-		[this, doc]() {
-			std::lock_guard l( mWorkMutex );
-			mWorkersCount++;
-		},
-		[this]() {
-			{
-				std::lock_guard l( mWorkMutex );
-				mWorkersCount--;
-			}
-			mWorkerCondition.notify_all();
-		} );
 	if ( !mReady )
 		return;
 	auto linter = supportsLinter( doc );
 	if ( linter.command.empty() )
 		return;
 
+	Uint64 modificationId = doc->getModificationId();
 	IOStreamString fileString;
 	if ( doc->isDirty() || !doc->hasFilepath() ) {
-		std::string tmpPath;
-		if ( !doc->hasFilepath() ) {
-			tmpPath =
-				Sys::getTempPath() + ".ecode-" + doc->getFilename() + "." + String::randString( 8 );
-		} else if ( linter.useTmpFolder ) {
-			tmpPath = Sys::getTempPath() + doc->getFilename();
-			if ( FileSystem::fileExists( tmpPath ) ) {
-				tmpPath = Sys::getTempPath() + ".ecode-" + doc->getFilename() + "." +
-						  String::randString( 8 );
+		bool inDocFolder = doc->hasFilepath() && !linter.useTmpFolder;
+		TempFile tempFile;
+		{
+			std::lock_guard l( mLintQueueMutex );
+			tempFile = mTempFiles[doc.get()];
+		}
+
+		if ( tempFile.path.empty() || tempFile.filename != doc->getFilename() ||
+			 tempFile.inDocFolder != inDocFolder ) {
+			if ( !tempFile.path.empty() && !tempFile.inDocFolder )
+				FileSystem::fileRemove( tempFile.path );
+			tempFile.filename = doc->getFilename();
+			tempFile.inDocFolder = inDocFolder;
+			if ( !doc->hasFilepath() ) {
+				tempFile.path = Sys::getTempPath() + ".ecode-" + doc->getFilename() + "." +
+								String::randString( 8 );
+			} else if ( linter.useTmpFolder ) {
+				tempFile.path = Sys::getTempPath() + doc->getFilename();
+				if ( FileSystem::fileExists( tempFile.path ) ) {
+					tempFile.path = Sys::getTempPath() + ".ecode-" + doc->getFilename() + "." +
+									String::randString( 8 );
+				}
+			} else {
+				std::string fileDir( FileSystem::fileRemoveFileName( doc->getFilePath() ) );
+				FileSystem::dirAddSlashAtEnd( fileDir );
+				tempFile.path = fileDir + "." + String::randString( 8 ) + "." + doc->getFilename();
 			}
-		} else {
-			std::string fileDir( FileSystem::fileRemoveFileName( doc->getFilePath() ) );
-			FileSystem::dirAddSlashAtEnd( fileDir );
-			tmpPath = fileDir + "." + String::randString( 8 ) + "." + doc->getFilename();
+			std::lock_guard l( mLintQueueMutex );
+			mTempFiles[doc.get()] = tempFile;
 		}
 
 		doc->save( fileString, true );
-		FileSystem::fileWrite( tmpPath, (Uint8*)fileString.getStreamPointer(),
+		FileSystem::fileWrite( tempFile.path, (Uint8*)fileString.getStreamPointer(),
 							   fileString.getSize() );
-		FileSystem::fileHide( tmpPath );
-		runLinter( doc, linter, tmpPath );
-		FileSystem::fileRemove( tmpPath );
+		FileSystem::fileHide( tempFile.path );
+		runLinter( doc, linter, tempFile.path, modificationId, queueTime );
+		// The copies next to the document would be visible to other tools, they are not kept
+		if ( inDocFolder )
+			FileSystem::fileRemove( tempFile.path );
 	} else {
-		runLinter( doc, linter, doc->getFilePath() );
+		runLinter( doc, linter, doc->getFilePath(), modificationId, queueTime );
 	}
 }
 
 void LinterPlugin::runLinter( std::shared_ptr<TextDocument> doc, const Linter& linter,
-							  const std::string& path ) {
+							  const std::string& path, const Uint64& modificationId,
+							  const Time& queueTime ) {
 	Clock clock;
 	std::string cmd( linter.command );
 	String::replaceAll( cmd, "$FILENAME", "\"" + path + "\"" );
@@ -827,6 +946,12 @@ void LinterPlugin::runLinter( std::shared_ptr<TextDocument> doc, const Linter& l
 		process.join( &returnCode );
 		process.destroy();
 
+		// The document changed while it was being linted, a newer lint will report it
+		if ( doc->getModificationId() != modificationId ) {
+			Log::debug( "LinterPlugin::runLinter for %s discarded stale results", path.c_str() );
+			return;
+		}
+
 		if ( linter.hasNoErrorsExitCode && linter.noErrorsExitCode == returnCode ) {
 			Lock matchesLock( mMatchesMutex );
 			mMatches[doc.get()] = {};
@@ -943,10 +1068,11 @@ void LinterPlugin::runLinter( std::shared_ptr<TextDocument> doc, const Linter& l
 
 		setMatches( doc.get(), MatchOrigin::Linter, matches );
 
-		Log::info( "LinterPlugin::runLinter for %s took %.2fms. Found: %d matches. Errors: %d, "
-				   "Warnings: %d, Notices: %d.",
-				   path.c_str(), clock.getElapsedTime().asMilliseconds(), totalMatches, totalErrors,
-				   totalWarns, totalNotice );
+		Log::info( "LinterPlugin::runLinter for %s took %.2fms (queued %.2fms). Found: %d matches. "
+				   "Errors: %d, Warnings: %d, Notices: %d.",
+				   path.c_str(), clock.getElapsedTime().asMilliseconds(),
+				   queueTime.asMilliseconds(), totalMatches, totalErrors, totalWarns,
+				   totalNotice );
 	}
 }
 
@@ -8,6 +8,7 @@
 #include <eepp/system/process.hpp>
 #include <eepp/system/threadpool.hpp>
 #include <eepp/ui/uicodeeditor.hpp>
+#include <deque>
 #include <memory>
 #include <set>
 using namespace EE;
@@ -128,6 +129,26 @@ class LinterPlugin : public Plugin {
 	std::mutex mRunningProcessesMutex;
 	std::unordered_map<TextDocument*, Process*> mRunningProcesses;
 
+	// Lints waiting for a free job, one per document (the latest version requested)
+	struct LintRequest {
+		std::shared_ptr<TextDocument> doc;
+		Uint64 modificationId{ 0 };
+		Clock queued;
+	};
+	std::mutex mLintQueueMutex;
+	std::deque<TextDocument*> mLintQueue;
+	std::unordered_map<TextDocument*, LintRequest> mLintRequests;
+	// Documents being linted and the version being linted
+	std::unordered_map<TextDocument*, Uint64> mLintsRunning;
+	// Temporary copies of the dirty documents, reused between runs
+	struct TempFile {
+		std::string path;
+		std::string filename;
+		bool inDocFolder{ false };
+	};
+	std::unordered_map<TextDocument*, TempFile> mTempFiles;
+	size_t mMaxJobs{ 1 };
+
 	bool mHoveringMatch{ false };
 	bool mEnableLSPDiagnostics{ true };
 	bool mErrorLens{ true };
@@ -142,10 +163,17 @@ class LinterPlugin : public Plugin {
 
 	void load( PluginManager* pluginManager );
 
-	void lintDoc( std::shared_ptr<TextDocument> doc );
+	void scheduleLint( std::shared_ptr<TextDocument> doc );
+
+	void runLintQueue();
+
+	void removeLintRequests( TextDocument* doc );
+
+	void lintDoc( std::shared_ptr<TextDocument> doc, const Time& queueTime );
 
 	void runLinter( std::shared_ptr<TextDocument> doc, const Linter& linter,
-					const std::string& path );
+					const std::string& path, const Uint64& modificationId,
+					const Time& queueTime );
 
 	Linter supportsLinter( std::shared_ptr<TextDocument> doc );
 
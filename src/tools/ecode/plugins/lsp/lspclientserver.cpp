@@ -10,6 +10,7 @@
 #include <eepp/ui/doc/textdocument.hpp>
 #include <eepp/window/engine.hpp>
 #include <list>
+#include <unordered_set>
 
 namespace ecode {
 
@@ -1154,6 +1155,7 @@ LSPClientServer::LSPClientServer( LSPClientServerManager* manager, const String:
 
 LSPClientServer::~LSPClientServer() {
 	shutdown();
+	stopReceiving();
 	eeSAFE_DELETE( mSocket );
 	{
 		Lock l( mClientsMutex );
@@ -1168,6 +1170,7 @@ bool LSPClientServer::socketConnect() {
 		Sys::sleep( Milliseconds( 250 ) ); // We wait a reasonable time, otherwise it seems that
 										   // some servers will not respond correctly
 		if ( Socket::Done == mSocket->connect( mLSP.host, mLSP.port, Seconds( 3 ) ) ) {
+			startReceiving();
 			mSocket->startAsyncRead(
 				[this]( const char* bytes, size_t n ) { readStdOut( bytes, n ); } );
 			return true;
@@ -1199,6 +1202,7 @@ bool LSPClientServer::start() {
 		if ( ret && mProcess.isAlive() ) {
 			mUsingProcess = true;
 
+			startReceiving();
 			mProcess.startAsyncRead(
 				[this]( const char* bytes, size_t n ) { readStdOut( bytes, n ); },
 				[this]( const char* bytes, size_t n ) { readStdErr( bytes, n ); } );
@@ -1270,12 +1274,28 @@ const LSPServerCapabilities& LSPClientServer::getCapabilities() const {
 
 LSPClientServer::LSPRequestHandle LSPClientServer::cancel( const PluginIDType& reqid ) {
 	size_t res = 0;
+	PluginIDType sentId( reqid );
 	{
 		Lock l( mHandlersMutex );
 		res = mHandlers.erase( reqid ) > 0;
+		auto shared = mSharedWith.find( reqid );
+		if ( shared != mSharedWith.end() ) {
+			sentId = shared->second;
+			mSharedWith.erase( shared );
+			auto& callers = mSharedReplies[sentId];
+			callers.erase( std::remove( callers.begin(), callers.end(), reqid ), callers.end() );
+			if ( callers.empty() )
+				mSharedReplies.erase( sentId );
+		}
+		// The request sent is only cancelled once none of its callers waits for the reply
+		if ( mHandlers.find( sentId ) != mHandlers.end() ||
+			 mSharedReplies.find( sentId ) != mSharedReplies.end() )
+			res = 0;
+		else if ( res > 0 )
+			eraseSupersedableRequest( sentId );
 	}
 	if ( res > 0 ) {
-		auto params = newID( reqid );
+		auto params = newID( sentId );
 		if ( needsAsync() ) {
 			sendAsync( newRequest( "$/cancelRequest", params ) );
 			return {};
@@ -1285,6 +1305,22 @@ LSPClientServer::LSPRequestHandle LSPClientServer::cancel( const PluginIDType& r
 	return LSPRequestHandle();
 }
 
+// Requests that lose their purpose once a newer one for the same document is sent (the cursor or
+// the mouse moved), so the newer request replaces the pending one
+static const std::unordered_set<std::string> SUPERSEDABLE_METHODS = {
+	"textDocument/hover", "textDocument/completion", "textDocument/signatureHelp",
+	"textDocument/documentHighlight" };
+
+static std::string getSupersedeKey( const json& msg ) {
+	if ( !msg.contains( MEMBER_METHOD ) || !msg[MEMBER_METHOD].is_string() ||
+		 SUPERSEDABLE_METHODS.count( msg[MEMBER_METHOD].get<std::string>() ) == 0 ||
+		 !msg.contains( MEMBER_PARAMS ) || !msg[MEMBER_PARAMS].contains( MEMBER_TEXTDOCUMENT ) ||
+		 !msg[MEMBER_PARAMS][MEMBER_TEXTDOCUMENT].contains( MEMBER_URI ) )
+		return "";
+	return msg[MEMBER_METHOD].get<std::string>() + " " +
+		   msg[MEMBER_PARAMS][MEMBER_TEXTDOCUMENT][MEMBER_URI].get<std::string>();
+}
+
 LSPClientServer::LSPRequestHandle LSPClientServer::write( json&& msg, const JsonReplyHandler& h,
 														  const JsonReplyHandler& eh,
 														  const int id ) {
@@ -1296,13 +1332,52 @@ LSPClientServer::LSPRequestHandle LSPClientServer::write( json&& msg, const Json
 
 	msg["jsonrpc"] = "2.0";
 
+	bool sendNow =
+		mReady || ( msg.contains( MEMBER_METHOD ) && msg[MEMBER_METHOD] == "initialize" );
+
 	// notification == no handler
 	if ( h ) {
+		// Queued messages are written again once the server is ready
+		std::string supersedeKey( sendNow ? getSupersedeKey( msg ) : "" );
+		PluginIDType supersededId;
 		int msgId = ++mLastMsgId;
 		msg[MEMBER_ID] = msgId;
 		ret.mId = msgId;
-		Lock l( mHandlersMutex );
-		mHandlers[msgId] = { h, eh };
+		{
+			Lock l( mHandlersMutex );
+			if ( !supersedeKey.empty() ) {
+				auto latest = mSupersedableRequests.find( supersedeKey );
+				if ( latest != mSupersedableRequests.end() ) {
+					// Still pending while the first caller or any caller sharing it waits
+					auto shared = mSharedReplies.find( latest->second.id );
+					if ( mHandlers.find( latest->second.id ) != mHandlers.end() ||
+						 shared != mSharedReplies.end() ) {
+						if ( latest->second.params == msg[MEMBER_PARAMS] ) {
+							// The same request is still waiting for its reply, share it. The
+							// caller gets its own id, so it can cancel only its handler.
+							mHandlers[msgId] = { h, eh };
+							mSharedReplies[latest->second.id].push_back( msgId );
+							mSharedWith[msgId] = latest->second.id;
+							return ret;
+						}
+						mHandlers.erase( latest->second.id );
+						if ( shared != mSharedReplies.end() ) {
+							for ( const auto& callerId : shared->second ) {
+								mHandlers.erase( callerId );
+								mSharedWith.erase( callerId );
+							}
+							mSharedReplies.erase( shared );
+						}
+						supersededId = latest->second.id;
+					}
+				}
+				mSupersedableRequests[supersedeKey] = { msgId, msg[MEMBER_PARAMS] };
+			}
+			mHandlers[msgId] = { h, eh };
+		}
+		// The reply of the replaced request won't be used, let the server stop working on it
+		if ( supersededId.isValid() )
+			write( newRequest( "$/cancelRequest", newID( supersededId ) ) );
 	} else if ( id ) {
 		msg[MEMBER_ID] = id;
 	}
@@ -1311,7 +1386,7 @@ LSPClientServer::LSPRequestHandle LSPClientServer::write( json&& msg, const Json
 		std::string sjson( msg.dump() );
 		sjson.insert( 0, "Content-Length: " + String::toString( sjson.size() ) + "\r\n\r\n" );
 
-		if ( mReady || ( msg.contains( MEMBER_METHOD ) && msg[MEMBER_METHOD] == "initialize" ) ) {
+		if ( sendNow ) {
 			if ( !isSilent() ) {
 				std::string method;
 				if ( msg.contains( MEMBER_METHOD ) )
@@ -1492,6 +1567,16 @@ bool LSPClientServer::hasDocuments() const {
 }
 
 LSPClientServer::LSPRequestHandle LSPClientServer::didClose( const URI& document ) {
+	{
+		Lock l( mHandlersMutex );
+		std::string uriSuffix( " " + document.toString() );
+		for ( auto it = mSupersedableRequests.begin(); it != mSupersedableRequests.end(); ) {
+			if ( String::endsWith( it->first, uriSuffix ) )
+				it = mSupersedableRequests.erase( it );
+			else
+				++it;
+		}
+	}
 	auto params = textDocumentParams( document );
 	return send( newRequest( "textDocument/didClose", params ) );
 }
@@ -1739,16 +1824,174 @@ void LSPClientServer::processRequest( const json& msg ) {
 }
 
 void LSPClientServer::readStdOut( const char* bytes, size_t n ) {
-	mReceive.append( bytes, n );
+	// The reader thread only buffers the bytes, the messages can be megabytes of json and parsing
+	// them here would stall the reads
+	std::lock_guard<std::mutex> l( mIncomingMutex );
+	if ( mReceiveClosing )
+		return;
+	mIncoming.append( bytes, n );
+	mIncomingCond.notify_one();
+}
+
+void LSPClientServer::startReceiving() {
+	std::lock_guard<std::mutex> l( mIncomingMutex );
+	if ( !mReceiveThread.joinable() && !mReceiveClosing )
+		mReceiveThread = std::thread( [this] { receiveLoop(); } );
+}
 
+void LSPClientServer::stopReceiving() {
+	{
+		std::lock_guard<std::mutex> l( mIncomingMutex );
+		mReceiveClosing = true;
+		mIncomingCond.notify_one();
+	}
+	if ( mReceiveThread.joinable() )
+		mReceiveThread.join();
+}
+
+void LSPClientServer::receiveLoop() {
+	std::unique_lock<std::mutex> l( mIncomingMutex );
+	while ( true ) {
+		mIncomingCond.wait( l, [this] { return mReceiveClosing || !mIncoming.empty(); } );
+		if ( mReceiveClosing )
+			break;
+		if ( mReceive.empty() ) {
+			mReceive.swap( mIncoming );
+		} else {
+			mReceive.append( mIncoming );
+			mIncoming.clear();
+		}
+		l.unlock();
+		processReceived();
+		l.lock();
+	}
+}
+
+namespace {
+
+// Reads the top level members of a message until it knows if it's a reply and its id, so the
+// replies nobody waits for anymore can be dropped without building the json
+class ReplyIdReader : public json::json_sax_t {
+  public:
+	PluginIDType id;
+	bool isReply{ false };
+	bool isRequest{ false };
+
+	bool null() override { return value(); }
+
+	bool boolean( bool ) override { return value(); }
+
+	bool number_integer( number_integer_t val ) override {
+		if ( readingId )
+			id = PluginIDType( (Int64)val );
+		return value();
+	}
+
+	bool number_unsigned( number_unsigned_t val ) override {
+		if ( readingId )
+			id = PluginIDType( (Int64)val );
+		return value();
+	}
+
+	bool number_float( number_float_t, const string_t& ) override { return value(); }
+
+	bool string( string_t& val ) override {
+		if ( readingId )
+			id = PluginIDType( val );
+		return value();
+	}
+
+	bool binary( binary_t& ) override { return value(); }
+
+	bool start_object( std::size_t ) override {
+		readingId = false;
+		depth++;
+		return true;
+	}
+
+	bool key( string_t& val ) override {
+		if ( depth != 1 )
+			return true;
+		if ( val == "id" ) {
+			readingId = true;
+		} else if ( val == "method" ) {
+			isRequest = true;
+			return false;
+		} else if ( val == "result" || val == "error" ) {
+			isReply = true;
+			return !id.isValid();
+		}
+		return true;
+	}
+
+	bool end_object() override {
+		depth--;
+		return true;
+	}
+
+	bool start_array( std::size_t ) override {
+		readingId = false;
+		depth++;
+		return true;
+	}
+
+	bool end_array() override {
+		depth--;
+		return true;
+	}
+
+	bool parse_error( std::size_t, const std::string&, const json::exception& ) override {
+		return false;
+	}
+
+  protected:
+	size_t depth{ 0 };
+	bool readingId{ false };
+
+	bool value() {
+		readingId = false;
+		return !( isReply && id.isValid() );
+	}
+};
+
+} // namespace
+
+bool LSPClientServer::isLateReply( const char* payload, size_t length ) {
+	ReplyIdReader reader;
+	json::sax_parse( payload, payload + length, &reader );
+	if ( !reader.isReply || reader.isRequest || !reader.id.isValid() )
+		return false;
+	Lock l( mHandlersMutex );
+	if ( mHandlers.find( reader.id ) != mHandlers.end() ||
+		 mSharedReplies.find( reader.id ) != mSharedReplies.end() )
+		return false;
+	eraseSupersedableRequest( reader.id );
+	return true;
+}
+
+void LSPClientServer::eraseSupersedableRequest( const PluginIDType& id ) {
+	// Only one request per method and document is kept, a scan is cheaper than another index
+	for ( auto it = mSupersedableRequests.begin(); it != mSupersedableRequests.end(); ++it ) {
+		if ( it->second.id == id ) {
+			mSupersedableRequests.erase( it );
+			return;
+		}
+	}
+}
+
+void LSPClientServer::processReceived() {
 	std::string& buffer = mReceive;
+	// Messages are framed in place and the consumed bytes are erased once per batch
+	size_t offset = 0;
 
 	while ( ( mUsingProcess && !mProcess.isShuttingDown() ) ||
 			( mUsingSocket && mSocket != nullptr ) ) {
-		auto index = buffer.find( CONTENT_LENGTH_HEADER );
+		auto index = buffer.find( CONTENT_LENGTH_HEADER, offset );
 		if ( index == std::string::npos ) {
-			if ( buffer.size() > ( (Uint64)1 << 20 ) )
+			if ( buffer.size() - offset > ( (Uint64)1 << 20 ) ) {
 				buffer.clear();
+				offset = 0;
+			}
 			break;
 		}
 
@@ -1763,20 +2006,21 @@ void LSPClientServer::readStdOut( const char* bytes, size_t n ) {
 		bool ok = String::fromString( length, buffer.substr( index, endindex - index ) );
 		// FIXME perhaps detect if no reply for some time
 		// then again possibly better left to user to restart in such case
-		if ( !ok ) {
+		if ( !ok || length < 0 ) {
 			if ( !isSilent() )
-				Log::debug( "LSPClientServer::readStdOut server %s invalid " CONTENT_LENGTH,
+				Log::debug( "LSPClientServer::processReceived server %s invalid " CONTENT_LENGTH,
 							mLSP.name.c_str() );
 			// flush and try to carry on to some next header
-			buffer.erase( 0, msgstart );
+			offset = msgstart;
 			continue;
 		}
 		// sanity check to avoid extensive buffering
 		if ( length > ( 1 << 29 ) ) {
 			if ( !isSilent() )
-				Log::debug( "LSPClientServer::readStdOut server %s excessive size",
+				Log::debug( "LSPClientServer::processReceived server %s excessive size",
 							mLSP.name.c_str() );
 			buffer.clear();
+			offset = 0;
 			continue;
 		}
 		if ( msgstart + length > buffer.length() ) {
@@ -1784,12 +2028,19 @@ void LSPClientServer::readStdOut( const char* bytes, size_t n ) {
 		}
 
 		// now onto payload
-		auto payload = buffer.substr( msgstart, length );
-		buffer.erase( 0, msgstart + length );
+		const char* payload = buffer.data() + msgstart;
+		offset = msgstart + length;
 
-		if ( payload.empty() ) {
+		if ( length == 0 ) {
 			if ( !isSilent() )
-				Log::debug( "LSPClientServer::readStdOut server %s empty payload",
+				Log::debug( "LSPClientServer::processReceived server %s empty payload",
+							mLSP.name.c_str() );
+			continue;
+		}
+
+		if ( isLateReply( payload, length ) ) {
+			if ( !isSilent() )
+				Log::debug( "LSPClientServer::processReceived server %s dropped a late reply",
 							mLSP.name.c_str() );
 			continue;
 		}
@@ -1797,7 +2048,7 @@ void LSPClientServer::readStdOut( const char* bytes, size_t n ) {
 #ifndef EE_DEBUG
 		try {
 #endif
-			auto res = json::parse( payload );
+			auto res = json::parse( payload, payload + length );
 
 			PluginIDType msgid;
 			if ( res.contains( MEMBER_ID ) ) {
@@ -1815,51 +2066,66 @@ void LSPClientServer::readStdOut( const char* bytes, size_t n ) {
 			if ( !isSilent() ) {
 				std::string respd( res.dump() );
 				if ( trimLogs() && respd.size() > EE_1KB ) {
-					Log::debug( "LSPClientServer::readStdOut server %s said:", mLSP.name.c_str() );
+					Log::debug( "LSPClientServer::processReceived server %s said:",
+								mLSP.name.c_str() );
 					if ( Log::instance()->getLogLevelThreshold() <= LogLevel::Debug )
 						Log::instance()->writel( std::string_view( respd ).substr( 0, EE_1KB ) );
 				} else {
-					Log::debug( "LSPClientServer::readStdOut server %s said:\n%s",
+					Log::debug( "LSPClientServer::processReceived server %s said:\n%s",
 								mLSP.name.c_str(), respd.c_str() );
 				}
 			}
 
-			HandlersMap::iterator it;
-			HandlersMap::iterator itEnd;
-			JsonReplyHandler handlerOK;
-			JsonReplyHandler handlerErr;
-			bool handlerFound = false;
+			// The handler of the request and the ones of the callers that share its reply
+			std::vector<std::pair<PluginIDType, HandlersMap::mapped_type>> handlers;
 			{
 				Lock l( mHandlersMutex );
-				it = mHandlers.find( msgid );
-				itEnd = mHandlers.end();
-				handlerFound = it != itEnd;
-				if ( handlerFound ) {
-					handlerOK = it->second.first;
-					handlerErr = it->second.second;
+				auto it = mHandlers.find( msgid );
+				if ( it != mHandlers.end() ) {
+					handlers.emplace_back( msgid, std::move( it->second ) );
 					mHandlers.erase( it );
 				}
+				auto shared = mSharedReplies.find( msgid );
+				if ( shared != mSharedReplies.end() ) {
+					for ( const auto& callerId : shared->second ) {
+						auto caller = mHandlers.find( callerId );
+						if ( caller != mHandlers.end() ) {
+							handlers.emplace_back( callerId, std::move( caller->second ) );
+							mHandlers.erase( caller );
+						}
+						mSharedWith.erase( callerId );
+					}
+					mSharedReplies.erase( shared );
+				}
+				eraseSupersedableRequest( msgid );
 			}
 
-			if ( handlerFound ) {
-				if ( res.contains( MEMBER_ERROR ) && handlerErr ) {
-					handlerErr( msgid, res[MEMBER_ERROR] );
-				} else {
-					handlerOK( msgid, res[MEMBER_RESULT] );
+			if ( !handlers.empty() ) {
+				for ( const auto& handler : handlers ) {
+					if ( res.contains( MEMBER_ERROR ) && handler.second.second ) {
+						handler.second.second( handler.first, res[MEMBER_ERROR] );
+					} else {
+						handler.second.first( handler.first, res[MEMBER_RESULT] );
+					}
 				}
 			} else {
 				if ( !isSilent() ) {
-					Log::debug( "LSPClientServer::readStdOut server %s unexpected reply id: %s",
-								mLSP.name.c_str(), msgid.toString().c_str() );
+					Log::debug(
+						"LSPClientServer::processReceived server %s unexpected reply id: %s",
+						mLSP.name.c_str(), msgid.toString().c_str() );
 				}
 			}
 #ifndef EE_DEBUG
 		} catch ( const json::exception& e ) {
-			Log::warning( "LSPClientServer::readStdOut server %s said: Coudln't parse json err: %s",
-						  mLSP.name.c_str(), e.what() );
+			Log::warning(
+				"LSPClientServer::processReceived server %s said: Coudln't parse json err: %s",
+				mLSP.name.c_str(), e.what() );
 		}
 #endif
 	}
+
+	if ( offset > 0 )
+		buffer.erase( 0, offset );
 }
 
 void LSPClientServer::readStdErr( const char* bytes, size_t n ) {
@@ -2198,6 +2464,9 @@ void LSPClientServer::shutdown() {
 		{
 			Lock l( mHandlersMutex );
 			mHandlers.clear();
+			mSharedReplies.clear();
+			mSharedWith.clear();
+			mSupersedableRequests.clear();
 		}
 		sendSync( newRequest( "shutdown" ) );
 		Sys::sleep( Milliseconds( 100 ) );
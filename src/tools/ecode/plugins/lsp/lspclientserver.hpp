@@ -6,14 +6,17 @@
 #include "lspdocumentclient.hpp"
 #include "lspprotocol.hpp"
 #include <atomic>
+#include <condition_variable>
 #include <eepp/network/tcpsocket.hpp>
 #include <eepp/system/process.hpp>
 #include <eepp/ui/doc/textdocument.hpp>
 #include <eepp/ui/uicodeeditor.hpp>
 #include <eepp/ui/uipopupmenu.hpp>
 #include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <queue>
+#include <thread>
 
 using json = nlohmann::json;
 
@@ -267,8 +270,27 @@ class LSPClientServer {
 		JsonReplyHandler eh;
 	};
 	std::vector<QueueMessage> mQueuedMessages;
+	// Bytes read from the server, framed and parsed by the receive thread
+	std::string mIncoming;
+	std::mutex mIncomingMutex;
+	std::condition_variable mIncomingCond;
+	std::thread mReceiveThread;
+	bool mReceiveClosing{ false };
+	// Only accessed by the receive thread
 	std::string mReceive;
 	std::string mReceiveErr;
+	// Last request of the requests that a newer one of the same document replaces (hover,
+	// completion, etc) while it waits for its reply, guarded by mHandlersMutex
+	struct SupersedableRequest {
+		PluginIDType id;
+		json params;
+	};
+	std::unordered_map<std::string, SupersedableRequest> mSupersedableRequests;
+	// Requests that share the reply of an identical pending request: the callers of each request
+	// sent and the request each caller shares, guarded by mHandlersMutex. Every caller keeps its
+	// own id and handler, the request is only cancelled once none of them waits for it.
+	std::map<PluginIDType, std::vector<PluginIDType>> mSharedReplies;
+	std::map<PluginIDType, PluginIDType> mSharedWith;
 	LSPServerCapabilities mCapabilities;
 	URI mWorkspaceFolder;
 	std::vector<std::string> mLanguagesSupported;
@@ -285,6 +307,20 @@ class LSPClientServer {
 
 	void readStdOut( const char* bytes, size_t n );
 
+	void startReceiving();
+
+	void stopReceiving();
+
+	void receiveLoop();
+
+	void processReceived();
+
+	bool isLateReply( const char* payload, size_t length );
+
+	/** Forgets the supersedable request once its reply is processed, dropped or cancelled. Must be
+	 * called with mHandlersMutex locked. */
+	void eraseSupersedableRequest( const PluginIDType& id );
+
 	void readStdErr( const char* bytes, size_t n );
 
 	LSPRequestHandle write( json&& msg, const JsonReplyHandler& h = nullptr,
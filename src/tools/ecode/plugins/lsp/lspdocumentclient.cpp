@@ -2,6 +2,7 @@
 #include "lspclientplugin.hpp"
 #include "lspclientserver.hpp"
 #include "lspclientservermanager.hpp"
+#include <algorithm>
 #include <eepp/system/filesystem.hpp>
 #include <eepp/system/iostreamstring.hpp>
 #include <eepp/system/log.hpp>
@@ -48,6 +49,16 @@ void LSPDocumentClient::onDocumentTextChanged( const DocumentContentChange& chan
 	requestSemanticHighlightingDelayed();
 }
 
+void LSPDocumentClient::onDocumentBatchTextChanged(
+	const std::vector<DocumentContentChange>& changes ) {
+	// A batched edit is a single document version with several content changes
+	++mVersion;
+	mServer->queueDidChange( mDoc->getURI(), mVersion, "", changes );
+	mServer->getThreadPool()->run( [this]() { mServer->processDidChangeQueue(); } );
+	requestSymbolsDelayed();
+	requestSemanticHighlightingDelayed();
+}
+
 void LSPDocumentClient::onDocumentUndoRedo( const TextDocument::UndoRedo& /*eventType*/ ) {}
 
 void LSPDocumentClient::onDocumentCursorChange( const TextPosition& ) {}
@@ -266,13 +277,11 @@ void LSPDocumentClient::processTokens( LSPSemanticTokensDelta&& tokens,
 	if ( !tokens.resultId.empty() )
 		mSemanticeResultId = tokens.resultId;
 
-	for ( const auto& edit : tokens.edits ) {
-		auto& curTokens = mSemanticTokens.data;
-		if ( edit.deleteCount > 0 ) {
-			curTokens.erase( curTokens.begin() + edit.start,
-							 curTokens.begin() + edit.start + edit.deleteCount );
-		}
-		curTokens.insert( curTokens.begin() + edit.start, edit.data.begin(), edit.data.end() );
+	if ( !tokens.edits.empty() && !applyTokensEdits( tokens.edits ) ) {
+		Log::warning( "LSPDocumentClient::processTokens invalid edits for doc: %s",
+					  mDoc->getURI().toString().c_str() );
+		mRunningSemanticTokens = false;
+		return requestSemanticHighlightingDelayed( true );
 	}
 
 	if ( !tokens.data.empty() ) {
@@ -284,6 +293,33 @@ void LSPDocumentClient::processTokens( LSPSemanticTokensDelta&& tokens,
 	mRunningSemanticTokens = false;
 }
 
+bool LSPDocumentClient::applyTokensEdits( std::vector<LSPSemanticTokensEdit>& edits ) {
+	// The edits offsets refer to the previous data, so the new data is built in a single pass
+	// instead of shifting the data once per edit
+	std::stable_sort( edits.begin(), edits.end(),
+					  []( const LSPSemanticTokensEdit& left, const LSPSemanticTokensEdit& right ) {
+						  return left.start < right.start;
+					  } );
+	const auto& curTokens = mSemanticTokens.data;
+	std::vector<Int32> newTokens;
+	size_t newSize = curTokens.size();
+	for ( const auto& edit : edits )
+		newSize += edit.data.size();
+	newTokens.reserve( newSize );
+	size_t pos = 0;
+	for ( const auto& edit : edits ) {
+		if ( edit.start < pos || edit.start + edit.deleteCount > curTokens.size() )
+			return false;
+		newTokens.insert( newTokens.end(), curTokens.begin() + pos,
+						  curTokens.begin() + edit.start );
+		newTokens.insert( newTokens.end(), edit.data.begin(), edit.data.end() );
+		pos = edit.start + edit.deleteCount;
+	}
+	newTokens.insert( newTokens.end(), curTokens.begin() + pos, curTokens.end() );
+	mSemanticTokens.data = std::move( newTokens );
+	return true;
+}
+
 void LSPDocumentClient::highlight() {
 	if ( mShutdown )
 		return;
@@ -298,10 +334,9 @@ void LSPDocumentClient::highlight() {
 	const auto& caps = mServer->getCapabilities().semanticTokenProvider;
 	Uint32 currentLine = 0;
 	Uint32 start = 0;
-	std::unordered_map<size_t, TokenizedLine> tokenizerLines;
-	Int64 lastLine = 0;
-	TokenizedLine* lastLinePtr = nullptr;
-	Time diff;
+	// The tokens are only decoded here, the highlighter merges them when the lines are displayed
+	UnorderedMap<size_t, TokenizedLine> lines;
+	TokenizedLine* line = nullptr;
 
 	for ( size_t i = 0; i < data.size(); i += 5 ) {
 		if ( mShutdown )
@@ -319,39 +354,31 @@ void LSPDocumentClient::highlight() {
 			start = deltaStart;
 		}
 
-		auto* line = &tokenizerLines[currentLine];
+		if ( currentLine >= mDoc->linesCount() )
+			break;
+
+		if ( line == nullptr || deltaLine != 0 ) {
+			line = &lines[currentLine];
+			line->hash = mDoc->line( currentLine ).getHash();
+		}
+
 		if ( type >= 0 && type < (int)caps.legend.tokenTypes.size() ) {
 			const auto& ltype = caps.legend.tokenTypes[type];
 			line->tokens.push_back( { semanticTokenTypeToSyntaxType( ltype ), start, len } );
 		} else {
 			line->tokens.push_back( { SyntaxStyleTypes::Normal, start, len } );
 		}
-		line->hash = mDoc->line( currentLine ).getHash();
-		line->updateSignature();
-
-		auto curSignature = mDoc->getHighlighter()->getTokenizedLineSignature( lastLine );
-		if ( lastLine != currentLine && lastLinePtr && lastLinePtr->signature == curSignature ) {
-			tokenizerLines.erase( lastLine );
-		}
-
-		lastLine = currentLine;
-		lastLinePtr = line;
 	}
 
-	diff = clock.getElapsedTime();
+	for ( auto& tline : lines )
+		tline.second.updateSignature();
 
-	for ( auto& tline : tokenizerLines ) {
-		if ( mShutdown )
-			return;
-
-		mDoc->getHighlighter()->mergeLine( tline.first, tline.second );
-	}
+	size_t linesCount = lines.size();
+	mDoc->getHighlighter()->setOverlayLines( std::move( lines ) );
 
 	if ( !mServer->isSilent() ) {
-		Log::debug(
-			"LSPDocumentClient::highlight took: %.2f ms. Diff analysis took: %.2f ms. Updated "
-			"%lld elements",
-			clock.getElapsedTime().asMilliseconds(), diff.asMilliseconds(), tokenizerLines.size() );
+		Log::debug( "LSPDocumentClient::highlight took: %.2f ms. Updated %zu lines",
+					clock.getElapsedTime().asMilliseconds(), linesCount );
 	}
 }
 
@@ -28,6 +28,7 @@ class LSPDocumentClient : public TextDocument::Client {
 
 	virtual void onDocumentLoaded( TextDocument* );
 	virtual void onDocumentTextChanged( const DocumentContentChange& change );
+	virtual void onDocumentBatchTextChanged( const std::vector<DocumentContentChange>& changes );
 	virtual void onDocumentUndoRedo( const TextDocument::UndoRedo& eventType );
 	virtual void onDocumentCursorChange( const TextPosition& );
 	virtual void onDocumentSelectionChange( const TextRange& );
@@ -84,6 +85,8 @@ class LSPDocumentClient : public TextDocument::Client {
 
 	void processTokens( LSPSemanticTokensDelta&& tokens, const Uint64& docModificationId );
 
+	bool applyTokensEdits( std::vector<LSPSemanticTokensEdit>& edits );
+
 	void highlight();
 };
 
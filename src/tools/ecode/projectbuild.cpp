@@ -763,12 +763,14 @@ void ProjectBuildManager::runBuild( const std::string& buildName, const std::str
 
 		if ( mProcess->create( cmd.cmd, cmd.args, options, toUnorderedMap( res.envs ),
 							   cmd.workingDir ) ) {
-			std::string buffer( 1024, '\0' );
+			// A read returns what's available, a bigger buffer only means fewer chunks when the
+			// build outputs faster than it's consumed
+			std::string buffer( 16 * 1024, '\0' );
 			unsigned bytesRead = 0;
 			int returnCode;
 			do {
 				bytesRead = mProcess->readStdOut( buffer );
-				std::string data( buffer.substr( 0, bytesRead ) );
+				std::string data( buffer.data(), bytesRead );
 				if ( progressFn )
 					progressFn( progress, std::move( data ), &cmd );
 			} while ( bytesRead != 0 && mProcess->isAlive() && !mShuttingDown && !mCancelBuild );
@@ -8,6 +8,70 @@ namespace ecode {
 
 #define PRJ_ALLOWED_PATH ".ecode/.prjallowed"
 
+/** Applies the project ignore files while the project is walked. Every folder with a .gitignore
+ * gets a filter with its matcher added to the ones of the parent folders. */
+class ProjectDirectoryFilter : public DirectoryWalker::Filter {
+  public:
+	ProjectDirectoryFilter( std::vector<std::shared_ptr<const IgnoreMatcher>>&& matchers,
+							std::shared_ptr<const IgnoreMatcher> allowedMatcher,
+							const std::vector<std::string>& acceptedPatterns ) :
+		mMatchers( std::move( matchers ) ),
+		mAllowedMatcher( allowedMatcher ),
+		mAcceptedPatterns( acceptedPatterns ) {}
+
+	bool ignore( const DirectoryWalker::Entry& entry ) const override {
+		if ( isIgnored( entry.directory, entry.name ) && !isAllowed( entry.directory, entry.name ) )
+			return true;
+
+		if ( entry.isDirectory || mAcceptedPatterns.empty() )
+			return false;
+
+		// The static match is used because the LuaPattern instances can't be shared between threads
+		for ( const auto& pattern : mAcceptedPatterns ) {
+			if ( LuaPattern::matches( entry.name, pattern ) )
+				return false;
+		}
+		return true;
+	}
+
+	std::shared_ptr<const DirectoryWalker::Filter>
+	enterDirectory( const std::string& path ) const override {
+		auto matcher = std::make_shared<GitIgnoreMatcher>( path );
+		if ( !matcher->canMatch() )
+			return shared_from_this();
+		auto matchers( mMatchers );
+		matchers.emplace_back( matcher );
+		return std::make_shared<ProjectDirectoryFilter>( std::move( matchers ), mAllowedMatcher,
+														 mAcceptedPatterns );
+	}
+
+  protected:
+	std::vector<std::shared_ptr<const IgnoreMatcher>> mMatchers;
+	std::shared_ptr<const IgnoreMatcher> mAllowedMatcher;
+	std::vector<std::string> mAcceptedPatterns;
+
+	bool isIgnored( const std::string& dir, const std::string& name ) const {
+		std::string localPath;
+		for ( const auto& matcher : mMatchers ) {
+			localPath.clear();
+			if ( String::startsWith( dir, matcher->getPath() ) )
+				localPath = dir.substr( matcher->getPath().size() );
+			if ( matcher->match( localPath + name ) )
+				return true;
+		}
+		return false;
+	}
+
+	bool isAllowed( const std::string& dir, const std::string& name ) const {
+		if ( !mAllowedMatcher )
+			return false;
+		std::string localPath;
+		if ( String::startsWith( dir, mAllowedMatcher->getPath() ) )
+			localPath = dir.substr( mAllowedMatcher->getPath().size() );
+		return mAllowedMatcher->match( localPath + name );
+	}
+};
+
 ProjectDirectoryTree::ProjectDirectoryTree( const std::string& path,
 											std::shared_ptr<ThreadPool> threadPool, App* app ) :
 	mPath( path ),
@@ -23,6 +87,14 @@ ProjectDirectoryTree::ProjectDirectoryTree( const std::string& path,
 
 ProjectDirectoryTree::~ProjectDirectoryTree() {
 	mClosing = true;
+	if ( mSearchIndex )
+		mSearchIndex->stop();
+	if ( mSymbolIndex )
+		mSymbolIndex->stop();
+	if ( mWalker ) {
+		mWalker->stop();
+		mWalker->wait();
+	}
 	if ( mApp->getPluginManager() )
 		mApp->getPluginManager()->unsubscribeMessages( "ProjectDirectoryTree" );
 	Lock rl( mMatchingMutex );
@@ -36,69 +108,73 @@ ProjectDirectoryTree::~ProjectDirectoryTree() {
 void ProjectDirectoryTree::scan( const ProjectDirectoryTree::ScanCompleteEvent& scanComplete,
 								 const std::vector<std::string>& acceptedPatterns,
 								 const bool& ignoreHidden ) {
-#if EE_PLATFORM != EE_PLATFORM_EMSCRIPTEN || defined( __EMSCRIPTEN_PTHREADS__ )
-	mPool->run(
-		[this, acceptedPatterns, ignoreHidden] {
-#endif
-			Lock l( mFilesMutex );
-			mRunning = true;
-			mIgnoreHidden = ignoreHidden;
-			mDirectories.push_back( mPath );
-
-			if ( !mAllowedMatcher && FileSystem::fileExists( mPath + PRJ_ALLOWED_PATH ) )
-				mAllowedMatcher = std::make_unique<GitIgnoreMatcher>( mPath, PRJ_ALLOWED_PATH );
-
-			if ( !acceptedPatterns.empty() ) {
-				std::vector<std::string> files;
-				std::vector<std::string> names;
-				std::vector<LuaPattern> patterns;
-				for ( auto& strPattern : acceptedPatterns )
-					patterns.emplace_back( LuaPattern( strPattern ) );
-				mAcceptedPatterns = patterns;
-				std::set<std::string> info;
-				getDirectoryFiles( files, names, mPath, info, false, mIgnoreMatcher,
-								   mAllowedMatcher.get() );
-				size_t namesCount = names.size();
-				bool found;
-				for ( size_t i = 0; i < namesCount; i++ ) {
-					found = false;
-					for ( auto& pattern : patterns ) {
-						if ( pattern.matches( names[i] ) ) {
-							found = true;
-							break;
-						}
-					}
-					if ( found ) {
-						mFiles.emplace_back( std::move( files[i] ) );
-						mNames.emplace_back( std::move( names[i] ) );
-					}
-				}
-			} else {
-				std::set<std::string> info;
-				getDirectoryFiles( mFiles, mNames, mPath, info, ignoreHidden, mIgnoreMatcher,
-								   mAllowedMatcher.get() );
-			}
-			mIsReady = true;
+	{
+		Lock l( mFilesMutex );
+		mRunning = true;
+		mIgnoreHidden = ignoreHidden;
+		mDirectories.push_back( mPath );
+
+		if ( !mAllowedMatcher && FileSystem::fileExists( mPath + PRJ_ALLOWED_PATH ) )
+			mAllowedMatcher = std::make_shared<GitIgnoreMatcher>( mPath, PRJ_ALLOWED_PATH );
+
+		mAcceptedPatterns.clear();
+		for ( auto& strPattern : acceptedPatterns )
+			mAcceptedPatterns.emplace_back( LuaPattern( strPattern ) );
+	}
+
+	std::vector<std::shared_ptr<const IgnoreMatcher>> matchers;
+	auto rootMatcher = std::make_shared<GitIgnoreMatcher>( mPath );
+	if ( rootMatcher->canMatch() )
+		matchers.emplace_back( rootMatcher );
+
+	// Links to folders are not walked, the same as before the parallel scan
+	mWalker = DirectoryWalker::createShared(
+		mPath,
+		std::make_shared<ProjectDirectoryFilter>( std::move( matchers ), mAllowedMatcher,
+												  acceptedPatterns ),
+		false );
+
+	auto onBatch = [this]( std::vector<DirectoryWalker::Entry>&& entries ) {
+		addEntries( std::move( entries ) );
+	};
+
+	auto onDone = [this, scanComplete] {
+		mIsReady = true;
+		if ( !mClosing ) {
 			mApp->getPluginManager()->subscribeMessages(
 				"ProjectDirectoryTree", [this]( const PluginMessage& msg ) -> PluginRequestHandle {
 					return processMessage( msg );
 				} );
-#if EE_PLATFORM == EE_PLATFORM_EMSCRIPTEN && !defined( __EMSCRIPTEN_PTHREADS__ )
-			if ( scanComplete )
-				scanComplete( *this );
-#endif
+		}
+		if ( !mClosing && scanComplete ) {
+			Lock l( mDoneMutex );
+			scanComplete( *this );
+		}
+		mRunning = false;
+	};
+
 #if EE_PLATFORM != EE_PLATFORM_EMSCRIPTEN || defined( __EMSCRIPTEN_PTHREADS__ )
-		},
-		[scanComplete, this]( const auto& ) {
-			if ( !mClosing && scanComplete ) {
-				Lock l( mDoneMutex );
-				scanComplete( *this );
-			}
-			mRunning = false;
-		} );
+	mWalker->run( mPool, onBatch, onDone );
+#else
+	mWalker->run( onBatch );
+	onDone();
 #endif
 }
 
+void ProjectDirectoryTree::addEntries( std::vector<DirectoryWalker::Entry>&& entries ) {
+	Lock rl( mMatchingMutex );
+	Lock l( mFilesMutex );
+	for ( auto& entry : entries ) {
+		if ( entry.isDirectory ) {
+			if ( !entry.isLink )
+				mDirectories.emplace_back( entry.getPath() + FileSystem::getOSSlash() );
+		} else {
+			mFiles.emplace_back( entry.getPath() );
+			mNames.emplace_back( std::move( entry.name ) );
+		}
+	}
+}
+
 std::shared_ptr<FileListModel>
 ProjectDirectoryTree::fuzzyMatchTree( const std::vector<std::string>& matches,
 									  const size_t& max ) const {
@@ -172,6 +248,7 @@ void ProjectDirectoryTree::asyncMatchTree( const std::string& match, const size_
 std::shared_ptr<FileListModel>
 ProjectDirectoryTree::asModel( const size_t& max,
 							   const std::vector<CommandInfo>& prependCommands ) const {
+	Lock rl( mMatchingMutex );
 	if ( mNames.empty() )
 		return std::make_shared<FileListModel>( std::vector<std::string>(),
 												std::vector<std::string>() );
@@ -236,6 +313,41 @@ const std::vector<std::string>& ProjectDirectoryTree::getDirectories() const {
 	return mDirectories;
 }
 
+void ProjectDirectoryTree::buildSearchIndex( const std::string& indexPath ) {
+	if ( mSearchIndex )
+		return;
+	mSearchIndex = std::make_shared<ProjectSearchIndex>( indexPath );
+	std::vector<std::string> files;
+	{
+		Lock l( mFilesMutex );
+		files = mFiles;
+	}
+	auto searchIndex = mSearchIndex;
+	mPool->run( [searchIndex, files] { searchIndex->build( files ); } );
+}
+
+std::vector<std::string>
+ProjectDirectoryTree::getSearchCandidates( const std::string& text ) const {
+	Lock l( mFilesMutex );
+	if ( !mSearchIndex )
+		return mFiles;
+	return mSearchIndex->getCandidates( mFiles, text );
+}
+
+void ProjectDirectoryTree::buildSymbolIndex( const std::string& indexPath ) {
+	if ( mSymbolIndex )
+		return;
+	mSymbolIndex = std::make_shared<WorkspaceSymbolIndex>( indexPath );
+	std::vector<std::string> files;
+	{
+		Lock l( mFilesMutex );
+		files = mFiles;
+	}
+	auto symbolIndex = mSymbolIndex;
+	auto pool = mPool;
+	mPool->run( [symbolIndex, files, pool] { symbolIndex->build( files, pool ); } );
+}
+
 bool ProjectDirectoryTree::isFileInTree( const std::string& filePath ) const {
 	return std::find( mFiles.begin(), mFiles.end(), filePath ) != mFiles.end();
 }
@@ -317,6 +429,74 @@ void ProjectDirectoryTree::onChange( const ProjectDirectoryTree::Action& action,
 		case ProjectDirectoryTree::Action::Modified:
 			break;
 	}
+	if ( mSearchIndex )
+		updateSearchIndex( action, file, oldFilename );
+	if ( mSymbolIndex )
+		updateSymbolIndex( action, file, oldFilename );
+}
+
+static std::pair<std::string, std::string> getMovedPaths( const FileInfo& file,
+														  const std::string& oldFilename ) {
+	std::string dir( file.getDirectoryPath() );
+	if ( file.isDirectory() ) {
+		FileSystem::dirRemoveSlashAtEnd( dir );
+		std::string newDir( dir );
+		dir = FileSystem::fileRemoveFileName( dir );
+		FileSystem::dirAddSlashAtEnd( dir );
+		return { dir + oldFilename, newDir };
+	}
+	FileSystem::dirAddSlashAtEnd( dir );
+	return { dir + oldFilename, file.getFilepath() };
+}
+
+void ProjectDirectoryTree::updateSearchIndex( const Action& action, const FileInfo& file,
+											  const std::string& oldFilename ) {
+	switch ( action ) {
+		case ProjectDirectoryTree::Action::Delete:
+			mSearchIndex->removeFile( file.getFilepath() );
+			return;
+		case ProjectDirectoryTree::Action::Moved: {
+			auto paths( getMovedPaths( file, oldFilename ) );
+			mSearchIndex->moveFile( paths.first, paths.second );
+			if ( file.isDirectory() )
+				return;
+			break;
+		}
+		case ProjectDirectoryTree::Action::Add:
+		case ProjectDirectoryTree::Action::Modified:
+			if ( file.isDirectory() )
+				return;
+			// Until the file is indexed again it's always a search candidate
+			mSearchIndex->invalidateFile( file.getFilepath() );
+			break;
+	}
+	auto searchIndex = mSearchIndex;
+	std::string path( file.getFilepath() );
+	mPool->run( [searchIndex, path] { searchIndex->updateFile( path ); } );
+}
+
+void ProjectDirectoryTree::updateSymbolIndex( const Action& action, const FileInfo& file,
+											  const std::string& oldFilename ) {
+	switch ( action ) {
+		case ProjectDirectoryTree::Action::Delete:
+			mSymbolIndex->removeFile( file.getFilepath() );
+			return;
+		case ProjectDirectoryTree::Action::Moved: {
+			auto paths( getMovedPaths( file, oldFilename ) );
+			mSymbolIndex->moveFile( paths.first, paths.second );
+			if ( file.isDirectory() )
+				return;
+			break;
+		}
+		case ProjectDirectoryTree::Action::Add:
+		case ProjectDirectoryTree::Action::Modified:
+			if ( file.isDirectory() )
+				return;
+			break;
+	}
+	auto symbolIndex = mSymbolIndex;
+	std::string path( file.getFilepath() );
+	mPool->run( [symbolIndex, path] { symbolIndex->updateFile( path ); } );
 }
 
 void ProjectDirectoryTree::tryAddFile( const FileInfo& file ) {
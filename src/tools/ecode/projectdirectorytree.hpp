@@ -3,7 +3,10 @@
 
 #include "ignorematcher.hpp"
 #include "plugins/pluginmanager.hpp"
+#include "projectsearchindex.hpp"
+#include "workspacesymbolindex.hpp"
 #include <eepp/scene/scenemanager.hpp>
+#include <eepp/system/directorywalker.hpp>
 #include <eepp/system/luapattern.hpp>
 #include <eepp/system/mutex.hpp>
 #include <eepp/system/threadpool.hpp>
@@ -145,6 +148,19 @@ class ProjectDirectoryTree {
 
 	const std::string& getPath() const { return mPath; }
 
+	/** Builds (or loads and refreshes) the search index of the project files in the background.
+	 * The index is saved in indexPath and kept updated with the file changes. */
+	void buildSearchIndex( const std::string& indexPath );
+
+	/** @return The files that can contain the text, all the files if there isn't a search index. */
+	std::vector<std::string> getSearchCandidates( const std::string& text ) const;
+
+	/** Builds (or loads and refreshes) the symbol index of the project files in the background.
+	 * The index is saved in indexPath and kept updated with the file changes. */
+	void buildSymbolIndex( const std::string& indexPath );
+
+	std::shared_ptr<WorkspaceSymbolIndex> getSymbolIndex() const { return mSymbolIndex; }
+
   protected:
 	std::string mPath;
 	std::shared_ptr<ThreadPool> mPool;
@@ -152,7 +168,10 @@ class ProjectDirectoryTree {
 	std::vector<std::string> mNames;
 	std::vector<std::string> mDirectories;
 	std::vector<LuaPattern> mAcceptedPatterns;
-	std::unique_ptr<GitIgnoreMatcher> mAllowedMatcher;
+	std::shared_ptr<GitIgnoreMatcher> mAllowedMatcher;
+	std::shared_ptr<DirectoryWalker> mWalker;
+	std::shared_ptr<ProjectSearchIndex> mSearchIndex;
+	std::shared_ptr<WorkspaceSymbolIndex> mSymbolIndex;
 	bool mRunning;
 	bool mIsReady;
 	bool mIgnoreHidden;
@@ -168,6 +187,8 @@ class ProjectDirectoryTree {
 							const bool& ignoreHidden, IgnoreMatcherManager& ignoreMatcher,
 							GitIgnoreMatcher* allowedMatcher );
 
+	void addEntries( std::vector<DirectoryWalker::Entry>&& entries );
+
 	void addFile( const FileInfo& file );
 
 	void tryAddFile( const FileInfo& file );
@@ -176,6 +197,12 @@ class ProjectDirectoryTree {
 
 	void removeFile( const FileInfo& file );
 
+	void updateSearchIndex( const Action& action, const FileInfo& file,
+							const std::string& oldFilename );
+
+	void updateSymbolIndex( const Action& action, const FileInfo& file,
+							const std::string& oldFilename );
+
 	IgnoreMatcherManager getIgnoreMatcherFromPath( const std::string& path );
 
 	size_t findFileIndex( const std::string& path );
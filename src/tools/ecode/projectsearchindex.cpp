@@ -0,0 +1,312 @@
+#include "projectsearchindex.hpp"
+#include <algorithm>
+#include <cstring>
+#include <eepp/core/string.hpp>
+#include <eepp/system/clock.hpp>
+#include <eepp/system/fileinfo.hpp>
+#include <eepp/system/filesystem.hpp>
+#include <eepp/system/lock.hpp>
+#include <eepp/system/log.hpp>
+#include <unordered_set>
+
+namespace ecode {
+
+static const char INDEX_MAGIC[4] = { 'E', 'P', 'S', 'I' };
+
+static Uint32 packTrigram( const std::string& text, size_t pos ) {
+	return ( (Uint32)(Uint8)text[pos] << 16 ) | ( (Uint32)(Uint8)text[pos + 1] << 8 ) |
+		   (Uint32)(Uint8)text[pos + 2];
+}
+
+template <typename T> static void writeValue( std::string& buffer, const T& val ) {
+	buffer.append( reinterpret_cast<const char*>( &val ), sizeof( val ) );
+}
+
+template <typename T> static bool readValue( const std::string& buffer, size_t& pos, T& val ) {
+	if ( buffer.size() - pos < sizeof( val ) )
+		return false;
+	memcpy( &val, buffer.data() + pos, sizeof( val ) );
+	pos += sizeof( val );
+	return true;
+}
+
+static bool isInsidePath( const std::string& path, const std::string& dir ) {
+	std::string dirPath( dir );
+	FileSystem::dirAddSlashAtEnd( dirPath );
+	return String::startsWith( path, dirPath );
+}
+
+ProjectSearchIndex::ProjectSearchIndex( const std::string& indexPath ) : mIndexPath( indexPath ) {}
+
+void ProjectSearchIndex::build( const std::vector<std::string>& files ) {
+	Lock bl( mBuildMutex );
+	Clock clock;
+	load();
+
+	std::vector<std::pair<std::string, Uint32>> pending;
+	for ( const auto& file : files ) {
+		if ( mStopped )
+			return;
+		FileInfo info( file );
+		Lock l( mMutex );
+		auto& entry = mFiles[file];
+		if ( !entry.indexed || entry.stale ||
+			 entry.modificationTime != info.getModificationTime() ||
+			 entry.size != info.getSize() ) {
+			entry.stale = true;
+			pending.emplace_back( file, entry.changes );
+		}
+	}
+
+	{
+		std::unordered_set<std::string> filesSet( files.begin(), files.end() );
+		Lock l( mMutex );
+		for ( auto it = mFiles.begin(); it != mFiles.end(); ) {
+			if ( filesSet.find( it->first ) == filesSet.end() ) {
+				it = mFiles.erase( it );
+				mDirty = true;
+			} else {
+				++it;
+			}
+		}
+	}
+
+	// The stale files are always candidates, so the index can be used while it's being updated
+	mReady = true;
+
+	std::vector<Uint64> seen;
+	for ( const auto& file : pending ) {
+		if ( mStopped )
+			break;
+		FileEntry entry( indexFile( file.first, seen ) );
+		Lock l( mMutex );
+		auto it = mFiles.find( file.first );
+		// Discard it if the file changed again while it was being indexed
+		if ( it != mFiles.end() && it->second.changes == file.second ) {
+			entry.changes = file.second;
+			it->second = std::move( entry );
+			mDirty = true;
+		}
+	}
+
+	Log::info( "ProjectSearchIndex: indexed %zu of %zu files in %.2fms", pending.size(),
+			   files.size(), clock.getElapsedTime().asMilliseconds() );
+
+	if ( !mStopped )
+		save();
+}
+
+void ProjectSearchIndex::stop() {
+	mStopped = true;
+}
+
+bool ProjectSearchIndex::isReady() const {
+	return mReady;
+}
+
+void ProjectSearchIndex::invalidateFile( const std::string& path ) {
+	Lock l( mMutex );
+	auto& entry = mFiles[path];
+	entry.stale = true;
+	entry.changes++;
+	mDirty = true;
+}
+
+void ProjectSearchIndex::updateFile( const std::string& path ) {
+	Uint32 changes = 0;
+	{
+		Lock l( mMutex );
+		auto it = mFiles.find( path );
+		if ( it != mFiles.end() ) {
+			if ( it->second.indexed && !it->second.stale )
+				return;
+			changes = it->second.changes;
+		} else {
+			mFiles[path].stale = true;
+		}
+	}
+
+	std::vector<Uint64> seen;
+	FileEntry entry( indexFile( path, seen ) );
+	Lock l( mMutex );
+	auto it = mFiles.find( path );
+	if ( it != mFiles.end() && it->second.changes == changes ) {
+		entry.changes = changes;
+		it->second = std::move( entry );
+		mDirty = true;
+	}
+}
+
+void ProjectSearchIndex::removeFile( const std::string& path ) {
+	Lock l( mMutex );
+	for ( auto it = mFiles.begin(); it != mFiles.end(); ) {
+		if ( it->first == path || isInsidePath( it->first, path ) ) {
+			it = mFiles.erase( it );
+			mDirty = true;
+		} else {
+			++it;
+		}
+	}
+}
+
+void ProjectSearchIndex::moveFile( const std::string& oldPath, const std::string& newPath ) {
+	Lock l( mMutex );
+	std::string oldDir( oldPath );
+	std::string newDir( newPath );
+	FileSystem::dirAddSlashAtEnd( oldDir );
+	FileSystem::dirAddSlashAtEnd( newDir );
+	std::vector<std::pair<std::string, FileEntry>> moved;
+	for ( auto it = mFiles.begin(); it != mFiles.end(); ) {
+		if ( it->first == oldPath ) {
+			moved.emplace_back( newPath, std::move( it->second ) );
+		} else if ( String::startsWith( it->first, oldDir ) ) {
+			moved.emplace_back( newDir + it->first.substr( oldDir.size() ),
+								std::move( it->second ) );
+		} else {
+			++it;
+			continue;
+		}
+		it = mFiles.erase( it );
+	}
+	for ( auto& file : moved )
+		mFiles[file.first] = std::move( file.second );
+	mDirty = mDirty || !moved.empty();
+}
+
+std::vector<std::string> ProjectSearchIndex::getCandidates( const std::vector<std::string>& files,
+															 const std::string& text ) const {
+	if ( !mReady || text.size() < 3 )
+		return files;
+
+	std::vector<Uint32> trigrams( getTrigrams( text ) );
+	std::vector<std::string> candidates;
+	Lock l( mMutex );
+	for ( const auto& file : files ) {
+		auto it = mFiles.find( file );
+		if ( it == mFiles.end() || !it->second.indexed || it->second.stale ||
+			 std::all_of( trigrams.begin(), trigrams.end(), [&it]( const Uint32& trigram ) {
+				 return std::binary_search( it->second.trigrams.begin(),
+											it->second.trigrams.end(), trigram );
+			 } ) ) {
+			candidates.push_back( file );
+		}
+	}
+	return candidates;
+}
+
+bool ProjectSearchIndex::save() {
+	std::string buffer;
+	{
+		Lock l( mMutex );
+		if ( !mDirty )
+			return true;
+		buffer.append( INDEX_MAGIC, sizeof( INDEX_MAGIC ) );
+		writeValue( buffer, VERSION );
+		writeValue( buffer, (Uint32)mFiles.size() );
+		for ( const auto& file : mFiles ) {
+			// Stale files are saved as not indexed, they must be indexed again when loaded
+			bool indexed = file.second.indexed && !file.second.stale;
+			writeValue( buffer, (Uint32)file.first.size() );
+			buffer.append( file.first );
+			writeValue( buffer, file.second.modificationTime );
+			writeValue( buffer, file.second.size );
+			writeValue( buffer, (Uint32)( indexed ? file.second.trigrams.size() : 0 ) );
+			writeValue( buffer, (Uint8)indexed );
+			if ( indexed && !file.second.trigrams.empty() )
+				buffer.append( reinterpret_cast<const char*>( file.second.trigrams.data() ),
+							   file.second.trigrams.size() * sizeof( Uint32 ) );
+		}
+		mDirty = false;
+	}
+	return FileSystem::fileWrite( mIndexPath, buffer );
+}
+
+bool ProjectSearchIndex::load() {
+	std::string buffer;
+	if ( !FileSystem::fileExists( mIndexPath ) || !FileSystem::fileGet( mIndexPath, buffer ) )
+		return false;
+
+	size_t pos = sizeof( INDEX_MAGIC );
+	Uint32 version = 0;
+	Uint32 count = 0;
+	if ( buffer.size() < pos || memcmp( buffer.data(), INDEX_MAGIC, pos ) != 0 ||
+		 !readValue( buffer, pos, version ) || version != VERSION ||
+		 !readValue( buffer, pos, count ) )
+		return false;
+
+	std::unordered_map<std::string, FileEntry> files;
+	files.reserve( count );
+	for ( Uint32 i = 0; i < count; i++ ) {
+		Uint32 pathSize = 0;
+		if ( !readValue( buffer, pos, pathSize ) || buffer.size() - pos < pathSize )
+			return false;
+		std::string path( buffer.data() + pos, pathSize );
+		pos += pathSize;
+		FileEntry entry;
+		Uint32 trigramsCount = 0;
+		Uint8 indexed = 0;
+		if ( !readValue( buffer, pos, entry.modificationTime ) ||
+			 !readValue( buffer, pos, entry.size ) || !readValue( buffer, pos, trigramsCount ) ||
+			 !readValue( buffer, pos, indexed ) ||
+			 ( buffer.size() - pos ) / sizeof( Uint32 ) < trigramsCount )
+			return false;
+		entry.indexed = indexed != 0;
+		entry.trigrams.resize( trigramsCount );
+		if ( trigramsCount > 0 )
+			memcpy( entry.trigrams.data(), buffer.data() + pos, trigramsCount * sizeof( Uint32 ) );
+		pos += trigramsCount * sizeof( Uint32 );
+		files[std::move( path )] = std::move( entry );
+	}
+
+	Lock l( mMutex );
+	// Keep the changes reported while it was loading
+	for ( auto& file : mFiles )
+		files[file.first] = std::move( file.second );
+	mFiles = std::move( files );
+	return true;
+}
+
+ProjectSearchIndex::FileEntry ProjectSearchIndex::indexFile( const std::string& path,
+															 std::vector<Uint64>& seen ) const {
+	FileEntry entry;
+	FileInfo info( path );
+	entry.modificationTime = info.getModificationTime();
+	entry.size = info.getSize();
+	std::string text;
+	if ( !info.exists() || entry.size > MAX_FILE_SIZE || !FileSystem::fileGet( path, text ) )
+		return entry;
+
+	// Lowercased the same way the project search does, so the index is valid for case sensitive
+	// and insensitive searches
+	String::toLowerInPlace( text );
+	// One bit for each possible trigram, to collect the unique ones without sorting duplicates
+	if ( seen.empty() )
+		seen.resize( ( 1 << 24 ) / 64 );
+	for ( size_t i = 0; i + 2 < text.size(); i++ ) {
+		Uint32 trigram = packTrigram( text, i );
+		Uint64 bit = 1ULL << ( trigram & 63 );
+		if ( !( seen[trigram >> 6] & bit ) ) {
+			seen[trigram >> 6] |= bit;
+			entry.trigrams.push_back( trigram );
+		}
+	}
+	for ( const auto& trigram : entry.trigrams )
+		seen[trigram >> 6] = 0;
+	std::sort( entry.trigrams.begin(), entry.trigrams.end() );
+	entry.trigrams.shrink_to_fit();
+	entry.indexed = true;
+	return entry;
+}
+
+std::vector<Uint32> ProjectSearchIndex::getTrigrams( const std::string& text ) {
+	std::string lower( text );
+	String::toLowerInPlace( lower );
+	std::vector<Uint32> trigrams;
+	for ( size_t i = 0; i + 2 < lower.size(); i++ )
+		trigrams.push_back( packTrigram( lower, i ) );
+	std::sort( trigrams.begin(), trigrams.end() );
+	trigrams.erase( std::unique( trigrams.begin(), trigrams.end() ), trigrams.end() );
+	return trigrams;
+}
+
+} // namespace ecode
@@ -0,0 +1,87 @@
+#ifndef ECODE_PROJECTSEARCHINDEX_HPP
+#define ECODE_PROJECTSEARCHINDEX_HPP
+
+#include <atomic>
+#include <eepp/config.hpp>
+#include <eepp/system/mutex.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace EE;
+using namespace EE::System;
+
+namespace ecode {
+
+/** Trigram index of the contents of the project files, used to narrow the files that a project
+ * search needs to scan.
+ * Every file keeps the sorted trigrams of its lowercased contents, the same way the search
+ * lowercases them. A file changed since it was indexed (or not indexed at all) is always a search
+ * candidate, so a stale index never hides a result. */
+class ProjectSearchIndex {
+  public:
+	static constexpr Uint32 VERSION = 1;
+
+	/** Files bigger than this are not indexed and always scanned. */
+	static constexpr Uint64 MAX_FILE_SIZE = 32 * 1024 * 1024;
+
+	explicit ProjectSearchIndex( const std::string& indexPath );
+
+	/** Loads the saved index and indexes the files added or modified since it was saved. Meant to
+	 * run in a background thread. */
+	void build( const std::vector<std::string>& files );
+
+	/** Stops a running build, what was indexed is kept. */
+	void stop();
+
+	bool isReady() const;
+
+	/** Marks the file as changed, it's a search candidate until it's indexed again. */
+	void invalidateFile( const std::string& path );
+
+	/** Indexes the file again if it was invalidated or it's not in the index. */
+	void updateFile( const std::string& path );
+
+	/** Removes the file, or every file inside the folder if path is a folder. */
+	void removeFile( const std::string& path );
+
+	/** Renames the file, or the files inside the folder if oldPath is a folder. */
+	void moveFile( const std::string& oldPath, const std::string& newPath );
+
+	/** @return The files that can contain text (a literal search string). */
+	std::vector<std::string> getCandidates( const std::vector<std::string>& files,
+											const std::string& text ) const;
+
+	bool save();
+
+	const std::string& getIndexPath() const { return mIndexPath; }
+
+  protected:
+	struct FileEntry {
+		Uint64 modificationTime{ 0 };
+		Uint64 size{ 0 };
+		std::vector<Uint32> trigrams;
+		// Times it was invalidated, to discard an indexing that read an old version of the file
+		Uint32 changes{ 0 };
+		bool indexed{ false };
+		bool stale{ false };
+	};
+
+	std::string mIndexPath;
+	std::unordered_map<std::string, FileEntry> mFiles;
+	mutable Mutex mMutex;
+	Mutex mBuildMutex;
+	std::atomic<bool> mReady{ false };
+	std::atomic<bool> mStopped{ false };
+	bool mDirty{ false };
+
+	bool load();
+
+	FileEntry indexFile( const std::string& path, std::vector<Uint64>& seen ) const;
+
+	static std::vector<Uint32> getTrigrams( const std::string& text );
+};
+
+} // namespace ecode
+
+#endif // ECODE_PROJECTSEARCHINDEX_HPP
@@ -1151,6 +1151,9 @@ UIMenu* SettingsMenu::createViewMenu() {
 	mViewMenu->addCheckBox( i18n( "show_indentation_guides", "Show Indentation Guides" ) )
 		->setActive( mApp->getConfig().editor.showIndentationGuides )
 		->setId( "show-indentation-guides" );
+	mViewMenu->addCheckBox( i18n( "line_wrap", "Line Wrap" ) )
+		->setActive( mApp->getConfig().editor.lineWrap )
+		->setId( "line-wrap" );
 	mViewMenu->addCheckBox( i18n( "show_doc_info", "Show Document Info" ) )
 		->setActive( mApp->getConfig().editor.showDocInfo )
 		->setId( "show-doc-info" );
@@ -1233,6 +1236,12 @@ UIMenu* SettingsMenu::createViewMenu() {
 			mSplitter->forEachEditor( [this]( UICodeEditor* editor ) {
 				editor->setShowIndentationGuides( mApp->getConfig().editor.showIndentationGuides );
 			} );
+		} else if ( item->getId() == "line-wrap" ) {
+			mApp->getConfig().editor.lineWrap = item->asType<UIMenuCheckBox>()->isActive();
+			mSplitter->forEachEditor( [this]( UICodeEditor* editor ) {
+				editor->setLineWrapMode( mApp->getConfig().editor.lineWrap ? LineWrapMode::Word
+																		   : LineWrapMode::NoWrap );
+			} );
 		} else if ( item->getId() == "show-doc-info" ) {
 			mApp->getConfig().editor.showDocInfo = item->asType<UIMenuCheckBox>()->isActive();
 			if ( mApp->getDocInfo() )
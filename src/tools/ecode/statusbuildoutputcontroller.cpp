@@ -1,9 +1,17 @@
 #include "statusbuildoutputcontroller.hpp"
 #include "ecode.hpp"
 #include "widgetcommandexecuter.hpp"
+#include <eepp/system/lock.hpp>
 
 namespace ecode {
 
+// The output document keeps the last lines only, the first lines are removed in blocks of
+// MAX_OUTPUT_LINES / 8 lines
+static constexpr Int64 MAX_OUTPUT_LINES = 100000;
+
+// Longer lines are not matched against the output parser patterns
+static constexpr size_t MAX_PARSED_LINE_LENGTH = 16 * 1024;
+
 StatusBuildOutputController::StatusBuildOutputController( UISplitter* mainSplitter,
 														  UISceneNode* uiSceneNode, App* app ) :
 	StatusBarElement( mainSplitter, uiSceneNode, app ) {}
@@ -56,7 +64,8 @@ bool StatusBuildOutputController::searchFindAndAddStatusResult(
 					continue;
 				}
 
-				std::string subtxt = text.substr( matches[i].start, matches[i].end );
+				std::string subtxt =
+					text.substr( matches[i].start, matches[i].end - matches[i].start );
 				if ( pattern.config.patternOrder.message == i ) {
 					auto nl = subtxt.find_first_of( '\n' );
 					if ( nl == std::string::npos ) {
@@ -86,17 +95,95 @@ bool StatusBuildOutputController::searchFindAndAddStatusResult(
 				}
 			}
 
-			mStatusResults.emplace_back( status );
-			if ( mTableIssues->getModel() )
-				mTableIssues->getModel()->invalidate();
+			Lock l( mOutputMutex );
+			mPendingStatusResults.emplace_back( std::move( status ) );
+			requestOutputFlush();
 			return true;
 		}
 	}
 	return false;
 }
 
-static void safeInsertBuffer( TextDocument& doc, const std::string& buffer ) {
-	doc.insert( 0, doc.endOfDoc(), buffer );
+void StatusBuildOutputController::parseOutput( const std::string& buffer,
+											   const ProjectBuildCommand* cmd ) {
+	size_t start = 0;
+	size_t nl;
+	while ( ( nl = buffer.find( '\n', start ) ) != std::string::npos ) {
+		mCurLineBuffer.append( buffer, start, nl - start );
+		if ( mCurLineBuffer.size() <= MAX_PARSED_LINE_LENGTH )
+			searchFindAndAddStatusResult( mPatternHolder, mCurLineBuffer, cmd );
+		mCurLineBuffer.clear();
+		start = nl + 1;
+	}
+	if ( start < buffer.size() && mCurLineBuffer.size() <= MAX_PARSED_LINE_LENGTH )
+		mCurLineBuffer.append( buffer, start, std::string::npos );
+}
+
+void StatusBuildOutputController::appendOutput( const std::string& buffer ) {
+	Lock l( mOutputMutex );
+	mPendingOutput += buffer;
+	requestOutputFlush();
+}
+
+void StatusBuildOutputController::requestOutputFlush() {
+	// mOutputMutex must be locked. All the output received until the flush runs is inserted at
+	// once, instead of updating the document for every chunk read from the build
+	if ( mOutputFlushPending )
+		return;
+	mOutputFlushPending = true;
+	mBuildOutput->runOnMainThread( [this] { flushOutput(); } );
+}
+
+void StatusBuildOutputController::flushOutput() {
+	std::string output;
+	std::vector<StatusMessage> results;
+	{
+		Lock l( mOutputMutex );
+		output.swap( mPendingOutput );
+		results.swap( mPendingStatusResults );
+		mOutputFlushPending = false;
+	}
+
+	if ( !results.empty() ) {
+		for ( auto& result : results )
+			mStatusResults.emplace_back( std::move( result ) );
+		if ( mTableIssues && mTableIssues->getModel() )
+			mTableIssues->getModel()->invalidate();
+	}
+
+	if ( output.empty() )
+		return;
+
+	TextDocument& doc = mBuildOutput->getDocument();
+
+	// Only the lines that will be kept are inserted
+	Int64 newLines = 0;
+	for ( size_t i = output.size(); i-- > 0; ) {
+		if ( output[i] == '\n' && ++newLines >= MAX_OUTPUT_LINES ) {
+			output.erase( 0, i + 1 );
+			doc.remove( 0, { doc.startOfDoc(), doc.endOfDoc() } );
+			break;
+		}
+	}
+
+	doc.insert( 0, doc.endOfDoc(), output );
+
+	Int64 linesCount = doc.linesCount();
+	if ( linesCount > MAX_OUTPUT_LINES + MAX_OUTPUT_LINES / 8 )
+		doc.remove( 0, { { 0, 0 }, { linesCount - MAX_OUTPUT_LINES, 0 } } );
+
+	// The output can't be edited, keeping its undo history would only retain memory
+	doc.getUndoStack().clear();
+
+	if ( mScrollLocked )
+		mBuildOutput->setScrollY( mBuildOutput->getMaxScroll().y );
+}
+
+void StatusBuildOutputController::resetOutput() {
+	Lock l( mOutputMutex );
+	mPendingOutput.clear();
+	mPendingStatusResults.clear();
+	mCurLineBuffer.clear();
 }
 
 void StatusBuildOutputController::runBuild( const std::string& buildName,
@@ -110,6 +197,7 @@ void StatusBuildOutputController::runBuild( const std::string& buildName,
 	show();
 	showBuildOutput();
 
+	resetOutput();
 	mStatusResults.clear();
 	if ( mTableIssues )
 		mTableIssues->getSelection().clear();
@@ -119,7 +207,6 @@ void StatusBuildOutputController::runBuild( const std::string& buildName,
 	std::vector<SyntaxPattern> patterns;
 
 	mPatternHolder.clear();
-	mCurLineBuffer.clear();
 
 	auto configs = { outputParser.getPresetConfig(), outputParser.getConfig() };
 	for ( const auto& config : configs ) {
@@ -176,31 +263,15 @@ void StatusBuildOutputController::runBuild( const std::string& buildName,
 		buildName, [this]( const auto& key, const auto& def ) { return mApp->i18n( key, def ); },
 		buildType,
 		[this]( auto, std::string buffer, const ProjectBuildCommand* cmd ) {
-			mBuildOutput->runOnMainThread( [this, buffer]() {
-				safeInsertBuffer( mBuildOutput->getDocument(), buffer );
-				if ( mScrollLocked )
-					mBuildOutput->setScrollY( mBuildOutput->getMaxScroll().y );
-			} );
-
-			if ( nullptr == cmd )
-				return;
-
-			do {
-				auto nl = buffer.find_first_of( '\n' );
-				if ( nl != std::string::npos ) {
-					mCurLineBuffer += buffer.substr( 0, nl );
-					searchFindAndAddStatusResult( mPatternHolder, mCurLineBuffer, cmd );
-					buffer = buffer.substr( nl + 1 );
-					mCurLineBuffer.clear();
-				} else {
-					mCurLineBuffer += buffer;
-					buffer.clear();
-				}
-			} while ( !buffer.empty() );
+			appendOutput( buffer );
+			// Parsed in the build thread, only the issues found are sent to the main thread
+			if ( nullptr != cmd )
+				parseOutput( buffer, cmd );
 		},
 		[this, updateBuildButton]( auto exitCode, const ProjectBuildCommand* cmd ) {
 			if ( !mCurLineBuffer.empty() && nullptr != cmd )
 				searchFindAndAddStatusResult( mPatternHolder, mCurLineBuffer, cmd );
+			mCurLineBuffer.clear();
 			String buffer;
 
 			if ( EXIT_SUCCESS == exitCode ) {
@@ -211,11 +282,7 @@ void StatusBuildOutputController::runBuild( const std::string& buildName,
 						 mApp->i18n( "build_failed", "Build run with errors\n" );
 			}
 
-			mBuildOutput->runOnMainThread( [this, buffer]() {
-				safeInsertBuffer( mBuildOutput->getDocument(), buffer );
-				if ( mScrollLocked )
-					mBuildOutput->setScrollY( mBuildOutput->getMaxScroll().y );
-			} );
+			appendOutput( buffer.toUtf8() );
 
 			updateBuildButton();
 
@@ -239,6 +306,7 @@ void StatusBuildOutputController::runClean( const std::string& buildName,
 
 	show();
 
+	resetOutput();
 	mBuildOutput->getDocument().reset();
 	mBuildOutput->setScrollY( mBuildOutput->getMaxScroll().y );
 
@@ -275,13 +343,7 @@ void StatusBuildOutputController::runClean( const std::string& buildName,
 	auto res = pbm->clean(
 		buildName, [this]( const auto& key, const auto& def ) { return mApp->i18n( key, def ); },
 		buildType,
-		[this]( auto, auto buffer, auto ) {
-			mBuildOutput->runOnMainThread( [this, buffer]() {
-				safeInsertBuffer( mBuildOutput->getDocument(), buffer );
-				if ( mScrollLocked )
-					mBuildOutput->setScrollY( mBuildOutput->getMaxScroll().y );
-			} );
-		},
+		[this]( auto, auto buffer, auto ) { appendOutput( buffer ); },
 		[this, enableBuildButton]( auto exitCode, auto ) {
 			String buffer;
 
@@ -293,11 +355,7 @@ void StatusBuildOutputController::runClean( const std::string& buildName,
 						 mApp->i18n( "clean_failed", "Clean run with errors\n" );
 			}
 
-			mBuildOutput->runOnMainThread( [this, buffer]() {
-				safeInsertBuffer( mBuildOutput->getDocument(), buffer );
-				if ( mScrollLocked )
-					mBuildOutput->setScrollY( mBuildOutput->getMaxScroll().y );
-			} );
+			appendOutput( buffer.toUtf8() );
 
 			UIPushButton* cleanButton = getCleanButton( mApp );
 			if ( cleanButton )
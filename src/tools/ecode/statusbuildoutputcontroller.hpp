@@ -5,6 +5,7 @@
 #include "uistatusbar.hpp"
 #include "widgetcommandexecuter.hpp"
 #include <eepp/system/luapattern.hpp>
+#include <eepp/system/mutex.hpp>
 #include <eepp/ui/tools/uicodeeditorsplitter.hpp>
 #include <eepp/ui/uicodeeditor.hpp>
 #include <eepp/ui/uirelativelayout.hpp>
@@ -68,6 +69,11 @@ class StatusBuildOutputController : public StatusBarElement {
 	std::vector<PatternHolder> mPatternHolder;
 	std::string mCurLineBuffer;
 	bool mScrollLocked{ true };
+	// Output and issues produced by the build thread, waiting to be flushed in the main thread
+	Mutex mOutputMutex;
+	std::string mPendingOutput;
+	std::vector<StatusMessage> mPendingStatusResults;
+	bool mOutputFlushPending{ false };
 
 	void createContainer();
 
@@ -78,6 +84,16 @@ class StatusBuildOutputController : public StatusBarElement {
 	bool searchFindAndAddStatusResult( const std::vector<PatternHolder>& patterns,
 									   const std::string& text, const ProjectBuildCommand* cmd );
 
+	void parseOutput( const std::string& buffer, const ProjectBuildCommand* cmd );
+
+	void appendOutput( const std::string& buffer );
+
+	void requestOutputFlush();
+
+	void flushOutput();
+
+	void resetOutput();
+
 	void onLoadDone( const Variant& lineNum, const Variant& colNum );
 
 	void setHeaderWidth();
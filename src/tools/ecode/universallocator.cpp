@@ -145,7 +145,9 @@ void UniversalLocator::updateFilesTable() {
 		text = pathAndPos.first;
 	}
 
-	if ( !mApp->isDirTreeReady() ) {
+	// The files found are listed while the project is still being scanned
+	if ( !mApp->isDirTreeReady() &&
+		 ( !mApp->getDirTree() || mApp->getDirTree()->getFilesCount() == 0 ) ) {
 		mLocateTable->setModel( ProjectDirectoryTree::emptyModel( getLocatorCommands() ) );
 		mLocateTable->getSelection().set( mLocateTable->getModel()->index( 0 ) );
 	} else if ( !mLocateInput->getText().empty() ) {
@@ -743,13 +745,13 @@ std::shared_ptr<ItemListOwnerModel<std::string>>
 UniversalLocator::openFileTypeModel( const std::string& match ) {
 	if ( nullptr == mApp->getSplitter()->getCurEditor() )
 		return ItemListOwnerModel<std::string>::create( {} );
-	const auto& defs = SyntaxDefinitionManager::instance()->getDefinitions();
+	const auto& defs = SyntaxDefinitionManager::instance()->getDefinitionsMetadata();
 	std::vector<std::string> fileTypeNames;
 	fileTypeNames.reserve( defs.size() );
-	for ( const auto& def : defs ) {
-		if ( match.empty() || String::startsWith( String::toLower( def.getLanguageName() ),
+	for ( const auto* def : defs ) {
+		if ( match.empty() || String::startsWith( String::toLower( def->getLanguageName() ),
 												  String::toLower( match ) ) )
-			fileTypeNames.push_back( def.getLanguageName() );
+			fileTypeNames.push_back( def->getLanguageName() );
 	}
 	std::sort( fileTypeNames.begin(), fileTypeNames.end() );
 	return ItemListOwnerModel<std::string>::create( fileTypeNames );
@@ -823,11 +825,22 @@ void UniversalLocator::requestWorkspaceSymbol() {
 	if ( mWorkspaceSymbolQuery != txt.toUtf8() || mWorkspaceSymbolQuery.empty() ) {
 		mWorkspaceSymbolQuery = txt.toUtf8();
 
-		if ( !mWorkspaceSymbolModel ) {
-			auto defTxt = getDefQueryText( PluginCapability::WorkspaceSymbol );
-			mWorkspaceSymbolModel = emptyModel( defTxt, mWorkspaceSymbolQuery );
+		auto symbolIndex = mApp->getDirTree() ? mApp->getDirTree()->getSymbolIndex() : nullptr;
+		if ( symbolIndex && symbolIndex->isReady() && !mWorkspaceSymbolQuery.empty() ) {
+			// The language server results are appended to the indexed ones when they arrive
+			mWorkspaceSymbolModel = LSPSymbolInfoModel::create(
+				mUISceneNode, mWorkspaceSymbolQuery,
+				symbolIndex->query( mWorkspaceSymbolQuery, LOCATEBAR_MAX_RESULTS ) );
+			mLocateTable->setModel( mWorkspaceSymbolModel );
+			if ( mWorkspaceSymbolModel->rowCount( {} ) > 0 )
+				mLocateTable->getSelection().set( mLocateTable->getModel()->index( 0 ) );
+		} else {
+			if ( !mWorkspaceSymbolModel ) {
+				auto defTxt = getDefQueryText( PluginCapability::WorkspaceSymbol );
+				mWorkspaceSymbolModel = emptyModel( defTxt, mWorkspaceSymbolQuery );
+			}
+			mLocateTable->setModel( mWorkspaceSymbolModel );
 		}
-		mLocateTable->setModel( mWorkspaceSymbolModel );
 
 		if ( mQueryWorkspaceLastId.isValid() ) {
 			json r( pluginID( mQueryWorkspaceLastId ) );
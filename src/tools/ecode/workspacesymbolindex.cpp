@@ -0,0 +1,366 @@
+#include "workspacesymbolindex.hpp"
+#include <climits>
+#include <cstring>
+#include <eepp/core/string.hpp>
+#include <eepp/system/clock.hpp>
+#include <eepp/system/fileinfo.hpp>
+#include <eepp/system/filesystem.hpp>
+#include <eepp/system/lock.hpp>
+#include <eepp/system/log.hpp>
+#include <eepp/ui/doc/syntaxdefinitionmanager.hpp>
+#include <eepp/ui/doc/syntaxtokenizer.hpp>
+#include <map>
+#include <unordered_set>
+
+using namespace EE::UI::Doc;
+
+namespace ecode {
+
+static const char INDEX_MAGIC[4] = { 'E', 'W', 'S', 'I' };
+
+// Longer lines are usually minified or generated code, they are not tokenized
+static constexpr size_t MAX_LINE_LENGTH = 4096;
+
+template <typename T> static void writeValue( std::string& buffer, const T& val ) {
+	buffer.append( reinterpret_cast<const char*>( &val ), sizeof( val ) );
+}
+
+template <typename T> static bool readValue( const std::string& buffer, size_t& pos, T& val ) {
+	if ( buffer.size() - pos < sizeof( val ) )
+		return false;
+	memcpy( &val, buffer.data() + pos, sizeof( val ) );
+	pos += sizeof( val );
+	return true;
+}
+
+static void writeString( std::string& buffer, const std::string& str ) {
+	writeValue( buffer, (Uint32)str.size() );
+	buffer.append( str );
+}
+
+static bool readString( const std::string& buffer, size_t& pos, std::string& str ) {
+	Uint32 size = 0;
+	if ( !readValue( buffer, pos, size ) || buffer.size() - pos < size )
+		return false;
+	str.assign( buffer.data() + pos, size );
+	pos += size;
+	return true;
+}
+
+static bool isInsidePath( const std::string& path, const std::string& dir ) {
+	std::string dirPath( dir );
+	FileSystem::dirAddSlashAtEnd( dirPath );
+	return String::startsWith( path, dirPath );
+}
+
+static bool isIdentifier( const std::string& name ) {
+	if ( name.size() < 2 || std::isdigit( (unsigned char)name[0] ) )
+		return false;
+	for ( const auto& chr : name ) {
+		if ( !std::isalnum( (unsigned char)chr ) && chr != '_' && chr != '$' && (Uint8)chr < 0x80 )
+			return false;
+	}
+	return true;
+}
+
+WorkspaceSymbolIndex::WorkspaceSymbolIndex( const std::string& indexPath ) :
+	mIndexPath( indexPath ) {}
+
+void WorkspaceSymbolIndex::build( const std::vector<std::string>& files,
+								  std::shared_ptr<ThreadPool> pool ) {
+	load();
+
+	auto pending = std::make_shared<std::vector<std::pair<std::string, Uint32>>>();
+	{
+		std::unordered_set<std::string> filesSet( files.begin(), files.end() );
+		Lock l( mMutex );
+		for ( auto it = mFiles.begin(); it != mFiles.end(); ) {
+			if ( filesSet.find( it->first ) == filesSet.end() ) {
+				it = mFiles.erase( it );
+				mDirty = true;
+			} else {
+				++it;
+			}
+		}
+	}
+
+	for ( const auto& file : files ) {
+		if ( mStopped )
+			return;
+		FileInfo info( file );
+		Lock l( mMutex );
+		auto& entry = mFiles[file];
+		if ( !entry.indexed || entry.modificationTime != info.getModificationTime() ||
+			 entry.size != info.getSize() )
+			pending->emplace_back( file, entry.changes );
+	}
+
+	// What was loaded can be queried while the rest is indexed
+	mReady = true;
+
+	if ( pending->empty() )
+		return;
+
+	size_t numTasks =
+		std::max<size_t>( 1, std::min<size_t>( pool->numThreads(), pending->size() ) );
+	auto next = std::make_shared<std::atomic<size_t>>( 0 );
+	auto running = std::make_shared<std::atomic<size_t>>( numTasks );
+	auto clock = std::make_shared<Clock>();
+	auto index = shared_from_this();
+	size_t filesCount = files.size();
+
+	for ( size_t i = 0; i < numTasks; i++ ) {
+		pool->run( [index, pending, next, running, clock, filesCount] {
+			size_t pos;
+			while ( !index->mStopped && ( pos = ( *next )++ ) < pending->size() ) {
+				const auto& file = ( *pending )[pos];
+				index->setFile( file.first, indexFile( file.first ), file.second );
+			}
+
+			if ( --( *running ) == 0 ) {
+				Log::info( "WorkspaceSymbolIndex: indexed %zu of %zu files in %.2fms",
+						   pending->size(), filesCount, clock->getElapsedTime().asMilliseconds() );
+				if ( !index->mStopped )
+					index->save();
+			}
+		} );
+	}
+}
+
+void WorkspaceSymbolIndex::stop() {
+	mStopped = true;
+}
+
+bool WorkspaceSymbolIndex::isReady() const {
+	return mReady;
+}
+
+void WorkspaceSymbolIndex::updateFile( const std::string& path ) {
+	Uint32 changes = 0;
+	{
+		Lock l( mMutex );
+		changes = ++mFiles[path].changes;
+	}
+	setFile( path, indexFile( path ), changes );
+}
+
+void WorkspaceSymbolIndex::removeFile( const std::string& path ) {
+	Lock l( mMutex );
+	for ( auto it = mFiles.begin(); it != mFiles.end(); ) {
+		if ( it->first == path || isInsidePath( it->first, path ) ) {
+			it = mFiles.erase( it );
+			mDirty = true;
+		} else {
+			++it;
+		}
+	}
+}
+
+void WorkspaceSymbolIndex::moveFile( const std::string& oldPath, const std::string& newPath ) {
+	Lock l( mMutex );
+	std::string oldDir( oldPath );
+	std::string newDir( newPath );
+	FileSystem::dirAddSlashAtEnd( oldDir );
+	FileSystem::dirAddSlashAtEnd( newDir );
+	std::vector<std::pair<std::string, FileEntry>> moved;
+	for ( auto it = mFiles.begin(); it != mFiles.end(); ) {
+		if ( it->first == oldPath ) {
+			moved.emplace_back( newPath, std::move( it->second ) );
+		} else if ( String::startsWith( it->first, oldDir ) ) {
+			moved.emplace_back( newDir + it->first.substr( oldDir.size() ),
+								std::move( it->second ) );
+		} else {
+			++it;
+			continue;
+		}
+		it = mFiles.erase( it );
+	}
+	for ( auto& file : moved )
+		mFiles[file.first] = std::move( file.second );
+	mDirty = mDirty || !moved.empty();
+}
+
+LSPSymbolInformationList WorkspaceSymbolIndex::query( const std::string& query,
+													  size_t limit ) const {
+	std::multimap<int, std::pair<const std::string*, const Symbol*>, std::greater<int>> matches;
+	LSPSymbolInformationList list;
+	Lock l( mMutex );
+	for ( const auto& file : mFiles ) {
+		for ( const auto& symbol : file.second.symbols ) {
+			int score = String::fuzzyMatch( symbol.name, query );
+			if ( score == INT_MIN ||
+				 ( matches.size() >= limit && score <= std::prev( matches.end() )->first ) )
+				continue;
+			matches.insert( { score, { &file.first, &symbol } } );
+			if ( matches.size() > limit )
+				matches.erase( std::prev( matches.end() ) );
+		}
+	}
+
+	for ( const auto& match : matches ) {
+		const Symbol& symbol = *match.second.second;
+		TextPosition pos( symbol.line, symbol.column );
+		LSPSymbolInformation info( symbol.name, symbol.kind, { pos, pos }, "" );
+		info.url = URI( "file://" + *match.second.first );
+		info.score = match.first;
+		list.emplace_back( std::move( info ) );
+	}
+	return list;
+}
+
+bool WorkspaceSymbolIndex::save() {
+	std::string buffer;
+	{
+		Lock l( mMutex );
+		if ( !mDirty )
+			return true;
+		buffer.append( INDEX_MAGIC, sizeof( INDEX_MAGIC ) );
+		writeValue( buffer, VERSION );
+		writeValue( buffer, (Uint32)mFiles.size() );
+		for ( const auto& file : mFiles ) {
+			writeString( buffer, file.first );
+			writeValue( buffer, file.second.modificationTime );
+			writeValue( buffer, file.second.size );
+			writeValue( buffer, (Uint8)file.second.indexed );
+			writeValue( buffer, (Uint32)file.second.symbols.size() );
+			for ( const auto& symbol : file.second.symbols ) {
+				writeString( buffer, symbol.name );
+				writeValue( buffer, (Uint8)symbol.kind );
+				writeValue( buffer, symbol.line );
+				writeValue( buffer, symbol.column );
+			}
+		}
+		mDirty = false;
+	}
+	return FileSystem::fileWrite( mIndexPath, buffer );
+}
+
+bool WorkspaceSymbolIndex::load() {
+	std::string buffer;
+	if ( !FileSystem::fileExists( mIndexPath ) || !FileSystem::fileGet( mIndexPath, buffer ) )
+		return false;
+
+	size_t pos = sizeof( INDEX_MAGIC );
+	Uint32 version = 0;
+	Uint32 count = 0;
+	if ( buffer.size() < pos || memcmp( buffer.data(), INDEX_MAGIC, pos ) != 0 ||
+		 !readValue( buffer, pos, version ) || version != VERSION ||
+		 !readValue( buffer, pos, count ) )
+		return false;
+
+	std::unordered_map<std::string, FileEntry> files;
+	files.reserve( count );
+	for ( Uint32 i = 0; i < count; i++ ) {
+		std::string path;
+		FileEntry entry;
+		Uint8 indexed = 0;
+		Uint32 symbolsCount = 0;
+		if ( !readString( buffer, pos, path ) ||
+			 !readValue( buffer, pos, entry.modificationTime ) ||
+			 !readValue( buffer, pos, entry.size ) || !readValue( buffer, pos, indexed ) ||
+			 !readValue( buffer, pos, symbolsCount ) )
+			return false;
+		entry.indexed = indexed != 0;
+		for ( Uint32 s = 0; s < symbolsCount; s++ ) {
+			Symbol symbol;
+			Uint8 kind = 0;
+			if ( !readString( buffer, pos, symbol.name ) || !readValue( buffer, pos, kind ) ||
+				 !readValue( buffer, pos, symbol.line ) ||
+				 !readValue( buffer, pos, symbol.column ) )
+				return false;
+			symbol.kind = static_cast<LSPSymbolKind>( kind );
+			entry.symbols.emplace_back( std::move( symbol ) );
+		}
+		files[std::move( path )] = std::move( entry );
+	}
+
+	Lock l( mMutex );
+	// Keep the changes reported while it was loading
+	for ( auto& file : mFiles )
+		files[file.first] = std::move( file.second );
+	mFiles = std::move( files );
+	return true;
+}
+
+void WorkspaceSymbolIndex::setFile( const std::string& path, FileEntry&& entry, Uint32 changes ) {
+	Lock l( mMutex );
+	auto it = mFiles.find( path );
+	// Discard it if the file changed again while it was being indexed
+	if ( it != mFiles.end() && it->second.changes == changes ) {
+		entry.changes = changes;
+		it->second = std::move( entry );
+		mDirty = true;
+	}
+}
+
+WorkspaceSymbolIndex::FileEntry WorkspaceSymbolIndex::indexFile( const std::string& path ) {
+	FileEntry entry;
+	FileInfo info( path );
+	entry.modificationTime = info.getModificationTime();
+	entry.size = info.getSize();
+	entry.indexed = true;
+
+	const SyntaxDefinition& syntax = SyntaxDefinitionManager::instance()->getByExtension( path );
+	std::string text;
+	if ( &syntax == &SyntaxDefinitionManager::instance()->getPlainDefinition() ||
+		 !info.exists() || entry.size > MAX_FILE_SIZE || !FileSystem::fileGet( path, text ) )
+		return entry;
+
+	// Symbol index and indentation of its location, by name and kind
+	std::unordered_map<std::string, std::pair<size_t, size_t>> found;
+	SyntaxState state;
+	std::string line;
+	Uint32 lineNum = 0;
+	size_t start = 0;
+	while ( start < text.size() ) {
+		size_t end = text.find( '\n', start );
+		end = end == std::string::npos ? text.size() : end + 1;
+		if ( end - start > MAX_LINE_LENGTH ) {
+			start = end;
+			lineNum++;
+			continue;
+		}
+		line.assign( text, start, end - start );
+		start = end;
+
+		auto tokens = SyntaxTokenizer::tokenizeComplete( syntax, line, state );
+		state = tokens.second;
+		size_t indent = line.find_first_not_of( " \t" );
+		Uint32 column = 0;
+		for ( const auto& token : tokens.first ) {
+			Uint32 tokenColumn = column;
+			column += token.len;
+			if ( token.type != SyntaxStyleTypes::Function &&
+				 token.type != SyntaxStyleTypes::Keyword2 )
+				continue;
+			std::string name( String::trim( token.text ) );
+			// Type keywords are highlighted as keyword2 too, only the user types are symbols
+			if ( !isIdentifier( name ) || ( token.type == SyntaxStyleTypes::Keyword2 &&
+											syntax.getSymbol( name ) != SyntaxStyleEmpty() ) )
+				continue;
+			Symbol symbol;
+			symbol.kind = token.type == SyntaxStyleTypes::Function ? LSPSymbolKind::Function
+																   : LSPSymbolKind::Class;
+			symbol.line = lineNum;
+			// The trimmed spaces are single byte characters
+			symbol.column = tokenColumn + static_cast<Uint32>( token.text.find( name ) );
+			std::string key( name + ( symbol.kind == LSPSymbolKind::Function ? "(" : "" ) );
+			auto it = found.find( key );
+			if ( it == found.end() ) {
+				symbol.name = std::move( name );
+				found[key] = { entry.symbols.size(), indent };
+				entry.symbols.emplace_back( std::move( symbol ) );
+			} else if ( indent < it->second.second ) {
+				auto& prev = entry.symbols[it->second.first];
+				prev.line = symbol.line;
+				prev.column = symbol.column;
+				it->second.second = indent;
+			}
+		}
+		lineNum++;
+	}
+	entry.symbols.shrink_to_fit();
+	return entry;
+}
+
+} // namespace ecode
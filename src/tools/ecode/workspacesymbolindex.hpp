@@ -0,0 +1,90 @@
+#ifndef ECODE_WORKSPACESYMBOLINDEX_HPP
+#define ECODE_WORKSPACESYMBOLINDEX_HPP
+
+#include "plugins/lsp/lspprotocol.hpp"
+#include <atomic>
+#include <eepp/config.hpp>
+#include <eepp/system/mutex.hpp>
+#include <eepp/system/threadpool.hpp>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace EE;
+using namespace EE::System;
+
+namespace ecode {
+
+/** Index of the functions and types of the project files, built from the syntax highlighting
+ * tokens, so the workspace symbols can be searched without a language server.
+ * Every file keeps one location per symbol name: the least indented occurrence, that is usually
+ * the definition. */
+class WorkspaceSymbolIndex : public std::enable_shared_from_this<WorkspaceSymbolIndex> {
+  public:
+	static constexpr Uint32 VERSION = 1;
+
+	/** Files bigger than this are not indexed. */
+	static constexpr Uint64 MAX_FILE_SIZE = 2 * 1024 * 1024;
+
+	explicit WorkspaceSymbolIndex( const std::string& indexPath );
+
+	/** Loads the saved index and indexes the files added or modified since it was saved, with one
+	 * task per thread of the pool. */
+	void build( const std::vector<std::string>& files, std::shared_ptr<ThreadPool> pool );
+
+	/** Stops a running build, what was indexed is kept. */
+	void stop();
+
+	bool isReady() const;
+
+	/** Indexes the file again. */
+	void updateFile( const std::string& path );
+
+	/** Removes the file, or every file inside the folder if path is a folder. */
+	void removeFile( const std::string& path );
+
+	/** Renames the file, or the files inside the folder if oldPath is a folder. */
+	void moveFile( const std::string& oldPath, const std::string& newPath );
+
+	/** @return The symbols that fuzzy match the query, best matches first. */
+	LSPSymbolInformationList query( const std::string& query, size_t limit ) const;
+
+	bool save();
+
+	const std::string& getIndexPath() const { return mIndexPath; }
+
+  protected:
+	struct Symbol {
+		std::string name;
+		LSPSymbolKind kind{ LSPSymbolKind::Function };
+		Uint32 line{ 0 };
+		Uint32 column{ 0 };
+	};
+
+	struct FileEntry {
+		Uint64 modificationTime{ 0 };
+		Uint64 size{ 0 };
+		std::vector<Symbol> symbols;
+		// Times it changed, to discard an indexing that read an old version of the file
+		Uint32 changes{ 0 };
+		bool indexed{ false };
+	};
+
+	std::string mIndexPath;
+	std::unordered_map<std::string, FileEntry> mFiles;
+	mutable Mutex mMutex;
+	std::atomic<bool> mReady{ false };
+	std::atomic<bool> mStopped{ false };
+	bool mDirty{ false };
+
+	bool load();
+
+	void setFile( const std::string& path, FileEntry&& entry, Uint32 changes );
+
+	static FileEntry indexFile( const std::string& path );
+};
+
+} // namespace ecode
+
+#endif // ECODE_WORKSPACESYMBOLINDEX_HPP